@@ -42,6 +42,48 @@ int HAL_Download_Write(_IN_ void * handle,_IN_ uint32_t total_length,_IN_ uint8_
  */
 int HAL_Download_End(_IN_ void * handle);
 
+/**
+ * @brief 打开用于MQTT离线消息存储的分区
+ *
+ * @param name              分区名
+ * @param size              输出分区大小, 单位为字节
+ * @param sector_size       输出分区的擦除块大小, 单位为字节
+ * @return                  指向分区结构体的指针, 失败返回NULL
+ */
+void * HAL_Store_Open(_IN_ const char *name, _OU_ uint32_t *size, _OU_ uint32_t *sector_size);
+
+/**
+ * @brief 从分区offset处读取length字节的数据
+ *
+ * @param    handle          指向分区结构体的指针
+ * @param    offset          分区内的偏移
+ * @param    buffer          数据的指针
+ * @param    length          数据的长度，单位为字节
+ * @return                  -1失败 0成功
+ */
+int HAL_Store_Read(_IN_ void * handle, _IN_ uint32_t offset, _OU_ uint8_t *buffer, _IN_ uint32_t length);
+
+/**
+ * @brief 将length字节的数据写入分区offset处, 写入的区域须已擦除
+ *
+ * @param    handle          指向分区结构体的指针
+ * @param    offset          分区内的偏移
+ * @param    buffer          数据的指针
+ * @param    length          数据的长度，单位为字节
+ * @return                  -1失败 0成功
+ */
+int HAL_Store_Write(_IN_ void * handle, _IN_ uint32_t offset, _IN_ const uint8_t *buffer, _IN_ uint32_t length);
+
+/**
+ * @brief 擦除分区offset处length字节的区域, offset和length须按擦除块对齐
+ *
+ * @param    handle          指向分区结构体的指针
+ * @param    offset          分区内的偏移
+ * @param    length          擦除的长度，单位为字节
+ * @return                  -1失败 0成功
+ */
+int HAL_Store_Erase(_IN_ void * handle, _IN_ uint32_t offset, _IN_ uint32_t length);
+
 
 #if defined(__cplusplus)
 }
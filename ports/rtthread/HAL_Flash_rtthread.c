@@ -67,4 +67,49 @@ int HAL_Download_End(_IN_ void * handle)
     return SUCCESS_RET;
 }
 
+void * HAL_Store_Open(_IN_ const char *name, _OU_ uint32_t *size, _OU_ uint32_t *sector_size)
+{
+    const struct fal_partition * part = RT_NULL;
+    const struct fal_flash_dev * flash = RT_NULL;
+
+    if ((part = fal_partition_find(name)) == RT_NULL)
+    {
+        LOG_ERROR("Partition (%s) find error!", name);
+        return NULL;
+    }
+    if ((flash = fal_flash_device_find(part->flash_name)) == RT_NULL)
+    {
+        LOG_ERROR("Flash device (%s) find error!", part->flash_name);
+        return NULL;
+    }
+
+    *size = part->len;
+    *sector_size = flash->blk_size;
+    return (void *)part;
+}
+
+int HAL_Store_Read(_IN_ void * handle, _IN_ uint32_t offset, _OU_ uint8_t *buffer, _IN_ uint32_t length)
+{
+    const struct fal_partition * part = (struct fal_partition *) handle;
+    if (fal_partition_read(part, offset, buffer, length) < 0)
+        return FAILURE_RET;
+    return SUCCESS_RET;
+}
+
+int HAL_Store_Write(_IN_ void * handle, _IN_ uint32_t offset, _IN_ const uint8_t *buffer, _IN_ uint32_t length)
+{
+    const struct fal_partition * part = (struct fal_partition *) handle;
+    if (fal_partition_write(part, offset, buffer, length) < 0)
+        return FAILURE_RET;
+    return SUCCESS_RET;
+}
+
+int HAL_Store_Erase(_IN_ void * handle, _IN_ uint32_t offset, _IN_ uint32_t length)
+{
+    const struct fal_partition * part = (struct fal_partition *) handle;
+    if (fal_partition_erase(part, offset, length) < 0)
+        return FAILURE_RET;
+    return SUCCESS_RET;
+}
+
 
@@ -63,6 +63,51 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     return;
 }
 
+static int g_semnum = 0;
+
+void *HAL_SemaphoreCreate(void)
+{
+    char name[RT_NAME_MAX];
+    rt_snprintf(name, RT_NAME_MAX, "sem%d", g_semnum);
+    g_semnum++;
+    return rt_sem_create(name, 0, RT_IPC_FLAG_FIFO);
+}
+
+void HAL_SemaphoreDestroy(_IN_ void *sem)
+{
+    rt_sem_delete((rt_sem_t)sem);
+    return;
+}
+
+void HAL_SemaphorePost(_IN_ void *sem)
+{
+    rt_sem_release((rt_sem_t)sem);
+    return;
+}
+
+IoT_Error_t HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms)
+{
+    if (RT_EOK != rt_sem_take((rt_sem_t)sem, rt_tick_from_millisecond(timeout_ms))) {
+        return FAILURE_RET;
+    }
+
+    return SUCCESS_RET;
+}
+
+IoT_Error_t HAL_ThreadCreate(_IN_ const char *name, _IN_ void (*entry)(void *), _IN_ void *arg,
+                             _IN_ uint32_t stack_size, _IN_ uint8_t priority)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create(name, entry, arg, stack_size, priority, 10);
+    if (RT_NULL == tid) {
+        return FAILURE_RET;
+    }
+    rt_thread_startup(tid);
+
+    return SUCCESS_RET;
+}
+
 void *HAL_Malloc(_IN_ uint32_t size)
 {
     return rt_malloc(size);
@@ -17,12 +17,16 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/select.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
 
 #include <rtthread.h>
 #include "uiot_import.h"
 
+/* HAL_TCP_Writev单次sendmsg发送的最大数据块个数, 更多的数据块分批发送 */
+#define RTTHREAD_WRITEV_MAX     (8)
+
 static uint64_t rtthread_get_time_ms(void)
 {
 #if (RT_TICK_PER_SECOND == 1000)
@@ -51,6 +55,31 @@ static uint64_t rtthread_time_left(uint64_t t_end, uint64_t t_now)
     return t_left;
 }
 
+/* 等待套接字可读(is_write为0)或可写, 返回值 >0: 就绪; =0: 超时; <0: 错误 */
+static int rtthread_select(int tcp_fd, int is_write, uint64_t t_left)
+{
+    int ret;
+    fd_set fds;
+    struct timeval tv;
+
+    FD_ZERO(&fds);
+    FD_SET(tcp_fd, &fds);
+
+    tv.tv_sec = t_left / 1000;
+    tv.tv_usec = (t_left % 1000) * 1000;
+
+    ret = select(tcp_fd + 1, is_write ? NULL : &fds, is_write ? &fds : NULL, NULL, &tv);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        printf("select fail\n");
+        return ret;
+    }
+
+    return (ret > 0 && FD_ISSET(tcp_fd, &fds)) ? 1 : 0;
+}
+
 uintptr_t HAL_TCP_Connect(_IN_ const char *host, _IN_ uint16_t port) {
     struct addrinfo hints;
     struct addrinfo *addrInfoList = NULL;
@@ -122,35 +151,101 @@ int32_t HAL_TCP_Disconnect(_IN_ uintptr_t fd) {
 
 int32_t HAL_TCP_Write(_IN_ uintptr_t fd, _IN_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms) {
     int ret,tcp_fd;
+    IoT_Error_t err_code;
     size_t len_sent;
     uint64_t t_end;
 
     t_end = rtthread_get_time_ms() + timeout_ms;
     len_sent = 0;
-    ret = 1; /* send one time if timeout_ms is value 0 */
+    err_code = SUCCESS_RET;
 
     tcp_fd = (int)fd;
 
     do {
-        uint64_t t_left = rtthread_time_left(t_end, rtthread_get_time_ms());
+        /* send one time if timeout_ms is value 0 */
+        ret = rtthread_select(tcp_fd, 1, rtthread_time_left(t_end, rtthread_get_time_ms()));
+        if (ret < 0) {
+            err_code = ERR_TCP_WRITE_FAILED;
+            break;
+        } else if (ret == 0) {
+            continue;
+        }
 
-        ret = send(tcp_fd, buf + len_sent, len - len_sent, 0);
+        ret = send(tcp_fd, buf + len_sent, len - len_sent, MSG_DONTWAIT);
         if (ret > 0) {
             len_sent += ret;
         } 
-        else if (errno == EINTR || errno == EAGAIN){
-            printf("send fail,try again\n");
+        else if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+            printf("send fail\n");
+            err_code = ERR_TCP_WRITE_FAILED;
+            break;
+        }
+    } while ((len_sent < len) && (rtthread_time_left(t_end, rtthread_get_time_ms()) > 0));
+
+    return (0 != len_sent) ? len_sent : err_code;
+}
+
+
+int32_t HAL_TCP_Writev(_IN_ uintptr_t fd, _IN_ utils_iovec_t *iov, _IN_ int iovcnt, _IN_ uint32_t timeout_ms) {
+    int ret,tcp_fd,i,cnt;
+    IoT_Error_t err_code;
+    size_t len, len_sent, offset;
+    uint64_t t_end;
+    struct iovec vec[RTTHREAD_WRITEV_MAX];
+    struct msghdr msg;
+
+    len = 0;
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].len;
+    }
+
+    t_end = rtthread_get_time_ms() + timeout_ms;
+    len_sent = 0;
+    err_code = SUCCESS_RET;
+
+    tcp_fd = (int)fd;
+
+    do {
+        ret = rtthread_select(tcp_fd, 1, rtthread_time_left(t_end, rtthread_get_time_ms()));
+        if (ret < 0) {
+            err_code = ERR_TCP_WRITE_FAILED;
+            break;
+        } else if (ret == 0) {
             continue;
         }
-        else{
+
+        /* 跳过已经发送的数据, 一次最多发送RTTHREAD_WRITEV_MAX个数据块 */
+        offset = len_sent;
+        cnt = 0;
+        for (i = 0; i < iovcnt && cnt < RTTHREAD_WRITEV_MAX; ++i) {
+            if (offset >= iov[i].len) {
+                offset -= iov[i].len;
+                continue;
+            }
+            vec[cnt].iov_base = iov[i].base + offset;
+            vec[cnt].iov_len = iov[i].len - offset;
+            offset = 0;
+            cnt++;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = cnt;
+
+        ret = sendmsg(tcp_fd, &msg, MSG_DONTWAIT);
+        if (ret > 0) {
+            len_sent += ret;
+        }
+        else if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+            printf("sendmsg fail\n");
+            err_code = ERR_TCP_WRITE_FAILED;
             break;
         }
-    } while ((len_sent < len)&& (rtthread_time_left(t_end, rtthread_get_time_ms()) > 0));
+    } while ((len_sent < len) && (rtthread_time_left(t_end, rtthread_get_time_ms()) > 0));
 
-    return len_sent > 0 ? len_sent : ERR_TCP_WRITE_FAILED;
+    return (0 != len_sent) ? len_sent : err_code;
 }
 
-
 int32_t HAL_TCP_Read(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms) {
     int ret,tcp_fd;
     IoT_Error_t err_code;
@@ -168,22 +263,28 @@ int32_t HAL_TCP_Read(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len
         if (0 == t_left) {
             break;
         }
-        
+
+        ret = rtthread_select(tcp_fd, 0, t_left);
+        if (ret < 0) {
+            err_code = ERR_TCP_READ_FAILED;
+            break;
+        } else if (ret == 0) {
+            continue;
+        }
+
         ret = recv(tcp_fd, buf + len_recv, len - len_recv, MSG_DONTWAIT);
         if (ret > 0) {
             len_recv += ret;
         }
         else if (0 == ret) 
         {
-            continue;
+            printf("connection is closed by peer\n");
+            err_code = ERR_TCP_PEER_SHUTDOWN;
+            break;
         }
-        else 
+        else if (errno != EINTR && errno != EAGAIN)
         {
-            if (errno == EINTR || errno == EAGAIN)
-            {
-                continue;
-            }
-            printf("read fail,try again\n");
+            printf("read fail\n");
             err_code = ERR_TCP_READ_FAILED;
             break;
         }
@@ -192,4 +293,83 @@ int32_t HAL_TCP_Read(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len
     return (0 != len_recv) ? len_recv : err_code;
 }
 
+int32_t HAL_TCP_WaitReadable(_IN_ uintptr_t fd, _IN_ uint32_t timeout_ms) {
+    int ret;
+
+    ret = rtthread_select((int)fd, 0, timeout_ms);
+
+    return (ret < 0) ? ERR_TCP_READ_FAILED : ret;
+}
+
+int32_t HAL_TCP_WaitReadableMany(_IN_ uintptr_t *fds, _OU_ uint8_t *readable, _IN_ int count, _IN_ uint32_t timeout_ms) {
+    int ret, i;
+    int max_fd = -1;
+    fd_set fds_set;
+    struct timeval tv;
+
+    FD_ZERO(&fds_set);
+    for (i = 0; i < count; ++i) {
+        readable[i] = 0;
+        FD_SET((int)fds[i], &fds_set);
+        if ((int)fds[i] > max_fd) {
+            max_fd = (int)fds[i];
+        }
+    }
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(max_fd + 1, &fds_set, NULL, NULL, &tv);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        printf("select fail\n");
+        return ERR_TCP_READ_FAILED;
+    }
+
+    ret = 0;
+    for (i = 0; i < count; ++i) {
+        if (FD_ISSET((int)fds[i], &fds_set)) {
+            readable[i] = 1;
+            ret++;
+        }
+    }
+
+    return ret;
+}
+
+int32_t HAL_TCP_ReadAvail(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms) {
+    int ret,tcp_fd;
+    uint64_t t_end;
+
+    t_end = rtthread_get_time_ms() + timeout_ms;
+
+    tcp_fd = (int)fd;
+
+    do {
+        ret = rtthread_select(tcp_fd, 0, rtthread_time_left(t_end, rtthread_get_time_ms()));
+        if (ret < 0) {
+            return ERR_TCP_READ_FAILED;
+        } else if (ret == 0) {
+            continue;
+        }
 
+        ret = recv(tcp_fd, buf, len, MSG_DONTWAIT);
+        if (ret > 0) {
+            return ret;
+        }
+        else if (0 == ret)
+        {
+            printf("connection is closed by peer\n");
+            return ERR_TCP_PEER_SHUTDOWN;
+        }
+        else if (errno != EINTR && errno != EAGAIN)
+        {
+            printf("read fail\n");
+            return ERR_TCP_READ_FAILED;
+        }
+    } while (rtthread_time_left(t_end, rtthread_get_time_ms()) > 0);
+
+    return 0;
+}
@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/select.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +33,12 @@ extern "C" {
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
 
+/* mbedtls_ssl_read单次阻塞等待的默认超时时间 */
+#define TLS_READ_TIMEOUT_MS     10000
+
+/* HAL_TLS_Writev合并小数据块的暂存区大小 */
+#define TLS_WRITEV_STAGE_LEN    256
+
 /**
  * @brief 用于保存SSL连接相关数据结构
  */
@@ -44,6 +51,7 @@ typedef struct {
     mbedtls_x509_crt ca_cert;             // ca证书信息
     mbedtls_x509_crt client_cert;         // 客户端证书信息
     mbedtls_pk_context private_key;       // 客户端私钥信息
+    unsigned char writev_stage[TLS_WRITEV_STAGE_LEN];    // 合并小数据块的暂存区
 } TLSDataParams;
 
 /**
@@ -153,7 +161,18 @@ int _server_certificate_verify(void *hostname, mbedtls_x509_crt *crt, int depth,
 
 uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16_t authmode, _IN_ const char *ca_crt,
                           _IN_ size_t ca_crt_len) {
+    return HAL_TLS_ConnectResume(host, port, authmode, ca_crt, ca_crt_len, NULL, NULL);
+}
+
+uintptr_t HAL_TLS_ConnectResume(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16_t authmode,
+                                _IN_ const char *ca_crt, _IN_ size_t ca_crt_len, _IN_ void *session,
+                                _OU_ uint8_t *resumed) {
     int ret = 0;
+    mbedtls_ssl_session *saved = (mbedtls_ssl_session *) session;
+
+    if (NULL != resumed) {
+        *resumed = 0;
+    }
 
     TLSDataParams *pDataParams = (TLSDataParams *) HAL_Malloc(sizeof(TLSDataParams));
 
@@ -181,7 +200,12 @@ uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16
 
     mbedtls_ssl_conf_ca_chain(&(pDataParams->ssl_conf), &(pDataParams->ca_cert), NULL);
 
-    mbedtls_ssl_conf_read_timeout(&(pDataParams->ssl_conf), 10000);
+    mbedtls_ssl_conf_read_timeout(&(pDataParams->ssl_conf), TLS_READ_TIMEOUT_MS);
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&(pDataParams->ssl_conf), MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
     if ((ret = mbedtls_ssl_setup(&(pDataParams->ssl), &(pDataParams->ssl_conf))) != 0) {
         LOG_ERROR("failed! mbedtls_ssl_setup returned -0x%x\n", -ret);
         goto error;
@@ -193,6 +217,11 @@ uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16
         goto error;
     }
 
+    // 恢复上一次连接的会话, 失败时不影响完整握手
+    if (NULL != saved && 0 != (ret = mbedtls_ssl_set_session(&(pDataParams->ssl), saved))) {
+        LOG_DEBUG("mbedtls_ssl_set_session returned -0x%x, full handshake", -ret);
+    }
+
     LOG_DEBUG("SSL state connect : %d ", pDataParams->ssl.state);
     mbedtls_ssl_set_bio(&(pDataParams->ssl), &(pDataParams->socket_fd), mbedtls_net_send, mbedtls_net_recv,
                         mbedtls_net_recv_timeout);
@@ -216,6 +245,13 @@ uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16
 
     //mbedtls_ssl_conf_read_timeout(&(pDataParams->ssl_conf), 100);
 
+    // 恢复会话时沿用原来的主密钥, 完整握手会协商新的主密钥; Session ID和Session Ticket两种方式都适用
+    if (NULL != saved && NULL != resumed
+        && 0 == memcmp(saved->master, pDataParams->ssl.session->master, sizeof(saved->master))) {
+        *resumed = 1;
+        LOG_DEBUG("TLS session resumed");
+    }
+
     LOG_INFO("connected with /%s/%d...", host, port);
 
     return (uintptr_t) pDataParams;
@@ -225,6 +261,42 @@ uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16
     return 0;
 }
 
+int32_t HAL_TLS_SaveSession(_IN_ uintptr_t handle, _OU_ void **session) {
+    if ((uintptr_t) NULL == handle || NULL == session) {
+        return FAILURE_RET;
+    }
+    TLSDataParams *pParams = (TLSDataParams *) handle;
+    mbedtls_ssl_session *saved = (mbedtls_ssl_session *) *session;
+
+    if (NULL == saved) {
+        if (NULL == (saved = (mbedtls_ssl_session *) HAL_Malloc(sizeof(mbedtls_ssl_session)))) {
+            return FAILURE_RET;
+        }
+    } else {
+        mbedtls_ssl_session_free(saved);
+    }
+    mbedtls_ssl_session_init(saved);
+
+    if (0 != mbedtls_ssl_get_session(&(pParams->ssl), saved)) {
+        mbedtls_ssl_session_free(saved);
+        HAL_Free(saved);
+        *session = NULL;
+        return FAILURE_RET;
+    }
+
+    *session = saved;
+    return SUCCESS_RET;
+}
+
+void HAL_TLS_FreeSession(_IN_ void *session) {
+    if (NULL == session) {
+        return;
+    }
+
+    mbedtls_ssl_session_free((mbedtls_ssl_session *) session);
+    HAL_Free(session);
+}
+
 int32_t HAL_TLS_Disconnect(_IN_ uintptr_t handle) {
     if ((uintptr_t) NULL == handle) {
         LOG_DEBUG("handle is NULL");
@@ -272,6 +344,77 @@ int32_t HAL_TLS_Write(_IN_ uintptr_t handle, _IN_ unsigned char *buf, _IN_ size_
     return written_so_far;
 }
 
+/*
+ * 较小的数据块先拼接到暂存区, 凑满暂存区或遇到较大的数据块时与其开头部分合并成一个TLS记录发送,
+ * 较大数据块的剩余部分直接从调用者的内存发送, 避免把整个报文拷贝一次.
+ */
+int32_t HAL_TLS_Writev(_IN_ uintptr_t handle, _IN_ utils_iovec_t *iov, _IN_ int iovcnt, _IN_ uint32_t timeout_ms) {
+    Timer timer;
+    HAL_Timer_Init(&timer);
+    HAL_Timer_Countdown_ms(&timer, (unsigned int) timeout_ms);
+    size_t written_so_far = 0;
+    size_t stage_len = 0;
+    size_t fill, len;
+    unsigned char *base;
+    int write_rc = 0;
+    int i;
+
+    TLSDataParams *pParams = (TLSDataParams *) handle;
+
+    for (i = 0; i < iovcnt; ++i) {
+        base = iov[i].base;
+        len = iov[i].len;
+
+        if (stage_len + len <= TLS_WRITEV_STAGE_LEN) {
+            memcpy(pParams->writev_stage + stage_len, base, len);
+            stage_len += len;
+            continue;
+        }
+
+        if (stage_len > 0) {
+            fill = TLS_WRITEV_STAGE_LEN - stage_len;
+            memcpy(pParams->writev_stage + stage_len, base, fill);
+            base += fill;
+            len -= fill;
+
+            write_rc = HAL_TLS_Write(handle, pParams->writev_stage, TLS_WRITEV_STAGE_LEN, HAL_Timer_Remain_ms(&timer));
+            if (write_rc < 0) {
+                return (0 != written_so_far) ? written_so_far : write_rc;
+            }
+            written_so_far += write_rc;
+            stage_len = 0;
+            if (write_rc < TLS_WRITEV_STAGE_LEN) {
+                return written_so_far;
+            }
+        }
+
+        if (len < TLS_WRITEV_STAGE_LEN) {
+            memcpy(pParams->writev_stage, base, len);
+            stage_len = len;
+            continue;
+        }
+
+        write_rc = HAL_TLS_Write(handle, base, len, HAL_Timer_Remain_ms(&timer));
+        if (write_rc < 0) {
+            return (0 != written_so_far) ? written_so_far : write_rc;
+        }
+        written_so_far += write_rc;
+        if ((size_t)write_rc < len) {
+            return written_so_far;
+        }
+    }
+
+    if (stage_len > 0) {
+        write_rc = HAL_TLS_Write(handle, pParams->writev_stage, stage_len, HAL_Timer_Remain_ms(&timer));
+        if (write_rc < 0) {
+            return (0 != written_so_far) ? written_so_far : write_rc;
+        }
+        written_so_far += write_rc;
+    }
+
+    return written_so_far;
+}
+
 int32_t HAL_TLS_Read(_IN_ uintptr_t handle, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms) {
     Timer timer;
     HAL_Timer_Init(&timer);
@@ -300,6 +443,104 @@ int32_t HAL_TLS_Read(_IN_ uintptr_t handle, _OU_ unsigned char *buf, _IN_ size_t
     return read_len;
 }
 
+int32_t HAL_TLS_WaitReadable(_IN_ uintptr_t handle, _IN_ uint32_t timeout_ms) {
+    int ret = 0;
+
+    TLSDataParams *pParams = (TLSDataParams *) handle;
+
+    /* 上一个TLS记录中已解密但尚未读取的数据 */
+    if (mbedtls_ssl_get_bytes_avail(&(pParams->ssl)) > 0) {
+        return 1;
+    }
+
+    ret = mbedtls_net_poll(&(pParams->socket_fd), MBEDTLS_NET_POLL_READ, timeout_ms);
+    if (ret < 0) {
+        LOG_ERROR("failed! mbedtls_net_poll returned -0x%x\n", -ret);
+        return ERR_SSL_READ_FAILED;
+    }
+
+    return (ret & MBEDTLS_NET_POLL_READ) ? 1 : 0;
+}
+
+int32_t HAL_TLS_WaitReadableMany(_IN_ uintptr_t *handles, _OU_ uint8_t *readable, _IN_ int count, _IN_ uint32_t timeout_ms) {
+    int ret = 0, i;
+    int max_fd = -1;
+    fd_set fds_set;
+    struct timeval tv;
+    TLSDataParams *pParams;
+
+    FD_ZERO(&fds_set);
+    for (i = 0; i < count; ++i) {
+        pParams = (TLSDataParams *) handles[i];
+        readable[i] = 0;
+
+        /* 上一个TLS记录中已解密但尚未读取的数据 */
+        if (mbedtls_ssl_get_bytes_avail(&(pParams->ssl)) > 0) {
+            readable[i] = 1;
+            ret++;
+        }
+
+        FD_SET(pParams->socket_fd.fd, &fds_set);
+        if (pParams->socket_fd.fd > max_fd) {
+            max_fd = pParams->socket_fd.fd;
+        }
+    }
+
+    if (ret > 0) {
+        return ret;
+    }
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(max_fd + 1, &fds_set, NULL, NULL, &tv);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        LOG_ERROR("failed! select returned %d\n", ret);
+        return ERR_SSL_READ_FAILED;
+    }
+
+    ret = 0;
+    for (i = 0; i < count; ++i) {
+        if (FD_ISSET(((TLSDataParams *) handles[i])->socket_fd.fd, &fds_set)) {
+            readable[i] = 1;
+            ret++;
+        }
+    }
+
+    return ret;
+}
+
+int32_t HAL_TLS_ReadAvail(_IN_ uintptr_t handle, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms) {
+    Timer timer;
+    HAL_Timer_Init(&timer);
+    HAL_Timer_Countdown_ms(&timer, timeout_ms);
+    int read_rc = 0;
+
+    TLSDataParams *pParams = (TLSDataParams *) handle;
+
+    /* mbedtls_ssl_read在有已解密的数据时直接返回, 否则按read_timeout阻塞等待下一个TLS记录 */
+    mbedtls_ssl_conf_read_timeout(&(pParams->ssl_conf), (timeout_ms > 0) ? timeout_ms : 1);
+
+    do {
+        read_rc = mbedtls_ssl_read(&(pParams->ssl), buf, len);
+    } while ((read_rc == MBEDTLS_ERR_SSL_WANT_READ || read_rc == MBEDTLS_ERR_SSL_WANT_WRITE) && !HAL_Timer_Expired(&timer));
+
+    mbedtls_ssl_conf_read_timeout(&(pParams->ssl_conf), TLS_READ_TIMEOUT_MS);
+
+    if (read_rc > 0) {
+        return read_rc;
+    } else if (read_rc == MBEDTLS_ERR_SSL_TIMEOUT || read_rc == MBEDTLS_ERR_SSL_WANT_READ
+               || read_rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+
+    LOG_ERROR("failed! mbedtls_ssl_read returned -0x%x\n", -read_rc);
+    return ERR_SSL_READ_FAILED;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,7 @@ typedef struct {
     void       *callbacks[DM_TYPE_MAX];
     char       *upstream_topic_templates[DM_TYPE_MAX];
     char       *downstream_topic_templates[DM_TYPE_MAX];
+    void       *pub_handles[DM_TYPE_MAX];
     void       *context;
 } DM_MQTT_Struct_t;
 
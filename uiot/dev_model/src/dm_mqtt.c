@@ -88,7 +88,13 @@ static int _dm_mqtt_gen_event_payload(char *buf, size_t buf_len, int request_id,
     FUNC_EXIT_RC(SUCCESS_RET);
 }
 
-static int _dm_mqtt_publish(DM_MQTT_Struct_t *handle, char *topic_name, int qos, const char *msg) {
+/* 事件上报(如告警)需要尽快送达, 不能排在属性上报等普通消息之后 */
+static MQTTPubPriority _dm_mqtt_type_priority(DM_Type type) {
+    return (EVENT_POST == type) ? MQTT_PRIORITY_CRITICAL : MQTT_PRIORITY_NORMAL;
+}
+
+static int _dm_mqtt_publish(DM_MQTT_Struct_t *handle, char *topic_name, int qos, MQTTPubPriority priority,
+                            const char *msg) {
     FUNC_ENTRY;
 
     int ret;
@@ -102,6 +108,7 @@ static int _dm_mqtt_publish(DM_MQTT_Struct_t *handle, char *topic_name, int qos,
     }
     pub_params.payload = (void *) msg;
     pub_params.payload_len = strlen(msg);
+    pub_params.priority = priority;
 
     ret = IOT_MQTT_Publish(handle->mqtt, topic_name, &pub_params);
     if (ret < 0) {
@@ -112,6 +119,31 @@ static int _dm_mqtt_publish(DM_MQTT_Struct_t *handle, char *topic_name, int qos,
     FUNC_EXIT_RC(ret);
 }
 
+/* 上行主题固定的消息通过注册回调时创建的发布句柄发送, 不必每次生成主题 */
+static int _dm_mqtt_publish_by_type(DM_MQTT_Struct_t *handle, DM_Type type, const char *msg) {
+    FUNC_ENTRY;
+
+    int ret;
+    char topic[DM_TOPIC_BUF_LEN];
+
+    if (NULL == handle->pub_handles[type]) {
+        if (SUCCESS_RET != _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->upstream_topic_templates[type],
+                handle->product_sn, handle->device_sn)) {
+            LOG_ERROR("generate topic name failed\r\n");
+            FUNC_EXIT_RC(FAILURE_RET);
+        }
+        FUNC_EXIT_RC(_dm_mqtt_publish(handle, topic, 1, _dm_mqtt_type_priority(type), msg));
+    }
+
+    ret = IOT_MQTT_PublishWith(handle->pub_handles[type], (void *) msg, strlen(msg));
+    if (ret < 0) {
+        LOG_ERROR("publish to topic type: %d failed\r\n", type);
+        FUNC_EXIT_RC(FAILURE_RET);
+    }
+
+    FUNC_EXIT_RC(ret);
+}
+
 static void _dm_mqtt_common_reply_cb(MQTTMessage *message, CommonReplyCB cb) {
     FUNC_ENTRY;
 
@@ -237,7 +269,6 @@ void dm_mqtt_property_set_cb(void *pClient, MQTTMessage *message, void *pContext
     char *request_id = NULL;
     char *property = NULL;
     char *msg_reply = NULL;
-    char *topic = NULL;
     char *msg = NULL;
 
     if (NULL == (msg = HAL_Malloc(message->payload_len + 1))) {
@@ -263,21 +294,12 @@ void dm_mqtt_property_set_cb(void *pClient, MQTTMessage *message, void *pContext
         LOG_ERROR("allocate for msg_reply failed\r\n");
         goto do_exit;
     }
-    if (NULL == (topic = HAL_Malloc(DM_TOPIC_BUF_LEN))) {
-        LOG_ERROR("allocate for topic failed\r\n");
-        goto do_exit;
-    }
-    if (SUCCESS_RET != _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->upstream_topic_templates[PROPERTY_SET],
-            handle->product_sn, handle->device_sn)) {
-        LOG_ERROR("generate topic name failed\r\n");
-        goto do_exit;
-    }
     ret = HAL_Snprintf(msg_reply, DM_MSG_REPLY_BUF_LEN, "{\"RequestID\": \"%s\", \"RetCode\": %d}", request_id, cb_ret);
     if (ret < 0 || ret >= DM_MSG_REPLY_BUF_LEN) {
         LOG_ERROR("HAL_Snprintf msg_reply failed\r\n");
         goto do_exit;
     }
-    ret = _dm_mqtt_publish(handle, topic, 1, msg_reply);
+    ret = _dm_mqtt_publish_by_type(handle, PROPERTY_SET, msg_reply);
     if (ret < 0) {
         LOG_ERROR("mqtt publish msg failed\r\n");
         goto do_exit;
@@ -288,7 +310,6 @@ do_exit:
     HAL_Free(request_id);
     HAL_Free(property);
     HAL_Free(msg_reply);
-    HAL_Free(topic);
 
     FUNC_EXIT;
 }
@@ -457,7 +478,7 @@ void dm_mqtt_command_cb(void *pClient, MQTTMessage *message, void *pContext) {
         LOG_ERROR("generate cmd_reply msg failed\r\n");
         goto do_exit;
     }
-    ret = _dm_mqtt_publish(handle, topic, 1, cmd_reply);
+    ret = _dm_mqtt_publish(handle, topic, 1, MQTT_PRIORITY_NORMAL, cmd_reply);
     if (ret < 0) {
         LOG_ERROR("mqtt publish msg failed\r\n");
         goto do_exit;
@@ -488,6 +509,22 @@ int _dsc_mqtt_register_callback(DM_MQTT_Struct_t *handle, DM_Type dm_type, void
     handle->downstream_topic_templates[dm_type] = g_dm_mqtt_cb[dm_type].downstream_topic_template;
 
     char topic[DM_TOPIC_BUF_LEN];
+
+    /* 命令回复的主题中带有RequestID, 不能预先创建发布句柄 */
+    if (COMMAND != dm_type && NULL == handle->pub_handles[dm_type]) {
+        ret = _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->upstream_topic_templates[dm_type],
+                                      handle->product_sn, handle->device_sn);
+        if (SUCCESS_RET == ret) {
+            handle->pub_handles[dm_type] = IOT_MQTT_PreparePublish(handle->mqtt, topic, QOS1);
+        }
+        if (NULL != handle->pub_handles[dm_type]) {
+            IOT_MQTT_SetPublishPriority(handle->pub_handles[dm_type], _dm_mqtt_type_priority(dm_type));
+        }
+        if (NULL == handle->pub_handles[dm_type]) {
+            LOG_WARN("prepare publish handle failed, topic will be generated on every publish\r\n");
+        }
+    }
+
     ret = _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->downstream_topic_templates[dm_type],
                                   handle->product_sn, handle->device_sn);
     if (ret < 0) {
@@ -547,8 +584,14 @@ void *dsc_init(const char *product_sn, const char *device_sn, void *channel, voi
 int dsc_deinit(void *handle) {
     FUNC_ENTRY;
 
-    if (NULL != handle) {
-        HAL_Free(handle);
+    DM_MQTT_Struct_t *h_dsc = (DM_MQTT_Struct_t *) handle;
+    int i;
+
+    if (NULL != h_dsc) {
+        for (i = 0; i < DM_TYPE_MAX; ++i) {
+            IOT_MQTT_ReleasePublish(&h_dsc->pub_handles[i]);
+        }
+        HAL_Free(h_dsc);
     }
 
     FUNC_EXIT_RC(SUCCESS_RET);
@@ -986,23 +1029,11 @@ int dm_mqtt_property_report_publish(DM_MQTT_Struct_t *handle, DM_Type type, int
 
     int ret = FAILURE_RET;
     char *msg_report = NULL;
-    char *topic = NULL;
 
     if (NULL == (msg_report = HAL_Malloc(DM_MSG_REPORT_BUF_LEN))) {
         LOG_ERROR("allocate for msg_report failed\r\n");
         return FAILURE_RET;
     }
-    if (NULL == (topic = HAL_Malloc(DM_TOPIC_BUF_LEN))) {
-        LOG_ERROR("allocate for topic failed\r\n");
-        HAL_Free(msg_report);
-        return FAILURE_RET;
-    }
-
-    if (SUCCESS_RET != _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->upstream_topic_templates[type],
-            handle->product_sn, handle->device_sn)) {
-        LOG_ERROR("generate topic failed\r\n");
-        goto do_exit;
-    }
 
     ret = _dm_mqtt_gen_property_payload(msg_report, DM_MSG_REPORT_BUF_LEN, type, request_id, payload);
     if (ret < 0) {
@@ -1010,13 +1041,12 @@ int dm_mqtt_property_report_publish(DM_MQTT_Struct_t *handle, DM_Type type, int
         ret = FAILURE_RET;
         goto do_exit;
     }
-    ret = _dm_mqtt_publish(handle, topic, 1, msg_report);
+    ret = _dm_mqtt_publish_by_type(handle, type, msg_report);
     if (ret < 0) {
         LOG_ERROR("mqtt publish msg failed\r\n");
     }
 
 do_exit:
-    HAL_Free(topic);
     HAL_Free(msg_report);
 
     FUNC_EXIT_RC(ret);
@@ -1058,35 +1088,23 @@ int dm_mqtt_event_publish(DM_MQTT_Struct_t *handle, int request_id, const char *
 
     int ret = FAILURE_RET;
     char *msg_report = NULL;
-    char *topic = NULL;
 
     if (NULL == (msg_report = HAL_Malloc(DM_EVENT_POST_BUF_LEN))) {
         LOG_ERROR("allocate for msg_report failed\r\n");
         goto do_exit;
     }
-    if (NULL == (topic = HAL_Malloc(DM_TOPIC_BUF_LEN))) {
-        LOG_ERROR("allocate for topic failed\r\n");
-        goto do_exit;
-    }
-
-    if (SUCCESS_RET != _dm_mqtt_gen_topic_name(topic, DM_TOPIC_BUF_LEN, handle->upstream_topic_templates[EVENT_POST],
-            handle->product_sn, handle->device_sn)) {
-        LOG_ERROR("generate topic failed\r\n");
-        goto do_exit;
-    }
 
     ret = _dm_mqtt_gen_event_payload(msg_report, DM_EVENT_POST_BUF_LEN, request_id, identifier, payload);
     if (ret < 0) {
         LOG_ERROR("generate msg_report failed\r\n");
         goto do_exit;
     }
-    ret = _dm_mqtt_publish(handle, topic, 1, msg_report);
+    ret = _dm_mqtt_publish_by_type(handle, EVENT_POST, msg_report);
     if (ret < 0) {
         LOG_ERROR("mqtt publish msg failed\r\n");
     }
 
 do_exit:
-    HAL_Free(topic);
     HAL_Free(msg_report);
 
     FUNC_EXIT_RC(ret);
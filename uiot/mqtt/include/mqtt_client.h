@@ -33,6 +33,8 @@ extern "C" {
 
 #include "utils_timer.h"
 #include "utils_list.h"
+#include "utils_topic_trie.h"
+#include "utils_mpsc_ring.h"
 
 /* 报文id最大值 */
 #define MAX_PACKET_ID                                               (65535)
@@ -40,9 +42,6 @@ extern "C" {
 /* 成功订阅主题的最大个数 */
 #define MAX_SUB_TOPICS                                              (10)
 
-/* 在列表中最大的重新发布数量 */
-#define MAX_REPUB_NUM                                               (20)
-
 /* 重连最小等待时间 */
 #define MIN_RECONNECT_WAIT_INTERVAL                                 (1000)
 
@@ -88,6 +87,42 @@ typedef enum msgTypes {
     DISCONNECT  = 14     // Client is Disconnecting
 } MessageTypes;
 
+/**
+ * @brief MQTT 5.0 属性标识符, 参考MQTT 5.0协议说明文档2.2.2.2小结
+ */
+typedef enum {
+    MQTT_PROP_PAYLOAD_FORMAT_INDICATOR          = 0x01,
+    MQTT_PROP_MESSAGE_EXPIRY_INTERVAL           = 0x02,
+    MQTT_PROP_CONTENT_TYPE                      = 0x03,
+    MQTT_PROP_RESPONSE_TOPIC                    = 0x08,
+    MQTT_PROP_CORRELATION_DATA                  = 0x09,
+    MQTT_PROP_SUBSCRIPTION_IDENTIFIER           = 0x0B,
+    MQTT_PROP_SESSION_EXPIRY_INTERVAL           = 0x11,
+    MQTT_PROP_ASSIGNED_CLIENT_IDENTIFIER        = 0x12,
+    MQTT_PROP_SERVER_KEEP_ALIVE                 = 0x13,
+    MQTT_PROP_AUTHENTICATION_METHOD             = 0x15,
+    MQTT_PROP_AUTHENTICATION_DATA               = 0x16,
+    MQTT_PROP_REQUEST_PROBLEM_INFORMATION       = 0x17,
+    MQTT_PROP_WILL_DELAY_INTERVAL               = 0x18,
+    MQTT_PROP_REQUEST_RESPONSE_INFORMATION      = 0x19,
+    MQTT_PROP_RESPONSE_INFORMATION              = 0x1A,
+    MQTT_PROP_SERVER_REFERENCE                  = 0x1C,
+    MQTT_PROP_REASON_STRING                     = 0x1F,
+    MQTT_PROP_RECEIVE_MAXIMUM                   = 0x21,
+    MQTT_PROP_TOPIC_ALIAS_MAXIMUM               = 0x22,
+    MQTT_PROP_TOPIC_ALIAS                       = 0x23,
+    MQTT_PROP_MAXIMUM_QOS                       = 0x24,
+    MQTT_PROP_RETAIN_AVAILABLE                  = 0x25,
+    MQTT_PROP_USER_PROPERTY                     = 0x26,
+    MQTT_PROP_MAXIMUM_PACKET_SIZE               = 0x27,
+    MQTT_PROP_WILDCARD_SUBSCRIPTION_AVAILABLE   = 0x28,
+    MQTT_PROP_SUBSCRIPTION_IDENTIFIER_AVAILABLE = 0x29,
+    MQTT_PROP_SHARED_SUBSCRIPTION_AVAILABLE     = 0x2A
+} MQTTPropertyId;
+
+/* MQTT 5.0 原因码, 小于该值表示成功, 大于等于该值表示失败 */
+#define MQTT_REASON_CODE_FAILURE        0x80
+
 typedef enum {
     DISCONNECTED = 0,
     CONNECTED    = 1
@@ -141,7 +176,7 @@ typedef struct {
 
     char                        struct_id[4];           // The eyecatcher for this structure.  must be MQTC.
     uint8_t                     struct_version;         // 结构体版本号, 必须为0
-    uint8_t                     mqtt_version;           // MQTT版本协议号 4 = 3.1.1
+    uint8_t                     mqtt_version;           // MQTT版本协议号 4 = 3.1.1, 5 = 5.0
     uint16_t                    keep_alive_interval;    // 心跳周期, 单位: s
     uint8_t                     clean_session;          // 清理会话标志位, 具体含义请参考MQTT协议说明文档3.1.2.4小结
 
@@ -151,7 +186,7 @@ typedef struct {
 /**
  * MQTT连接参数结构体默认值定义
  */
-#define DEFAULT_MQTT_CONNECT_PARAMS { NULL, NULL, NULL, {'M', 'Q', 'T', 'C'}, 0, 4, 240, 1 , 1,}
+#define DEFAULT_MQTT_CONNECT_PARAMS { NULL, NULL, NULL, {'M', 'Q', 'T', 'C'}, 0, UIOT_MQTT_PROTOCOL_VERSION, 240, 1 , 1,}
 
 /**
  * @brief 订阅主题对应的消息处理结构体定义
@@ -161,8 +196,204 @@ typedef struct SubTopicHandle {
     OnMessageHandler        message_handler;             // 订阅主题消息回调:wq函数指针
     void                    *message_handler_data;       // 用户数据, 通过回调函数返回
     QoS                     qos;                         // 服务质量等级
+    OnMessageChunkHandler   chunk_handler;               // 分片接收消息回调函数指针
+    uint8_t                 manual_ack;                  // QoS1/QoS2消息是否由应用调用IOT_MQTT_Ack回复
 } SubTopicHandle;
 
+typedef enum MQTT_NODE_STATE {
+    MQTT_NODE_STATE_NORMAL = 0,
+    MQTT_NODE_STATE_INVALID,
+} MQTTNodeState;
+
+/* 记录已经发布的topic的信息 */
+typedef struct REPUBLISH_INFO {
+    Timer                   pub_start_time;     /* 等待PUBACK的超时时间 */
+    uint64_t                expire_ms;          /* 等待PUBACK超时的时刻, 超时最小堆的排序键 */
+    uint16_t                heap_pos;           /* 在超时最小堆中的位置 */
+    uint64_t                sent_ms;            /* 最近一次发送的时间, 用于计算PUBACK的往返时间 */
+    MQTTNodeState           node_state;         /* 节点状态 */
+    uint8_t                 retries;            /* 超时后已重发的次数 */
+    uint16_t                msg_id;             /* 发布消息的packet id */
+    uint32_t                len;                /* 消息长度 */
+    unsigned char           *buf;               /* 消息内容 */
+    OnPublishComplete       on_complete;        /* 异步发布完成的回调函数 */
+    void                    *complete_data;     /* 异步发布完成回调的用户数据 */
+} UIoTPubInfo;
+
+/* 按发送顺序记录的等待PUBACK的消息 */
+typedef struct {
+    uint16_t                msg_id;             /* 消息的packet id */
+    uint32_t                pos;                /* 报文在重发缓存区中的起始位置 */
+    uint32_t                len;                /* 报文长度 */
+} UIoTPubOrder;
+
+/*
+ * 等待PUBACK的QoS1消息窗口. 槽位按 packet id 对窗口大小取模寻址, 收到PUBACK时O(1)定位; order按发送顺序记录消息.
+ * 报文保存在客户端创建时一次性分配的重发缓存区中, 按发送顺序首尾相接, 重发时原地设置DUP标志后再次发送.
+ * 已确认的消息只释放槽位, 其在order和缓存区中占用的空间在到达队头时才被回收.
+ * 重发超时时间按Jacobson/Karels算法由PUBACK的平滑往返时间及其偏差计算, 每条消息每重发一次加倍.
+ * 重发后超时顺序与发送顺序不再一致, 等待PUBACK的消息另按超时时刻组成最小堆, 最早超时的消息总在堆顶.
+ */
+typedef struct {
+    UIoTPubInfo             *slots;             /* 槽位数组 */
+    UIoTPubOrder            *order;             /* 按发送顺序记录消息的环形队列 */
+    uint16_t                *heap;              /* 按超时时刻排序的槽位下标最小堆, 元素个数为in_flight */
+    uint16_t                size;               /* 窗口大小 */
+    uint16_t                head;               /* 环形队列头 */
+    uint16_t                count;              /* 环形队列中的记录个数, 包含已确认但尚未出队的记录 */
+    uint16_t                in_flight;          /* 等待PUBACK的消息个数 */
+    uint16_t                limit;              /* 等待PUBACK的消息个数上限, MQTT 5.0下不超过服务器的Receive Maximum */
+    unsigned char           *arena;             /* 重发缓存区 */
+    uint32_t                arena_size;         /* 重发缓存区大小 */
+    uint32_t                arena_used;         /* 重发缓存区已占用的字节数 */
+    uint32_t                arena_high_water;   /* 重发缓存区占用的历史最大值 */
+    uint32_t                srtt;               /* PUBACK的平滑往返时间, 单位:ms, 0表示还未测得 */
+    uint32_t                rttvar;             /* PUBACK往返时间的平均偏差, 单位:ms */
+    uint32_t                rto;                /* 重发超时时间, 单位:ms, 0表示还未测得往返时间 */
+    uint32_t                retransmits;        /* 已重发的消息次数 */
+} UIoTPubWindow;
+
+/*
+ * MQTT 5.0发布消息的主题别名表. 别名为下标加1, 按主题首次发布的顺序分配, 在客户端的生命周期内不变, 表满后新主题不再使用别名.
+ * 别名映射只在一次网络连接内有效, 每次连接后别名首次使用时携带主题全称, 之后只发送别名和空主题.
+ * 只在持有lock_write_buf时访问.
+ */
+typedef struct {
+    char                    *topics[UIOT_MQTT_TOPIC_ALIAS_MAX];     /* 别名对应的主题 */
+    uint8_t                 announced[UIOT_MQTT_TOPIC_ALIAS_MAX];   /* 本次连接中是否已经发送过别名对应的主题全称 */
+    uint16_t                count;                                  /* 已分配的别名个数 */
+    uint16_t                limit;                                  /* 本次连接服务器允许的别名上限, 0表示不使用别名 */
+} UIoTTopicAlias;
+
+/**
+ * @brief 从MQTT 5.0报文属性中解析出的客户端关心的属性, 其余属性被跳过
+ */
+typedef struct {
+    uint16_t                receive_max;        /* Receive Maximum, 未携带时为65535 */
+    uint16_t                topic_alias_max;    /* Topic Alias Maximum, 未携带时为0 */
+    uint16_t                topic_alias;        /* Topic Alias, 未携带时为0 */
+    uint16_t                server_keep_alive;  /* Server Keep Alive, 未携带时为0 */
+    char                    *reason;            /* Reason String, 未携带时为NULL, 不以'\0'结尾 */
+    uint16_t                reason_len;         /* Reason String的长度 */
+} MQTTProperties;
+
+typedef enum {
+    MQTT_INBOUND_FREE = 0,                      /* 空闲 */
+    MQTT_INBOUND_PUBACK_SENT = 1,               /* QoS1消息已回复PUBACK */
+    MQTT_INBOUND_PUBREC_SENT = 2,               /* QoS2消息已回复PUBREC, 等待PUBREL */
+} MQTTInboundState;
+
+/**
+ * @brief 已收到的QoS1/QoS2消息的packet id记录, 用于过滤重复消息以及QoS2消息的接收流程
+ *
+ * 记录按packet id的低位直接存放在UIOT_MQTT_INBOUND_ID_WINDOW大小的数组中, 服务器顺序分配packet id时
+ * 窗口内的记录不会冲突, 冲突时新记录覆盖旧记录. 只由Yield所在线程访问, 不需要加锁.
+ */
+typedef struct {
+    uint16_t                id;                 /* packet id */
+    uint8_t                 state;              /* 状态, 见MQTTInboundState */
+    Timer                   expire;             /* QoS1记录的过期时间 */
+} UIoTInboundId;
+
+typedef enum {
+    MQTT_INBOUND_ACK_FREE = 0,                  /* 空闲 */
+    MQTT_INBOUND_ACK_PENDING = 1,               /* 已分发, 等待应用回复 */
+    MQTT_INBOUND_ACK_READY = 2,                 /* 应用已回复, 等待发送PUBACK/PUBREC */
+    MQTT_INBOUND_ACK_SENDING = 3,               /* 正在发送PUBACK/PUBREC */
+} MQTTInboundAckState;
+
+/**
+ * @brief 手动回复的订阅中已分发, 还未发送PUBACK/PUBREC的消息. 由lock_generic保护.
+ *
+ * 应用通过ack token回复消息, ack token的高16位为inbound_ack_epoch, 低16位为packet id.
+ * 服务器没有保留会话时清空记录并更新inbound_ack_epoch, 之前的ack token随之失效.
+ */
+typedef struct {
+    uint16_t                id;                 /* packet id */
+    uint8_t                 qos;                /* 消息的QoS, 决定回复PUBACK还是PUBREC */
+    uint8_t                 state;              /* 状态, 见MQTTInboundAckState */
+} UIoTInboundAck;
+
+/**
+ * @brief 一个优先级的消息发送时延统计, 由lock_write_buf保护
+ */
+typedef struct {
+    uint32_t                count;              /* 已发出的消息个数 */
+    uint32_t                max_ms;             /* 最大时延, 单位:ms */
+    uint64_t                total_ms;           /* 时延总和, 单位:ms */
+} UIoTPubLatency;
+
+/**
+ * @brief 发布速率限制的令牌桶, 由lock_rate保护
+ *
+ * 令牌数以百万分之一个令牌为单位, 取用时按经过的时间补充, 不需要定时器.
+ */
+typedef struct {
+    char                    *prefix;            /* 主题前缀, 客户端级令牌桶为NULL */
+    uint32_t                rate;               /* 每秒补充的令牌数, 单位:千分之一个令牌, 为0表示未使用 */
+    int64_t                 burst;              /* 令牌桶容量, 单位:百万分之一个令牌 */
+    uint8_t                 policy;             /* 令牌耗尽时的处理方式, 见MQTTRateLimitPolicy */
+    int64_t                 tokens;             /* 当前令牌数, 单位:百万分之一个令牌, 重发消息可以使其透支 */
+    uint64_t                refill_ms;          /* 上次补充令牌的时刻 */
+    uint32_t                passed;             /* 直接取得令牌的消息条数 */
+    uint32_t                deferred;           /* 延后发出的消息条数 */
+    uint32_t                dropped;            /* 丢弃的消息条数 */
+} UIoTRateBucket;
+
+/*
+ * 离线消息存储. 分区按擦除块划分为扇区, 扇区循环使用, 每个扇区以头部(魔数, 序号)开始, 记录只追加写入且不跨扇区.
+ * 读取位置通过追加写入的检查点记录持久化, 掉电重启后从最新的检查点恢复; 扇区在下一次被分配时才擦除,
+ * 每轮循环每个扇区只擦除一次. 所有扇区写满时丢弃最早的扇区. 内存占用只有本结构体和两个记录缓冲区.
+ */
+typedef struct UIoTStore {
+    struct UIoTStore        *next;              /* 已打开的存储链表, 防止多个客户端打开同一个分区 */
+    char                    *partition;         /* 分区名 */
+    void                    *handle;            /* 分区句柄 */
+    void                    *lock;              /* 读写位置的锁 */
+    uint32_t                sector_size;        /* 扇区大小 */
+    uint16_t                sector_count;       /* 扇区个数 */
+    uint16_t                write_sector;       /* 正在写入的扇区 */
+    uint32_t                write_offset;       /* 写入位置, 为0表示还没有打开过扇区 */
+    uint32_t                write_seq;          /* 正在写入的扇区序号 */
+    uint16_t                read_sector;        /* 正在读取的扇区 */
+    uint32_t                read_offset;        /* 读取位置 */
+    uint32_t                read_seq;           /* 正在读取的扇区序号 */
+    uint32_t                records;            /* 等待补发的消息条数 */
+    uint32_t                bytes;              /* 等待补发的消息占用的字节数 */
+    uint32_t                dropped;            /* 存储已满时被丢弃的消息条数 */
+    uint16_t                since_checkpoint;   /* 上一次检查点之后补发的消息条数 */
+    volatile uint8_t        in_flight;          /* 是否有补发的QoS1消息在等待PUBACK */
+    uint16_t                peek_sector;        /* 正在补发的消息所在扇区 */
+    uint32_t                peek_offset;        /* 正在补发的消息在扇区中的位置 */
+    uint32_t                peek_len;           /* 正在补发的消息记录长度 */
+    unsigned char           *wbuf;              /* 写入记录的缓冲区 */
+    unsigned char           *rbuf;              /* 读取记录的缓冲区 */
+    Timer                   drain_timer;        /* 下一次补发的时间 */
+} UIoTStore;
+
+/**
+ * @brief 间歇连接模式的状态, 只由Yield所在线程修改; wake_requested可在其他线程中设置, pending_subs由lock_generic保护
+ *
+ * 休眠期间客户端保持断开, 发布的消息写入离线存储. 满足唤醒条件时开始一个周期: 连接, 发出休眠期间的订阅,
+ * 补发离线存储中的消息, 所有应答完成且已过listen_ms(或超过max_awake_ms)后断开, 然后重新开始休眠.
+ */
+typedef struct {
+    MQTTDutyCycleParams     params;             /* 间歇连接参数 */
+    volatile uint8_t        enabled;            /* 是否开启间歇连接模式 */
+    uint8_t                 awake;              /* 是否处于一个连接周期中 */
+    uint8_t                 failed;             /* 上一个周期连接失败, 按退避时间重试 */
+    volatile uint8_t        wake_requested;     /* 应用请求尽快连接 */
+    Timer                   wake_timer;         /* 下一次定时连接或连接失败后重试的时间 */
+    Timer                   listen_timer;       /* 连接后至少保持到此时 */
+    Timer                   awake_timer;        /* 连接最长保持到此时 */
+    uint64_t                cycle_start_ms;     /* 本周期开始连接的时刻 */
+    uint32_t                tx_packets_start;   /* 本周期开始时已发送的报文个数 */
+    uint32_t                tx_bytes_start;     /* 本周期开始时已发送的字节数 */
+    MQTTDutyCycleStats      stats;              /* 最近一个周期的统计 */
+    SubTopicHandle          pending_subs[MAX_SUB_TOPICS];   /* 休眠期间的订阅, 主题名为副本, 下一次连接时发出 */
+    uint8_t                 pending_sub_count;  /* 休眠期间的订阅个数 */
+} UIoTDutyCycle;
+
 /**
  * @brief MQTT Client结构体定义
  */
@@ -170,17 +401,25 @@ typedef struct Client {
     uint8_t                  is_connected;                                  // 网络是否连接
     uint8_t                  was_manually_disconnected;                     // 是否手动断开连接
     uint8_t                  is_ping_outstanding;                           // 心跳包是否未完成, 即未收到服务器响应
+    uint8_t                  session_present;                               // 最近一次连接时服务器是否保留了会话
+    uint8_t                  connack_pending;                               // 流水线连接已发出CONNECT, 还未收到CONNACK
 
     uint16_t                 next_packet_id;                                // MQTT报文标识符
     uint32_t                 command_timeout_ms;                            // MQTT消息超时时间, 单位:ms
 
-    uint32_t                 current_reconnect_wait_interval;               // MQTT重连周期, 单位:ms
+    uint32_t                 current_reconnect_wait_interval;               // MQTT重连退避时间上限, 单位:ms
+    uint32_t                 reconnect_rand;                                // 重连随机抖动的随机数状态
     uint32_t                 counter_network_disconnected;                  // 网络断开连接次数
 
     size_t                   write_buf_size;                                // 消息发送buffer长度
     size_t                   read_buf_size;                                 // 消息接收buffer长度
-    unsigned char            write_buf[UIOT_MQTT_TX_BUF_LEN];               // MQTT消息发送buffer
-    unsigned char            read_buf[UIOT_MQTT_RX_BUF_LEN];                // MQTT消息接收buffer
+    unsigned char            *write_buf;                                    // MQTT消息发送buffer
+    unsigned char            *read_buf;                                     // MQTT消息接收buffer
+    size_t                   write_buf_base;                                // 消息发送buffer的初始长度
+    size_t                   read_buf_base;                                 // 消息接收buffer的初始长度
+    size_t                   buf_max_size;                                  // 收发buffer按需扩展的上限
+    Timer                    write_buf_shrink_timer;                        // 扩展后的发送buffer收缩回初始长度的时间
+    Timer                    read_buf_shrink_timer;                         // 扩展后的接收buffer收缩回初始长度的时间
 
     void                     *lock_generic;                                 // client原子锁
     void                     *lock_write_buf;                               // 输出流的锁
@@ -188,8 +427,13 @@ typedef struct Client {
     void                     *lock_list_pub;                                // 等待发布消息ack列表的锁
     void                     *lock_list_sub;                                // 等待订阅消息ack列表的锁
 
-    List                     *list_pub_wait_ack;                            // 等待发布消息ack列表
+    UIoTPubWindow            pub_window;                                    // 等待发布消息ack的窗口
+    UIoTTopicAlias           topic_alias;                                   // MQTT 5.0发布消息的主题别名表
     List                     *list_sub_wait_ack;                            // 等待订阅消息ack列表
+    UIoTInboundId            inbound_ids[UIOT_MQTT_INBOUND_ID_WINDOW];      // 已收到的QoS1/QoS2消息的packet id
+    UIoTInboundAck           inbound_acks[UIOT_MQTT_MANUAL_ACK_MAX];        // 等待应用回复的消息
+    uint16_t                 inbound_ack_count;                             // 等待应用回复或等待发送回复的消息个数
+    uint16_t                 inbound_ack_epoch;                             // ack token的序号
 
     MQTTEventHandler         event_handler;                                 // 事件句柄
 
@@ -198,33 +442,90 @@ typedef struct Client {
     utils_network_t          network_stack;                                 // MQTT底层使用的网络参数
 
     Timer                    ping_timer;                                    // MQTT心跳包发送定时器
+    Timer                    tx_idle_timer;                                 // 上次发送报文后经过一个心跳周期的时间
+    Timer                    rx_idle_timer;                                 // 上次收到报文后经过两个心跳周期的时间
+    uint16_t                 ping_interval;                                 // 当前心跳周期, 单位:s
+    uint16_t                 ping_interval_max;                             // 自适应心跳探测到的心跳周期上限, 单位:s
+    uint8_t                  ping_probe;                                    // 未完成的心跳包是否在链路空闲一个心跳周期后发出
+    uint32_t                 ping_sent;                                     // 已发送的心跳包个数
+    uint32_t                 ping_suppressed;                               // 省去的心跳包个数
     Timer                    reconnect_delay_timer;                         // MQTT重连定时器, 判断是否已到重连时间
 
     SubTopicHandle           sub_handles[MAX_SUB_TOPICS];                   // 订阅主题对应的消息处理结构数组
+    TopicTrieNode            *sub_trie;                                     // 订阅主题树, 节点值为sub_handles下标, 用于消息分发
+
+    unsigned char            *tx_batch;                                     // 小报文合并发送缓冲区, 未开启合并发送时为NULL
+    size_t                   tx_batch_size;                                 // 合并发送缓冲区大小
+    size_t                   tx_batch_len;                                  // 合并发送缓冲区中待发送的字节数
+    uint8_t                  tx_cork;                                       // 是否将小报文合并发送
+    Timer                    tx_batch_timer;                                // 合并发送缓冲区的最迟发送时间
+
+    uint32_t                 tx_packets;                                    // 已发送的报文个数
+    uint32_t                 tx_writes;                                     // 调用底层网络写接口的次数
+    uint32_t                 tx_bytes;                                      // 已发送的字节数
+    volatile uint16_t        tx_critical_waiting;                           // 等待lock_write_buf的关键消息个数, 由lock_generic保护
+    uint16_t                 tx_critical_yielding;                          // 为关键消息让出而等待tx_critical_sem的消息个数, 由lock_generic保护
+    void                     *tx_critical_sem;                              // 关键消息释放lock_write_buf且没有其他关键消息等待时的通知
+    UIoTPubLatency           pub_latency[MQTT_PRIORITY_MAX];                // 各优先级消息的发送时延
+
+    MpscRing                 *async_rings[MQTT_PRIORITY_MAX];               // 各优先级的异步发布队列, 未开启异步发布时为NULL
+    uint8_t                  async_turn;                                    // 异步发布队列轮流发送时当前轮到的优先级
+    uint8_t                  async_served;                                  // 当前优先级本轮已发送的消息个数
+    void                     *async_held;                                   // 发布窗口已满时暂缓发送的QoS1消息, 只由异步发布线程修改
+    void                     *async_sem;                                    // 异步发布队列中有新消息的通知
+    void                     *async_exit_sem;                               // 异步发布线程已退出的通知
+    volatile uint8_t         async_stop;                                    // 通知异步发布线程退出
+
+    UIoTStore                *store;                                        // 离线消息存储, 未开启时为NULL
+
+    void                     *lock_rate;                                    // 令牌桶的锁, 持有时不获取其他锁
+    UIoTRateBucket           rate_client;                                   // 客户端级令牌桶
+    UIoTRateBucket           rate_topics[UIOT_MQTT_RATE_LIMIT_TOPICS + 1];  // 按主题前缀的令牌桶, 多出的一个保证数组非空
+    volatile uint8_t         rate_active;                                   // 使用中的令牌桶个数, 为0时跳过限速
+    uint32_t                 rate_deferred;                                 // 所有令牌桶延后发出的消息条数, 取消令牌桶后仍保留
+    uint32_t                 rate_dropped;                                  // 所有令牌桶丢弃的消息条数, 取消令牌桶后仍保留
+
+    UIoTDutyCycle            duty;                                          // 间歇连接模式的状态
 } UIoT_Client;
 
+/* 发布句柄中为固定头部预留的空间: 1字节报文类型 + 最多4字节剩余长度 */
+#define MQTT_PUB_HANDLE_FIXED_HEADER_LEN    (5)
+
+/*
+ * 发布句柄, 预先编码好主题, 发布时只需填写固定头部, 报文标识符和剩余长度.
+ * buf依次存放: 预留的固定头部, 2字节主题长度, 主题, 报文标识符, MQTT 5.0属性. 只在持有lock_write_buf时修改buf.
+ */
+typedef struct {
+    UIoT_Client             *client;            /* 所属的MQTT客户端 */
+    QoS                     qos;                /* 发布消息的QoS */
+    uint8_t                 priority;           /* 发布消息的优先级, 见MQTTPubPriority */
+    uint16_t                topic_alias;        /* 上次使用的主题别名, 用于跳过别名表的查找 */
+    uint16_t                topic_len;          /* 主题长度 */
+    char                    *topic;             /* 主题名, 以'\0'结尾 */
+    unsigned char           *buf;               /* 预先编码的报文头部 */
+    unsigned char           alias_buf[16];      /* 只发送别名和空主题时的报文头部 */
+} UIoTPubHandle;
+
+/**
+ * @brief 客户端组, 组中的客户端由同一个线程通过IOT_MQTT_GroupYield驱动
+ */
+typedef struct {
+    void                     *lock;                                         // 客户端列表的锁
+    void                     *yield_lock;                                   // Yield处理单个客户端期间持有, 移出该客户端时等待处理结束
+    UIoT_Client              *yielding;                                     // Yield正在处理的客户端, 由lock保护
+    uint16_t                 count;                                         // 客户端个数
+    UIoT_Client              *clients[UIOT_MQTT_GROUP_MAX_CLIENTS];         // 客户端列表
+} UIoTClientGroup;
+
 /**
  * @brief MQTT协议版本
  */
 typedef enum {
-    MQTT_3_1_1 = 4
+    MQTT_3_1_1 = 4,
+    MQTT_5_0 = 5
 } MQTT_VERSION;
 
 
-typedef enum MQTT_NODE_STATE {
-    MQTT_NODE_STATE_NORMAL = 0,
-    MQTT_NODE_STATE_INVALID,
-} MQTTNodeState;
-
-/* 记录已经发布的topic的信息 */
-typedef struct REPUBLISH_INFO {
-    Timer                   pub_start_time;     /* 发布的时间 */
-    MQTTNodeState           node_state;         /* 节点状态 */
-    uint16_t                msg_id;             /* 发布消息的packet id */
-    uint32_t                len;                /* 消息长度 */
-    unsigned char           *buf;               /* 消息内容 */
-} UIoTPubInfo;
-
 /* 记录已经订阅的topic的信息 */
 typedef struct SUBSCRIBE_INFO {
     enum msgTypes           type;           /* 类型, (sub or unsub) */
@@ -245,6 +546,13 @@ typedef struct SUBSCRIBE_INFO {
  */
 int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams);
 
+/**
+ * @brief 释放uiot_mqtt_init创建的资源, 不释放连接参数和客户端结构体本身, 可以重复调用
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_deinit(UIoT_Client *pClient);
+
 /**
  * @brief 建立基于TLS的MQTT连接
  *
@@ -287,6 +595,274 @@ int uiot_mqtt_disconnect(UIoT_Client *pClient);
  */
 int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pParams);
 
+/**
+ * @brief 发布MQTT消息, QoS1消息收到PUBACK或等待超时后调用on_complete
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topicName     主题名
+ * @param pParams       发布参数
+ * @param on_complete   发布完成的回调函数, 可为NULL
+ * @param complete_data 回调函数的用户数据
+ * @param queued_ms     消息放入发布队列的时刻, 用于统计发送时延, 为0时取调用时刻
+ * @return < 0  :   表示失败, 此时不会调用on_complete
+ *         >= 0 :   返回唯一的packet id
+ */
+int uiot_mqtt_publish_with_callback(UIoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                    OnPublishComplete on_complete, void *complete_data, uint64_t queued_ms);
+
+/**
+ * @brief 为主题创建发布句柄, 主题只编码一次, 之后通过uiot_mqtt_publish_with发布
+ *
+ * @param pClient   MQTT客户端结构体
+ * @param topicName 主题名
+ * @param qos       发布消息的QoS
+ * @return 成功返回发布句柄, 失败返回NULL
+ */
+UIoTPubHandle *uiot_mqtt_publish_prepare(UIoT_Client *pClient, char *topicName, QoS qos);
+
+/**
+ * @brief 通过发布句柄发布MQTT消息
+ *
+ * @param pHandle     发布句柄
+ * @param payload     消息负载
+ * @param payload_len 消息负载长度
+ * @return < 0  :   表示失败
+ *         >= 0 :   返回唯一的packet id
+ */
+int uiot_mqtt_publish_with(UIoTPubHandle *pHandle, void *payload, size_t payload_len);
+
+/**
+ * @brief 释放发布句柄
+ *
+ * @param pHandle 发布句柄
+ */
+void uiot_mqtt_publish_release(UIoTPubHandle *pHandle);
+
+/**
+ * @brief 创建异步发布队列及发送线程, UIOT_MQTT_ASYNC_QUEUE_LEN为0时不做任何操作
+ *
+ * @param pClient MQTT客户端结构体
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_async_init(UIoT_Client *pClient);
+
+/**
+ * @brief 停止发送线程, 释放异步发布队列, 队列中未发送的消息以失败回调
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_async_deinit(UIoT_Client *pClient);
+
+/**
+ * @brief 发布窗口中有消息被移除时调用, 有因窗口已满暂缓发送的异步消息时唤醒异步发布线程
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_async_window_released(UIoT_Client *pClient);
+
+/**
+ * @brief 将消息拷贝后放入异步发布队列
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topicName     主题名
+ * @param pParams       发布参数
+ * @param on_complete   发布完成的回调函数, 可为NULL
+ * @param complete_data 回调函数的用户数据
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_publish_async(UIoT_Client *pClient, char *topicName, PublishParams *pParams,
+                            OnPublishComplete on_complete, void *complete_data);
+
+/**
+ * @brief 打开离线消息存储分区并从掉电前的状态恢复, UIOT_MQTT_STORE_ENABLE为0时不做任何操作
+ *
+ * @param pClient   MQTT客户端结构体
+ * @param partition 分区名, 为NULL时使用UIOT_MQTT_STORE_PARTITION; 分区已被其他客户端打开时失败
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_store_init(UIoT_Client *pClient, const char *partition);
+
+/**
+ * @brief 释放离线消息存储占用的内存, flash中的消息保留到下次启动
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_store_deinit(UIoT_Client *pClient);
+
+/**
+ * @brief 发布的消息是否需要写入离线存储, 即客户端未连接或存储中还有未补发的消息
+ *
+ * 连接正常时关键消息不排在存储中的消息之后, 直接发送
+ *
+ * @param pClient  MQTT客户端结构体
+ * @param priority 消息优先级, 见MQTTPubPriority
+ * @return 需要写入离线存储时返回true
+ */
+bool uiot_mqtt_store_should_queue(UIoT_Client *pClient, uint8_t priority);
+
+/**
+ * @brief 将消息追加写入离线存储
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topicName     主题名
+ * @param pParams       发布参数
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_store_push(UIoT_Client *pClient, char *topicName, PublishParams *pParams);
+
+/**
+ * @brief 按UIOT_MQTT_STORE_DRAIN_INTERVAL_MS的间隔补发离线存储中最早的消息, 只在Yield所在线程调用
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_store_drain(UIoT_Client *pClient);
+
+/* uiot_mqtt_rate_acquire的返回值, 表示令牌耗尽且策略为写入离线存储 */
+#define MQTT_RATE_QUEUED    (1)
+
+/* uiot_mqtt_rate_acquire的返回值, 表示等待令牌后取得令牌 */
+#define MQTT_RATE_WAITED    (2)
+
+/**
+ * @brief 创建令牌桶的锁, 初始时不限速
+ *
+ * @param pClient MQTT客户端结构体
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_rate_init(UIoT_Client *pClient);
+
+/**
+ * @brief 释放令牌桶
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_rate_deinit(UIoT_Client *pClient);
+
+/**
+ * @brief 设置或取消一个令牌桶
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topic_prefix  主题前缀, 为NULL时为客户端级令牌桶
+ * @param pParams       令牌桶参数, 为NULL或rate为0时取消
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_rate_set(UIoT_Client *pClient, const char *topic_prefix, MQTTRateLimitParams *pParams);
+
+/**
+ * @brief 获取一个令牌桶的统计
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topic_prefix  主题前缀, 为NULL时为客户端级令牌桶
+ * @param pStats        返回的统计数据
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_rate_get_stats(UIoT_Client *pClient, const char *topic_prefix, MQTTRateLimitStats *pStats);
+
+/**
+ * @brief 为一条新发布的消息取得令牌, 令牌耗尽时按令牌桶的策略等待, 丢弃或要求写入离线存储. 不能持有lock_write_buf调用
+ *
+ * @param pClient   MQTT客户端结构体
+ * @param topic     主题名
+ * @return 返回SUCCESS, 表示直接取得令牌; 返回MQTT_RATE_WAITED, 表示等待后取得令牌;
+ *         返回MQTT_RATE_QUEUED, 表示调用者应写入离线存储;
+ *         返回ERR_MQTT_RATE_LIMITED, 表示消息被丢弃
+ */
+int uiot_mqtt_rate_acquire(UIoT_Client *pClient, const char *topic);
+
+/**
+ * @brief 为离线存储中补发的消息尝试取得令牌, 不等待也不计入统计
+ *
+ * @param pClient   MQTT客户端结构体
+ * @param topic     主题名
+ * @return 已取得令牌时返回0, 否则返回还需要等待的时间, 单位:ms
+ */
+uint32_t uiot_mqtt_rate_poll(UIoT_Client *pClient, const char *topic);
+
+/**
+ * @brief 归还未能发出的消息取得的令牌
+ *
+ * @param pClient   MQTT客户端结构体
+ * @param topic     主题名
+ * @param passed    取得令牌时是否计入了直接取得令牌的统计, 即uiot_mqtt_rate_acquire返回SUCCESS
+ */
+void uiot_mqtt_rate_refund(UIoT_Client *pClient, const char *topic, bool passed);
+
+/**
+ * @brief QoS1消息重发时消耗客户端级令牌桶的一个令牌, 令牌不足时透支, 最多透支一个令牌桶容量
+ *
+ * @param pClient   MQTT客户端结构体
+ */
+void uiot_mqtt_rate_charge(UIoT_Client *pClient);
+
+/**
+ * @brief 开启或关闭间歇连接模式
+ *
+ * @param pClient MQTT客户端结构体
+ * @param pParams 间歇连接参数, 为NULL时关闭
+ * @return 返回SUCCESS, 表示成功; 未开启离线存储时返回FAILURE
+ */
+int uiot_mqtt_duty_set(UIoT_Client *pClient, MQTTDutyCycleParams *pParams);
+
+/**
+ * @brief 释放休眠期间保存的订阅
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_duty_deinit(UIoT_Client *pClient);
+
+/**
+ * @brief 休眠期间需要连接时开始一个周期, 只在Yield所在线程调用
+ *
+ * @param pClient MQTT客户端结构体
+ * @return 返回MQTT_RECONNECTED, 表示已连接; 返回MQTT_DUTY_CYCLE_SLEEPING, 表示还未到连接时间或连接失败
+ */
+int uiot_mqtt_duty_begin(UIoT_Client *pClient);
+
+/**
+ * @brief 一轮处理之后检查本周期是否可以结束, 可以结束时断开连接并通知MQTT_EVENT_DUTY_CYCLE_DONE
+ *
+ * @param pClient MQTT客户端结构体
+ * @param ret     本轮处理的结果
+ * @return 周期结束时返回MQTT_DUTY_CYCLE_SLEEPING, 否则返回ret
+ */
+int uiot_mqtt_duty_check(UIoT_Client *pClient, int ret);
+
+/**
+ * @brief 计算距离间歇连接模式下一个定时事件的时间, 休眠期间不超过UIOT_MQTT_DUTY_WAKE_POLL_MS
+ *
+ * @param pClient MQTT客户端结构体
+ * @return 需要等待的时间, 单位:ms
+ */
+uint32_t uiot_mqtt_duty_deadline_ms(UIoT_Client *pClient);
+
+/**
+ * @brief 休眠期间保存订阅, 下一次连接时发出
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topicFilters  主题过滤器数组
+ * @param pParams       订阅参数数组
+ * @param count         主题个数
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_duty_defer_subscribe(UIoT_Client *pClient, char **topicFilters, SubscribeParams *pParams,
+                                   uint32_t count);
+
+/**
+ * @brief 取消休眠期间保存的订阅, 调用者需持有lock_generic
+ *
+ * @param pClient       MQTT客户端结构体
+ * @param topicFilter   主题过滤器
+ * @return 返回true, 表示存在并已取消
+ */
+bool uiot_mqtt_duty_cancel_subscribe(UIoT_Client *pClient, const char *topicFilter);
+
+/**
+ * @brief 连接建立后发出休眠期间保存的订阅, 发送失败的订阅留待下一次连接
+ *
+ * @param pClient MQTT客户端结构体
+ */
+void uiot_mqtt_duty_flush_subscribe(UIoT_Client *pClient);
+
 /**
  * @brief 订阅MQTT主题
  *
@@ -298,6 +874,18 @@ int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pPar
  */
 int uiot_mqtt_subscribe(UIoT_Client *pClient, char *topicFilter, SubscribeParams *pParams);
 
+/**
+ * @brief 在一个SUBSCRIBE报文中订阅多个MQTT主题
+ *
+ * @param pClient MQTT客户端结构体
+ * @param topicFilters 主题过滤器数组
+ * @param pParams 订阅参数数组, 与topicFilters一一对应
+ * @param count 主题个数, 不超过MAX_SUB_TOPICS
+ * @return < 0  :   表示失败
+ *         >= 0 :   返回唯一的packet id 
+ */
+int uiot_mqtt_subscribe_many(UIoT_Client *pClient, char **topicFilters, SubscribeParams *pParams, uint32_t count);
+
 /**
  * @brief 重新订阅断开连接之前已订阅的主题
  *
@@ -316,6 +904,17 @@ int uiot_mqtt_resubscribe(UIoT_Client *pClient);
  */
 int uiot_mqtt_unsubscribe(UIoT_Client *pClient, char *topicFilter);
 
+/**
+ * @brief 在一个UNSUBSCRIBE报文中取消订阅多个MQTT主题
+ *
+ * @param pClient MQTT客户端结构体
+ * @param topicFilters 主题过滤器数组
+ * @param count 主题个数, 不超过MAX_SUB_TOPICS
+ * @return < 0  :   表示失败
+ *         >= 0 :   返回唯一的packet id   
+ */
+int uiot_mqtt_unsubscribe_many(UIoT_Client *pClient, char **topicFilters, uint32_t count);
+
 /**
  * @brief 在当前线程为底层MQTT客户端让出一定CPU执行时间
  *
@@ -327,6 +926,73 @@ int uiot_mqtt_unsubscribe(UIoT_Client *pClient, char *topicFilter);
  */
 int uiot_mqtt_yield(UIoT_Client *pClient, uint32_t timeout_ms);
 
+/**
+ * @brief 处理一个客户端的一轮事件: 已连接时读取已到达的报文并处理定时事件, 断开时按重连周期尝试重连
+ *
+ * @param pClient    MQTT Client结构体
+ * @param timer      Yield的超时定时器
+ * @param readable   等待网络数据的结果, <0: 网络错误; =0: 没有数据到达; >0: 有数据可读
+ * @return 返回SUCCESS, 表示成功, 返回ERR_MQTT_ATTEMPTING_RECONNECT, 表示正在重连
+ */
+int uiot_mqtt_yield_once(UIoT_Client *pClient, Timer *timer, int readable);
+
+/**
+ * @brief 计算距离客户端下一个定时事件的时间
+ *
+ * @param pClient    MQTT Client结构体
+ * @param timer      Yield的超时定时器
+ * @return           需要等待的时间, 单位:ms
+ */
+uint32_t uiot_mqtt_next_deadline_ms(UIoT_Client *pClient, Timer *timer);
+
+/**
+ * @brief 连接建立后重置心跳状态, 自适应心跳学习到的心跳周期在重连后保留, 调用者需持有lock_generic
+ *
+ * @param pClient    MQTT Client结构体
+ */
+void uiot_mqtt_keepalive_reset(UIoT_Client *pClient);
+
+/**
+ * @brief 创建客户端组
+ *
+ * @return 创建成功返回客户端组, 失败返回NULL
+ */
+UIoTClientGroup *uiot_mqtt_group_create(void);
+
+/**
+ * @brief 销毁客户端组, 组中的客户端不会被销毁
+ *
+ * @param pGroup 客户端组
+ */
+void uiot_mqtt_group_destroy(UIoTClientGroup *pGroup);
+
+/**
+ * @brief 将客户端加入客户端组
+ *
+ * @param pGroup  客户端组
+ * @param pClient MQTT Client结构体
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_group_add(UIoTClientGroup *pGroup, UIoT_Client *pClient);
+
+/**
+ * @brief 将客户端移出客户端组, Yield正在处理该客户端时等待处理结束后返回, 返回后Yield不再访问该客户端
+ *
+ * @param pGroup  客户端组
+ * @param pClient MQTT Client结构体
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_group_remove(UIoTClientGroup *pGroup, UIoT_Client *pClient);
+
+/**
+ * @brief 在当前线程为客户端组中的所有客户端让出一定CPU执行时间
+ *
+ * @param pGroup     客户端组
+ * @param timeout_ms Yield操作超时时间
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_group_yield(UIoTClientGroup *pGroup, uint32_t timeout_ms);
+
 /**
  * @brief 客户端自动重连是否开启
  *
@@ -400,6 +1066,77 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
  */
 int send_mqtt_packet(UIoT_Client *pClient, size_t length, Timer *timer);
 
+/**
+ * @brief 发送指定缓冲区中的报文数据, 调用者需持有lock_write_buf
+ *
+ * @param pClient       Client结构体
+ * @param buf           报文数据
+ * @param length        报文长度
+ * @param timer         定时器
+ * @return
+ */
+int send_mqtt_buf(UIoT_Client *pClient, unsigned char *buf, size_t length, Timer *timer);
+
+/**
+ * @brief 确保发送缓冲区至少有len字节, 不足时在buf_max_size范围内扩展, 调用者需持有lock_write_buf
+ *
+ * @param pClient       Client结构体
+ * @param len           需要的长度
+ * @return              返回SUCCESS, 表示成功, 返回ERR_MQTT_BUFFER_TOO_SHORT, 表示超过扩展上限
+ */
+int uiot_mqtt_write_buf_reserve(UIoT_Client *pClient, size_t len);
+
+/**
+ * @brief 扩展后的收发缓冲区空闲超过UIOT_MQTT_BUF_SHRINK_IDLE_MS时收缩回初始长度, 只在Yield所在线程调用
+ *
+ * @param pClient       Client结构体
+ */
+void uiot_mqtt_buf_shrink_idle(UIoT_Client *pClient);
+
+/**
+ * @brief 发送可以延迟的小报文(PUBACK, PINGREQ, QoS0 PUBLISH等), 调用者需持有lock_write_buf
+ *
+ * 开启合并发送时报文先追加到合并发送缓冲区, 缓冲区满, 到达最迟发送时间, 有不可延迟的报文需要发送
+ * 或一次Yield循环结束时一并发送; 未开启时与send_mqtt_bufv相同
+ *
+ * @param pClient       Client结构体
+ * @param iov           数据块数组, 发送过程中会被修改
+ * @param iovcnt        数据块个数
+ * @param timer         定时器
+ * @return
+ */
+int send_mqtt_bufv_corked(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt, Timer *timer);
+
+/**
+ * @brief 发送write_buf中可以延迟的小报文, 调用者需持有lock_write_buf
+ *
+ * @param pClient       Client结构体
+ * @param length        报文长度
+ * @param timer         定时器
+ * @return
+ */
+int send_mqtt_packet_corked(UIoT_Client *pClient, size_t length, Timer *timer);
+
+/**
+ * @brief 发送合并发送缓冲区中的报文, 调用者需持有lock_write_buf
+ *
+ * @param pClient       Client结构体
+ * @param timer         定时器
+ * @return
+ */
+int uiot_mqtt_batch_flush(UIoT_Client *pClient, Timer *timer);
+
+/**
+ * @brief 按顺序发送多个数据块组成的报文, 调用者需持有lock_write_buf
+ *
+ * @param pClient       Client结构体
+ * @param iov           数据块数组, 发送过程中会被修改
+ * @param iovcnt        数据块个数
+ * @param timer         定时器
+ * @return
+ */
+int send_mqtt_bufv(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt, Timer *timer);
+
 /**
  * @brief 等待指定类型的MQTT控制报文
  *
@@ -437,6 +1174,91 @@ uint8_t get_client_conn_state(UIoT_Client *pClient);
  */
 int uiot_mqtt_pub_info_proc(UIoT_Client *pClient);
 
+/**
+ * @brief 初始化等待PUBACK的消息窗口
+ *
+ * @param window      消息窗口
+ * @param size        窗口大小, 即最多同时等待PUBACK的消息个数
+ * @param arena_size  重发缓存区大小
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_pub_window_init(UIoTPubWindow *window, uint16_t size, uint32_t arena_size);
+
+/**
+ * @brief 释放消息窗口及其重发缓存区
+ *
+ * @param window  消息窗口
+ */
+void uiot_mqtt_pub_window_deinit(UIoTPubWindow *window);
+
+/**
+ * @brief 在窗口中为即将发送的消息分配槽位和len字节的重发缓存, 调用者需持有lock_list_pub
+ *
+ * 调用者将报文序列化到返回槽位的buf中, 发送失败时调用uiot_mqtt_pub_window_release归还
+ *
+ * @param window      消息窗口
+ * @param msg_id      消息的packet id
+ * @param len         报文长度
+ * @param timeout_ms  等待PUBACK的超时时间
+ * @return 窗口已满, packet id对应的槽位被占用或重发缓存区空间不足时返回NULL
+ */
+UIoTPubInfo *uiot_mqtt_pub_window_push(UIoTPubWindow *window, uint16_t msg_id, uint32_t len, uint32_t timeout_ms);
+
+/**
+ * @brief 查找窗口中packet id对应的消息, 调用者需持有lock_list_pub
+ *
+ * @param window  消息窗口
+ * @param msg_id  消息的packet id
+ * @return 消息不在窗口中返回NULL
+ */
+UIoTPubInfo *uiot_mqtt_pub_window_find(UIoTPubWindow *window, uint16_t msg_id);
+
+/**
+ * @brief 从窗口中移除packet id对应的消息, 调用者需持有lock_list_pub
+ *
+ * @param window  消息窗口
+ * @param msg_id  消息的packet id
+ * @return 返回SUCCESS, 表示成功; 消息不在窗口中返回FAILURE
+ */
+int uiot_mqtt_pub_window_release(UIoTPubWindow *window, uint16_t msg_id);
+
+/**
+ * @brief 获取窗口中最早超时的消息, 即超时最小堆的堆顶, 调用者需持有lock_list_pub
+ *
+ * @param window  消息窗口
+ * @return 窗口为空时返回NULL
+ */
+UIoTPubInfo *uiot_mqtt_pub_window_next_expiry(UIoTPubWindow *window);
+
+/**
+ * @brief 收到PUBACK时用消息的往返时间更新重发超时时间, 重发过的消息不参与计算, 调用者需持有lock_list_pub
+ *
+ * @param window  消息窗口
+ * @param slot    收到PUBACK的消息
+ */
+void uiot_mqtt_pub_window_rtt_sample(UIoTPubWindow *window, UIoTPubInfo *slot);
+
+/**
+ * @brief 重发窗口中的消息并设置DUP标志, 按已重发次数重新计算超时时间, 调用者需持有lock_write_buf和lock_list_pub
+ *
+ * MQTT 5.0下新连接中尚未生效的主题别名会换成主题全称重新序列化报文头部
+ *
+ * @param pClient    MQTT客户端结构体
+ * @param repubInfo  需要重发的消息
+ * @param timer      发送超时定时器
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_pub_resend(UIoT_Client *pClient, UIoTPubInfo *repubInfo, Timer *timer);
+
+/**
+ * @brief 重连成功后按发送顺序重发窗口中上一次连接未收到PUBACK的消息, UIOT_MQTT_RETRANS_MAX为0时不做任何操作
+ *
+ * @param pClient MQTT客户端结构体
+ * @param sent_before_ms 只重发在此时刻之前发送的消息, 本次连接中已发出的消息不再重发
+ * @return 返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_pub_resend_all(UIoT_Client *pClient, uint64_t sent_before_ms);
+
 /**
  * @brief 检查 Subscribe ACK 等待列表，若有成功接收或者超时，则将对应节点从列表中移除
  *
@@ -445,6 +1267,13 @@ int uiot_mqtt_pub_info_proc(UIoT_Client *pClient);
  */
 int uiot_mqtt_sub_info_proc(UIoT_Client *pClient);
 
+/**
+ * @brief 根据sub_handles重建订阅主题树, 调用者需持有lock_generic
+ *
+ * @param pClient MQTT客户端
+ */
+void uiot_mqtt_sub_trie_rebuild(UIoT_Client *pClient);
+
 int push_sub_info_to(UIoT_Client *c, int len, unsigned short msgId, MessageTypes type,
                                    SubTopicHandle *handler, ListNode **node);
 
@@ -454,15 +1283,43 @@ int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes pa
 
 int serialize_packet_with_zero_payload(unsigned char *buf, size_t buf_len, MessageTypes packetType, uint32_t *serialized_len);
 
-int deserialize_publish_packet(unsigned char *dup, QoS *qos, uint8_t *retained, uint16_t *packet_id, char **topicName,
-                               uint16_t *topicNameLen, unsigned char **payload, size_t *payload_len, unsigned char *buf, size_t buf_len);
+int deserialize_publish_packet(uint8_t mqtt_version, unsigned char *dup, QoS *qos, uint8_t *retained, uint16_t *packet_id,
+                               char **topicName, uint16_t *topicNameLen, unsigned char **payload, size_t *payload_len,
+                               unsigned char *buf, size_t buf_len);
 
-int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t *count,
+int deserialize_suback_packet(uint8_t mqtt_version, uint16_t *packet_id, uint32_t max_count, uint32_t *count,
                                      QoS *grantedQoSs, unsigned char *buf, size_t buf_len);
 
-int deserialize_unsuback_packet(uint16_t *packet_id, unsigned char *buf, size_t buf_len);
+int deserialize_unsuback_packet(uint8_t mqtt_version, uint16_t *packet_id, uint8_t *reason_code,
+                                unsigned char *buf, size_t buf_len);
+
+int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_id, uint8_t *reason_code,
+                           unsigned char *buf, size_t buf_len);
+
+/**
+ * @brief 读取MQTT 5.0报文的属性长度和属性, 读取后pptr指向属性之后的数据
+ *
+ * @param pptr      属性长度字段的位置
+ * @param enddata   报文结束位置
+ * @param props     解析出的属性, 可为NULL
+ * @return          SUCCESS_RET表示成功, 属性格式错误时返回ERR_MQTT_PACKET_READ_ERROR
+ */
+int mqtt_read_properties(unsigned char **pptr, unsigned char *enddata, MQTTProperties *props);
+
+/**
+ * @brief 清空主题别名的发送记录, 每次建立连接时调用, 调用者需持有lock_write_buf
+ *
+ * @param pClient
+ * @param limit     本次连接服务器允许的别名上限
+ */
+void uiot_mqtt_topic_alias_reset(UIoT_Client *pClient, uint16_t limit);
 
-int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_id, unsigned char *buf, size_t buf_len);
+/**
+ * @brief 释放主题别名表
+ *
+ * @param pClient
+ */
+void uiot_mqtt_topic_alias_deinit(UIoT_Client *pClient);
 
 bool parse_mqtt_payload_retcode_type(char *pJsonDoc, uint32_t *pRetCode); 
 
@@ -470,11 +1327,38 @@ bool parse_mqtt_state_request_id_type(char *pJsonDoc, char **pType);
 
 bool parse_mqtt_state_password_type(char *pJsonDoc, char **pType);
 
-#ifdef MQTT_CHECK_REPEAT_MSG
+/**
+ * @brief 清空已收到消息的packet id记录, 服务器没有保留会话时调用
+ *
+ * @param pClient
+ */
+void uiot_mqtt_inbound_reset(UIoT_Client *pClient);
+
+/**
+ * @brief 回复手动回复的订阅中收到的消息, 见IOT_MQTT_Ack
+ *
+ * @param pClient
+ * @param ack_token  消息回调中message->ack_token的值
+ * @return           返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_ack(UIoT_Client *pClient, uint32_t ack_token);
+
+/**
+ * @brief 发送应用已回复但还未发出的PUBACK/PUBREC, 未连接时不做任何操作
+ *
+ * @param pClient
+ * @return           返回SUCCESS, 表示成功
+ */
+int uiot_mqtt_ack_flush(UIoT_Client *pClient);
 
-void reset_repeat_packet_id_buffer(void);
+/**
+ * @brief 等待应用回复的消息是否已达到UIOT_MQTT_MANUAL_ACK_MAX, 达到时暂停读取网络数据
+ *
+ * @param pClient
+ * @return           返回true, 表示暂停读取
+ */
+bool uiot_mqtt_rx_paused(UIoT_Client *pClient);
 
-#endif
 /**
  * @brief 根据剩余长度计算整个MQTT报文的长度
  *
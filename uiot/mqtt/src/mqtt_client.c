@@ -125,41 +125,65 @@ void* IOT_MQTT_Construct(MQTTInitParams *pParams)
         LOG_INFO("mqtt connect success\n");
     }
 
+    if (SUCCESS_RET != uiot_mqtt_async_init(mqtt_client)) {
+        LOG_ERROR("mqtt async publish init failed\n");
+        IOT_MQTT_Destroy((void **)&mqtt_client);
+        return NULL;
+    }
+
     return mqtt_client;
 end:
+    uiot_mqtt_deinit(mqtt_client);
     HAL_Free(mqtt_client);
     return NULL;
 }
 
+/**
+ * @brief 销毁客户端前结束所有等待PUBACK的消息, 异步发布的完成回调以ERR_MQTT_NO_CONN通知
+ *
+ * @param pClient
+ */
+static void _mqtt_pub_window_abort(UIoT_Client *pClient) {
+    UIoTPubWindow *window = &pClient->pub_window;
+    OnPublishComplete on_complete;
+    void *complete_data;
+    uint16_t packet_id;
+    uint16_t i;
+
+    for (i = 0; i < window->size; ++i) {
+        HAL_MutexLock(pClient->lock_list_pub);
+        if (MQTT_NODE_STATE_NORMAL != window->slots[i].node_state) {
+            HAL_MutexUnlock(pClient->lock_list_pub);
+            continue;
+        }
+        packet_id = window->slots[i].msg_id;
+        on_complete = window->slots[i].on_complete;
+        complete_data = window->slots[i].complete_data;
+        (void)uiot_mqtt_pub_window_release(window, packet_id);
+        HAL_MutexUnlock(pClient->lock_list_pub);
+
+        if (NULL != on_complete) {
+            on_complete(pClient, packet_id, ERR_MQTT_NO_CONN, complete_data);
+        }
+    }
+}
+
 int IOT_MQTT_Destroy(void **pClient) {
     POINTER_VALID_CHECK(*pClient, ERR_PARAM_INVALID);
 
     UIoT_Client *mqtt_client = (UIoT_Client *)(*pClient);
 
-    int ret = uiot_mqtt_disconnect(mqtt_client);
-    int loop = 0;
-#ifdef MQTT_CHECK_REPEAT_MSG
-    reset_repeat_packet_id_buffer();
-#endif
-
-    HAL_MutexDestroy(mqtt_client->lock_generic);
-    HAL_MutexDestroy(mqtt_client->lock_write_buf);
+    uiot_mqtt_async_deinit(mqtt_client);
 
-    HAL_MutexDestroy(mqtt_client->lock_list_sub);
-    HAL_MutexDestroy(mqtt_client->lock_list_pub);
+    int ret = uiot_mqtt_disconnect(mqtt_client);
 
-    list_destroy(mqtt_client->list_pub_wait_ack);
-    list_destroy(mqtt_client->list_sub_wait_ack);
+    _mqtt_pub_window_abort(mqtt_client);
+    uiot_mqtt_deinit(mqtt_client);
 
     HAL_Free(mqtt_client->options.username);
     HAL_Free(mqtt_client->options.client_id);
     HAL_Free(mqtt_client->options.password);
 
-    for (loop = 0; loop < MAX_SUB_TOPICS; ++loop)
-    {
-        HAL_Free((char *)mqtt_client->sub_handles[loop].topic_filter);
-    }
-
     HAL_Free(*pClient);
     *pClient = NULL;
 
@@ -174,6 +198,35 @@ int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms) {
     return ret;
 }
 
+void *IOT_MQTT_GroupCreate(void) {
+
+    return uiot_mqtt_group_create();
+}
+
+int IOT_MQTT_GroupDestroy(void **pGroup) {
+    POINTER_VALID_CHECK(pGroup, ERR_PARAM_INVALID);
+
+    uiot_mqtt_group_destroy((UIoTClientGroup *)(*pGroup));
+    *pGroup = NULL;
+
+    return SUCCESS_RET;
+}
+
+int IOT_MQTT_GroupAdd(void *pGroup, void *pClient) {
+
+    return uiot_mqtt_group_add((UIoTClientGroup *)pGroup, (UIoT_Client *)pClient);
+}
+
+int IOT_MQTT_GroupRemove(void *pGroup, void *pClient) {
+
+    return uiot_mqtt_group_remove((UIoTClientGroup *)pGroup, (UIoT_Client *)pClient);
+}
+
+int IOT_MQTT_GroupYield(void *pGroup, uint32_t timeout_ms) {
+
+    return uiot_mqtt_group_yield((UIoTClientGroup *)pGroup, timeout_ms);
+}
+
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams) {
 
     UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
@@ -181,6 +234,48 @@ int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams) {
     return uiot_mqtt_publish(mqtt_client, topicName, pParams);
 }
 
+int IOT_MQTT_PublishAsync(void *pClient, char *topicName, PublishParams *pParams,
+                          OnPublishComplete on_complete, void *pUserData) {
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return uiot_mqtt_publish_async(mqtt_client, topicName, pParams, on_complete, pUserData);
+}
+
+void *IOT_MQTT_PreparePublish(void *pClient, char *topicName, QoS qos) {
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return uiot_mqtt_publish_prepare(mqtt_client, topicName, qos);
+}
+
+int IOT_MQTT_PublishWith(void *pHandle, void *payload, size_t payload_len) {
+
+    UIoTPubHandle *pub_handle = (UIoTPubHandle *)pHandle;
+
+    return uiot_mqtt_publish_with(pub_handle, payload, payload_len);
+}
+
+int IOT_MQTT_SetPublishPriority(void *pHandle, MQTTPubPriority priority) {
+    POINTER_VALID_CHECK(pHandle, ERR_PARAM_INVALID);
+    if (priority >= MQTT_PRIORITY_MAX) {
+        return ERR_PARAM_INVALID;
+    }
+
+    ((UIoTPubHandle *)pHandle)->priority = (uint8_t)priority;
+
+    return SUCCESS_RET;
+}
+
+int IOT_MQTT_ReleasePublish(void **pHandle) {
+    POINTER_VALID_CHECK(pHandle, ERR_PARAM_INVALID);
+
+    uiot_mqtt_publish_release((UIoTPubHandle *)*pHandle);
+    *pHandle = NULL;
+
+    return SUCCESS_RET;
+}
+
 int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParams) {
 
     UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
@@ -188,6 +283,20 @@ int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParam
     return uiot_mqtt_subscribe(mqtt_client, topicFilter, pParams);
 }
 
+int IOT_MQTT_SubscribeMany(void *pClient, char **topicFilters, SubscribeParams *pParams, uint32_t count) {
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return uiot_mqtt_subscribe_many(mqtt_client, topicFilters, pParams, count);
+}
+
+int IOT_MQTT_Ack(void *pClient, uint32_t ack_token) {
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return uiot_mqtt_ack(mqtt_client, ack_token);
+}
+
 int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter) {
 
     UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
@@ -195,6 +304,13 @@ int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter) {
     return uiot_mqtt_unsubscribe(mqtt_client, topicFilter);
 }
 
+int IOT_MQTT_UnsubscribeMany(void *pClient, char **topicFilters, uint32_t count) {
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return uiot_mqtt_unsubscribe_many(mqtt_client, topicFilters, count);
+}
+
 bool IOT_MQTT_IsConnected(void *pClient) {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
 
@@ -203,6 +319,159 @@ bool IOT_MQTT_IsConnected(void *pClient) {
     return get_client_conn_state(mqtt_client) == 1;
 }
 
+bool IOT_MQTT_IsSessionPresent(void *pClient) {
+    POINTER_VALID_CHECK(pClient, false);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    return mqtt_client->session_present == 1;
+}
+
+int IOT_MQTT_GetStats(void *pClient, MQTTClientStats *pStats) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pStats, ERR_PARAM_INVALID);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+    int i;
+
+    memset(pStats, 0, sizeof(MQTTClientStats));
+
+    HAL_MutexLock(mqtt_client->lock_list_pub);
+    pStats->pub_in_flight = mqtt_client->pub_window.in_flight;
+    pStats->retrans_arena_size = mqtt_client->pub_window.arena_size;
+    pStats->retrans_arena_used = mqtt_client->pub_window.arena_used;
+    pStats->retrans_arena_high_water = mqtt_client->pub_window.arena_high_water;
+    pStats->pub_retransmits = mqtt_client->pub_window.retransmits;
+    pStats->pub_rto = mqtt_client->pub_window.rto;
+    HAL_MutexUnlock(mqtt_client->lock_list_pub);
+
+    HAL_MutexLock(mqtt_client->lock_write_buf);
+    pStats->tx_packets = mqtt_client->tx_packets;
+    pStats->tx_writes = mqtt_client->tx_writes;
+    pStats->tx_bytes = mqtt_client->tx_bytes;
+    pStats->ping_sent = mqtt_client->ping_sent;
+    pStats->ping_suppressed = mqtt_client->ping_suppressed;
+    for (i = 0; i < MQTT_PRIORITY_MAX; ++i) {
+        pStats->pub_latency[i].count = mqtt_client->pub_latency[i].count;
+        pStats->pub_latency[i].max_ms = mqtt_client->pub_latency[i].max_ms;
+        if (mqtt_client->pub_latency[i].count > 0) {
+            pStats->pub_latency[i].avg_ms = (uint32_t)(mqtt_client->pub_latency[i].total_ms
+                                                       / mqtt_client->pub_latency[i].count);
+        }
+    }
+    HAL_MutexUnlock(mqtt_client->lock_write_buf);
+
+    HAL_MutexLock(mqtt_client->lock_generic);
+    pStats->ping_interval = mqtt_client->ping_interval;
+    HAL_MutexUnlock(mqtt_client->lock_generic);
+
+    if (NULL != mqtt_client->store) {
+        HAL_MutexLock(mqtt_client->store->lock);
+        pStats->store_records = mqtt_client->store->records;
+        pStats->store_bytes = mqtt_client->store->bytes;
+        pStats->store_dropped = mqtt_client->store->dropped;
+        HAL_MutexUnlock(mqtt_client->store->lock);
+    }
+
+    HAL_MutexLock(mqtt_client->lock_rate);
+    pStats->rate_deferred = mqtt_client->rate_deferred;
+    pStats->rate_dropped = mqtt_client->rate_dropped;
+    HAL_MutexUnlock(mqtt_client->lock_rate);
+
+    return SUCCESS_RET;
+}
+
+int IOT_MQTT_SetRateLimit(void *pClient, const char *topic_prefix, MQTTRateLimitParams *pParams) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    return uiot_mqtt_rate_set((UIoT_Client *)pClient, topic_prefix, pParams);
+}
+
+int IOT_MQTT_GetRateLimitStats(void *pClient, const char *topic_prefix, MQTTRateLimitStats *pStats) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    return uiot_mqtt_rate_get_stats((UIoT_Client *)pClient, topic_prefix, pStats);
+}
+
+int IOT_MQTT_SetDutyCycle(void *pClient, MQTTDutyCycleParams *pParams) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    return uiot_mqtt_duty_set((UIoT_Client *)pClient, pParams);
+}
+
+int IOT_MQTT_DutyCycleWake(void *pClient) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    if (!mqtt_client->duty.enabled) {
+        return FAILURE_RET;
+    }
+
+    // 由Yield所在线程在下一次检查时连接, 最多延迟UIOT_MQTT_DUTY_WAKE_POLL_MS
+    mqtt_client->duty.wake_requested = 1;
+
+    return SUCCESS_RET;
+}
+
+int IOT_MQTT_GetDutyCycleStats(void *pClient, MQTTDutyCycleStats *pStats) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pStats, ERR_PARAM_INVALID);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+
+    HAL_MutexLock(mqtt_client->lock_generic);
+    *pStats = mqtt_client->duty.stats;
+    HAL_MutexUnlock(mqtt_client->lock_generic);
+
+    return SUCCESS_RET;
+}
+
+int IOT_MQTT_SetCork(void *pClient, bool enable) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+    Timer timer;
+    int ret = SUCCESS_RET;
+
+    if (enable && NULL == mqtt_client->tx_batch) {
+        LOG_WARN("tx batch is not enabled");
+        return SUCCESS_RET;
+    }
+
+    HAL_MutexLock(mqtt_client->lock_write_buf);
+    mqtt_client->tx_cork = (uint8_t) enable;
+    if (!enable && mqtt_client->tx_batch_len > 0) {
+        init_timer(&timer);
+        countdown_ms(&timer, mqtt_client->command_timeout_ms);
+        ret = uiot_mqtt_batch_flush(mqtt_client, &timer);
+    }
+    HAL_MutexUnlock(mqtt_client->lock_write_buf);
+
+    return ret;
+}
+
+int IOT_MQTT_Flush(void *pClient) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoT_Client   *mqtt_client = (UIoT_Client *)pClient;
+    Timer timer;
+    int ret;
+
+    if (!get_client_conn_state(mqtt_client)) {
+        return ERR_MQTT_NO_CONN;
+    }
+
+    init_timer(&timer);
+    countdown_ms(&timer, mqtt_client->command_timeout_ms);
+
+    HAL_MutexLock(mqtt_client->lock_write_buf);
+    ret = uiot_mqtt_batch_flush(mqtt_client, &timer);
+    HAL_MutexUnlock(mqtt_client->lock_write_buf);
+
+    return ret;
+}
+
 static void on_message_callback_get_device_secret(void *pClient, MQTTMessage *message, void *userData) 
 {    
     LOG_DEBUG("Receive Message With topicName:%.*s, payload:%.*s\n",
@@ -348,8 +617,15 @@ int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams) {
 
     // packet id 初始化时取1
     pClient->next_packet_id = 1;
-    pClient->write_buf_size = UIOT_MQTT_TX_BUF_LEN;
-    pClient->read_buf_size = UIOT_MQTT_RX_BUF_LEN;
+    // ack token中的序号不为0, 为0的ack token表示无需回复
+    pClient->inbound_ack_epoch = 1;
+    pClient->write_buf_base = (0 != pParams->tx_buf_size) ? pParams->tx_buf_size : UIOT_MQTT_TX_BUF_LEN;
+    pClient->read_buf_base = (0 != pParams->rx_buf_size) ? pParams->rx_buf_size : UIOT_MQTT_RX_BUF_LEN;
+    pClient->buf_max_size = pParams->max_buf_size;
+    pClient->write_buf_size = pClient->write_buf_base;
+    pClient->read_buf_size = pClient->read_buf_base;
+    init_timer(&(pClient->write_buf_shrink_timer));
+    init_timer(&(pClient->read_buf_shrink_timer));
     
     pClient->event_handler = pParams->event_handler;
 
@@ -360,6 +636,15 @@ int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams) {
 
     set_client_conn_state(pClient, DISCONNECTED);
 
+    if ((pClient->write_buf = (unsigned char *)HAL_Malloc(pClient->write_buf_size)) == NULL) {
+        LOG_ERROR("create write buf failed.");
+        goto error;
+    }
+    if ((pClient->read_buf = (unsigned char *)HAL_Malloc(pClient->read_buf_size)) == NULL) {
+        LOG_ERROR("create read buf failed.");
+        goto error;
+    }
+
     if ((pClient->lock_write_buf = HAL_MutexCreate()) == NULL) {
         LOG_ERROR("create write buf lock failed.");
         goto error;
@@ -372,12 +657,25 @@ int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams) {
         LOG_ERROR("create pub list lock failed.");
         goto error;
     }
+    if ((pClient->tx_critical_sem = HAL_SemaphoreCreate()) == NULL) {
+        LOG_ERROR("create critical publish semaphore failed.");
+        goto error;
+    }
 
-    if ((pClient->list_pub_wait_ack = list_new()) == NULL) {
-        LOG_ERROR("create pub wait list failed.");
+    if (SUCCESS_RET != uiot_mqtt_pub_window_init(&pClient->pub_window, UIOT_MQTT_MAX_INFLIGHT,
+                                                 UIOT_MQTT_RETRANS_ARENA_LEN)) {
+        LOG_ERROR("create pub wait window failed.");
         goto error;
     }
-    pClient->list_pub_wait_ack->free = HAL_Free;
+
+    if (UIOT_MQTT_TX_BATCH_LEN > 0) {
+        if ((pClient->tx_batch = (unsigned char *)HAL_Malloc(UIOT_MQTT_TX_BATCH_LEN)) == NULL) {
+            LOG_ERROR("create tx batch buffer failed.");
+            goto error;
+        }
+        pClient->tx_batch_size = UIOT_MQTT_TX_BATCH_LEN;
+        init_timer(&pClient->tx_batch_timer);
+    }
 
     if ((pClient->list_sub_wait_ack = list_new()) == NULL) {
         LOG_ERROR("create sub wait list failed.");
@@ -385,6 +683,11 @@ int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams) {
     }
     pClient->list_sub_wait_ack->free = HAL_Free;
 
+    if ((pClient->sub_trie = topic_trie_new()) == NULL) {
+        LOG_ERROR("create sub topic trie failed.");
+        goto error;
+    }
+
 #ifdef PKG_USING_UCLOUD_TLS
     // TLS连接参数初始化
     pClient->network_stack.authmode = SSL_CA_VERIFY_NONE;
@@ -398,21 +701,76 @@ int uiot_mqtt_init(UIoT_Client *pClient, MQTTInitParams *pParams) {
     uiot_mqtt_network_init(&(pClient->network_stack), pClient->network_stack.pHostAddress,
             pClient->network_stack.port, pClient->network_stack.authmode, pClient->network_stack.ca_crt);
 
+    // 断开时保存TLS会话, 重连时尝试恢复以省去完整握手
+    pClient->network_stack.tls_session_cache = 1;
+
+    if (SUCCESS_RET != utils_net_ring_init(&(pClient->network_stack), UIOT_MQTT_RX_RING_LEN)) {
+        LOG_ERROR("create rx ring failed.");
+        goto error;
+    }
+
+    if (SUCCESS_RET != uiot_mqtt_store_init(pClient, pParams->store_partition)) {
+        LOG_ERROR("open mqtt store failed.");
+        goto error;
+    }
+
+    if (SUCCESS_RET != uiot_mqtt_rate_init(pClient)) {
+        goto error;
+    }
+
     // ping定时器以及重连延迟定时器相关初始化
     init_timer(&(pClient->ping_timer));
+    init_timer(&(pClient->tx_idle_timer));
+    init_timer(&(pClient->rx_idle_timer));
     init_timer(&(pClient->reconnect_delay_timer));
 
     return SUCCESS_RET;
 
 error:
-    if (pClient->list_pub_wait_ack) {
-        pClient->list_pub_wait_ack->free(pClient->list_pub_wait_ack);
-        pClient->list_pub_wait_ack = NULL;
+    uiot_mqtt_deinit(pClient);
+
+    return FAILURE_RET;
+}
+
+void uiot_mqtt_deinit(UIoT_Client *pClient) {
+    int i;
+
+    if (NULL == pClient) {
+        return;
+    }
+
+    uiot_mqtt_duty_deinit(pClient);
+    uiot_mqtt_rate_deinit(pClient);
+    uiot_mqtt_store_deinit(pClient);
+    utils_net_ring_deinit(&(pClient->network_stack));
+    utils_net_session_free(&(pClient->network_stack));
+    uiot_mqtt_topic_alias_deinit(pClient);
+    uiot_mqtt_pub_window_deinit(&pClient->pub_window);
+
+    for (i = 0; i < MAX_SUB_TOPICS; ++i) {
+        HAL_Free((char *)pClient->sub_handles[i].topic_filter);
+        pClient->sub_handles[i].topic_filter = NULL;
+    }
+    if (pClient->sub_trie) {
+        topic_trie_destroy(pClient->sub_trie);
+        pClient->sub_trie = NULL;
     }
     if (pClient->list_sub_wait_ack) {
-        pClient->list_sub_wait_ack->free(pClient->list_sub_wait_ack);
+        list_destroy(pClient->list_sub_wait_ack);
         pClient->list_sub_wait_ack = NULL;
     }
+    if (pClient->tx_batch) {
+        HAL_Free(pClient->tx_batch);
+        pClient->tx_batch = NULL;
+    }
+    if (pClient->write_buf) {
+        HAL_Free(pClient->write_buf);
+        pClient->write_buf = NULL;
+    }
+    if (pClient->read_buf) {
+        HAL_Free(pClient->read_buf);
+        pClient->read_buf = NULL;
+    }
     if (pClient->lock_generic) {
         HAL_MutexDestroy(pClient->lock_generic);
         pClient->lock_generic = NULL;
@@ -429,8 +787,10 @@ error:
         HAL_MutexDestroy(pClient->lock_write_buf);
         pClient->lock_write_buf = NULL;
     }
-
-    return FAILURE_RET;
+    if (pClient->tx_critical_sem) {
+        HAL_SemaphoreDestroy(pClient->tx_critical_sem);
+        pClient->tx_critical_sem = NULL;
+    }
 }
 
 int uiot_mqtt_set_autoreconnect(UIoT_Client *pClient, bool value) {
@@ -0,0 +1,322 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+/* 发送线程等待新消息的最长时间, 超时后检查是否需要退出 */
+#define MQTT_ASYNC_WAIT_MS          (1000)
+
+/* 有暂缓发送的消息时等待发布窗口空出的最长时间, 防止错过唤醒 */
+#define MQTT_ASYNC_HELD_WAIT_MS     (100)
+
+/* 异步发布队列中的消息, 主题与负载紧随结构体存放 */
+typedef struct {
+    PublishParams           params;             /* 发布参数 */
+    char                    *topic;             /* 主题名 */
+    OnPublishComplete       on_complete;        /* 发布完成的回调函数 */
+    void                    *complete_data;     /* 回调函数的用户数据 */
+    uint64_t                queued_ms;          /* 放入队列的时刻, 用于统计发送时延 */
+} UIoTAsyncPubMsg;
+
+static const uint8_t s_async_weights[MQTT_PRIORITY_MAX] = {
+    UIOT_MQTT_PRIORITY_WEIGHT_NORMAL,           /* MQTT_PRIORITY_NORMAL */
+    0,                                          /* MQTT_PRIORITY_CRITICAL, 不参与轮流发送 */
+    UIOT_MQTT_PRIORITY_WEIGHT_BULK,             /* MQTT_PRIORITY_BULK */
+};
+
+static void _mqtt_async_complete(UIoT_Client *pClient, UIoTAsyncPubMsg *msg, int result)
+{
+    if (NULL != msg->on_complete) {
+        msg->on_complete(pClient, msg->params.id, result, msg->complete_data);
+    }
+}
+
+/*
+ * 取出下一条要发送的消息. 关键消息严格优先; 普通消息与批量消息按权重轮流发送,
+ * 一方的队列为空时另一方可以使用全部发送机会.
+ */
+static UIoTAsyncPubMsg *_mqtt_async_next(UIoT_Client *pClient)
+{
+    UIoTAsyncPubMsg *msg;
+    int i;
+
+    /* 暂缓发送的消息先于队列中的所有消息发送, 保持发送顺序 */
+    if (NULL != pClient->async_held) {
+        msg = (UIoTAsyncPubMsg *)pClient->async_held;
+        pClient->async_held = NULL;
+        return msg;
+    }
+
+    msg = (UIoTAsyncPubMsg *)mpsc_ring_pop(pClient->async_rings[MQTT_PRIORITY_CRITICAL]);
+    if (NULL != msg) {
+        return msg;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        msg = (UIoTAsyncPubMsg *)mpsc_ring_pop(pClient->async_rings[pClient->async_turn]);
+        if (NULL != msg && ++pClient->async_served < s_async_weights[pClient->async_turn]) {
+            return msg;
+        }
+
+        pClient->async_turn = (MQTT_PRIORITY_NORMAL == pClient->async_turn) ? MQTT_PRIORITY_BULK : MQTT_PRIORITY_NORMAL;
+        pClient->async_served = 0;
+        if (NULL != msg) {
+            return msg;
+        }
+    }
+
+    return NULL;
+}
+
+/* 发布窗口中还有等待PUBACK的消息时, 窗口已满只是暂时的, 收到PUBACK或超时后即可发送 */
+static bool _mqtt_async_window_busy(UIoT_Client *pClient)
+{
+    bool busy;
+
+    HAL_MutexLock(pClient->lock_list_pub);
+    busy = pClient->pub_window.in_flight > 0;
+    HAL_MutexUnlock(pClient->lock_list_pub);
+
+    return busy;
+}
+
+/*
+ * 依次发送队列中的消息, QoS1消息的完成回调由PUBACK处理或超时检测触发.
+ * 发布窗口已满时消息留在队头, 等窗口空出后再发送, 不作为发送失败.
+ */
+static void _mqtt_async_drain(UIoT_Client *pClient)
+{
+    UIoTAsyncPubMsg *msg;
+    int rate;
+    int ret;
+
+    while (!pClient->async_stop && NULL != (msg = _mqtt_async_next(pClient))) {
+        if (uiot_mqtt_store_should_queue(pClient, msg->params.priority)) {
+            ret = uiot_mqtt_store_push(pClient, msg->topic, &msg->params);
+            _mqtt_async_complete(pClient, msg, (ret < 0) ? ret : SUCCESS_RET);
+        } else if (SUCCESS_RET != (rate = uiot_mqtt_rate_acquire(pClient, msg->topic)) && MQTT_RATE_WAITED != rate) {
+            /* 限速策略为等待时在发送线程中等待, 之后的消息随之延后 */
+            ret = rate;
+            if (MQTT_RATE_QUEUED == ret) {
+                ret = uiot_mqtt_store_push(pClient, msg->topic, &msg->params);
+            }
+            _mqtt_async_complete(pClient, msg, (ret < 0) ? ret : SUCCESS_RET);
+        } else if (QOS0 == msg->params.qos) {
+            ret = uiot_mqtt_publish_with_callback(pClient, msg->topic, &msg->params, NULL, NULL, msg->queued_ms);
+            if (ret < 0) {
+                uiot_mqtt_rate_refund(pClient, msg->topic, SUCCESS_RET == rate);
+            }
+            _mqtt_async_complete(pClient, msg, (ret < 0) ? ret : SUCCESS_RET);
+        } else {
+            ret = uiot_mqtt_publish_with_callback(pClient, msg->topic, &msg->params, msg->on_complete,
+                                                  msg->complete_data, msg->queued_ms);
+            if (ret < 0) {
+                uiot_mqtt_rate_refund(pClient, msg->topic, SUCCESS_RET == rate);
+                if (ERR_MQTT_PUSH_TO_LIST_FAILED == ret && _mqtt_async_window_busy(pClient)) {
+                    pClient->async_held = msg;
+                    break;
+                }
+                _mqtt_async_complete(pClient, msg, ret);
+            }
+        }
+
+        HAL_Free(msg);
+    }
+}
+
+static void _mqtt_async_task(void *arg)
+{
+    UIoT_Client *pClient = (UIoT_Client *)arg;
+    uint32_t wait_ms;
+
+    while (!pClient->async_stop) {
+        wait_ms = (NULL != pClient->async_held) ? MQTT_ASYNC_HELD_WAIT_MS : MQTT_ASYNC_WAIT_MS;
+        if (SUCCESS_RET == HAL_SemaphoreWait(pClient->async_sem, wait_ms) || NULL != pClient->async_held) {
+            _mqtt_async_drain(pClient);
+        }
+    }
+
+    HAL_SemaphorePost(pClient->async_exit_sem);
+}
+
+static void _mqtt_async_rings_destroy(UIoT_Client *pClient)
+{
+    int i;
+
+    for (i = 0; i < MQTT_PRIORITY_MAX; ++i) {
+        if (NULL != pClient->async_rings[i]) {
+            mpsc_ring_destroy(pClient->async_rings[i]);
+            pClient->async_rings[i] = NULL;
+        }
+    }
+}
+
+int uiot_mqtt_async_init(UIoT_Client *pClient)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    int i;
+
+    if (0 == UIOT_MQTT_ASYNC_QUEUE_LEN) {
+        return SUCCESS_RET;
+    }
+
+    pClient->async_stop = 0;
+    pClient->async_turn = MQTT_PRIORITY_NORMAL;
+    pClient->async_served = 0;
+
+    /* 每个优先级一个队列, 批量消息堆积时不会占满关键消息的队列 */
+    for (i = 0; i < MQTT_PRIORITY_MAX; ++i) {
+        if ((pClient->async_rings[i] = mpsc_ring_new(UIOT_MQTT_ASYNC_QUEUE_LEN)) == NULL) {
+            LOG_ERROR("create async publish queue failed.");
+            goto error;
+        }
+    }
+    if ((pClient->async_sem = HAL_SemaphoreCreate()) == NULL) {
+        LOG_ERROR("create async publish semaphore failed.");
+        goto error;
+    }
+    if ((pClient->async_exit_sem = HAL_SemaphoreCreate()) == NULL) {
+        LOG_ERROR("create async publish semaphore failed.");
+        goto error;
+    }
+    if (SUCCESS_RET != HAL_ThreadCreate("mqtt_pub", _mqtt_async_task, pClient, UIOT_MQTT_ASYNC_TASK_STACK_SIZE,
+                                        UIOT_MQTT_ASYNC_TASK_PRIORITY)) {
+        LOG_ERROR("create async publish task failed.");
+        goto error;
+    }
+
+    return SUCCESS_RET;
+
+error:
+    if (pClient->async_exit_sem) {
+        HAL_SemaphoreDestroy(pClient->async_exit_sem);
+        pClient->async_exit_sem = NULL;
+    }
+    if (pClient->async_sem) {
+        HAL_SemaphoreDestroy(pClient->async_sem);
+        pClient->async_sem = NULL;
+    }
+    _mqtt_async_rings_destroy(pClient);
+
+    return FAILURE_RET;
+}
+
+void uiot_mqtt_async_deinit(UIoT_Client *pClient)
+{
+    UIoTAsyncPubMsg *msg;
+    int i;
+
+    if (NULL == pClient || NULL == pClient->async_rings[MQTT_PRIORITY_NORMAL]) {
+        return;
+    }
+
+    /* 发送线程可能正阻塞在一次发送中, 必须等其退出后才能释放队列 */
+    pClient->async_stop = 1;
+    HAL_SemaphorePost(pClient->async_sem);
+    while (SUCCESS_RET != HAL_SemaphoreWait(pClient->async_exit_sem, MQTT_ASYNC_WAIT_MS)) {
+        LOG_WARN("waiting for async publish task to exit");
+    }
+
+    if (NULL != (msg = (UIoTAsyncPubMsg *)pClient->async_held)) {
+        pClient->async_held = NULL;
+        _mqtt_async_complete(pClient, msg, FAILURE_RET);
+        HAL_Free(msg);
+    }
+    for (i = 0; i < MQTT_PRIORITY_MAX; ++i) {
+        while (NULL != (msg = (UIoTAsyncPubMsg *)mpsc_ring_pop(pClient->async_rings[i]))) {
+            _mqtt_async_complete(pClient, msg, FAILURE_RET);
+            HAL_Free(msg);
+        }
+    }
+
+    HAL_SemaphoreDestroy(pClient->async_exit_sem);
+    HAL_SemaphoreDestroy(pClient->async_sem);
+    _mqtt_async_rings_destroy(pClient);
+    pClient->async_exit_sem = NULL;
+    pClient->async_sem = NULL;
+}
+
+void uiot_mqtt_async_window_released(UIoT_Client *pClient)
+{
+    if (NULL != pClient->async_held) {
+        HAL_SemaphorePost(pClient->async_sem);
+    }
+}
+
+int uiot_mqtt_publish_async(UIoT_Client *pClient, char *topicName, PublishParams *pParams,
+                            OnPublishComplete on_complete, void *complete_data)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
+    STRING_PTR_VALID_CHECK(topicName, ERR_PARAM_INVALID);
+
+    UIoTAsyncPubMsg *msg;
+    size_t topicLen = strlen(topicName);
+
+    if (NULL == pClient->async_rings[MQTT_PRIORITY_NORMAL]) {
+        LOG_ERROR("async publish is not enabled");
+        return FAILURE_RET;
+    }
+
+    if (pParams->priority >= MQTT_PRIORITY_MAX) {
+        return ERR_PARAM_INVALID;
+    }
+
+    if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
+        return ERR_MAX_TOPIC_LENGTH;
+    }
+
+    if (pParams->qos == QOS2) {
+        LOG_ERROR("QoS2 is not supported currently");
+        return ERR_MQTT_QOS_NOT_SUPPORT;
+    }
+
+    msg = (UIoTAsyncPubMsg *)HAL_Malloc(sizeof(UIoTAsyncPubMsg) + topicLen + 1 + pParams->payload_len);
+    if (NULL == msg) {
+        LOG_ERROR("memory malloc failed!");
+        return FAILURE_RET;
+    }
+
+    msg->params = *pParams;
+    msg->params.id = 0;
+    msg->topic = (char *)msg + sizeof(UIoTAsyncPubMsg);
+    memcpy(msg->topic, topicName, topicLen + 1);
+    msg->params.payload = msg->topic + topicLen + 1;
+    if (pParams->payload_len > 0) {
+        memcpy(msg->params.payload, pParams->payload, pParams->payload_len);
+    }
+    msg->on_complete = on_complete;
+    msg->complete_data = complete_data;
+    msg->queued_ms = HAL_UptimeMs();
+
+    if (0 != mpsc_ring_push(pClient->async_rings[msg->params.priority], msg)) {
+        HAL_Free(msg);
+        return ERR_MQTT_ASYNC_QUEUE_FULL;
+    }
+    HAL_SemaphorePost(pClient->async_sem);
+
+    return SUCCESS_RET;
+}
+
+#ifdef __cplusplus
+}
+#endif
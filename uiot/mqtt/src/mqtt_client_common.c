@@ -25,6 +25,13 @@ extern "C" {
 #include "utils_list.h"
 #include "lite-utils.h"
 
+#if UIOT_MQTT_MANUAL_ACK_MAX < 1 || UIOT_MQTT_MANUAL_ACK_MAX > 255
+#error "UIOT_MQTT_MANUAL_ACK_MAX must be in range 1~255"
+#endif
+
+#if UIOT_MQTT_INBOUND_ID_WINDOW < 1 || (UIOT_MQTT_INBOUND_ID_WINDOW & (UIOT_MQTT_INBOUND_ID_WINDOW - 1)) != 0
+#error "UIOT_MQTT_INBOUND_ID_WINDOW must be a power of 2"
+#endif
 
 #define MAX_NO_OF_REMAINING_LENGTH_BYTES 4
 
@@ -49,6 +56,10 @@ static int _check_handle_is_identical(SubTopicHandle *sub_handle1, SubTopicHandl
         return 1;
     }
 
+    if (sub_handle1->chunk_handler != sub_handle2->chunk_handler) {
+        return 1;
+    }
+
     return 0;
 }
 
@@ -104,12 +115,12 @@ size_t get_mqtt_packet_len(size_t rem_len) {
 
 /**
  * Decodes the message length according to the MQTT algorithm
- * @param getcharfn pointer to function to read the next character from the data source
+ * @param buf the buffer holding the remaining length field
  * @param value the decoded length returned
- * @return the number of bytes read from the socket
+ * @param readBytesLen the number of bytes used by the remaining length field
+ * @return int indicating function execution status
  */
-static int _decode_packet_rem_len_from_buf_read(uint32_t (*getcharfn)(unsigned char *, uint32_t), uint32_t *value,
-                                                uint32_t *readBytesLen) {
+int mqtt_read_packet_rem_len_form_buf(unsigned char *buf, uint32_t *value, uint32_t *readBytesLen) {
     unsigned char c;
     uint32_t multiplier = 1;
     uint32_t len = 0;
@@ -119,11 +130,7 @@ static int _decode_packet_rem_len_from_buf_read(uint32_t (*getcharfn)(unsigned c
             /* bad data */
             return ERR_MQTT_PACKET_READ_ERROR;
         }
-        uint32_t getLen = 0;
-        getLen = (*getcharfn)(&c, 1);
-        if (1 != getLen) {
-            return FAILURE_RET;
-        }
+        c = *buf++;
         *value += (c & 127) * multiplier;
         multiplier *= 128;
     } while ((c & 128) != 0);
@@ -133,22 +140,6 @@ static int _decode_packet_rem_len_from_buf_read(uint32_t (*getcharfn)(unsigned c
     return SUCCESS_RET;
 }
 
-static unsigned char *bufptr;
-uint32_t bufchar(unsigned char *c, uint32_t count) {
-    uint32_t i;
-
-    for (i = 0; i < count; ++i) {
-        *c = *bufptr++;
-    }
-
-    return count;
-}
-
-int mqtt_read_packet_rem_len_form_buf(unsigned char *buf, uint32_t *value, uint32_t *readBytesLen) {
-    bufptr = buf;
-    return _decode_packet_rem_len_from_buf_read(bufchar, value, readBytesLen);
-}
-
 /**
  * Calculates uint16 packet id from two bytes read from the input buffer
  * @param pptr pointer to the input buffer - incremented by the number of bytes used & returned
@@ -208,6 +199,141 @@ void mqtt_write_utf8_string(unsigned char **pptr, const char *string) {
     *pptr += len;
 }
 
+/**
+ * Decodes a variable byte integer, not reading beyond enddata
+ * @param pptr pointer to the input buffer - incremented by the number of bytes used & returned
+ * @param enddata pointer to the end of the data
+ * @param value the decoded value returned
+ * @return int indicating function execution status
+ */
+static int _mqtt_read_var_int(unsigned char **pptr, unsigned char *enddata, uint32_t *value) {
+    unsigned char c;
+    uint32_t multiplier = 1;
+    uint32_t len = 0;
+
+    *value = 0;
+    do {
+        if (*pptr >= enddata || ++len > MAX_NO_OF_REMAINING_LENGTH_BYTES) {
+            return ERR_MQTT_PACKET_READ_ERROR;
+        }
+        c = mqtt_read_char(pptr);
+        *value += (c & 127) * multiplier;
+        multiplier *= 128;
+    } while ((c & 128) != 0);
+
+    return SUCCESS_RET;
+}
+
+int mqtt_read_properties(unsigned char **pptr, unsigned char *enddata, MQTTProperties *props) {
+    POINTER_VALID_CHECK(pptr, ERR_PARAM_INVALID);
+
+    unsigned char *ptr = *pptr;
+    unsigned char *propend;
+    uint32_t props_len = 0;
+    uint32_t value = 0;
+    uint16_t len;
+    unsigned char id;
+    int pairs;
+
+    if (NULL != props) {
+        memset(props, 0, sizeof(MQTTProperties));
+        props->receive_max = 65535;
+    }
+
+    if (SUCCESS_RET != _mqtt_read_var_int(&ptr, enddata, &props_len) || props_len > (uint32_t)(enddata - ptr)) {
+        return ERR_MQTT_PACKET_READ_ERROR;
+    }
+    propend = ptr + props_len;
+
+    // 属性按标识符决定取值类型, 只保存客户端关心的属性
+    while (ptr < propend) {
+        id = mqtt_read_char(&ptr);
+        switch (id) {
+            case MQTT_PROP_PAYLOAD_FORMAT_INDICATOR:
+            case MQTT_PROP_REQUEST_PROBLEM_INFORMATION:
+            case MQTT_PROP_REQUEST_RESPONSE_INFORMATION:
+            case MQTT_PROP_MAXIMUM_QOS:
+            case MQTT_PROP_RETAIN_AVAILABLE:
+            case MQTT_PROP_WILDCARD_SUBSCRIPTION_AVAILABLE:
+            case MQTT_PROP_SUBSCRIPTION_IDENTIFIER_AVAILABLE:
+            case MQTT_PROP_SHARED_SUBSCRIPTION_AVAILABLE:
+                if (propend - ptr < 1) {
+                    return ERR_MQTT_PACKET_READ_ERROR;
+                }
+                ptr += 1;
+                break;
+            case MQTT_PROP_SERVER_KEEP_ALIVE:
+            case MQTT_PROP_RECEIVE_MAXIMUM:
+            case MQTT_PROP_TOPIC_ALIAS_MAXIMUM:
+            case MQTT_PROP_TOPIC_ALIAS:
+                if (propend - ptr < 2) {
+                    return ERR_MQTT_PACKET_READ_ERROR;
+                }
+                len = mqtt_read_uint16_t(&ptr);
+                if (NULL == props) {
+                    break;
+                }
+                if (MQTT_PROP_SERVER_KEEP_ALIVE == id) {
+                    props->server_keep_alive = len;
+                } else if (MQTT_PROP_RECEIVE_MAXIMUM == id) {
+                    props->receive_max = len;
+                } else if (MQTT_PROP_TOPIC_ALIAS_MAXIMUM == id) {
+                    props->topic_alias_max = len;
+                } else {
+                    props->topic_alias = len;
+                }
+                break;
+            case MQTT_PROP_MESSAGE_EXPIRY_INTERVAL:
+            case MQTT_PROP_SESSION_EXPIRY_INTERVAL:
+            case MQTT_PROP_WILL_DELAY_INTERVAL:
+            case MQTT_PROP_MAXIMUM_PACKET_SIZE:
+                if (propend - ptr < 4) {
+                    return ERR_MQTT_PACKET_READ_ERROR;
+                }
+                ptr += 4;
+                break;
+            case MQTT_PROP_SUBSCRIPTION_IDENTIFIER:
+                if (SUCCESS_RET != _mqtt_read_var_int(&ptr, propend, &value)) {
+                    return ERR_MQTT_PACKET_READ_ERROR;
+                }
+                break;
+            case MQTT_PROP_CONTENT_TYPE:
+            case MQTT_PROP_RESPONSE_TOPIC:
+            case MQTT_PROP_CORRELATION_DATA:
+            case MQTT_PROP_ASSIGNED_CLIENT_IDENTIFIER:
+            case MQTT_PROP_AUTHENTICATION_METHOD:
+            case MQTT_PROP_AUTHENTICATION_DATA:
+            case MQTT_PROP_RESPONSE_INFORMATION:
+            case MQTT_PROP_SERVER_REFERENCE:
+            case MQTT_PROP_REASON_STRING:
+            case MQTT_PROP_USER_PROPERTY:
+                // 字符串或二进制数据, 用户属性为两个字符串
+                for (pairs = (MQTT_PROP_USER_PROPERTY == id) ? 2 : 1; pairs > 0; --pairs) {
+                    if (propend - ptr < 2) {
+                        return ERR_MQTT_PACKET_READ_ERROR;
+                    }
+                    len = mqtt_read_uint16_t(&ptr);
+                    if (propend - ptr < len) {
+                        return ERR_MQTT_PACKET_READ_ERROR;
+                    }
+                    if (MQTT_PROP_REASON_STRING == id && NULL != props) {
+                        props->reason = (char *)ptr;
+                        props->reason_len = len;
+                    }
+                    ptr += len;
+                }
+                break;
+            default:
+                LOG_ERROR("unknown mqtt property: 0x%02x", id);
+                return ERR_MQTT_PACKET_READ_ERROR;
+        }
+    }
+
+    *pptr = propend;
+
+    return SUCCESS_RET;
+}
+
 /**
  * Initialize the MQTT Header fixed byte. Used to ensure that Header bits are
  */
@@ -298,14 +424,17 @@ int mqtt_init_packet_header(unsigned char *header, MessageTypes message_type,
   * @param packet_type returned integer - the MQTT packet type
   * @param dup returned integer - the MQTT dup flag
   * @param packet_id returned integer - the MQTT packet identifier
+  * @param reason_code returned integer - the MQTT 5.0 reason code, 0 if absent
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
   * @param buf_len the length in bytes of the data in the supplied buffer
   * @return error code.  1 is success, 0 is failure
   */
-int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_id, unsigned char *buf, size_t buf_len) {
+int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_id, uint8_t *reason_code,
+                           unsigned char *buf, size_t buf_len) {
     POINTER_VALID_CHECK(packet_type, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(dup, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(packet_id, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(reason_code, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
 
     int ret;
@@ -337,13 +466,10 @@ int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_
 
     *packet_id = mqtt_read_uint16_t(&curdata);
     
-    // 返回错误码处理
+    // MQTT 5.0的原因码, 由调用者判断是否成功; 其后的属性不需要处理
+    *reason_code = 0;
     if (enddata - curdata >= 1) {
-        unsigned char ack_code = mqtt_read_char(&curdata);
-        if (ack_code != 0) {
-            LOG_ERROR("deserialize_ack_packet failure! ack_code = 0x%02x", ack_code);
-            return FAILURE_RET;
-        }
+        *reason_code = mqtt_read_char(&curdata);
     }
 
     return SUCCESS_RET;
@@ -351,6 +477,7 @@ int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_
 
 /**
   * Deserializes the supplied (wire) buffer into suback data
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param packet_id returned integer - the MQTT packet identifier
   * @param max_count - the maximum number of members allowed in the grantedQoSs array
   * @param count returned integer - number of members in the grantedQoSs array
@@ -359,7 +486,7 @@ int deserialize_ack_packet(uint8_t *packet_type, uint8_t *dup, uint16_t *packet_
   * @param buf_len the length in bytes of the data in the supplied buffer
   * @return error code.  1 is success, 0 is failure
   */
-int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t *count,
+int deserialize_suback_packet(uint8_t mqtt_version, uint16_t *packet_id, uint32_t max_count, uint32_t *count,
                                      QoS *grantedQoSs, unsigned char *buf, size_t buf_len) 
 {
     POINTER_VALID_CHECK(packet_id, ERR_PARAM_INVALID);
@@ -399,10 +526,15 @@ int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t
     // 读取报文可变头部的报文标识符
     *packet_id = mqtt_read_uint16_t(&curdata);
 
+    // MQTT 5.0 报文标识符后为属性, 负载为每个主题的原因码
+    if (MQTT_5_0 == mqtt_version && SUCCESS_RET != mqtt_read_properties(&curdata, enddata, NULL)) {
+        return FAILURE_RET;
+    }
+
     // 读取报文的负载部分
     *count = 0;
     while (curdata < enddata) {
-        if (*count > max_count) {
+        if (*count >= max_count) {
             return FAILURE_RET;
         }
         grantedQoSs[(*count)++] = (QoS) mqtt_read_char(&curdata);
@@ -413,26 +545,69 @@ int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t
 
 /**
   * Deserializes the supplied (wire) buffer into unsuback data
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param packet_id returned integer - the MQTT packet identifier
+  * @param reason_code returned integer - the first failed MQTT 5.0 reason code, 0 if all succeeded
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
   * @param buf_len the length in bytes of the data in the supplied buffer
   * @return int indicating function execution status
   */
-int deserialize_unsuback_packet(uint16_t *packet_id, unsigned char *buf, size_t buf_len) 
+int deserialize_unsuback_packet(uint8_t mqtt_version, uint16_t *packet_id, uint8_t *reason_code,
+                                unsigned char *buf, size_t buf_len) 
 {
     POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(packet_id, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(reason_code, ERR_PARAM_INVALID);
 
     unsigned char type = 0;
     unsigned char dup = 0;
+    unsigned char *curdata = buf + 1;
+    unsigned char *enddata = NULL;
+    uint32_t decodedLen = 0, readBytesLen = 0;
+    uint8_t code;
     int ret;
 
-    ret = deserialize_ack_packet(&type, &dup, packet_id, buf, buf_len);
-    if (SUCCESS_RET == ret && UNSUBACK != type) {
-        ret = FAILURE_RET;
+    if (MQTT_5_0 != mqtt_version) {
+        ret = deserialize_ack_packet(&type, &dup, packet_id, reason_code, buf, buf_len);
+        if (SUCCESS_RET == ret && UNSUBACK != type) {
+            ret = FAILURE_RET;
+        }
+        return ret;
     }
 
-    return ret;
+    // MQTT 5.0 报文标识符后为属性, 负载为每个主题的原因码
+    if (4 > buf_len) {
+        return ERR_MQTT_BUFFER_TOO_SHORT;
+    }
+    type = (buf[0]&MQTT_HEADER_TYPE_MASK)>>MQTT_HEADER_TYPE_SHIFT;
+    if (UNSUBACK != type) {
+        return FAILURE_RET;
+    }
+
+    ret = mqtt_read_packet_rem_len_form_buf(curdata, &decodedLen, &readBytesLen);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+    curdata += readBytesLen;
+    enddata = curdata + decodedLen;
+    if (enddata - curdata < 2) {
+        return FAILURE_RET;
+    }
+
+    *packet_id = mqtt_read_uint16_t(&curdata);
+    if (SUCCESS_RET != mqtt_read_properties(&curdata, enddata, NULL)) {
+        return FAILURE_RET;
+    }
+
+    *reason_code = 0;
+    while (curdata < enddata) {
+        code = mqtt_read_char(&curdata);
+        if (code >= MQTT_REASON_CODE_FAILURE && 0 == *reason_code) {
+            *reason_code = code;
+        }
+    }
+
+    return SUCCESS_RET;
 }
 
 /**
@@ -471,33 +646,246 @@ int serialize_packet_with_zero_payload(unsigned char *buf, size_t buf_len, Messa
     return SUCCESS_RET;
 }
 
-int send_mqtt_packet(UIoT_Client *pClient, size_t length, Timer *timer) {
+/* 将缓冲区替换为len字节的新缓冲区, 保留原缓冲区前keep字节的数据 */
+static int _mqtt_buf_resize(unsigned char **buf, size_t *buf_size, size_t len, size_t keep) {
+    unsigned char *new_buf = (unsigned char *)HAL_Malloc(len);
+    if (NULL == new_buf) {
+        LOG_ERROR("memory malloc failed!");
+        return FAILURE_RET;
+    }
+
+    if (keep > 0) {
+        memcpy(new_buf, *buf, keep);
+    }
+    HAL_Free(*buf);
+    *buf = new_buf;
+    *buf_size = len;
+
+    return SUCCESS_RET;
+}
+
+/* 扩展的长度按256字节对齐, 避免报文长度略有增长时反复扩展 */
+static size_t _mqtt_buf_grow_len(UIoT_Client *pClient, size_t len) {
+    len = (len + 255) & ~((size_t)255);
+
+    return Min(len, pClient->buf_max_size);
+}
+
+int uiot_mqtt_write_buf_reserve(UIoT_Client *pClient, size_t len) {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
-    POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
-    size_t sent = 0;
+    if (len > pClient->write_buf_base) {
+        countdown_ms(&pClient->write_buf_shrink_timer, UIOT_MQTT_BUF_SHRINK_IDLE_MS);
+    }
+
+    if (len <= pClient->write_buf_size) {
+        return SUCCESS_RET;
+    }
 
-    if (length >= pClient->write_buf_size) {
+    if (len > pClient->buf_max_size ||
+        SUCCESS_RET != _mqtt_buf_resize(&pClient->write_buf, &pClient->write_buf_size, _mqtt_buf_grow_len(pClient, len), 0)) {
+        LOG_ERROR("MQTT Send buffer not enough: %d < %d", pClient->write_buf_size, len);
         return ERR_MQTT_BUFFER_TOO_SHORT;
     }
 
-    while (sent < length && !has_expired(timer)) {
+    return SUCCESS_RET;
+}
+
+/* 为完整读取total_len字节的报文扩展接收缓冲区, 已读取的固定头部第一个字节被保留 */
+static void _mqtt_read_buf_reserve(UIoT_Client *pClient, size_t total_len) {
+    if (total_len > pClient->read_buf_base) {
+        countdown_ms(&pClient->read_buf_shrink_timer, UIOT_MQTT_BUF_SHRINK_IDLE_MS);
+    }
+
+    if (total_len <= pClient->read_buf_size || total_len > pClient->buf_max_size) {
+        return;
+    }
+
+    (void)_mqtt_buf_resize(&pClient->read_buf, &pClient->read_buf_size, _mqtt_buf_grow_len(pClient, total_len), 1);
+}
+
+void uiot_mqtt_buf_shrink_idle(UIoT_Client *pClient) {
+    if (NULL == pClient) {
+        return;
+    }
+
+    if (pClient->read_buf_size > pClient->read_buf_base && has_expired(&pClient->read_buf_shrink_timer)) {
+        (void)_mqtt_buf_resize(&pClient->read_buf, &pClient->read_buf_size, pClient->read_buf_base, 0);
+    }
+
+    if (pClient->write_buf_size > pClient->write_buf_base) {
+        HAL_MutexLock(pClient->lock_write_buf);
+        if (pClient->write_buf_size > pClient->write_buf_base && has_expired(&pClient->write_buf_shrink_timer)) {
+            (void)_mqtt_buf_resize(&pClient->write_buf, &pClient->write_buf_size, pClient->write_buf_base, 0);
+        }
+        HAL_MutexUnlock(pClient->lock_write_buf);
+    }
+}
+
+/* 直接调用底层网络写接口发送数据, 不经过合并发送缓冲区 */
+static int _mqtt_write(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt, Timer *timer) {
+    int i = 0;
+
+    while (i < iovcnt && !has_expired(timer)) {
         int send_len = 0;
-        send_len = pClient->network_stack.write(&(pClient->network_stack), &(pClient->write_buf[sent]), length, left_ms(timer));
+        if (1 == iovcnt - i) {
+            send_len = pClient->network_stack.write(&(pClient->network_stack), iov[i].base, iov[i].len, left_ms(timer));
+        } else {
+            send_len = pClient->network_stack.writev(&(pClient->network_stack), &iov[i], iovcnt - i, left_ms(timer));
+        }
         if (send_len < 0) {
             /* there was an error writing the data */
             break;
         }
-        sent = sent + send_len;
+        pClient->tx_writes++;
+        pClient->tx_bytes += send_len;
+        /* 超时未写出任何数据时不能视为链路上有流量, 否则会推迟心跳 */
+        if (send_len > 0) {
+            countdown(&pClient->tx_idle_timer, pClient->ping_interval);
+        }
+
+        /* 跳过已经发送的数据块, 部分发送的数据块从剩余部分继续发送 */
+        while (i < iovcnt && (size_t)send_len >= iov[i].len) {
+            send_len -= iov[i].len;
+            i++;
+        }
+        if (i < iovcnt) {
+            iov[i].base += send_len;
+            iov[i].len -= send_len;
+        }
+    }
+
+    return (i == iovcnt) ? SUCCESS_RET : FAILURE_RET;
+}
+
+static size_t _mqtt_iov_len(utils_iovec_t *iov, int iovcnt) {
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].len;
+    }
+
+    return len;
+}
+
+static void _mqtt_batch_append(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt) {
+    int i;
+
+    if (0 == pClient->tx_batch_len) {
+        countdown_ms(&pClient->tx_batch_timer, UIOT_MQTT_TX_BATCH_DELAY_MS);
+    }
+
+    for (i = 0; i < iovcnt; ++i) {
+        memcpy(pClient->tx_batch + pClient->tx_batch_len, iov[i].base, iov[i].len);
+        pClient->tx_batch_len += iov[i].len;
     }
+}
 
-    if (sent == length) {
-        /* record the fact that we have successfully sent the packet */
-        //countdown(&c->ping_timer, c->keep_alive_interval);
+int uiot_mqtt_batch_flush(UIoT_Client *pClient, Timer *timer) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
+
+    utils_iovec_t iov;
+
+    if (0 == pClient->tx_batch_len) {
         return SUCCESS_RET;
     }
 
-    return FAILURE_RET;
+    iov.base = pClient->tx_batch;
+    iov.len = pClient->tx_batch_len;
+    pClient->tx_batch_len = 0;
+
+    return _mqtt_write(pClient, &iov, 1, timer);
+}
+
+int send_mqtt_packet(UIoT_Client *pClient, size_t length, Timer *timer) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    if (length > pClient->write_buf_size) {
+        return ERR_MQTT_BUFFER_TOO_SHORT;
+    }
+
+    return send_mqtt_buf(pClient, pClient->write_buf, length, timer);
+}
+
+int send_mqtt_buf(UIoT_Client *pClient, unsigned char *buf, size_t length, Timer *timer) {
+    POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
+
+    utils_iovec_t iov;
+
+    iov.base = buf;
+    iov.len = length;
+
+    return send_mqtt_bufv(pClient, &iov, 1, timer);
+}
+
+int send_mqtt_bufv(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt, Timer *timer) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(iov, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
+
+    int ret;
+
+    pClient->tx_packets++;
+
+    /* 不可延迟的报文与合并发送缓冲区中的报文一起发送, 放得下时合并为一次写入 */
+    if (pClient->tx_batch_len > 0) {
+        if (pClient->tx_batch_len + _mqtt_iov_len(iov, iovcnt) <= pClient->tx_batch_size) {
+            _mqtt_batch_append(pClient, iov, iovcnt);
+            return uiot_mqtt_batch_flush(pClient, timer);
+        }
+
+        ret = uiot_mqtt_batch_flush(pClient, timer);
+        if (SUCCESS_RET != ret) {
+            return ret;
+        }
+    }
+
+    return _mqtt_write(pClient, iov, iovcnt, timer);
+}
+
+int send_mqtt_bufv_corked(UIoT_Client *pClient, utils_iovec_t *iov, int iovcnt, Timer *timer) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(iov, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
+
+    size_t length = _mqtt_iov_len(iov, iovcnt);
+    int ret;
+
+    if (!pClient->tx_cork || NULL == pClient->tx_batch || length > pClient->tx_batch_size) {
+        return send_mqtt_bufv(pClient, iov, iovcnt, timer);
+    }
+
+    if (pClient->tx_batch_len + length > pClient->tx_batch_size) {
+        ret = uiot_mqtt_batch_flush(pClient, timer);
+        if (SUCCESS_RET != ret) {
+            return ret;
+        }
+    }
+
+    pClient->tx_packets++;
+    _mqtt_batch_append(pClient, iov, iovcnt);
+    if (pClient->tx_batch_len == pClient->tx_batch_size) {
+        return uiot_mqtt_batch_flush(pClient, timer);
+    }
+
+    return SUCCESS_RET;
+}
+
+int send_mqtt_packet_corked(UIoT_Client *pClient, size_t length, Timer *timer) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    utils_iovec_t iov;
+
+    if (length > pClient->write_buf_size) {
+        return ERR_MQTT_BUFFER_TOO_SHORT;
+    }
+
+    iov.base = pClient->write_buf;
+    iov.len = length;
+
+    return send_mqtt_bufv_corked(pClient, &iov, 1, timer);
 }
 
 /**
@@ -526,7 +914,7 @@ static int _decode_packet_rem_len_with_net_read(UIoT_Client *pClient, uint32_t *
             return ERR_MQTT_PACKET_READ_ERROR;
         }
 
-        if (pClient->network_stack.read(&(pClient->network_stack), &i, 1, timeout) <= 0) {
+        if (utils_net_ring_read(&(pClient->network_stack), &i, 1, timeout) <= 0) {
             /* The value argument is the important value. len is just used temporarily
              * and never used by the calling function for anything else */
             return FAILURE_RET;
@@ -548,12 +936,17 @@ static int _decode_packet_rem_len_with_net_read(UIoT_Client *pClient, uint32_t *
  * 2. 读取剩余长度字段, 最大为四个字节; 剩余长度表示可变包头和有效负载的长度
  * 3. 根据剩余长度, 读取剩下的数据, 包括可变包头和有效负荷
  *
+ * 所有读取都经过连接的预读缓冲区, 连续到达的多个报文只需访问一次底层连接
+ *
+ * 超过读缓冲区大小的PUBLISH报文只读取固定头部, 通过stream_len返回剩余长度, 由调用者分片读取
+ *
  * @param pClient        Client结构体
  * @param timer          定时器
  * @param packet_type    报文类型
+ * @param stream_len     需要分片读取的剩余长度, 0表示报文已完整读入读缓冲区
  * @return
  */
-static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type) {
+static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, uint32_t *stream_len) {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
@@ -567,8 +960,10 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
         timer_left_ms = 1;
     }
 
+    *stream_len = 0;
+
     // 1. 读取报文固定头部的第一个字节
-    read_len = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, 1, timer_left_ms);
+    read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, 1, timer_left_ms);
     if (read_len < 0) {
         return read_len;
     } else if (read_len == 0) {
@@ -589,6 +984,17 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
         return ret;
     }
 
+    // 报文超过读缓冲区时在扩展上限内扩展读缓冲区
+    _mqtt_read_buf_reserve(pClient, get_mqtt_packet_len(rem_len));
+
+    // PUBLISH报文仍超过读缓冲区时交给分片接收处理
+    *packet_type = (pClient->read_buf[0]&MQTT_HEADER_TYPE_MASK)>>MQTT_HEADER_TYPE_SHIFT;
+    if (PUBLISH == *packet_type && (rem_len >= pClient->read_buf_size ||
+        (len + mqtt_write_packet_rem_len(pClient->read_buf + 1, rem_len) + rem_len) > pClient->read_buf_size)) {
+        *stream_len = rem_len;
+        return SUCCESS_RET;
+    }
+
     // 如果读缓冲区的大小小于报文的剩余长度, 报文会被丢弃
     if (rem_len >= pClient->read_buf_size) {
         size_t total_bytes_read = 0;
@@ -602,7 +1008,7 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
 
         bytes_to_be_read = pClient->read_buf_size;
         do {
-            read_len = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read, timer_left_ms);
+            read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read, timer_left_ms);
             if (read_len > 0) {
                 total_bytes_read += read_len;
                 if ((rem_len - total_bytes_read) >= pClient->read_buf_size) {
@@ -629,7 +1035,7 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
         }
         timer_left_ms += UIOT_MQTT_MAX_REMAIN_WAIT_MS;
     
-        pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, rem_len, timer_left_ms);
+        utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, rem_len, timer_left_ms);
         return ERR_MQTT_BUFFER_TOO_SHORT;
     } else {
         if (rem_len > 0) {
@@ -639,7 +1045,7 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
                 timer_left_ms = 1;
             }
             timer_left_ms += UIOT_MQTT_MAX_REMAIN_WAIT_MS;
-            read_len = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf + len, rem_len, timer_left_ms);
+            read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf + len, rem_len, timer_left_ms);
             if (read_len < 0) {
                 return read_len;
             } else if (read_len == 0) {
@@ -653,72 +1059,162 @@ static int _read_mqtt_packet(UIoT_Client *pClient, Timer *timer, uint8_t *packet
     return SUCCESS_RET;
 }
 
+static UIoTInboundAck *_inbound_ack_find(UIoT_Client *pClient, uint16_t packet_id)
+{
+    int i;
+
+    for (i = 0; i < UIOT_MQTT_MANUAL_ACK_MAX; ++i) {
+        if (MQTT_INBOUND_ACK_FREE != pClient->inbound_acks[i].state && pClient->inbound_acks[i].id == packet_id) {
+            return &pClient->inbound_acks[i];
+        }
+    }
+
+    return NULL;
+}
+
 /**
- * @brief 消息主题是否相同
+ * @brief 记录等待应用回复的消息, 调用者需持有lock_generic
  *
- * @param topic_filter
- * @param topicName
- * @return
+ * @return 消息的ack token, 记录已满时返回0, 由SDK自动回复
  */
-static uint8_t _is_topic_equals(char *topic_filter, char *topicName) {
-    return (uint8_t) (strlen(topic_filter) == strlen(topicName) && !strcmp(topic_filter, topicName));
+static uint32_t _inbound_ack_defer(UIoT_Client *pClient, QoS qos, uint16_t packet_id)
+{
+    int i;
+
+    for (i = 0; i < UIOT_MQTT_MANUAL_ACK_MAX; ++i) {
+        if (MQTT_INBOUND_ACK_FREE == pClient->inbound_acks[i].state) {
+            pClient->inbound_acks[i].id = packet_id;
+            pClient->inbound_acks[i].qos = (uint8_t)qos;
+            pClient->inbound_acks[i].state = MQTT_INBOUND_ACK_PENDING;
+            pClient->inbound_ack_count++;
+            return ((uint32_t)pClient->inbound_ack_epoch << 16) | packet_id;
+        }
+    }
+
+    LOG_WARN("too many unacked messages, msg %u is acked automatically", packet_id);
+    return 0;
 }
 
 /**
- * @brief 消息主题匹配
- *
- * assume topic filter and name is in correct format
- * # can only be at end
- * + and # can only be next to separator
- *
- * @param topic_filter   订阅消息的主题名
- * @param topicName     收到消息的主题名, 不能包含通配符
- * @param topicNameLen  主题名的长度
- * @return
+ * @brief 应用还未回复的消息是否重复到达, 重复到达的消息不再分发, 由应用回复
  */
-static uint8_t _is_topic_matched(char *topic_filter, char *topicName, uint16_t topicNameLen) {
-    char *curf;
-    char *curn;
-    char *curn_end;
+static bool _inbound_ack_is_pending(UIoT_Client *pClient, uint16_t packet_id)
+{
+    bool pending;
 
-    curf = topic_filter;
-    curn = topicName;
-    curn_end = curn + topicNameLen;
+    if (0 == pClient->inbound_ack_count) {
+        return false;
+    }
 
-    while (*curf && (curn < curn_end)) {
+    HAL_MutexLock(pClient->lock_generic);
+    pending = (NULL != _inbound_ack_find(pClient, packet_id));
+    HAL_MutexUnlock(pClient->lock_generic);
 
-        if (*curf == '+' && *curn == '/') {
-            curf++;
-            continue;
-        }
+    return pending;
+}
 
-        if (*curn == '/' && *curf != '/') {
-            break;
-        }
+bool uiot_mqtt_rx_paused(UIoT_Client *pClient)
+{
+    /* 读取inbound_ack_count不加锁, 最多使暂停或恢复读取推迟一个轮询周期 */
+    return pClient->inbound_ack_count >= UIOT_MQTT_MANUAL_ACK_MAX;
+}
 
-        if (*curf != '+' && *curf != '#' && *curf != *curn) {
-            break;
-        }
+int uiot_mqtt_ack(UIoT_Client *pClient, uint32_t ack_token)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
 
-        if (*curf == '+') {
-            /* skip until we meet the next separator, or end of string */
-            char *nextpos = curn + 1;
-            while (nextpos < curn_end && *nextpos != '/')
-                nextpos = ++curn + 1;
-        } else if (*curf == '#') {
-            /* skip until end of string */
-            curn = curn_end - 1;
-        }
+    UIoTInboundAck *entry;
 
-        curf++;
-        curn++;
-    };
+    if (0 == ack_token) {
+        return SUCCESS_RET;
+    }
 
-    if (*curf == '\0') {
-        return (uint8_t) (curn == curn_end);
-    } else {
-        return (uint8_t) ((*curf == '#') || *(curf + 1) == '#' || (*curf == '+' && *(curn - 1) == '/'));
+    HAL_MutexLock(pClient->lock_generic);
+    entry = _inbound_ack_find(pClient, (uint16_t)(ack_token & 0xFFFF));
+    if ((ack_token >> 16) != pClient->inbound_ack_epoch || NULL == entry
+        || MQTT_INBOUND_ACK_PENDING != entry->state) {
+        HAL_MutexUnlock(pClient->lock_generic);
+        return ERR_MQTT_ACK_INVALID;
     }
+    entry->state = MQTT_INBOUND_ACK_READY;
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    return uiot_mqtt_ack_flush(pClient);
+}
+
+int uiot_mqtt_ack_flush(UIoT_Client *pClient)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoTInboundAck acks[UIOT_MQTT_MANUAL_ACK_MAX];
+    uint8_t sent[UIOT_MQTT_MANUAL_ACK_MAX];
+    Timer timer;
+    uint32_t len = 0;
+    int count = 0;
+    int ret = SUCCESS_RET;
+    int i, j;
+
+    // 未连接时保留回复, 重连且服务器保留了会话后再发送
+    if (!get_client_conn_state(pClient)) {
+        return SUCCESS_RET;
+    }
+
+    // 取出待发送的回复后释放lock_generic, 发送时只持有lock_write_buf
+    HAL_MutexLock(pClient->lock_generic);
+    for (i = 0; i < UIOT_MQTT_MANUAL_ACK_MAX; ++i) {
+        if (MQTT_INBOUND_ACK_READY == pClient->inbound_acks[i].state) {
+            pClient->inbound_acks[i].state = MQTT_INBOUND_ACK_SENDING;
+            acks[count++] = pClient->inbound_acks[i];
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (0 == count) {
+        return SUCCESS_RET;
+    }
+
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    for (i = 0; i < count; ++i) {
+        if (SUCCESS_RET == ret) {
+            ret = serialize_pub_ack_packet(pClient->write_buf, pClient->write_buf_size,
+                                           (QOS1 == acks[i].qos) ? PUBACK : PUBREC, 0, acks[i].id, &len);
+        }
+        if (SUCCESS_RET == ret) {
+            ret = send_mqtt_packet(pClient, len, &timer);
+        }
+        sent[i] = (SUCCESS_RET == ret);
+    }
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    // 发送失败的回复在重连后重新发送
+    HAL_MutexLock(pClient->lock_generic);
+    for (i = 0; i < count; ++i) {
+        for (j = 0; j < UIOT_MQTT_MANUAL_ACK_MAX; ++j) {
+            if (MQTT_INBOUND_ACK_SENDING == pClient->inbound_acks[j].state && pClient->inbound_acks[j].id == acks[i].id) {
+                break;
+            }
+        }
+        if (j == UIOT_MQTT_MANUAL_ACK_MAX) {
+            continue;
+        }
+
+        if (sent[i]) {
+            pClient->inbound_acks[j].state = MQTT_INBOUND_ACK_FREE;
+            pClient->inbound_ack_count--;
+        } else {
+            pClient->inbound_acks[j].state = MQTT_INBOUND_ACK_READY;
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (SUCCESS_RET != ret) {
+        LOG_ERROR("send manual ack failed: %d", ret);
+    }
+
+    return ret;
 }
 
 /**
@@ -736,29 +1232,50 @@ static int _deliver_message(UIoT_Client *pClient, char *topicName, uint16_t topi
 
     message->topic = topicName;
     message->topic_len = (size_t)topicNameLen;
+    message->ack_token = 0;
 
-    uint32_t i;
+    int i;
     int flag_matched = 0;
+    SubTopicHandle sub_handle;
     
+    // 通过订阅主题树查找匹配的订阅, 多个订阅匹配时取sub_handles中最靠前的设置了回调的一个
     HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_SUB_TOPICS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL)
-            && (_is_topic_equals(topicName, (char *) pClient->sub_handles[i].topic_filter) ||
-                _is_topic_matched((char *) pClient->sub_handles[i].topic_filter, topicName, topicNameLen)))
-        {
-            HAL_MutexUnlock(pClient->lock_generic);
-            if (pClient->sub_handles[i].message_handler != NULL) {
-                pClient->sub_handles[i].message_handler(pClient, message, pClient->sub_handles[i].message_handler_data);
-                return SUCCESS_RET;
-            }
-            HAL_MutexLock(pClient->lock_generic);
+    i = topic_trie_match(pClient->sub_trie, topicName, topicNameLen);
+    if (i >= 0) {
+        sub_handle = pClient->sub_handles[i];
+        // 回调中可能直接调用IOT_MQTT_Ack, 必须在回调前记录
+        if (sub_handle.manual_ack && sub_handle.message_handler != NULL && QOS0 != message->qos) {
+            message->ack_token = _inbound_ack_defer(pClient, message->qos, message->id);
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (i >= 0) {
+        if (sub_handle.message_handler != NULL) {
+            sub_handle.message_handler(pClient, message, sub_handle.message_handler_data);
+            return SUCCESS_RET;
+        }
+        // 只设置了分片回调时, 整个消息作为一个分片回调
+        if (sub_handle.chunk_handler != NULL) {
+            MQTTMessageChunk chunk;
+            chunk.qos = message->qos;
+            chunk.retained = message->retained;
+            chunk.dup = message->dup;
+            chunk.id = message->id;
+            chunk.topic = message->topic;
+            chunk.topic_len = message->topic_len;
+            chunk.total_len = message->payload_len;
+            chunk.offset = 0;
+            chunk.chunk = message->payload;
+            chunk.chunk_len = message->payload_len;
+            chunk.is_last = 1;
+            sub_handle.chunk_handler(pClient, &chunk, sub_handle.message_handler_data);
+            return SUCCESS_RET;
         }
     }
 
     /* Message handler not found for topic */
     /* May be we do not care  change FAILURE  use SUCCESS*/
-    HAL_MutexUnlock(pClient->lock_generic);
-
     if (0 == flag_matched) {
         LOG_DEBUG("no matching any topic, call default handle function");
 
@@ -774,71 +1291,65 @@ static int _deliver_message(UIoT_Client *pClient, char *topicName, uint16_t topi
 }
 
 /**
- * @brief 从等待 publish ACK 的列表中，移除由 msdId 标记的元素
+ * @brief 从等待 publish ACK 的窗口中，移除由 msdId 标记的消息
  *
  * @param c
  * @param msgId
+ * @param result    通知完成回调的发布结果
  *
  * @return 0, success; NOT 0, fail;
  */
-static int _mask_pubInfo_from(UIoT_Client *c, uint16_t msgId)
+static int _mask_pubInfo_from(UIoT_Client *c, uint16_t msgId, int result)
 {
+    int ret;
+    UIoTPubInfo *repubInfo;
+    OnPublishComplete on_complete = NULL;
+    void *complete_data = NULL;
+
     if (!c) {
         return FAILURE_RET;
     }
 
     HAL_MutexLock(c->lock_list_pub);
-    if (c->list_pub_wait_ack->len) {
-        ListIterator *iter;
-        ListNode *node = NULL;
-        UIoTPubInfo *repubInfo = NULL;
-
-        if (NULL == (iter = list_iterator_new(c->list_pub_wait_ack, LIST_TAIL))) {
-            HAL_MutexUnlock(c->lock_list_pub);
-            return SUCCESS_RET;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-
-            if (NULL == node) {
-                break;
-            }
-
-            repubInfo = (UIoTPubInfo *) node->val;
-            if (NULL == repubInfo) {
-                LOG_ERROR("node's value is invalid!");
-                continue;
-            }
-
-            if (repubInfo->msg_id == msgId) {
-                repubInfo->node_state = MQTT_NODE_STATE_INVALID; /* 标记为无效节点 */
-            }
-        }
-
-        list_iterator_destroy(iter);
+    repubInfo = uiot_mqtt_pub_window_find(&c->pub_window, msgId);
+    if (NULL != repubInfo) {
+        on_complete = repubInfo->on_complete;
+        complete_data = repubInfo->complete_data;
+        uiot_mqtt_pub_window_rtt_sample(&c->pub_window, repubInfo);
     }
+    ret = uiot_mqtt_pub_window_release(&c->pub_window, msgId);
     HAL_MutexUnlock(c->lock_list_pub);
 
-    return SUCCESS_RET;
+    if (NULL != on_complete) {
+        on_complete(c, msgId, result, complete_data);
+    }
+    if (SUCCESS_RET == ret) {
+        uiot_mqtt_async_window_released(c);
+    }
+
+    return ret;
 }
 
 /* 从等待 subscribe(unsubscribe) ACK 的列表中，移除由 msdId 标记的元素 */
 /* 同时返回消息处理数据 messageHandler */
 /* return: 0, success; NOT 0, fail; */
-static int _mask_sub_info_from(UIoT_Client *c, unsigned int msgId, SubTopicHandle *messageHandler)
+static int _mask_sub_info_from(UIoT_Client *c, unsigned int msgId, SubTopicHandle *messageHandlers,
+                               uint32_t max_count, uint32_t *count)
 {
-    if (NULL == c || NULL == messageHandler) {
+    if (NULL == c || NULL == messageHandlers || NULL == count) {
         return FAILURE_RET;
     }
 
+    *count = 0;
+
     HAL_MutexLock(c->lock_list_sub);
     if (c->list_sub_wait_ack->len) {
         ListIterator *iter;
         ListNode *node = NULL;
         UIoTSubInfo *sub_info = NULL;
 
-        if (NULL == (iter = list_iterator_new(c->list_sub_wait_ack, LIST_TAIL))) {
+        /* 按添加顺序遍历, 与报文中主题的顺序一致 */
+        if (NULL == (iter = list_iterator_new(c->list_sub_wait_ack, LIST_HEAD))) {
             HAL_MutexUnlock(c->lock_list_sub);
             return SUCCESS_RET;
         }
@@ -855,8 +1366,10 @@ static int _mask_sub_info_from(UIoT_Client *c, unsigned int msgId, SubTopicHandl
                 continue;
             }
 
-            if (sub_info->msg_id == msgId) {
-                *messageHandler = sub_info->handler; /* return handle */
+            if (sub_info->msg_id == msgId && MQTT_NODE_STATE_INVALID != sub_info->node_state) {
+                if (*count < max_count) {
+                    messageHandlers[(*count)++] = sub_info->handler; /* return handle */
+                }
                 sub_info->node_state = MQTT_NODE_STATE_INVALID; /* mark as invalid node */
             } 
         }
@@ -877,15 +1390,29 @@ static int _handle_puback_packet(UIoT_Client *pClient, Timer *timer)
     POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
     uint16_t packet_id;
-    uint8_t dup, type;
+    uint8_t dup, type, reason_code;
     int ret;
 
-    ret = deserialize_ack_packet(&type, &dup, &packet_id, pClient->read_buf, pClient->read_buf_size);
+    ret = deserialize_ack_packet(&type, &dup, &packet_id, &reason_code, pClient->read_buf, pClient->read_buf_size);
     if (SUCCESS_RET != ret) {
         return ret;
     }
 
-    (void)_mask_pubInfo_from(pClient, packet_id);
+    /* MQTT 5.0中服务器可以拒绝消息, 消息同样已结束, 不再重发 */
+    if (reason_code >= MQTT_REASON_CODE_FAILURE) {
+        LOG_ERROR("publish rejected, packet_id: %u reason_code: 0x%02x", packet_id, reason_code);
+        (void)_mask_pubInfo_from(pClient, packet_id, ERR_MQTT_PUB_NACK);
+
+        if (NULL != pClient->event_handler.h_fp) {
+            MQTTEventMsg msg;
+            msg.event_type = MQTT_EVENT_PUBLISH_NACK;
+            msg.msg = (void *)(uintptr_t)packet_id;
+            pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+        }
+        return SUCCESS_RET;
+    }
+
+    (void)_mask_pubInfo_from(pClient, packet_id, SUCCESS_RET);
 
     /* 调用回调函数，通知外部PUBLISH成功. */
     if (NULL != pClient->event_handler.h_fp) {
@@ -901,105 +1428,154 @@ static int _handle_puback_packet(UIoT_Client *pClient, Timer *timer)
 /**
  * @brief 终端收到服务器的的 SUBACK 消息之后, 处理收到的 SUBACK 报文
  */
+/**
+ * @brief 将订阅成功的主题加入sub_handles, 调用者需持有lock_generic
+ */
+static int _add_sub_handle(UIoT_Client *pClient, SubTopicHandle *sub_handle)
+{
+    int i;
+    int i_free = -1;
+
+    for (i = 0; i < MAX_SUB_TOPICS; ++i) {
+        if ((NULL != pClient->sub_handles[i].topic_filter)) {
+            if (0 == _check_handle_is_identical(&pClient->sub_handles[i], sub_handle)) {
+                pClient->sub_handles[i].manual_ack = sub_handle->manual_ack;
+                HAL_Free((void *)sub_handle->topic_filter);
+                sub_handle->topic_filter = NULL;
+                return SUCCESS_RET;
+            }
+        } else {
+            if (-1 == i_free) {
+                i_free = i; /* record available element */
+            }
+        }
+    }
+
+    if (-1 == i_free) {
+        LOG_ERROR("NO more @sub_handles space!");
+        HAL_Free((void *)sub_handle->topic_filter);
+        sub_handle->topic_filter = NULL;
+        return FAILURE_RET;
+    }
+
+    pClient->sub_handles[i_free].topic_filter = sub_handle->topic_filter;
+    pClient->sub_handles[i_free].message_handler = sub_handle->message_handler;
+    pClient->sub_handles[i_free].qos = sub_handle->qos;
+    pClient->sub_handles[i_free].message_handler_data = sub_handle->message_handler_data;
+    pClient->sub_handles[i_free].chunk_handler = sub_handle->chunk_handler;
+    pClient->sub_handles[i_free].manual_ack = sub_handle->manual_ack;
+
+    // 同一主题过滤器有多个订阅时, 主题树中记录最靠前的一个; 没有回调的订阅不参与分发
+    int trie_index = topic_trie_find(pClient->sub_trie, sub_handle->topic_filter);
+    if ((NULL != sub_handle->message_handler || NULL != sub_handle->chunk_handler)
+        && (trie_index < 0 || i_free < trie_index)) {
+        if (0 != topic_trie_insert(pClient->sub_trie, sub_handle->topic_filter, i_free)) {
+            LOG_ERROR("insert topic trie failed: %s", sub_handle->topic_filter);
+        }
+    }
+
+    return SUCCESS_RET;
+}
+
+/**
+ * @brief 终端收到服务器的的 SUBACK 消息之后, 处理收到的 SUBACK 报文
+ *
+ * 一个SUBSCRIBE报文可以包含多个主题, SUBACK中的返回码与报文中主题的顺序一一对应,
+ * 被服务器拒绝的主题不加入sub_handles
+ */
 static int _handle_suback_packet(UIoT_Client *pClient, Timer *timer, QoS qos)
 {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
     uint32_t count = 0;
+    uint32_t sub_count = 0;
     uint16_t packet_id = 0;
-    QoS grantedQoS[3] = {QOS0, QOS0, QOS0};
+    QoS grantedQoS[MAX_SUB_TOPICS];
+    SubTopicHandle sub_handles[MAX_SUB_TOPICS];
     int ret;
     bool sub_nack = false;
+    bool sub_full = false;
     
     // 反序列化SUBACK报文
-    ret = deserialize_suback_packet(&packet_id, 1, &count, grantedQoS, pClient->read_buf, pClient->read_buf_size);
+    ret = deserialize_suback_packet(pClient->options.mqtt_version, &packet_id, MAX_SUB_TOPICS, &count, grantedQoS,
+                                    pClient->read_buf, pClient->read_buf_size);
     if (SUCCESS_RET != ret) {
         return ret;
     }
 
-    int flag_dup = 0, i_free = -1;
-
-    int j;
-    for (j = 0; j <  count; j++) {
-        /* In negative case, grantedQoS will be 0xFFFF FF80, which means -128 */
-        if ((uint8_t)grantedQoS[j] == 0x80) {
-            sub_nack = true;
-            LOG_ERROR("MQTT SUBSCRIBE failed, ack code is 0x80");
-        }
-    }
-
     HAL_MutexLock(pClient->lock_generic);
     
-    SubTopicHandle sub_handle;
-    memset(&sub_handle, 0, sizeof(SubTopicHandle));
-    (void)_mask_sub_info_from(pClient, (unsigned int)packet_id, &sub_handle);
+    (void)_mask_sub_info_from(pClient, (unsigned int)packet_id, sub_handles, MAX_SUB_TOPICS, &sub_count);
 
-    if (/*(NULL == sub_handle.message_handler) || */(NULL == sub_handle.topic_filter)) {
+    if (0 == sub_count || NULL == sub_handles[0].topic_filter) {
         LOG_ERROR("sub_handle is illegal, topic is null");
         HAL_MutexUnlock(pClient->lock_generic);
         return ERR_MQTT_SUB_FAILED;
     }
 
+    uint32_t j;
+    for (j = 0; j < sub_count; j++) {
+        /* In negative case, grantedQoS will be 0xFFFF FF80, which means -128; MQTT 5.0 uses reason codes >= 0x80 */
+        if (j >= count || (uint8_t)grantedQoS[j] >= MQTT_REASON_CODE_FAILURE) {
+            sub_nack = true;
+            LOG_ERROR("MQTT SUBSCRIBE failed, packet_id: %u topic: %s", packet_id, sub_handles[j].topic_filter);
+            HAL_Free((void *)sub_handles[j].topic_filter);
+            sub_handles[j].topic_filter = NULL;
+            continue;
+        }
+
+        if (SUCCESS_RET != _add_sub_handle(pClient, &sub_handles[j])) {
+            sub_full = true;
+        }
+    }
+    
+    HAL_MutexUnlock(pClient->lock_generic);
+
     if (sub_nack) {
-        LOG_ERROR("MQTT SUBSCRIBE failed, packet_id: %u topic: %s", packet_id, sub_handle.topic_filter);
         /* 调用回调函数，通知外部 SUBSCRIBE 失败. */
         if (NULL != pClient->event_handler.h_fp) {
             MQTTEventMsg msg;
             msg.event_type = MQTT_EVENT_SUBSCRIBE_NACK;
             msg.msg = (void *)(uintptr_t)packet_id;
-            if (pClient->event_handler.h_fp != NULL)
-                pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+            pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
         }
-        HAL_Free((void *)sub_handle.topic_filter);
-        sub_handle.topic_filter = NULL;
-        HAL_MutexUnlock(pClient->lock_generic);
         return ERR_MQTT_SUB_FAILED;
     }
 
-    int i;
-    for (i = 0; i < MAX_SUB_TOPICS; ++i) {
-        if ((NULL != pClient->sub_handles[i].topic_filter)) {
-            if (0 == _check_handle_is_identical(&pClient->sub_handles[i], &sub_handle)) {
-                flag_dup = 1;
-                HAL_Free((void *)sub_handle.topic_filter);
-                sub_handle.topic_filter = NULL;
-                break;
-            }
-        } else {
-            if (-1 == i_free) {
-                i_free = i; /* record available element */
-            }
-        }
-    }
-
-    if (0 == flag_dup) {
-        if (-1 == i_free) {
-            LOG_ERROR("NO more @sub_handles space!");
-            HAL_MutexUnlock(pClient->lock_generic);
-            return FAILURE_RET;
-        } else {
-            pClient->sub_handles[i_free].topic_filter = sub_handle.topic_filter;
-            pClient->sub_handles[i_free].message_handler = sub_handle.message_handler;
-            pClient->sub_handles[i_free].qos = sub_handle.qos;
-            pClient->sub_handles[i_free].message_handler_data = sub_handle.message_handler_data;
-        }
+    if (sub_full) {
+        return FAILURE_RET;
     }
-    
-    HAL_MutexUnlock(pClient->lock_generic);
 
     /* 调用回调函数，通知外部 SUBSCRIBE 成功. */
     if (NULL != pClient->event_handler.h_fp) {
         MQTTEventMsg msg;
         msg.event_type = MQTT_EVENT_SUBSCRIBE_SUCCESS;
         msg.msg = (void *)(uintptr_t)packet_id;
-        if (pClient->event_handler.h_fp != NULL)
-            pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+        pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
     }
 
     return SUCCESS_RET;
 }
 
+void uiot_mqtt_sub_trie_rebuild(UIoT_Client *pClient) {
+    int i;
+
+    topic_trie_clear(pClient->sub_trie);
+
+    // 倒序插入, 同一主题过滤器最终记录最靠前的下标; 没有回调的订阅不插入,
+    // 与逐个比较时相同, 消息交给匹配的订阅中第一个设置了回调的
+    for (i = MAX_SUB_TOPICS - 1; i >= 0; --i) {
+        if (NULL == pClient->sub_handles[i].topic_filter
+            || (NULL == pClient->sub_handles[i].message_handler && NULL == pClient->sub_handles[i].chunk_handler)) {
+            continue;
+        }
+        if (0 != topic_trie_insert(pClient->sub_trie, pClient->sub_handles[i].topic_filter, i)) {
+            LOG_ERROR("insert topic trie failed: %s", pClient->sub_handles[i].topic_filter);
+        }
+    }
+}
+
 /**
  * @brief 终端收到服务器的的 USUBACK 消息之后, 处理收到的 USUBACK 报文
  */
@@ -1009,14 +1585,18 @@ static int _handle_unsuback_packet(UIoT_Client *pClient, Timer *timer)
     POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
     uint16_t packet_id = 0;
+    uint8_t reason_code = 0;
 
-    int ret =  deserialize_unsuback_packet(&packet_id, pClient->read_buf, pClient->read_buf_size);
+    int ret =  deserialize_unsuback_packet(pClient->options.mqtt_version, &packet_id, &reason_code,
+                                           pClient->read_buf, pClient->read_buf_size);
     if (ret != SUCCESS_RET) {
         return ret;
     }
 
-    SubTopicHandle messageHandler;
-    (void)_mask_sub_info_from(pClient, packet_id, &messageHandler);
+    SubTopicHandle messageHandlers[MAX_SUB_TOPICS];
+    uint32_t unsub_count = 0;
+    uint32_t j;
+    (void)_mask_sub_info_from(pClient, packet_id, messageHandlers, MAX_SUB_TOPICS, &unsub_count);
 
     /* Remove from message handler array */
     HAL_MutexLock(pClient->lock_generic);
@@ -1026,7 +1606,7 @@ static int _handle_unsuback_packet(UIoT_Client *pClient, Timer *timer)
     int i;
     for (i = 0; i < MAX_SUB_TOPICS; ++i) {
         if ((pClient->sub_handles[i].topic_filter != NULL)
-            && (0 == _check_handle_is_identical(&pClient->sub_handles[i], &messageHandler))) {            
+            && (0 == _check_handle_is_identical(&pClient->sub_handles[i], &messageHandlers[0]))) {            
             memset(&pClient->sub_handles[i], 0, sizeof(SubTopicHandle));
 
             /* NOTE: in case of more than one register(subscribe) with different callback function,
@@ -1035,15 +1615,22 @@ static int _handle_unsuback_packet(UIoT_Client *pClient, Timer *timer)
     }
     #endif
 
-    /* Free the topic filter malloced in uiot_mqtt_unsubscribe */
-    if (messageHandler.topic_filter) {
-        HAL_Free((void *)messageHandler.topic_filter);
-        messageHandler.topic_filter = NULL;
+    /* Free the topic filters malloced in uiot_mqtt_unsubscribe_many */
+    for (j = 0; j < unsub_count; ++j) {
+        if (messageHandlers[j].topic_filter) {
+            HAL_Free((void *)messageHandlers[j].topic_filter);
+            messageHandlers[j].topic_filter = NULL;
+        }
+    }
+
+    if (reason_code >= MQTT_REASON_CODE_FAILURE) {
+        LOG_ERROR("MQTT UNSUBSCRIBE failed, packet_id: %u reason_code: 0x%02x", packet_id, reason_code);
+        ret = ERR_MQTT_UNSUB_FAILED;
     }
 
     if (NULL != pClient->event_handler.h_fp) {
         MQTTEventMsg msg;
-        msg.event_type = MQTT_EVENT_UNSUBSCRIBE_SUCCESS;
+        msg.event_type = (SUCCESS_RET == ret) ? MQTT_EVENT_UNSUBSCRIBE_SUCCESS : MQTT_EVENT_UNSUBSCRIBE_NACK;
         msg.msg = (void *)(uintptr_t)packet_id;
 
         pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
@@ -1051,52 +1638,119 @@ static int _handle_unsuback_packet(UIoT_Client *pClient, Timer *timer)
 
     HAL_MutexUnlock(pClient->lock_generic);
 
-    return SUCCESS_RET;
+    return ret;
 }
 
-#ifdef MQTT_CHECK_REPEAT_MSG
+static UIoTInboundId *_inbound_id_slot(UIoT_Client *pClient, uint16_t packet_id)
+{
+    return &pClient->inbound_ids[packet_id & (UIOT_MQTT_INBOUND_ID_WINDOW - 1)];
+}
+
+void uiot_mqtt_inbound_reset(UIoT_Client *pClient)
+{
+    if (NULL == pClient) {
+        return;
+    }
 
-#define MQTT_MAX_REPEAT_BUF_LEN 50
-static uint16_t sg_repeat_packet_id_buf[MQTT_MAX_REPEAT_BUF_LEN];
+    memset(pClient->inbound_ids, 0, sizeof(pClient->inbound_ids));
+
+    // 没有会话的服务器不再接受之前消息的回复, 之前的ack token随之失效
+    HAL_MutexLock(pClient->lock_generic);
+    if (pClient->inbound_ack_count > 0) {
+        memset(pClient->inbound_acks, 0, sizeof(pClient->inbound_acks));
+        pClient->inbound_ack_count = 0;
+        pClient->inbound_ack_epoch = (uint16_t)((0xFFFF == pClient->inbound_ack_epoch) ? 1 : (pClient->inbound_ack_epoch + 1));
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+}
 
 /**
- * @brief 判断packet_id缓存中是否已经存有传入的packet_id;
+ * @brief 判断收到的QoS1/QoS2消息是否已经分发过
+ *
+ * QoS2消息在收到PUBREL之前重复收到时一定不再分发; QoS1消息只在开启MQTT_CHECK_REPEAT_MSG时,
+ * 对保留时间内DUP置位的重发消息过滤
  */
-static int _get_packet_id_in_repeat_buf(uint16_t packet_id)
+static bool _inbound_is_repeated(UIoT_Client *pClient, QoS qos, uint8_t dup, uint16_t packet_id)
 {
-    int i;
-    for (i = 0; i < MQTT_MAX_REPEAT_BUF_LEN; ++i)
-    {
-        if (packet_id == sg_repeat_packet_id_buf[i])
-        {
-            return packet_id;
-        }
+    UIoTInboundId *slot = _inbound_id_slot(pClient, packet_id);
+
+    if (slot->id != packet_id) {
+        return false;
+    }
+
+    if (QOS2 == qos) {
+        return MQTT_INBOUND_PUBREC_SENT == slot->state;
     }
-    return -1;
+
+#ifdef MQTT_CHECK_REPEAT_MSG
+    return dup && MQTT_INBOUND_PUBACK_SENT == slot->state && !has_expired(&slot->expire);
+#else
+    return false;
+#endif
 }
 
-static void _add_packet_id_to_repeat_buf(uint16_t packet_id)
+static void _inbound_record(UIoT_Client *pClient, QoS qos, uint16_t packet_id)
 {
-    static unsigned int current_packet_id_cnt = 0;
-    if (_get_packet_id_in_repeat_buf(packet_id) > 0)
-        return;
+    UIoTInboundId *slot = _inbound_id_slot(pClient, packet_id);
 
-    sg_repeat_packet_id_buf[current_packet_id_cnt++] = packet_id;
+    if (QOS2 == qos) {
+        slot->id = packet_id;
+        slot->state = MQTT_INBOUND_PUBREC_SENT;
+        return;
+    }
 
-    if (current_packet_id_cnt >= MQTT_MAX_REPEAT_BUF_LEN)
-        current_packet_id_cnt = current_packet_id_cnt % 50;
+#ifdef MQTT_CHECK_REPEAT_MSG
+    slot->id = packet_id;
+    slot->state = MQTT_INBOUND_PUBACK_SENT;
+    init_timer(&slot->expire);
+    countdown_ms(&slot->expire, UIOT_MQTT_INBOUND_ID_AGE_MS);
+#endif
 }
 
-void reset_repeat_packet_id_buffer(void)
-{
-    int i;
-    for (i = 0; i < MQTT_MAX_REPEAT_BUF_LEN; ++i)
-    {
-        sg_repeat_packet_id_buf[i] = 0;
+/**
+ * @brief 发送PUBACK/PUBREC/PUBREL/PUBCOMP报文
+ *
+ * @param pClient
+ * @param packet_type
+ * @param packet_id
+ * @param timer
+ * @return
+ */
+static int _send_ack_packet(UIoT_Client *pClient, MessageTypes packet_type, uint16_t packet_id, Timer *timer) {
+    int ret;
+    uint32_t len = 0;
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    ret = serialize_pub_ack_packet(pClient->write_buf, pClient->write_buf_size, packet_type, 0, packet_id, &len);
+    if (SUCCESS_RET != ret) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return ret;
+    }
+
+    ret = send_mqtt_packet_corked(pClient, len, timer);
+    if (SUCCESS_RET != ret) {
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return ret;
     }
+
+    HAL_MutexUnlock(pClient->lock_write_buf);
+    return SUCCESS_RET;
 }
 
-#endif
+/**
+ * @brief 回复QOS1/QOS2的PUBLISH报文, 并记录packet id
+ *
+ * @param pClient
+ * @param qos
+ * @param packet_id
+ * @param timer
+ * @return
+ */
+static int _send_publish_ack(UIoT_Client *pClient, QoS qos, uint16_t packet_id, Timer *timer) {
+    _inbound_record(pClient, qos, packet_id);
+
+    return _send_ack_packet(pClient, (QOS1 == qos) ? PUBACK : PUBREC, packet_id, timer);
+}
 
 /**
  * @brief 终端收到服务器的的PUBLISH消息之后, 处理收到的PUBLISH报文
@@ -1106,10 +1760,10 @@ static int _handle_publish_packet(UIoT_Client *pClient, Timer *timer) {
     uint16_t topic_len;
     MQTTMessage msg;
     int ret;
-    uint32_t len = 0;
 
-    ret = deserialize_publish_packet(&msg.dup, &msg.qos, &msg.retained, &msg.id, &topic_name, &topic_len, (unsigned char **) &msg.payload,
-                                    &msg.payload_len, pClient->read_buf, pClient->read_buf_size);
+    ret = deserialize_publish_packet(pClient->options.mqtt_version, &msg.dup, &msg.qos, &msg.retained, &msg.id,
+                                     &topic_name, &topic_len, (unsigned char **) &msg.payload, &msg.payload_len,
+                                     pClient->read_buf, pClient->read_buf_size);
     if (SUCCESS_RET != ret) {
         return ret;
     }
@@ -1133,45 +1787,231 @@ static int _handle_publish_packet(UIoT_Client *pClient, Timer *timer) {
         return ret;
 
     } else {
-#ifdef MQTT_CHECK_REPEAT_MSG
-        // 判断packet_id之前是否已经收到过
-        int repeat_id = _get_packet_id_in_repeat_buf(msg.id);
+        // 等待应用回复的消息重复到达时不再分发, 也不回复
+        if (_inbound_ack_is_pending(pClient, msg.id)) {
+            return SUCCESS_RET;
+        }
 
-        // 执行订阅消息的回调函数
-        if (repeat_id < 0)
-        {
-#endif
+        // 已经分发过的消息只回复, 不再执行订阅消息的回调函数
+        if (!_inbound_is_repeated(pClient, msg.qos, msg.dup, msg.id)) {
             ret = _deliver_message(pClient, fix_topic, topic_len, &msg);
             if (SUCCESS_RET != ret)
                 return ret;
-#ifdef MQTT_CHECK_REPEAT_MSG
+
+            // 由应用调用IOT_MQTT_Ack回复, 这里只记录packet id
+            if (0 != msg.ack_token) {
+                _inbound_record(pClient, msg.qos, msg.id);
+                return SUCCESS_RET;
+            }
         }
-        _add_packet_id_to_repeat_buf(msg.id);
-#endif
     }
     
-    HAL_MutexLock(pClient->lock_write_buf);
-    if (QOS1 == msg.qos) {
-        ret = serialize_pub_ack_packet(pClient->write_buf, pClient->write_buf_size, PUBACK, 0, msg.id, &len);
-    } else { /* Message is not QOS0 or 1 means only option left is QOS2 */
-        ret = serialize_pub_ack_packet(pClient->write_buf, pClient->write_buf_size, PUBREC, 0, msg.id, &len);
+    return _send_publish_ack(pClient, msg.qos, msg.id, timer);
+}
+
+/**
+ * @brief 查找与主题匹配的订阅的分片回调
+ *
+ * @param pClient
+ * @param topicName
+ * @param topicNameLen
+ * @param handler       分片回调函数
+ * @param handler_data  用户数据
+ * @return              找到返回SUCCESS_RET, 否则返回FAILURE_RET
+ */
+static int _find_chunk_handler(UIoT_Client *pClient, char *topicName, uint16_t topicNameLen,
+                               OnMessageChunkHandler *handler, void **handler_data) {
+    int i;
+    int ret = FAILURE_RET;
+
+    HAL_MutexLock(pClient->lock_generic);
+    i = topic_trie_match(pClient->sub_trie, topicName, topicNameLen);
+    if (i >= 0 && pClient->sub_handles[i].chunk_handler != NULL) {
+        *handler = pClient->sub_handles[i].chunk_handler;
+        *handler_data = pClient->sub_handles[i].message_handler_data;
+        ret = SUCCESS_RET;
     }
+    HAL_MutexUnlock(pClient->lock_generic);
 
-    if (SUCCESS_RET != ret) {
-        HAL_MutexUnlock(pClient->lock_write_buf);
-        return ret;
+    return ret;
+}
+
+/**
+ * @brief 分片接收时读取MQTT 5.0 PUBLISH报文的属性
+ *
+ * @param pClient
+ * @param timeout_ms
+ * @param rem_len       报文剩余长度
+ * @param total_read    已读取的字节数, 返回时加上属性占用的字节数
+ * @return
+ */
+static int _read_publish_stream_properties(UIoT_Client *pClient, uint32_t timeout_ms, uint32_t rem_len,
+                                           uint32_t *total_read) {
+    unsigned char *ptr = pClient->read_buf;
+    uint32_t len = 0;
+    uint32_t props_len = 0;
+    uint32_t len_bytes = 0;
+    MQTTProperties props;
+    int read_len;
+
+    // 属性长度为变长整数, 逐字节读取
+    do {
+        if (len >= MAX_NO_OF_REMAINING_LENGTH_BYTES || *total_read + len >= rem_len) {
+            return ERR_MQTT_PACKET_READ_ERROR;
+        }
+        read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf + len, 1, timeout_ms);
+        if (read_len != 1) {
+            return (read_len < 0) ? read_len : ERR_MQTT_PACKET_READ_ERROR;
+        }
+    } while (pClient->read_buf[len++] & 0x80);
+
+    (void)mqtt_read_packet_rem_len_form_buf(pClient->read_buf, &props_len, &len_bytes);
+    if (len + props_len > pClient->read_buf_size || *total_read + len + props_len > rem_len) {
+        return ERR_MQTT_PACKET_READ_ERROR;
     }
 
-    ret = send_mqtt_packet(pClient, len, timer);
-    if (SUCCESS_RET != ret) {
-        HAL_MutexUnlock(pClient->lock_write_buf);
-        return ret;
+    if (props_len > 0) {
+        read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf + len, props_len, timeout_ms);
+        if (read_len != (int)props_len) {
+            return (read_len < 0) ? read_len : ERR_MQTT_PACKET_READ_ERROR;
+        }
     }
 
-    HAL_MutexUnlock(pClient->lock_write_buf);
+    // 连接时没有允许服务器使用主题别名
+    if (SUCCESS_RET != mqtt_read_properties(&ptr, pClient->read_buf + len + props_len, &props) || 0 != props.topic_alias) {
+        return ERR_MQTT_PACKET_READ_ERROR;
+    }
+    *total_read += len + props_len;
+
     return SUCCESS_RET;
 }
 
+/**
+ * @brief 分片接收超过读缓冲区大小的PUBLISH报文
+ *
+ * 固定头部已由_read_mqtt_packet读入读缓冲区首字节, 这里读取可变头部后, 按读缓冲区大小依次
+ * 读取消息负载并回调订阅的分片回调函数。没有订阅设置分片回调时, 报文被读取丢弃
+ *
+ * @param pClient
+ * @param timer
+ * @param rem_len     报文剩余长度
+ * @return
+ */
+static int _handle_publish_stream(UIoT_Client *pClient, Timer *timer, uint32_t rem_len) {
+    unsigned char header = pClient->read_buf[0];
+    unsigned char *ptr;
+    char fix_topic[MAX_SIZE_OF_CLOUD_TOPIC] = {0};
+    uint16_t topic_len;
+    uint32_t var_header_len;
+    uint32_t total_read = 0;
+    OnMessageChunkHandler chunk_handler = NULL;
+    void *handler_data = NULL;
+    MQTTMessageChunk chunk;
+    uint8_t repeated = 0;
+    int read_len;
+    int timer_left_ms;
+    int ret;
+
+    memset(&chunk, 0, sizeof(MQTTMessageChunk));
+    chunk.qos = (QoS) ((header&MQTT_HEADER_QOS_MASK)>>MQTT_HEADER_QOS_SHIFT);
+    chunk.dup = (header&MQTT_HEADER_DUP_MASK)>>MQTT_HEADER_DUP_SHIFT;
+    chunk.retained = header&MQTT_HEADER_RETAIN_MASK;
+
+    timer_left_ms = left_ms(timer);
+    if (timer_left_ms <= 0) {
+        timer_left_ms = 1;
+    }
+    timer_left_ms += UIOT_MQTT_MAX_REMAIN_WAIT_MS;
+
+    // 1. 读取主题长度
+    read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, 2, timer_left_ms);
+    if (read_len != 2) {
+        return (read_len < 0) ? read_len : ERR_MQTT_PACKET_READ_ERROR;
+    }
+    total_read = 2;
+
+    ptr = pClient->read_buf;
+    topic_len = mqtt_read_uint16_t(&ptr);
+    var_header_len = topic_len + ((QOS0 == chunk.qos) ? 0 : 2);
+
+    // 2. 读取主题和packet id
+    if (topic_len >= MAX_SIZE_OF_CLOUD_TOPIC || (2 + var_header_len) > rem_len) {
+        LOG_ERROR("topic len exceed buffer len");
+        chunk_handler = NULL;
+    } else {
+        read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, var_header_len, timer_left_ms);
+        if (read_len != (int)var_header_len) {
+            return (read_len < 0) ? read_len : ERR_MQTT_PACKET_READ_ERROR;
+        }
+        total_read += var_header_len;
+
+        memcpy(fix_topic, pClient->read_buf, topic_len);
+        if (QOS0 != chunk.qos) {
+            ptr = pClient->read_buf + topic_len;
+            chunk.id = mqtt_read_uint16_t(&ptr);
+        }
+
+        if (MQTT_5_0 == pClient->options.mqtt_version) {
+            ret = _read_publish_stream_properties(pClient, timer_left_ms, rem_len, &total_read);
+            if (SUCCESS_RET != ret) {
+                return ret;
+            }
+        }
+
+        // 已经分发过的消息只读取不回调
+        if (QOS0 != chunk.qos && _inbound_is_repeated(pClient, chunk.qos, chunk.dup, chunk.id)) {
+            repeated = 1;
+        }
+        if (0 == repeated) {
+            (void)_find_chunk_handler(pClient, fix_topic, topic_len, &chunk_handler, &handler_data);
+        }
+    }
+
+    chunk.topic = fix_topic;
+    chunk.topic_len = topic_len;
+    chunk.total_len = rem_len - total_read;
+
+    // 3. 按读缓冲区大小分片读取消息负载
+    while (total_read < rem_len) {
+        size_t bytes_to_be_read = Min(rem_len - total_read, pClient->read_buf_size);
+
+        timer_left_ms = left_ms(timer);
+        if (timer_left_ms <= 0) {
+            timer_left_ms = 1;
+        }
+        timer_left_ms += UIOT_MQTT_MAX_REMAIN_WAIT_MS;
+
+        read_len = utils_net_ring_read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read, timer_left_ms);
+        if (read_len <= 0) {
+            return (read_len < 0) ? read_len : ERR_MQTT_PACKET_READ_ERROR;
+        }
+        total_read += read_len;
+
+        if (NULL != chunk_handler) {
+            chunk.chunk = pClient->read_buf;
+            chunk.chunk_len = read_len;
+            chunk.is_last = (total_read == rem_len) ? 1 : 0;
+            chunk_handler(pClient, &chunk, handler_data);
+            chunk.offset += read_len;
+        }
+    }
+
+    if (repeated) {
+        return _send_publish_ack(pClient, chunk.qos, chunk.id, timer);
+    }
+
+    if (NULL == chunk_handler) {
+        LOG_ERROR("MQTT Recv buffer not enough: %d < %d", pClient->read_buf_size, rem_len);
+        return ERR_MQTT_BUFFER_TOO_SHORT;
+    }
+
+    if (QOS0 == chunk.qos) {
+        return SUCCESS_RET;
+    }
+
+    return _send_publish_ack(pClient, chunk.qos, chunk.id, timer);
+}
+
 /**
  * @brief 处理PUBREC报文, 并发送PUBREL报文, PUBLISH报文为QOS2时
  *
@@ -1181,15 +2021,21 @@ static int _handle_publish_packet(UIoT_Client *pClient, Timer *timer) {
  */
 static int _handle_pubrec_packet(UIoT_Client *pClient, Timer *timer) {
     uint16_t packet_id;
-    unsigned char dup, type;
+    unsigned char dup, type, reason_code;
     int ret;
     uint32_t len;
 
-    ret = deserialize_ack_packet(&type, &dup, &packet_id, pClient->read_buf, pClient->read_buf_size);
+    ret = deserialize_ack_packet(&type, &dup, &packet_id, &reason_code, pClient->read_buf, pClient->read_buf_size);
     if (SUCCESS_RET != ret) {
         return ret;
     }
 
+    /* MQTT 5.0中PUBREC的原因码表示失败时, 流程结束, 不再发送PUBREL */
+    if (reason_code >= MQTT_REASON_CODE_FAILURE) {
+        LOG_ERROR("PUBREC failure, packet_id: %u reason_code: 0x%02x", packet_id, reason_code);
+        return FAILURE_RET;
+    }
+
     HAL_MutexLock(pClient->lock_write_buf);
     ret = serialize_pub_ack_packet(pClient->write_buf, pClient->write_buf_size, PUBREL, 0, packet_id, &len);
     if (SUCCESS_RET != ret) {
@@ -1209,15 +2055,78 @@ static int _handle_pubrec_packet(UIoT_Client *pClient, Timer *timer) {
     return SUCCESS_RET;
 }
 
+/**
+ * @brief 处理PUBREL报文, 结束QOS2消息的接收流程并回复PUBCOMP报文
+ *
+ * @param pClient
+ * @param timer
+ * @return
+ */
+static int _handle_pubrel_packet(UIoT_Client *pClient, Timer *timer) {
+    uint16_t packet_id;
+    unsigned char dup, type, reason_code;
+    UIoTInboundId *slot;
+    int ret;
+
+    ret = deserialize_ack_packet(&type, &dup, &packet_id, &reason_code, pClient->read_buf, pClient->read_buf_size);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    slot = _inbound_id_slot(pClient, packet_id);
+    if (slot->id == packet_id && MQTT_INBOUND_PUBREC_SENT == slot->state) {
+        slot->state = MQTT_INBOUND_FREE;
+    }
+
+    /* 记录已被覆盖或重复收到PUBREL时同样需要回复PUBCOMP, 详见 MQTT协议说明 4.3.3 */
+    return _send_ack_packet(pClient, PUBCOMP, packet_id, timer);
+}
+
+/**
+ * @brief 处理服务器发送的DISCONNECT报文(MQTT 5.0), 服务器发送后会关闭连接
+ *
+ * @param pClient
+ * @return 总是返回ERR_TCP_PEER_SHUTDOWN, 由调用者按连接断开处理
+ */
+static int _handle_disconnect_packet(UIoT_Client *pClient) {
+    unsigned char *curdata = pClient->read_buf + 1;
+    uint32_t decodedLen = 0, readBytesLen = 0;
+    uint8_t reason_code = 0;
+    char reason[64] = {0};
+    MQTTProperties props;
+
+    if (SUCCESS_RET == mqtt_read_packet_rem_len_form_buf(curdata, &decodedLen, &readBytesLen) && decodedLen > 0) {
+        curdata += readBytesLen;
+        reason_code = mqtt_read_char(&curdata);
+        if (decodedLen > 1 && SUCCESS_RET == mqtt_read_properties(&curdata, curdata + decodedLen - 1, &props)
+            && NULL != props.reason) {
+            memcpy(reason, props.reason, Min(props.reason_len, sizeof(reason) - 1));
+        }
+    }
+
+    LOG_ERROR("disconnected by server, reason_code: 0x%02x %s", reason_code, reason);
+
+    return ERR_TCP_PEER_SHUTDOWN;
+}
+
 /**
  * @brief 处理服务器的心跳包回包
  *
  * @param pClient
  */
-static void _handle_pingresp_packet(UIoT_Client *pClient) {
+static void _handle_pingresp_packet(UIoT_Client *pClient, uint8_t packet_type) {
     HAL_MutexLock(pClient->lock_generic);
+#if UIOT_MQTT_KEEPALIVE_ADAPTIVE
+    /* 链路空闲一个心跳周期后心跳包仍有回应, 说明NAT没有回收连接, 尝试延长心跳周期 */
+    if (PINGRESP == packet_type && pClient->ping_probe && pClient->ping_interval < pClient->ping_interval_max) {
+        pClient->ping_interval = Min(pClient->ping_interval + UIOT_MQTT_KEEPALIVE_ADAPTIVE_STEP,
+                                     pClient->ping_interval_max);
+        LOG_INFO("keepalive interval stretched to %u s", pClient->ping_interval);
+    }
+#endif
+    pClient->ping_probe = 0;
     pClient->is_ping_outstanding = 0;
-    countdown(&pClient->ping_timer, pClient->options.keep_alive_interval);
+    countdown(&pClient->ping_timer, pClient->ping_interval);
     HAL_MutexUnlock(pClient->lock_generic);
 
     return;
@@ -1228,8 +2137,9 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
     POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
 
     int ret;
+    uint32_t stream_len = 0;
     /* read the socket, see what work is due */
-    ret = _read_mqtt_packet(pClient, timer, packet_type);
+    ret = _read_mqtt_packet(pClient, timer, packet_type, &stream_len);
 
     if (ERR_MQTT_NOTHING_TO_READ == ret) {
         /* Nothing to read, not a cycle failure */
@@ -1240,6 +2150,9 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
         return ret;
     }
 
+    /* 收到任何报文都说明链路可用, 用于判断是否可以省去心跳包 */
+    countdown(&pClient->rx_idle_timer, 2 * pClient->ping_interval);
+
     switch (*packet_type) {
         case CONNACK:
             break;
@@ -1253,7 +2166,11 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
             ret = _handle_unsuback_packet(pClient, timer);
             break;
         case PUBLISH: {
-            ret = _handle_publish_packet(pClient, timer);
+            if (stream_len > 0) {
+                ret = _handle_publish_stream(pClient, timer, stream_len);
+            } else {
+                ret = _handle_publish_packet(pClient, timer);
+            }
             break;
         }
         case PUBREC: {
@@ -1261,13 +2178,16 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
             break;
         }
         case PUBREL: {
-            LOG_ERROR("Packet type PUBREL is currently NOT handled!");
+            ret = _handle_pubrel_packet(pClient, timer);
             break;
         }
         case PUBCOMP:
             break;
         case PINGRESP: 
             break;
+        case DISCONNECT:
+            ret = _handle_disconnect_packet(pClient);
+            break;
         default: {
             /* Either unknown packet type or Failure occurred
              * Should not happen */
@@ -1282,7 +2202,7 @@ int cycle_for_read(UIoT_Client *pClient, Timer *timer, uint8_t *packet_type, QoS
         case SUBACK:
         case UNSUBACK:
         case PINGRESP: {
-            _handle_pingresp_packet(pClient);
+            _handle_pingresp_packet(pClient, *packet_type);
             break;
         }
         /* Recv downlink pub means link is OK but we still need to send PING request */
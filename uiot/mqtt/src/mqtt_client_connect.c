@@ -59,6 +59,8 @@ static uint32_t _get_packet_connect_rem_len(MQTTConnectParams *options) {
         len = 12;
     } else if (4 == options->mqtt_version) {
         len = 10;
+    } else if (5 == options->mqtt_version) {
+        len = 10 + 1 + 3;   /* 属性长度 + Receive Maximum */
     }
 
     len += strlen(options->client_id) + 2;
@@ -124,9 +126,9 @@ static int _serialize_connect_packet(unsigned char *buf, size_t buf_len, MQTTCon
     ptr += mqtt_write_packet_rem_len(ptr, rem_len);
 
     // 报文可变头部协议名 + 协议版本号
-    if (4 == options->mqtt_version) {
+    if (4 == options->mqtt_version || 5 == options->mqtt_version) {
         mqtt_write_utf8_string(&ptr, "MQTT");
-        mqtt_write_char(&ptr, (unsigned char) 4);
+        mqtt_write_char(&ptr, (unsigned char) options->mqtt_version);
     } else {
         mqtt_write_utf8_string(&ptr, "MQIsdp");
         mqtt_write_char(&ptr, (unsigned char) 3);
@@ -144,6 +146,13 @@ static int _serialize_connect_packet(unsigned char *buf, size_t buf_len, MQTTCon
     // 报文可变头部心跳周期/保持连接, 一个以秒为单位的时间间隔, 表示为一个16位的字
     mqtt_write_uint_16(&ptr, options->keep_alive_interval);
 
+    // MQTT 5.0 报文可变头部属性: 服务器同时下发的QoS1/QoS2消息不超过已收消息packet id记录的窗口大小
+    if (5 == options->mqtt_version) {
+        mqtt_write_char(&ptr, 3);
+        mqtt_write_char(&ptr, MQTT_PROP_RECEIVE_MAXIMUM);
+        mqtt_write_uint_16(&ptr, UIOT_MQTT_INBOUND_ID_WINDOW);
+    }
+
     // 有效负载部分: 客户端标识符
     mqtt_write_utf8_string(&ptr, options->client_id);
 
@@ -161,17 +170,47 @@ static int _serialize_connect_packet(unsigned char *buf, size_t buf_len, MQTTCon
     return SUCCESS_RET;
 }
 
+/**
+  * Maps a MQTT 5.0 connect reason code to the connack return code
+  * @param reason_code the MQTT 5.0 connect reason code
+  * @return the connack return code
+  */
+static int _connack_reason_code_to_rc(unsigned char reason_code) {
+    switch (reason_code) {
+        case 0x00:
+            return MQTT_CONNECTION_ACCEPTED;
+        case 0x84:  // Unsupported Protocol Version
+            return ERR_MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION;
+        case 0x85:  // Client Identifier not valid
+            return ERR_MQTT_CONNACK_IDENTIFIER_REJECTED;
+        case 0x88:  // Server unavailable
+        case 0x89:  // Server busy
+            return ERR_MQTT_CONNACK_SERVER_UNAVAILABLE;
+        case 0x86:  // Bad User Name or Password
+            return ERR_MQTT_CONNACK_BAD_USERDATA;
+        case 0x87:  // Not authorized
+        case 0x8A:  // Banned
+            return ERR_MQTT_CONNACK_NOT_AUTHORIZED;
+        default:
+            return ERR_MQTT_CONNACK_UNKNOWN;
+    }
+}
+
 /**
   * Deserializes the supplied (wire) buffer into connack data - return code
-  * @param sessionPresent the session present flag returned (only for MQTT 3.1.1)
+  * @param mqtt_version the MQTT protocol version of the connection
+  * @param sessionPresent the session present flag returned (only for MQTT 3.1.1 and 5.0)
   * @param connack_rc returned integer value of the connack return code
+  * @param props returned MQTT 5.0 properties, untouched for other versions
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
   * @param buflen the length in bytes of the data in the supplied buffer
   * @return int indicating function execution status
   */
-static int _deserialize_connack_packet(uint8_t *sessionPresent, int *connack_rc, unsigned char *buf, size_t buflen) {
+static int _deserialize_connack_packet(uint8_t mqtt_version, uint8_t *sessionPresent, int *connack_rc,
+                                       MQTTProperties *props, unsigned char *buf, size_t buflen) {
     POINTER_VALID_CHECK(sessionPresent, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(connack_rc, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(props, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
 
     unsigned char header, type = 0;
@@ -201,7 +240,7 @@ static int _deserialize_connack_packet(uint8_t *sessionPresent, int *connack_rc,
     }
     curdata += (readBytesLen);
     enddata = curdata + decodedLen;
-    if (enddata - curdata != 2) {
+    if ((MQTT_5_0 == mqtt_version) ? (enddata - curdata < 3) : (enddata - curdata != 2)) {
         return FAILURE_RET;
     }
 
@@ -211,6 +250,17 @@ static int _deserialize_connack_packet(uint8_t *sessionPresent, int *connack_rc,
 
     // 读取可变头部-连接返回码 参考MQTT协议说明文档3.2.2.3小结
     connack_rc_char = mqtt_read_char(&curdata);
+
+    // MQTT 5.0 可变头部为连接原因码和属性
+    if (MQTT_5_0 == mqtt_version) {
+        *connack_rc = _connack_reason_code_to_rc(connack_rc_char);
+        if (MQTT_CONNECTION_ACCEPTED != *connack_rc) {
+            LOG_ERROR("connect refused, reason_code: 0x%02x", connack_rc_char);
+            return SUCCESS_RET;
+        }
+        return mqtt_read_properties(&curdata, enddata, props);
+    }
+
     switch (connack_rc_char) {
         case CONNACK_CONNECTION_ACCEPTED:
             *connack_rc = MQTT_CONNECTION_ACCEPTED;
@@ -238,6 +288,141 @@ static int _deserialize_connack_packet(uint8_t *sessionPresent, int *connack_rc,
     return SUCCESS_RET;
 }
 
+/**
+ * @brief 等待并解析CONNACK报文
+ *
+ * @param pClient
+ * @param timer
+ * @param sessionPresent 返回服务器是否保留了会话
+ * @param props          返回CONNACK中的属性
+ * @return 连接被接受时返回SUCCESS, 被拒绝时返回对应的错误码
+ */
+static int _mqtt_wait_connack(UIoT_Client *pClient, Timer *timer, uint8_t *sessionPresent, MQTTProperties *props) {
+    int connack_rc = FAILURE_RET, ret;
+
+    // 阻塞等待CONNACK的报文,
+    ret = wait_for_read(pClient, CONNACK, timer, 0);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    // 反序列化CONNACK包, 检查返回码; MQTT 3.1.1没有属性, 使用协议的默认值
+    memset(props, 0, sizeof(MQTTProperties));
+    props->receive_max = 65535;
+    ret = _deserialize_connack_packet(pClient->options.mqtt_version, sessionPresent, &connack_rc, props,
+                                      pClient->read_buf, pClient->read_buf_size);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    if (MQTT_CONNECTION_ACCEPTED != connack_rc) {
+        return connack_rc;
+    }
+
+    return SUCCESS_RET;
+}
+
+#if UIOT_MQTT_CONNECT_PIPELINE
+
+/* 判断packet id是否在(first, last]之间, packet id达到MAX_PACKET_ID后从1重新开始 */
+static bool _packet_id_in_range(uint16_t packet_id, uint16_t first, uint16_t last) {
+    if (first <= last) {
+        return packet_id > first && packet_id <= last;
+    }
+
+    return packet_id > first || packet_id <= last;
+}
+
+/**
+ * @brief 发出CONNECT后不等待CONNACK, 先按已连接处理, 紧接着发出重新订阅和离线存储中待补发的消息
+ *
+ * @param pClient
+ * @return
+ */
+static int _mqtt_connect_pipeline(UIoT_Client *pClient) {
+    int ret;
+
+    pClient->connack_pending = 1;
+    set_client_conn_state(pClient, CONNECTED);
+
+    // 不保留会话时服务器上没有之前的订阅关系, 必须重新订阅; 否则等收到CONNACK后再决定
+    if (pClient->options.clean_session) {
+        ret = uiot_mqtt_resubscribe(pClient);
+        if (SUCCESS_RET != ret) {
+            return ret;
+        }
+    }
+
+    uiot_mqtt_store_drain(pClient);
+
+    return SUCCESS_RET;
+}
+
+/**
+ * @brief 连接被拒绝或等待CONNACK失败时, 撤销CONNECT之后发出的订阅和发布请求
+ *
+ * 订阅关系仍保留在sub_handles中, 下次连接时重新订阅; 等待PUBACK的消息以失败结束
+ *
+ * @param pClient
+ * @param first_packet_id 发出CONNECT时最后分配的packet id
+ */
+static void _mqtt_connect_pipeline_rollback(UIoT_Client *pClient, uint16_t first_packet_id) {
+    uint16_t last_packet_id = pClient->next_packet_id;
+    uint16_t packet_id = first_packet_id;
+    ListIterator *iter;
+    ListNode *node;
+    UIoTSubInfo *sub_info;
+    UIoTPubInfo *repubInfo;
+    OnPublishComplete on_complete;
+    void *complete_data;
+
+    set_client_conn_state(pClient, DISCONNECTED);
+    pClient->connack_pending = 0;
+
+    if (first_packet_id == last_packet_id) {
+        return;
+    }
+
+    // 失效的节点由uiot_mqtt_sub_info_proc移除
+    HAL_MutexLock(pClient->lock_list_sub);
+    if (NULL != (iter = list_iterator_new(pClient->list_sub_wait_ack, LIST_HEAD))) {
+        while (NULL != (node = list_iterator_next(iter))) {
+            sub_info = (UIoTSubInfo *) node->val;
+            if (NULL == sub_info || MQTT_NODE_STATE_INVALID == sub_info->node_state
+                || !_packet_id_in_range(sub_info->msg_id, first_packet_id, last_packet_id)) {
+                continue;
+            }
+
+            HAL_Free((void *)sub_info->handler.topic_filter);
+            sub_info->handler.topic_filter = NULL;
+            sub_info->node_state = MQTT_NODE_STATE_INVALID;
+        }
+        list_iterator_destroy(iter);
+    }
+    HAL_MutexUnlock(pClient->lock_list_sub);
+
+    while (packet_id != last_packet_id) {
+        packet_id = (uint16_t)((MAX_PACKET_ID == packet_id) ? 1 : (packet_id + 1));
+
+        HAL_MutexLock(pClient->lock_list_pub);
+        repubInfo = uiot_mqtt_pub_window_find(&pClient->pub_window, packet_id);
+        if (NULL == repubInfo) {
+            HAL_MutexUnlock(pClient->lock_list_pub);
+            continue;
+        }
+        on_complete = repubInfo->on_complete;
+        complete_data = repubInfo->complete_data;
+        (void)uiot_mqtt_pub_window_release(&pClient->pub_window, packet_id);
+        HAL_MutexUnlock(pClient->lock_list_pub);
+
+        if (NULL != on_complete) {
+            on_complete(pClient, packet_id, ERR_MQTT_NO_CONN, complete_data);
+        }
+    }
+}
+
+#endif
+
 /**
  * @brief 与服务器建立MQTT连接
  *
@@ -247,9 +432,14 @@ static int _deserialize_connack_packet(uint8_t *sessionPresent, int *connack_rc,
  */
 static int _mqtt_connect(UIoT_Client *pClient, MQTTConnectParams *options) {
     Timer connect_timer;
-    int connack_rc = FAILURE_RET, ret = FAILURE_RET;
+    int ret = FAILURE_RET;
     uint8_t sessionPresent = 0;
     uint32_t len = 0;
+    MQTTProperties props;
+    uint64_t connect_start_ms = HAL_UptimeMs();
+#if UIOT_MQTT_CONNECT_PIPELINE
+    uint16_t first_packet_id;
+#endif
 
     init_timer(&connect_timer);
     countdown_ms(&connect_timer, pClient->command_timeout_ms);
@@ -265,6 +455,10 @@ static int _mqtt_connect(UIoT_Client *pClient, MQTTConnectParams *options) {
     }
 
     HAL_MutexLock(pClient->lock_write_buf);
+    // 丢弃上一次连接未发出的合并报文
+    pClient->tx_batch_len = 0;
+    // 上一次连接的主题别名已失效, 收到CONNACK前不使用别名
+    uiot_mqtt_topic_alias_reset(pClient, 0);
     // 序列化CONNECT报文
     ret = _serialize_connect_packet(pClient->write_buf, pClient->write_buf_size, &(pClient->options), &len);
     if (SUCCESS_RET != ret || 0 == len) {
@@ -280,29 +474,63 @@ static int _mqtt_connect(UIoT_Client *pClient, MQTTConnectParams *options) {
     }
     HAL_MutexUnlock(pClient->lock_write_buf);
 
-    // 阻塞等待CONNACK的报文,
-    ret = wait_for_read(pClient, CONNACK, &connect_timer, 0);
+#if UIOT_MQTT_CONNECT_PIPELINE
+    first_packet_id = pClient->next_packet_id;
+    ret = _mqtt_connect_pipeline(pClient);
+    if (SUCCESS_RET == ret) {
+        ret = _mqtt_wait_connack(pClient, &connect_timer, &sessionPresent, &props);
+    }
     if (SUCCESS_RET != ret) {
+        _mqtt_connect_pipeline_rollback(pClient, first_packet_id);
         return ret;
     }
-
-    // 反序列化CONNACK包, 检查返回码
-    ret = _deserialize_connack_packet(&sessionPresent, &connack_rc, pClient->read_buf, pClient->read_buf_size);
+#else
+    ret = _mqtt_wait_connack(pClient, &connect_timer, &sessionPresent, &props);
     if (SUCCESS_RET != ret) {
         return ret;
     }
+#endif
 
-    if (MQTT_CONNECTION_ACCEPTED != connack_rc) {
-        return connack_rc;
+    // 按服务器允许的个数限制本次连接等待PUBACK的消息和主题别名, 主题别名需要重新携带主题全称
+    HAL_MutexLock(pClient->lock_list_pub);
+    pClient->pub_window.limit = Min(pClient->pub_window.size, props.receive_max);
+    HAL_MutexUnlock(pClient->lock_list_pub);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    uiot_mqtt_topic_alias_reset(pClient, props.topic_alias_max);
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    // 服务器指定了心跳周期时必须使用服务器的值
+    if (props.server_keep_alive > 0 && props.server_keep_alive != pClient->options.keep_alive_interval) {
+        LOG_INFO("use server keep alive: %u", props.server_keep_alive);
+        pClient->options.keep_alive_interval = props.server_keep_alive;
+    }
+
+    // 服务器没有保留会话时, 之前收到的QoS2消息不会再收到PUBREL
+    pClient->session_present = (0 != sessionPresent) ? 1 : 0;
+    if (0 == sessionPresent) {
+        uiot_mqtt_inbound_reset(pClient);
     }
 
+    pClient->connack_pending = 0;
     set_client_conn_state(pClient, CONNECTED);
     HAL_MutexLock(pClient->lock_generic);
     pClient->was_manually_disconnected = 0;
-    pClient->is_ping_outstanding = 0;
-    countdown(&pClient->ping_timer, pClient->options.keep_alive_interval);
+    uiot_mqtt_keepalive_reset(pClient);
     HAL_MutexUnlock(pClient->lock_generic);
 
+    // 重发上一次连接中未收到PUBACK的消息, 发送失败时由读取报文时处理断线
+    ret = uiot_mqtt_pub_resend_all(pClient, connect_start_ms);
+    if (SUCCESS_RET != ret) {
+        LOG_WARN("resend in-flight publish failed: %d", ret);
+    }
+
+    // 发送断线期间应用回复的消息, 服务器没有保留会话时记录已被清空
+    ret = uiot_mqtt_ack_flush(pClient);
+    if (SUCCESS_RET != ret) {
+        LOG_WARN("send manual ack failed: %d", ret);
+    }
+
     return SUCCESS_RET;
 }
 
@@ -342,6 +570,22 @@ int uiot_mqtt_attempt_reconnect(UIoT_Client *pClient) {
         return ret;
     }
 
+    // 间歇连接模式休眠期间的订阅不在已订阅列表中, 无论是否重新订阅都需要发出
+    uiot_mqtt_duty_flush_subscribe(pClient);
+
+#if UIOT_MQTT_CONNECT_PIPELINE
+    // 不保留会话时已在CONNECT之后重新订阅
+    if (pClient->options.clean_session) {
+        return MQTT_RECONNECTED;
+    }
+#endif
+
+    // 服务器保留了会话时订阅关系仍然有效, 无需重新订阅
+    if (pClient->session_present && 0 == pClient->options.clean_session) {
+        LOG_INFO("session present, skip resubscribe");
+        return MQTT_RECONNECTED;
+    }
+
     ret = uiot_mqtt_resubscribe(pClient);
     if (ret != SUCCESS_RET) {
         return ret;
@@ -0,0 +1,416 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+static uint32_t _duty_remain_ms(Timer *timer) {
+    int remain_ms;
+
+    if (has_expired(timer)) {
+        return 0;
+    }
+
+    remain_ms = left_ms(timer);
+    return (remain_ms > 0) ? (uint32_t)remain_ms : 0;
+}
+
+/* 休眠期间是否需要开始一个周期. 连接失败后只按退避时间重试, 避免唤醒条件一直满足时反复连接 */
+static bool _duty_should_wake(UIoT_Client *pClient) {
+    UIoTDutyCycle *d = &pClient->duty;
+
+    if (d->failed || d->params.interval_ms > 0) {
+        if (has_expired(&d->wake_timer)) {
+            return true;
+        }
+    }
+
+    if (d->failed) {
+        return false;
+    }
+
+    if (d->wake_requested) {
+        return true;
+    }
+
+    return d->params.queue_threshold > 0 && NULL != pClient->store
+           && pClient->store->records >= d->params.queue_threshold;
+}
+
+/* 发布, 订阅和手动回复都已完成, 可以断开连接. 发送失败的订阅留待下一个周期, 不在此等待 */
+static bool _duty_is_quiet(UIoT_Client *pClient) {
+    bool quiet;
+
+    HAL_MutexLock(pClient->lock_list_pub);
+    quiet = (0 == pClient->pub_window.in_flight);
+    HAL_MutexUnlock(pClient->lock_list_pub);
+    if (!quiet) {
+        return false;
+    }
+
+    HAL_MutexLock(pClient->lock_list_sub);
+    quiet = (0 == pClient->list_sub_wait_ack->len);
+    HAL_MutexUnlock(pClient->lock_list_sub);
+    if (!quiet) {
+        return false;
+    }
+
+    if (NULL != pClient->store && (pClient->store->records > 0 || pClient->store->in_flight)) {
+        return false;
+    }
+
+    HAL_MutexLock(pClient->lock_generic);
+    quiet = (0 == pClient->inbound_ack_count);
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    return quiet && 0 == pClient->tx_batch_len;
+}
+
+static void _duty_cycle_start(UIoT_Client *pClient, uint64_t now) {
+    UIoTDutyCycle *d = &pClient->duty;
+
+    d->awake = 1;
+    d->cycle_start_ms = now;
+    d->tx_packets_start = pClient->tx_packets;
+    d->tx_bytes_start = pClient->tx_bytes;
+}
+
+static void _duty_timers_start(UIoT_Client *pClient) {
+    UIoTDutyCycle *d = &pClient->duty;
+
+    countdown_ms(&d->listen_timer, d->params.listen_ms);
+    countdown_ms(&d->awake_timer, Max(d->params.max_awake_ms, d->params.listen_ms));
+}
+
+/* 结束本周期: 断开连接(同时保存TLS会话), 记录统计, 设置下一次连接的时间 */
+static int _duty_cycle_end(UIoT_Client *pClient, int result, uint8_t complete) {
+    UIoTDutyCycle *d = &pClient->duty;
+    uint32_t delay_ms = d->params.interval_ms;
+    MQTTEventMsg msg;
+
+    if (get_client_conn_state(pClient)) {
+        uiot_mqtt_disconnect(pClient);
+    }
+    // 周期结束的断开不是手动断开, 之后仍按唤醒条件连接
+    pClient->was_manually_disconnected = 0;
+    d->awake = 0;
+
+    HAL_MutexLock(pClient->lock_generic);
+    d->stats.cycles++;
+    d->stats.radio_on_ms = (uint32_t)(HAL_UptimeMs() - d->cycle_start_ms);
+    d->stats.radio_on_total_ms += d->stats.radio_on_ms;
+    d->stats.tx_packets = pClient->tx_packets - d->tx_packets_start;
+    d->stats.tx_bytes = pClient->tx_bytes - d->tx_bytes_start;
+    d->stats.complete = complete;
+    d->stats.result = result;
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (SUCCESS_RET == result) {
+        d->failed = 0;
+        pClient->current_reconnect_wait_interval = MIN_RECONNECT_WAIT_INTERVAL;
+    } else {
+        // 连接失败时按重连退避时间重试, 不超过休眠时间
+        d->failed = 1;
+        delay_ms = pClient->current_reconnect_wait_interval;
+        if (d->params.interval_ms > 0) {
+            delay_ms = Min(delay_ms, d->params.interval_ms);
+        }
+        pClient->current_reconnect_wait_interval = Min(pClient->current_reconnect_wait_interval * 2,
+                                                       MAX_RECONNECT_WAIT_INTERVAL);
+    }
+    countdown_ms(&d->wake_timer, delay_ms);
+
+    LOG_INFO("duty cycle %u done, result: %d, radio on %u ms, connect %u ms, %u packets sent",
+             d->stats.cycles, result, d->stats.radio_on_ms, d->stats.connect_ms, d->stats.tx_packets);
+
+    if (NULL != pClient->event_handler.h_fp) {
+        msg.event_type = MQTT_EVENT_DUTY_CYCLE_DONE;
+        msg.msg = &d->stats;
+        pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+    }
+
+    return MQTT_DUTY_CYCLE_SLEEPING;
+}
+
+int uiot_mqtt_duty_set(UIoT_Client *pClient, MQTTDutyCycleParams *pParams) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoTDutyCycle *d = &pClient->duty;
+
+    if (NULL == pParams) {
+        if (!d->enabled) {
+            return SUCCESS_RET;
+        }
+
+        d->enabled = 0;
+        d->awake = 0;
+        // 休眠中关闭时立即按自动重连的规则连接, 保存的订阅在连接后发出
+        if (!get_client_conn_state(pClient)) {
+            pClient->current_reconnect_wait_interval = MIN_RECONNECT_WAIT_INTERVAL;
+            countdown_ms(&(pClient->reconnect_delay_timer), 0);
+        }
+        return SUCCESS_RET;
+    }
+
+    if (NULL == pClient->store) {
+        LOG_ERROR("duty cycle needs mqtt store, enable UIOT_MQTT_STORE_ENABLE");
+        return FAILURE_RET;
+    }
+
+    d->params = *pParams;
+    d->failed = 0;
+    d->wake_requested = 0;
+    countdown_ms(&d->wake_timer, d->params.interval_ms);
+
+    // 开启时已连接, 当前连接作为第一个周期, 补发完成后断开
+    if (!d->enabled && get_client_conn_state(pClient)) {
+        _duty_cycle_start(pClient, HAL_UptimeMs());
+        d->stats.connect_ms = 0;
+        d->stats.tls_resumed = pClient->network_stack.tls_resumed;
+    }
+    if (d->awake) {
+        _duty_timers_start(pClient);
+    }
+
+    d->enabled = 1;
+
+    return SUCCESS_RET;
+}
+
+void uiot_mqtt_duty_deinit(UIoT_Client *pClient) {
+    UIoTDutyCycle *d;
+    int i;
+
+    if (NULL == pClient) {
+        return;
+    }
+
+    d = &pClient->duty;
+    for (i = 0; i < d->pending_sub_count; ++i) {
+        HAL_Free((void *)d->pending_subs[i].topic_filter);
+        d->pending_subs[i].topic_filter = NULL;
+    }
+    d->pending_sub_count = 0;
+    d->enabled = 0;
+}
+
+int uiot_mqtt_duty_begin(UIoT_Client *pClient) {
+    UIoTDutyCycle *d = &pClient->duty;
+    uint64_t start_ms;
+    int ret;
+
+    if (!_duty_should_wake(pClient)) {
+        return MQTT_DUTY_CYCLE_SLEEPING;
+    }
+
+    d->wake_requested = 0;
+    start_ms = HAL_UptimeMs();
+    _duty_cycle_start(pClient, start_ms);
+
+    ret = uiot_mqtt_attempt_reconnect(pClient);
+    d->stats.connect_ms = (uint32_t)(HAL_UptimeMs() - start_ms);
+    d->stats.tls_resumed = pClient->network_stack.tls_resumed;
+    if (MQTT_RECONNECTED != ret) {
+        LOG_ERROR("duty cycle connect failed: %d", ret);
+        if (get_client_conn_state(pClient)) {
+            // 连接已建立但重新订阅失败, 本周期仍补发消息, 订阅在之后的周期中恢复
+            _duty_timers_start(pClient);
+            return MQTT_RECONNECTED;
+        }
+        return _duty_cycle_end(pClient, (ret < 0) ? ret : FAILURE_RET, 0);
+    }
+
+    _duty_timers_start(pClient);
+    return MQTT_RECONNECTED;
+}
+
+int uiot_mqtt_duty_check(UIoT_Client *pClient, int ret) {
+    UIoTDutyCycle *d = &pClient->duty;
+    bool quiet;
+
+    if (!d->awake) {
+        return ret;
+    }
+
+    if (!get_client_conn_state(pClient)) {
+        return _duty_cycle_end(pClient, ERR_MQTT_NO_CONN, 0);
+    }
+
+    if (!has_expired(&d->listen_timer)) {
+        return ret;
+    }
+
+    quiet = _duty_is_quiet(pClient);
+    if (quiet || has_expired(&d->awake_timer)) {
+        return _duty_cycle_end(pClient, SUCCESS_RET, quiet ? 1 : 0);
+    }
+
+    return ret;
+}
+
+uint32_t uiot_mqtt_duty_deadline_ms(UIoT_Client *pClient) {
+    UIoTDutyCycle *d = &pClient->duty;
+    uint32_t wait_ms;
+
+    if (d->awake) {
+        // 等待应答期间由报文到达或其他定时事件唤醒, 这里只需在监听和最长连接时间到时检查
+        return has_expired(&d->listen_timer) ? _duty_remain_ms(&d->awake_timer) : _duty_remain_ms(&d->listen_timer);
+    }
+
+    wait_ms = UIOT_MQTT_DUTY_WAKE_POLL_MS;
+    if (d->failed || d->params.interval_ms > 0) {
+        wait_ms = Min(wait_ms, _duty_remain_ms(&d->wake_timer));
+    }
+
+    return wait_ms;
+}
+
+/* 休眠期间保存的同名订阅, 调用者需持有lock_generic */
+static SubTopicHandle *_duty_find_sub(UIoTDutyCycle *d, const char *topicFilter) {
+    int i;
+
+    for (i = 0; i < d->pending_sub_count; ++i) {
+        if (0 == strcmp(d->pending_subs[i].topic_filter, topicFilter)) {
+            return &d->pending_subs[i];
+        }
+    }
+
+    return NULL;
+}
+
+int uiot_mqtt_duty_defer_subscribe(UIoT_Client *pClient, char **topicFilters, SubscribeParams *pParams,
+                                   uint32_t count) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(topicFilters, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
+
+    UIoTDutyCycle *d = &pClient->duty;
+    SubTopicHandle *sub;
+    char *topic;
+    uint32_t i;
+    int ret = SUCCESS_RET;
+
+    HAL_MutexLock(pClient->lock_generic);
+    for (i = 0; i < count; ++i) {
+        sub = _duty_find_sub(d, topicFilters[i]);
+        if (NULL == sub) {
+            if (d->pending_sub_count >= MAX_SUB_TOPICS) {
+                LOG_ERROR("too many pending subscriptions");
+                ret = FAILURE_RET;
+                break;
+            }
+            if (NULL == (topic = HAL_Malloc(strlen(topicFilters[i]) + 1))) {
+                LOG_ERROR("malloc failed");
+                ret = FAILURE_RET;
+                break;
+            }
+            strcpy(topic, topicFilters[i]);
+            sub = &d->pending_subs[d->pending_sub_count++];
+            sub->topic_filter = topic;
+        }
+
+        sub->message_handler = pParams[i].on_message_handler;
+        sub->message_handler_data = pParams[i].user_data;
+        sub->qos = pParams[i].qos;
+        sub->chunk_handler = pParams[i].on_chunk_handler;
+        sub->manual_ack = pParams[i].manual_ack;
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (SUCCESS_RET == ret) {
+        LOG_DEBUG("%u subscriptions deferred to next duty cycle", count);
+    }
+
+    return ret;
+}
+
+bool uiot_mqtt_duty_cancel_subscribe(UIoT_Client *pClient, const char *topicFilter) {
+    UIoTDutyCycle *d = &pClient->duty;
+    SubTopicHandle *sub = _duty_find_sub(d, topicFilter);
+
+    if (NULL == sub) {
+        return false;
+    }
+
+    HAL_Free((void *)sub->topic_filter);
+    *sub = d->pending_subs[--d->pending_sub_count];
+    d->pending_subs[d->pending_sub_count].topic_filter = NULL;
+
+    return true;
+}
+
+void uiot_mqtt_duty_flush_subscribe(UIoT_Client *pClient) {
+    UIoTDutyCycle *d = &pClient->duty;
+    SubTopicHandle subs[MAX_SUB_TOPICS];
+    char *topics[MAX_SUB_TOPICS];
+    SubscribeParams params[MAX_SUB_TOPICS];
+    uint32_t count, sent = 0;
+    uint32_t i;
+    int ret;
+
+    HAL_MutexLock(pClient->lock_generic);
+    count = d->pending_sub_count;
+    memcpy(subs, d->pending_subs, count * sizeof(SubTopicHandle));
+    d->pending_sub_count = 0;
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    if (0 == count) {
+        return;
+    }
+
+    for (i = 0; i < count; ++i) {
+        topics[i] = (char *)subs[i].topic_filter;
+        params[i].qos = subs[i].qos;
+        params[i].on_message_handler = subs[i].message_handler;
+        params[i].user_data = subs[i].message_handler_data;
+        params[i].on_chunk_handler = subs[i].chunk_handler;
+        params[i].manual_ack = subs[i].manual_ack;
+    }
+
+    // 与重新订阅相同, 发送缓冲区放不下时逐个订阅
+    ret = uiot_mqtt_subscribe_many(pClient, topics, params, count);
+    if (ret >= 0) {
+        sent = count;
+    } else if (ret == ERR_MQTT_BUFFER_TOO_SHORT) {
+        for (sent = 0; sent < count; ++sent) {
+            if ((ret = uiot_mqtt_subscribe(pClient, topics[sent], &params[sent])) < 0) {
+                break;
+            }
+        }
+    }
+    if (sent < count) {
+        LOG_ERROR("send pending subscriptions failed: %d", ret);
+    }
+
+    // 订阅报文中的主题名已另行保存, 发送失败的订阅放回, 休眠期间新加入的同名订阅优先
+    HAL_MutexLock(pClient->lock_generic);
+    for (i = 0; i < count; ++i) {
+        if (i >= sent && d->pending_sub_count < MAX_SUB_TOPICS && NULL == _duty_find_sub(d, topics[i])) {
+            d->pending_subs[d->pending_sub_count++] = subs[i];
+        } else {
+            HAL_Free(topics[i]);
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+}
+
+#ifdef __cplusplus
+}
+#endif
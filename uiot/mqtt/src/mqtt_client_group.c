@@ -0,0 +1,237 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#if UIOT_MQTT_GROUP_MAX_CLIENTS > UTILS_NET_WAIT_MANY_MAX
+#error "UIOT_MQTT_GROUP_MAX_CLIENTS must not exceed UTILS_NET_WAIT_MANY_MAX"
+#endif
+
+UIoTClientGroup *uiot_mqtt_group_create(void) {
+    UIoTClientGroup *pGroup = (UIoTClientGroup *)HAL_Malloc(sizeof(UIoTClientGroup));
+    if (NULL == pGroup) {
+        LOG_ERROR("memory malloc failed!");
+        return NULL;
+    }
+    memset(pGroup, 0, sizeof(UIoTClientGroup));
+
+    if ((pGroup->lock = HAL_MutexCreate()) == NULL) {
+        LOG_ERROR("create client group lock failed.");
+        HAL_Free(pGroup);
+        return NULL;
+    }
+    if ((pGroup->yield_lock = HAL_MutexCreate()) == NULL) {
+        LOG_ERROR("create client group lock failed.");
+        HAL_MutexDestroy(pGroup->lock);
+        HAL_Free(pGroup);
+        return NULL;
+    }
+
+    return pGroup;
+}
+
+void uiot_mqtt_group_destroy(UIoTClientGroup *pGroup) {
+    if (NULL == pGroup) {
+        return;
+    }
+
+    HAL_MutexDestroy(pGroup->yield_lock);
+    HAL_MutexDestroy(pGroup->lock);
+    HAL_Free(pGroup);
+}
+
+int uiot_mqtt_group_add(UIoTClientGroup *pGroup, UIoT_Client *pClient) {
+    POINTER_VALID_CHECK(pGroup, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    int i;
+
+    HAL_MutexLock(pGroup->lock);
+    for (i = 0; i < pGroup->count; ++i) {
+        if (pGroup->clients[i] == pClient) {
+            HAL_MutexUnlock(pGroup->lock);
+            return SUCCESS_RET;
+        }
+    }
+
+    if (pGroup->count >= UIOT_MQTT_GROUP_MAX_CLIENTS) {
+        HAL_MutexUnlock(pGroup->lock);
+        LOG_ERROR("client group is full");
+        return ERR_MQTT_GROUP_FULL;
+    }
+
+    pGroup->clients[pGroup->count++] = pClient;
+    HAL_MutexUnlock(pGroup->lock);
+
+    return SUCCESS_RET;
+}
+
+int uiot_mqtt_group_remove(UIoTClientGroup *pGroup, UIoT_Client *pClient) {
+    POINTER_VALID_CHECK(pGroup, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    int i;
+    int ret = ERR_PARAM_INVALID;
+    bool busy = false;
+
+    HAL_MutexLock(pGroup->lock);
+    for (i = 0; i < pGroup->count; ++i) {
+        if (pGroup->clients[i] == pClient) {
+            memmove(&pGroup->clients[i], &pGroup->clients[i + 1], (pGroup->count - i - 1) * sizeof(UIoT_Client *));
+            pGroup->count--;
+            ret = SUCCESS_RET;
+            break;
+        }
+    }
+    busy = (pGroup->yielding == pClient);
+    HAL_MutexUnlock(pGroup->lock);
+
+    /* Yield正在处理该客户端时等待处理结束; 在该客户端的回调中移出时锁可重入, 不会等待 */
+    if (busy) {
+        HAL_MutexLock(pGroup->yield_lock);
+        HAL_MutexUnlock(pGroup->yield_lock);
+    }
+
+    return ret;
+}
+
+/* 调用者需持有pGroup->lock */
+static bool _group_contains(UIoTClientGroup *pGroup, UIoT_Client *pClient) {
+    int i;
+
+    for (i = 0; i < pGroup->count; ++i) {
+        if (pGroup->clients[i] == pClient) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* 手动断开, 未开启自动重连或已放弃重连的客户端不再需要处理; 间歇连接模式休眠期间仍需检查唤醒条件 */
+static bool _group_client_is_idle(UIoT_Client *pClient) {
+    if (get_client_conn_state(pClient)) {
+        return false;
+    }
+
+    if (pClient->duty.enabled) {
+        return pClient->was_manually_disconnected == 1;
+    }
+
+    return pClient->was_manually_disconnected == 1 || pClient->options.auto_connect_enable == 0
+           || pClient->current_reconnect_wait_interval > MAX_RECONNECT_WAIT_INTERVAL;
+}
+
+int uiot_mqtt_group_yield(UIoTClientGroup *pGroup, uint32_t timeout_ms) {
+    POINTER_VALID_CHECK(pGroup, ERR_PARAM_INVALID);
+    NUMERIC_VALID_CHECK(timeout_ms, ERR_PARAM_INVALID);
+
+    UIoT_Client *clients[UIOT_MQTT_GROUP_MAX_CLIENTS];
+    utils_network_pt networks[UIOT_MQTT_GROUP_MAX_CLIENTS];
+    uint8_t readable[UIOT_MQTT_GROUP_MAX_CLIENTS];
+    uint8_t connected[UIOT_MQTT_GROUP_MAX_CLIENTS];
+    uint8_t active[UIOT_MQTT_GROUP_MAX_CLIENTS];
+    UIoT_Client *pClient;
+    Timer timer;
+    uint32_t wait_ms;
+    int net_count;
+    int count;
+    int wait_ret;
+    int ret, i;
+
+    init_timer(&timer);
+    countdown_ms(&timer, timeout_ms);
+
+    while (!has_expired(&timer)) {
+        // 1. 复制客户端列表, 收集已连接客户端的网络连接, 以及所有客户端中最近的定时事件
+        ret = left_ms(&timer);
+        wait_ms = (ret > 0) ? (uint32_t)ret : 0;
+        net_count = 0;
+        HAL_MutexLock(pGroup->lock);
+        count = pGroup->count;
+        memcpy(clients, pGroup->clients, count * sizeof(UIoT_Client *));
+        for (i = 0; i < count; ++i) {
+            pClient = clients[i];
+            active[i] = !_group_client_is_idle(pClient);
+            if (!active[i]) {
+                continue;
+            }
+
+            wait_ms = Min(wait_ms, uiot_mqtt_next_deadline_ms(pClient, &timer));
+            // 暂停读取的客户端不加入等待集合, 只处理定时事件
+            connected[i] = get_client_conn_state(pClient) && !uiot_mqtt_rx_paused(pClient);
+            if (connected[i]) {
+                networks[net_count++] = &(pClient->network_stack);
+            }
+        }
+        HAL_MutexUnlock(pGroup->lock);
+
+        // 2. 不持锁, 在同一个等待集合上阻塞, 直到任一连接有数据或下一个定时事件
+        wait_ret = 0;
+        if (net_count > 0) {
+            wait_ret = utils_net_wait_readable_many(networks, readable, net_count, wait_ms);
+        } else if (wait_ms > 0) {
+            HAL_SleepMs(wait_ms);
+        }
+
+        // 3. 依次处理快照中每个客户端的报文和定时事件. 等待期间已被移出的客户端跳过; 处理期间只持有yield_lock,
+        //    重连等耗时操作不阻塞加入和移出其他客户端, 移出正在处理的客户端时等待其处理结束
+        net_count = 0;
+        for (i = 0; i < count; ++i) {
+            if (!active[i]) {
+                continue;
+            }
+
+            pClient = clients[i];
+            HAL_MutexLock(pGroup->lock);
+            if (!_group_contains(pGroup, pClient)) {
+                HAL_MutexUnlock(pGroup->lock);
+                net_count += connected[i];
+                continue;
+            }
+            pGroup->yielding = pClient;
+            HAL_MutexLock(pGroup->yield_lock);
+            HAL_MutexUnlock(pGroup->lock);
+
+            ret = 0;
+            if (connected[i]) {
+                // 无法确定是哪一个连接出错时逐个检查
+                ret = (wait_ret < 0) ? utils_net_wait_readable(&(pClient->network_stack), 0) : readable[net_count];
+            }
+            ret = uiot_mqtt_yield_once(pClient, &timer, ret);
+            if (ret < 0 && ret != ERR_MQTT_ATTEMPTING_RECONNECT) {
+                LOG_WARN("client %p yield failed: %d", pClient, ret);
+            }
+
+            HAL_MutexLock(pGroup->lock);
+            pGroup->yielding = NULL;
+            HAL_MutexUnlock(pGroup->lock);
+            HAL_MutexUnlock(pGroup->yield_lock);
+            net_count += connected[i];
+        }
+    }
+
+    return SUCCESS_RET;
+}
+
+#ifdef __cplusplus
+}
+#endif
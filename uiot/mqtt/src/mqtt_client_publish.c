@@ -21,6 +21,17 @@ extern "C" {
 
 #include "mqtt_client.h"
 
+#if UIOT_MQTT_TOPIC_ALIAS_MAX < 1 || UIOT_MQTT_TOPIC_ALIAS_MAX > 65535
+#error "UIOT_MQTT_TOPIC_ALIAS_MAX must be in range 1~65535"
+#endif
+
+#if UIOT_MQTT_RTO_MIN_MS < 1 || UIOT_MQTT_RTO_MIN_MS > UIOT_MQTT_RTO_MAX_MS
+#error "UIOT_MQTT_RTO_MIN_MS must be in range 1~UIOT_MQTT_RTO_MAX_MS"
+#endif
+
+/* 为关键消息让出时等待通知的最长时间, 超时后重新检查, 防止错过通知 */
+#define MQTT_CRITICAL_YIELD_WAIT_MS     (100)
+
 /**
  * @param mqttstring the MQTTString structure into which the data is to be read
  * @param pptr pointer to the output buffer - incremented by the number of bytes used & returned
@@ -52,74 +63,389 @@ static int _read_string_with_len(char **string, uint16_t *stringLen, unsigned ch
 
 /**
   * Determines the length of the MQTT publish packet that would be produced using the supplied parameters
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param qos the MQTT QoS of the publish (packetid is omitted for QoS 0)
-  * @param topicName the topic name to be used in the publish  
+  * @param topicName the topic name to be used in the publish, empty when only the topic alias is sent
+  * @param topic_alias the MQTT 5.0 topic alias, 0 if not used
   * @param payload_len the length of the payload to be sent
   * @return the length of buffer needed to contain the serialized version of the packet
   */
-static uint32_t _get_publish_packet_len(uint8_t qos, char *topicName, size_t payload_len) {
+static uint32_t _get_publish_packet_len(uint8_t mqtt_version, uint8_t qos, char *topicName, uint16_t topic_alias,
+                                        size_t payload_len) {
     size_t len = 0;
 
     len += 2 + strlen(topicName) + payload_len;
     if (qos > 0) {
         len += 2; /* packetid */
     }
+    if (MQTT_5_0 == mqtt_version) {
+        len += 1; /* properties length */
+        if (topic_alias > 0) {
+            len += 3; /* Topic Alias */
+        }
+    }
     return (uint32_t) len;
 }
 
-static int _mask_push_pubInfo_to(UIoT_Client *c, int len, unsigned short msgId, ListNode **node)
+void uiot_mqtt_topic_alias_reset(UIoT_Client *pClient, uint16_t limit)
 {
-    if (!c || !node) {
-        LOG_ERROR("invalid parameters!");
-        return ERR_MQTT_PUSH_TO_LIST_FAILED;
+    memset(pClient->topic_alias.announced, 0, sizeof(pClient->topic_alias.announced));
+    pClient->topic_alias.limit = Min(limit, UIOT_MQTT_TOPIC_ALIAS_MAX);
+}
+
+void uiot_mqtt_topic_alias_deinit(UIoT_Client *pClient)
+{
+    uint16_t i;
+
+    for (i = 0; i < pClient->topic_alias.count; ++i) {
+        HAL_Free(pClient->topic_alias.topics[i]);
     }
+    memset(&pClient->topic_alias, 0, sizeof(UIoTTopicAlias));
+}
 
-    if ((len < 0) || (len > c->write_buf_size)) {
-        LOG_ERROR("the param of len is error!");
-        return FAILURE_RET;
+/*
+ * 查找主题的别名, 主题第一次发布时分配新的别名, 调用者需持有lock_write_buf.
+ * hint为该主题之前分配到的别名, 非0时不再查找别名表.
+ * 返回别名, 0表示不使用别名; announced返回本次连接中是否已经发送过别名对应的主题全称.
+ */
+static uint16_t _topic_alias_get(UIoT_Client *pClient, const char *topicName, uint16_t hint, uint8_t *announced)
+{
+    UIoTTopicAlias *table = &pClient->topic_alias;
+    size_t topicLen;
+    uint16_t i;
+
+    *announced = 0;
+    if (MQTT_5_0 != pClient->options.mqtt_version || 0 == table->limit) {
+        return 0;
     }
 
-    HAL_MutexLock(c->lock_list_pub);
+    /* 别名在客户端的生命周期内不变 */
+    if (hint > 0 && hint <= table->count) {
+        if (hint > table->limit) {
+            return 0;
+        }
+        *announced = table->announced[hint - 1];
+        return hint;
+    }
 
-    if (c->list_pub_wait_ack->len >= MAX_REPUB_NUM) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        LOG_ERROR("more than %u elements in republish list. List overflow!", c->list_pub_wait_ack->len);
-        return FAILURE_RET;
+    for (i = 0; i < table->count; ++i) {
+        if (0 == strcmp(table->topics[i], topicName)) {
+            // 重连后服务器允许的别名个数可能变少
+            if (i >= table->limit) {
+                return 0;
+            }
+            *announced = table->announced[i];
+            return i + 1;
+        }
     }
 
-    UIoTPubInfo *repubInfo = (UIoTPubInfo *)HAL_Malloc(sizeof(UIoTPubInfo) + len);
-    if (NULL == repubInfo) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        LOG_ERROR("memory malloc failed!");
+    if (table->count >= table->limit) {
+        return 0;
+    }
+
+    topicLen = strlen(topicName);
+    table->topics[table->count] = (char *)HAL_Malloc(topicLen + 1);
+    if (NULL == table->topics[table->count]) {
+        return 0;
+    }
+    memcpy(table->topics[table->count], topicName, topicLen + 1);
+    table->announced[table->count] = 0;
+
+    return ++table->count;
+}
+
+static UIoTPubInfo *_pub_window_slot(UIoTPubWindow *window, uint16_t msg_id)
+{
+    UIoTPubInfo *slot = &window->slots[msg_id % window->size];
+
+    if (MQTT_NODE_STATE_NORMAL != slot->node_state || slot->msg_id != msg_id) {
+        return NULL;
+    }
+
+    return slot;
+}
+
+/*
+ * 计算第retries次重发后等待PUBACK的时间. 还未测得往返时间或不重发时使用调用者给出的超时时间.
+ */
+static uint32_t _pub_window_rto(UIoTPubWindow *window, uint32_t timeout_ms, uint8_t retries)
+{
+    uint32_t rto = (UIOT_MQTT_RETRANS_MAX > 0 && window->rto > 0) ? window->rto : timeout_ms;
+
+    for (; retries > 0; --retries) {
+        rto = Min(rto * 2, UIOT_MQTT_RTO_MAX_MS);
+    }
+
+    return rto;
+}
+
+static void _pub_heap_set(UIoTPubWindow *window, uint16_t pos, uint16_t index)
+{
+    window->heap[pos] = index;
+    window->slots[index].heap_pos = pos;
+}
+
+static void _pub_heap_sift_up(UIoTPubWindow *window, uint16_t pos)
+{
+    uint16_t index = window->heap[pos];
+    uint64_t expire_ms = window->slots[index].expire_ms;
+    uint16_t parent;
+
+    while (pos > 0) {
+        parent = (uint16_t)((pos - 1) / 2);
+        if (window->slots[window->heap[parent]].expire_ms <= expire_ms) {
+            break;
+        }
+        _pub_heap_set(window, pos, window->heap[parent]);
+        pos = parent;
+    }
+    _pub_heap_set(window, pos, index);
+}
+
+static void _pub_heap_sift_down(UIoTPubWindow *window, uint16_t pos)
+{
+    uint16_t index = window->heap[pos];
+    uint64_t expire_ms = window->slots[index].expire_ms;
+    uint16_t len = window->in_flight;
+    uint16_t child;
+
+    while ((child = (uint16_t)(2 * pos + 1)) < len) {
+        if (child + 1 < len
+            && window->slots[window->heap[child + 1]].expire_ms < window->slots[window->heap[child]].expire_ms) {
+            child++;
+        }
+        if (expire_ms <= window->slots[window->heap[child]].expire_ms) {
+            break;
+        }
+        _pub_heap_set(window, pos, window->heap[child]);
+        pos = child;
+    }
+    _pub_heap_set(window, pos, index);
+}
+
+/*
+ * 设置消息等待PUBACK的超时时间, 并按新的超时时刻调整消息在超时最小堆中的位置
+ */
+static void _pub_window_schedule(UIoTPubWindow *window, UIoTPubInfo *slot, uint32_t timeout_ms)
+{
+    countdown_ms(&slot->pub_start_time, timeout_ms);
+    slot->expire_ms = HAL_UptimeMs() + timeout_ms;
+    _pub_heap_sift_up(window, slot->heap_pos);
+    _pub_heap_sift_down(window, slot->heap_pos);
+}
+
+/*
+ * 在重发缓存区中为len字节的报文分配连续空间.
+ * 缓存区中的报文按发送顺序首尾相接, 队头的报文出队后空间即被回收, 尾部放不下时从缓存区起始位置开始存放.
+ */
+static int _pub_window_arena_alloc(UIoTPubWindow *window, uint32_t len, uint32_t *pos)
+{
+    UIoTPubOrder *first;
+    UIoTPubOrder *last;
+    uint32_t tail;
+
+    if (0 == window->count) {
+        *pos = 0;
+        return (len <= window->arena_size) ? SUCCESS_RET : FAILURE_RET;
+    }
+
+    first = &window->order[window->head];
+    last = &window->order[(window->head + window->count - 1) % window->size];
+    tail = last->pos + last->len;
+
+    if (tail > first->pos) {
+        if (window->arena_size - tail >= len) {
+            *pos = tail;
+            return SUCCESS_RET;
+        }
+        if (first->pos >= len) {
+            *pos = 0;
+            return SUCCESS_RET;
+        }
+    } else if (first->pos - tail >= len) {
+        *pos = tail;
+        return SUCCESS_RET;
+    }
+
+    return FAILURE_RET;
+}
+
+int uiot_mqtt_pub_window_init(UIoTPubWindow *window, uint16_t size, uint32_t arena_size)
+{
+    uint16_t i;
+
+    POINTER_VALID_CHECK(window, ERR_PARAM_INVALID);
+    if (0 == size || 0 == arena_size) {
+        return ERR_PARAM_INVALID;
+    }
+
+    memset(window, 0, sizeof(UIoTPubWindow));
+
+    window->slots = (UIoTPubInfo *)HAL_Malloc(size * sizeof(UIoTPubInfo));
+    window->order = (UIoTPubOrder *)HAL_Malloc(size * sizeof(UIoTPubOrder));
+    window->heap = (uint16_t *)HAL_Malloc(size * sizeof(uint16_t));
+    window->arena = (unsigned char *)HAL_Malloc(arena_size);
+    if (NULL == window->slots || NULL == window->order || NULL == window->heap || NULL == window->arena) {
+        uiot_mqtt_pub_window_deinit(window);
         return FAILURE_RET;
     }
 
-    repubInfo->node_state = MQTT_NODE_STATE_NORMAL;
-    repubInfo->msg_id = msgId;
-    repubInfo->len = len;
-    init_timer(&repubInfo->pub_start_time);
-    countdown_ms(&repubInfo->pub_start_time, c->command_timeout_ms);
+    memset(window->slots, 0, size * sizeof(UIoTPubInfo));
+    for (i = 0; i < size; ++i) {
+        window->slots[i].node_state = MQTT_NODE_STATE_INVALID;
+    }
+    window->size = size;
+    window->limit = size;
+    window->arena_size = arena_size;
 
-    repubInfo->buf = (unsigned char *)repubInfo + sizeof(UIoTPubInfo);
+    return SUCCESS_RET;
+}
 
-    memcpy(repubInfo->buf, c->write_buf, len);
+void uiot_mqtt_pub_window_deinit(UIoTPubWindow *window)
+{
+    if (NULL == window) {
+        return;
+    }
+
+    HAL_Free(window->slots);
+    HAL_Free(window->order);
+    HAL_Free(window->heap);
+    HAL_Free(window->arena);
+
+    memset(window, 0, sizeof(UIoTPubWindow));
+}
+
+UIoTPubInfo *uiot_mqtt_pub_window_push(UIoTPubWindow *window, uint16_t msg_id, uint32_t len, uint32_t timeout_ms)
+{
+    UIoTPubInfo *slot = &window->slots[msg_id % window->size];
+    UIoTPubOrder *order;
+    uint32_t pos = 0;
+
+    if (window->count >= window->size || window->in_flight >= window->limit
+        || MQTT_NODE_STATE_NORMAL == slot->node_state) {
+        LOG_ERROR("publish window is full, %u messages waiting for ack", window->in_flight);
+        return NULL;
+    }
+
+    if (SUCCESS_RET != _pub_window_arena_alloc(window, len, &pos)) {
+        LOG_ERROR("retransmit arena is full, %u of %u bytes in use", window->arena_used, window->arena_size);
+        return NULL;
+    }
 
-    *node = list_node_new(repubInfo);
-    if (NULL == *node) {
-        HAL_MutexUnlock(c->lock_list_pub);
-        LOG_ERROR("list_node_new failed!");
+    slot->node_state = MQTT_NODE_STATE_NORMAL;
+    slot->msg_id = msg_id;
+    slot->len = len;
+    slot->buf = window->arena + pos;
+    slot->retries = 0;
+    slot->sent_ms = HAL_UptimeMs();
+    init_timer(&slot->pub_start_time);
+
+    order = &window->order[(window->head + window->count) % window->size];
+    order->msg_id = msg_id;
+    order->pos = pos;
+    order->len = len;
+    window->count++;
+
+    /* 新消息先放到堆尾, 再按超时时刻上移 */
+    _pub_heap_set(window, window->in_flight, (uint16_t)(slot - window->slots));
+    window->in_flight++;
+    _pub_window_schedule(window, slot, _pub_window_rto(window, timeout_ms, 0));
+
+    window->arena_used += len;
+    if (window->arena_used > window->arena_high_water) {
+        window->arena_high_water = window->arena_used;
+    }
+
+    return slot;
+}
+
+UIoTPubInfo *uiot_mqtt_pub_window_find(UIoTPubWindow *window, uint16_t msg_id)
+{
+    return _pub_window_slot(window, msg_id);
+}
+
+int uiot_mqtt_pub_window_release(UIoTPubWindow *window, uint16_t msg_id)
+{
+    UIoTPubInfo *slot = _pub_window_slot(window, msg_id);
+    UIoTPubOrder *last;
+    uint16_t moved;
+    uint16_t pos;
+
+    if (NULL == slot) {
         return FAILURE_RET;
     }
 
-    list_rpush(c->list_pub_wait_ack, *node);
+    slot->buf = NULL;
+    slot->len = 0;
+    slot->on_complete = NULL;
+    slot->complete_data = NULL;
+    slot->node_state = MQTT_NODE_STATE_INVALID;
+
+    /* 用堆尾的消息填补空位, 再按其超时时刻上移或下移 */
+    pos = slot->heap_pos;
+    window->in_flight--;
+    if (pos < window->in_flight) {
+        moved = window->heap[window->in_flight];
+        _pub_heap_set(window, pos, moved);
+        _pub_heap_sift_up(window, pos);
+        _pub_heap_sift_down(window, window->slots[moved].heap_pos);
+    }
 
-    HAL_MutexUnlock(c->lock_list_pub);
+    /* 缓存区按发送顺序回收, 中间的报文留到队头时再回收, 队尾的报文可以直接回收 */
+    if (window->count > 0) {
+        last = &window->order[(window->head + window->count - 1) % window->size];
+        if (last->msg_id == msg_id) {
+            window->arena_used -= last->len;
+            window->count--;
+        }
+    }
+
+    while (window->count > 0 && NULL == _pub_window_slot(window, window->order[window->head].msg_id)) {
+        window->arena_used -= window->order[window->head].len;
+        window->head = (uint16_t)((window->head + 1) % window->size);
+        window->count--;
+    }
 
     return SUCCESS_RET;
 }
 
+UIoTPubInfo *uiot_mqtt_pub_window_next_expiry(UIoTPubWindow *window)
+{
+    if (0 == window->in_flight) {
+        return NULL;
+    }
+
+    return &window->slots[window->heap[0]];
+}
+
+void uiot_mqtt_pub_window_rtt_sample(UIoTPubWindow *window, UIoTPubInfo *slot)
+{
+    uint32_t rtt;
+    uint32_t delta;
+
+    /* Karn算法: 重发过的消息无法确定PUBACK对应哪一次发送, 不参与计算 */
+    if (slot->buf[0] & MQTT_HEADER_DUP_MASK) {
+        return;
+    }
+
+    rtt = (uint32_t)(HAL_UptimeMs() - slot->sent_ms);
+    if (0 == window->srtt) {
+        window->srtt = Max(rtt, 1);
+        window->rttvar = rtt / 2;
+    } else {
+        delta = (window->srtt > rtt) ? (window->srtt - rtt) : (rtt - window->srtt);
+        window->rttvar = (3 * window->rttvar + delta) / 4;
+        window->srtt = Max((7 * window->srtt + rtt) / 8, 1);
+    }
+
+    window->rto = window->srtt + 4 * window->rttvar;
+    window->rto = Max(window->rto, UIOT_MQTT_RTO_MIN_MS);
+    window->rto = Min(window->rto, UIOT_MQTT_RTO_MAX_MS);
+}
+
 /**
   * Deserializes the supplied (wire) buffer into publish data
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param dup returned integer - the MQTT dup flag
   * @param qos returned integer - the MQTT QoS value
   * @param retained returned integer - the MQTT retained flag
@@ -131,8 +457,9 @@ static int _mask_push_pubInfo_to(UIoT_Client *c, int len, unsigned short msgId,
   * @param buf_len the length in bytes of the data in the supplied buffer
   * @return error code.  1 is success
   */
-int deserialize_publish_packet(uint8_t *dup, QoS *qos, uint8_t *retained, uint16_t *packet_id, char **topicName,
-                               uint16_t *topicNameLen,unsigned char **payload, size_t *payload_len, unsigned char *buf, size_t buf_len) 
+int deserialize_publish_packet(uint8_t mqtt_version, uint8_t *dup, QoS *qos, uint8_t *retained, uint16_t *packet_id,
+                               char **topicName, uint16_t *topicNameLen, unsigned char **payload, size_t *payload_len,
+                               unsigned char *buf, size_t buf_len) 
 {
     POINTER_VALID_CHECK(dup, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(qos, ERR_PARAM_INVALID);
@@ -183,6 +510,14 @@ int deserialize_publish_packet(uint8_t *dup, QoS *qos, uint8_t *retained, uint16
         *packet_id = mqtt_read_uint16_t(&curdata);
     }
 
+    /* MQTT 5.0 可变头部最后为属性. 连接时没有允许服务器使用主题别名, 收到的消息总是携带主题全称 */
+    if (MQTT_5_0 == mqtt_version) {
+        MQTTProperties props;
+        if (SUCCESS_RET != mqtt_read_properties(&curdata, enddata, &props) || 0 != props.topic_alias) {
+            return FAILURE_RET;
+        }
+    }
+
     *payload_len = (size_t) (enddata - curdata);
     *payload = curdata;
 
@@ -229,33 +564,34 @@ int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes pa
 
 
 /**
-  * Serializes the supplied publish data into the supplied buffer, ready for sending
-  * @param buf the buffer into which the packet will be serialized
+  * Serializes the fixed header and variable header of a publish packet into the supplied buffer,
+  * the payload is not copied and has to be sent right after the headers
+  * @param buf the buffer into which the headers will be serialized
   * @param buf_len the length in bytes of the supplied buffer
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param dup integer - the MQTT dup flag
   * @param qos integer - the MQTT QoS value
   * @param retained integer - the MQTT retained flag
   * @param packet_id integer - the MQTT packet identifier
   * @param topicName MQTTString - the MQTT topic in the publish
-  * @param payload byte buffer - the MQTT publish payload
+  * @param topic_alias integer - the MQTT 5.0 topic alias, 0 if not used
   * @param payload_len integer - the length of the MQTT payload
-  * @return the length of the serialized data.  <= 0 indicates error
+  * @param serialized_len returned integer - the length of the serialized headers
+  * @return SUCCESS if successful, error code if not
   */
-static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t dup, QoS qos, uint8_t retained,
-                                     uint16_t packet_id,
-                                     char *topicName, unsigned char *payload, size_t payload_len,
-                                     uint32_t *serialized_len) {
+static int _serialize_publish_header(unsigned char *buf, size_t buf_len, uint8_t mqtt_version, uint8_t dup, QoS qos,
+                                     uint8_t retained, uint16_t packet_id, char *topicName, uint16_t topic_alias,
+                                     size_t payload_len, uint32_t *serialized_len) {
     POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(serialized_len, ERR_PARAM_INVALID);
-    POINTER_VALID_CHECK(payload, ERR_PARAM_INVALID);
 
     unsigned char *ptr = buf;
     unsigned char header = 0;
     uint32_t rem_len = 0;
     int ret;
 
-    rem_len = _get_publish_packet_len(qos, topicName, payload_len);
-    if (get_mqtt_packet_len(rem_len) > buf_len) {
+    rem_len = _get_publish_packet_len(mqtt_version, qos, topicName, topic_alias, payload_len);
+    if (get_mqtt_packet_len(rem_len) - payload_len > buf_len) {
         return ERR_MQTT_BUFFER_TOO_SHORT;
     }
 
@@ -274,25 +610,157 @@ static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t
         mqtt_write_uint_16(&ptr, packet_id);  /* Variable Header: Topic Name */
     }
 
-    memcpy(ptr, payload, payload_len);
-    ptr += payload_len;
+    if (MQTT_5_0 == mqtt_version) {
+        /* Variable Header: Properties */
+        if (topic_alias > 0) {
+            mqtt_write_char(&ptr, 3);
+            mqtt_write_char(&ptr, MQTT_PROP_TOPIC_ALIAS);
+            mqtt_write_uint_16(&ptr, topic_alias);
+        } else {
+            mqtt_write_char(&ptr, 0);
+        }
+    }
 
     *serialized_len = (uint32_t) (ptr - buf);
 
     return SUCCESS_RET;
 }
 
-int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pParams) {
+/*
+ * 按消息优先级获取lock_write_buf. 有关键消息在等待时, 普通消息和批量消息先让出,
+ * 关键消息最多等待正在发送的一个报文.
+ */
+static void _publish_lock(UIoT_Client *pClient, uint8_t priority)
+{
+    if (MQTT_PRIORITY_CRITICAL == priority) {
+        HAL_MutexLock(pClient->lock_generic);
+        pClient->tx_critical_waiting++;
+        HAL_MutexUnlock(pClient->lock_generic);
+
+        HAL_MutexLock(pClient->lock_write_buf);
+
+        HAL_MutexLock(pClient->lock_generic);
+        pClient->tx_critical_waiting--;
+        HAL_MutexUnlock(pClient->lock_generic);
+        return;
+    }
+
+    HAL_MutexLock(pClient->lock_generic);
+    while (pClient->tx_critical_waiting > 0) {
+        pClient->tx_critical_yielding++;
+        HAL_MutexUnlock(pClient->lock_generic);
+        (void)HAL_SemaphoreWait(pClient->tx_critical_sem, MQTT_CRITICAL_YIELD_WAIT_MS);
+        HAL_MutexLock(pClient->lock_generic);
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+}
+
+/*
+ * 释放_publish_lock获取的lock_write_buf. 关键消息发出后如果没有其他关键消息在等待, 唤醒所有让出的消息.
+ * 等待超时的消息不会撤销登记, 多余的通知只会让之后的让出多检查一次.
+ */
+static void _publish_unlock(UIoT_Client *pClient, uint8_t priority)
+{
+    uint16_t yielding = 0;
+
+    HAL_MutexUnlock(pClient->lock_write_buf);
+    if (MQTT_PRIORITY_CRITICAL != priority) {
+        return;
+    }
+
+    HAL_MutexLock(pClient->lock_generic);
+    if (0 == pClient->tx_critical_waiting) {
+        yielding = pClient->tx_critical_yielding;
+        pClient->tx_critical_yielding = 0;
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+
+    while (yielding-- > 0) {
+        HAL_SemaphorePost(pClient->tx_critical_sem);
+    }
+}
+
+/*
+ * 记录消息从调用发布接口(或放入发布队列)到报文发出的时延, 调用者需持有lock_write_buf.
+ */
+static void _publish_latency_record(UIoT_Client *pClient, uint8_t priority, uint64_t queued_ms)
+{
+    UIoTPubLatency *latency = &pClient->pub_latency[priority];
+    uint32_t delay = (uint32_t)(HAL_UptimeMs() - queued_ms);
+
+    latency->count++;
+    latency->total_ms += delay;
+    latency->max_ms = Max(latency->max_ms, delay);
+}
+
+/*
+ * 发送已序列化好报文头部的PUBLISH报文, 调用者需持有lock_write_buf.
+ * QoS1消息拷贝到重发缓存区中, 从缓存区发送, 收到PUBACK前一直保留; QoS0消息的负载直接从调用者的内存发送,
+ * 关键消息不参与合并发送.
+ */
+static int _publish_send(UIoT_Client *pClient, QoS qos, uint8_t priority, uint16_t packet_id, unsigned char *header,
+                         uint32_t header_len, unsigned char *payload, size_t payload_len,
+                         OnPublishComplete on_complete, void *complete_data, Timer *timer)
+{
+    UIoTPubInfo *repubInfo = NULL;
+    utils_iovec_t iov[2];
+    int ret;
+
+    if (qos > QOS0) {
+        HAL_MutexLock(pClient->lock_list_pub);
+        repubInfo = uiot_mqtt_pub_window_push(&pClient->pub_window, packet_id, header_len + (uint32_t)payload_len,
+                                              pClient->command_timeout_ms);
+        if (NULL != repubInfo) {
+            repubInfo->on_complete = on_complete;
+            repubInfo->complete_data = complete_data;
+        }
+        HAL_MutexUnlock(pClient->lock_list_pub);
+        if (NULL == repubInfo) {
+            LOG_ERROR("push publish into pub window failed!");
+            return ERR_MQTT_PUSH_TO_LIST_FAILED;
+        }
+
+        memcpy(repubInfo->buf, header, header_len);
+        if (payload_len > 0) {
+            memcpy(repubInfo->buf + header_len, payload, payload_len);
+        }
+
+        ret = send_mqtt_buf(pClient, repubInfo->buf, header_len + (uint32_t)payload_len, timer);
+        if (SUCCESS_RET != ret) {
+            HAL_MutexLock(pClient->lock_list_pub);
+            (void)uiot_mqtt_pub_window_release(&pClient->pub_window, packet_id);
+            HAL_MutexUnlock(pClient->lock_list_pub);
+        }
+        return ret;
+    }
+
+    iov[0].base = header;
+    iov[0].len = header_len;
+    iov[1].base = payload;
+    iov[1].len = payload_len;
+    if (MQTT_PRIORITY_CRITICAL == priority) {
+        return send_mqtt_bufv(pClient, iov, 2, timer);
+    }
+    return send_mqtt_bufv_corked(pClient, iov, 2, timer);
+}
+
+int uiot_mqtt_publish_with_callback(UIoT_Client *pClient, char *topicName, PublishParams *pParams,
+                                    OnPublishComplete on_complete, void *complete_data, uint64_t queued_ms) {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
     STRING_PTR_VALID_CHECK(topicName, ERR_PARAM_INVALID);
 
+    uint64_t start_ms = (0 != queued_ms) ? queued_ms : HAL_UptimeMs();
     Timer timer;
     uint32_t len = 0;
     int ret;
+    uint8_t version = pClient->options.mqtt_version;
+    uint16_t alias;
+    uint8_t announced;
+    char *wire_topic;
 
-    ListNode *node = NULL;
-    
     size_t topicLen = strlen(topicName);
     if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
         return ERR_MAX_TOPIC_LENGTH;
@@ -303,6 +771,14 @@ int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pPar
         return ERR_MQTT_QOS_NOT_SUPPORT;
     }
 
+    if (pParams->payload_len > 0) {
+        POINTER_VALID_CHECK(pParams->payload, ERR_PARAM_INVALID);
+    }
+
+    if (pParams->priority >= MQTT_PRIORITY_MAX) {
+        return ERR_PARAM_INVALID;
+    }
+
     if (!get_client_conn_state(pClient)) {
         return ERR_MQTT_NO_CONN;
     }
@@ -310,7 +786,7 @@ int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pPar
     init_timer(&timer);
     countdown_ms(&timer, pClient->command_timeout_ms);
 
-    HAL_MutexLock(pClient->lock_write_buf);
+    _publish_lock(pClient, pParams->priority);
     if (pParams->qos == QOS1) {
         pParams->id = get_next_packet_id(pClient);
         LOG_INFO("publish qos1 seq=%d|topicName=%s|payload=%s", pParams->id, topicName, (char *)pParams->payload);
@@ -318,38 +794,374 @@ int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pPar
     else {
         LOG_INFO("publish qos0 seq=%d|topicName=%s|payload=%s", pParams->id, topicName, (char *)pParams->payload);
     }
-    ret = _serialize_publish_packet(pClient->write_buf, pClient->write_buf_size, 0, pParams->qos, pParams->retained, pParams->id,
-                                   topicName, (unsigned char *) pParams->payload, pParams->payload_len, &len);
+
+    /* MQTT 5.0 本次连接中已经发送过主题全称的别名只发送别名和空主题 */
+    alias = _topic_alias_get(pClient, topicName, 0, &announced);
+    wire_topic = announced ? "" : topicName;
+
+    /* 只把报文头序列化到write_buf中, 负载不经过write_buf */
+    len = get_mqtt_packet_len(_get_publish_packet_len(version, pParams->qos, wire_topic, alias, pParams->payload_len));
+    ret = uiot_mqtt_write_buf_reserve(pClient, len - pParams->payload_len);
+    if (SUCCESS_RET == ret) {
+        ret = _serialize_publish_header(pClient->write_buf, pClient->write_buf_size, version, 0, pParams->qos,
+                                        pParams->retained, pParams->id, wire_topic, alias, pParams->payload_len,
+                                        &len);
+    }
+    if (SUCCESS_RET == ret) {
+        ret = _publish_send(pClient, pParams->qos, pParams->priority, pParams->id, pClient->write_buf, len,
+                            (unsigned char *) pParams->payload, pParams->payload_len, on_complete, complete_data,
+                            &timer);
+    }
     if (SUCCESS_RET != ret) {
-        HAL_MutexUnlock(pClient->lock_write_buf);
+        _publish_unlock(pClient, pParams->priority);
         return ret;
     }
 
-    if (pParams->qos > QOS0) {
-        ret = _mask_push_pubInfo_to(pClient, len, pParams->id, &node);
-        if (SUCCESS_RET != ret) {
-            LOG_ERROR("push publish into pubInfolist failed!");
-            HAL_MutexUnlock(pClient->lock_write_buf);
-            return ret;
+    if (alias > 0) {
+        pClient->topic_alias.announced[alias - 1] = 1;
+    }
+    _publish_latency_record(pClient, pParams->priority, start_ms);
+
+    _publish_unlock(pClient, pParams->priority);
+
+    return pParams->id;
+}
+
+int uiot_mqtt_publish(UIoT_Client *pClient, char *topicName, PublishParams *pParams) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
+    STRING_PTR_VALID_CHECK(topicName, ERR_PARAM_INVALID);
+
+    uint64_t start_ms = HAL_UptimeMs();
+    int rate;
+    int ret;
+
+    /* 断线期间或离线消息还未补发完时写入离线存储 */
+    if (uiot_mqtt_store_should_queue(pClient, pParams->priority)) {
+        return uiot_mqtt_store_push(pClient, topicName, pParams);
+    }
+
+    rate = uiot_mqtt_rate_acquire(pClient, topicName);
+    if (MQTT_RATE_QUEUED == rate) {
+        return uiot_mqtt_store_push(pClient, topicName, pParams);
+    } else if (SUCCESS_RET != rate && MQTT_RATE_WAITED != rate) {
+        return rate;
+    }
+
+    ret = uiot_mqtt_publish_with_callback(pClient, topicName, pParams, NULL, NULL, start_ms);
+    if (ret < 0) {
+        uiot_mqtt_rate_refund(pClient, topicName, SUCCESS_RET == rate);
+    }
+
+    return ret;
+}
+
+UIoTPubHandle *uiot_mqtt_publish_prepare(UIoT_Client *pClient, char *topicName, QoS qos) {
+    POINTER_VALID_CHECK(pClient, NULL);
+    STRING_PTR_VALID_CHECK(topicName, NULL);
+
+    UIoTPubHandle *pHandle;
+    unsigned char *ptr;
+    size_t topicLen = strlen(topicName);
+
+    if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
+        LOG_ERROR("topic is too long: %u", (unsigned int)topicLen);
+        return NULL;
+    }
+
+    if (qos == QOS2) {
+        LOG_ERROR("QoS2 is not supported currently");
+        return NULL;
+    }
+
+    /* 句柄, 报文头部(固定头部 + 主题 + 报文标识符 + 最多4字节属性)和主题名一次分配 */
+    pHandle = (UIoTPubHandle *)HAL_Malloc(sizeof(UIoTPubHandle) + MQTT_PUB_HANDLE_FIXED_HEADER_LEN + 2 + topicLen
+                                          + 2 + 4 + topicLen + 1);
+    if (NULL == pHandle) {
+        LOG_ERROR("memory malloc failed!");
+        return NULL;
+    }
+    memset(pHandle, 0, sizeof(UIoTPubHandle));
+
+    pHandle->client = pClient;
+    pHandle->qos = qos;
+    pHandle->topic_len = (uint16_t)topicLen;
+    pHandle->buf = (unsigned char *)pHandle + sizeof(UIoTPubHandle);
+    pHandle->topic = (char *)pHandle->buf + MQTT_PUB_HANDLE_FIXED_HEADER_LEN + 2 + topicLen + 2 + 4;
+    memcpy(pHandle->topic, topicName, topicLen + 1);
+
+    ptr = pHandle->buf + MQTT_PUB_HANDLE_FIXED_HEADER_LEN;
+    mqtt_write_utf8_string(&ptr, pHandle->topic);
+
+    return pHandle;
+}
+
+/*
+ * 填写发布句柄中缓存的报文头部, 调用者需持有lock_write_buf.
+ * 固定头部的长度随剩余长度变化, 从预留空间的末尾向前写入, 与之后缓存的主题相接.
+ */
+static int _publish_handle_header(UIoTPubHandle *pHandle, uint8_t version, uint16_t packet_id, uint16_t alias,
+                                  uint8_t announced, size_t payload_len, unsigned char **header,
+                                  uint32_t *header_len)
+{
+    unsigned char fixed[MQTT_PUB_HANDLE_FIXED_HEADER_LEN];
+    unsigned char *var_header = pHandle->buf + MQTT_PUB_HANDLE_FIXED_HEADER_LEN;
+    unsigned char *ptr = var_header + 2 + pHandle->topic_len;
+    uint32_t fixed_len;
+    int ret;
+
+    /* 别名已生效时主题为空, 报文头部很短, 直接序列化 */
+    if (announced) {
+        *header = pHandle->alias_buf;
+        return _serialize_publish_header(pHandle->alias_buf, sizeof(pHandle->alias_buf), version, 0, pHandle->qos, 0,
+                                         packet_id, "", alias, payload_len, header_len);
+    }
+
+    if (pHandle->qos > QOS0) {
+        mqtt_write_uint_16(&ptr, packet_id);
+    }
+
+    if (MQTT_5_0 == version) {
+        if (alias > 0) {
+            mqtt_write_char(&ptr, 3);
+            mqtt_write_char(&ptr, MQTT_PROP_TOPIC_ALIAS);
+            mqtt_write_uint_16(&ptr, alias);
+        } else {
+            mqtt_write_char(&ptr, 0);
         }
     }
 
-    /* send the publish packet */
-    ret = send_mqtt_packet(pClient, len, &timer);
+    ret = mqtt_init_packet_header(&fixed[0], PUBLISH, pHandle->qos, 0, 0);
     if (SUCCESS_RET != ret) {
-        if (pParams->qos > QOS0) {
-            HAL_MutexLock(pClient->lock_list_pub);
-            list_remove(pClient->list_pub_wait_ack, node);
-            HAL_MutexUnlock(pClient->lock_list_pub);
+        return ret;
+    }
+    fixed_len = 1 + (uint32_t)mqtt_write_packet_rem_len(&fixed[1], (uint32_t)(ptr - var_header) + (uint32_t)payload_len);
+
+    *header = var_header - fixed_len;
+    memcpy(*header, fixed, fixed_len);
+    *header_len = (uint32_t)(ptr - *header);
+
+    return SUCCESS_RET;
+}
+
+int uiot_mqtt_publish_with(UIoTPubHandle *pHandle, void *payload, size_t payload_len) {
+    POINTER_VALID_CHECK(pHandle, ERR_PARAM_INVALID);
+
+    UIoT_Client *pClient = pHandle->client;
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    uint64_t start_ms = HAL_UptimeMs();
+    Timer timer;
+    unsigned char *header = NULL;
+    uint32_t header_len = 0;
+    uint16_t packet_id = 0;
+    uint16_t alias;
+    uint8_t announced;
+    int rate;
+    int ret;
+
+    if (payload_len > 0) {
+        POINTER_VALID_CHECK(payload, ERR_PARAM_INVALID);
+    }
+
+    params.qos = pHandle->qos;
+    params.priority = pHandle->priority;
+    params.payload = payload;
+    params.payload_len = payload_len;
+
+    /* 断线期间或离线消息还未补发完时写入离线存储 */
+    if (uiot_mqtt_store_should_queue(pClient, pHandle->priority)) {
+        return uiot_mqtt_store_push(pClient, pHandle->topic, &params);
+    }
+
+    if (!get_client_conn_state(pClient)) {
+        return ERR_MQTT_NO_CONN;
+    }
+
+    rate = uiot_mqtt_rate_acquire(pClient, pHandle->topic);
+    if (MQTT_RATE_QUEUED == rate) {
+        return uiot_mqtt_store_push(pClient, pHandle->topic, &params);
+    } else if (SUCCESS_RET != rate && MQTT_RATE_WAITED != rate) {
+        return rate;
+    }
+
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    _publish_lock(pClient, pHandle->priority);
+    if (pHandle->qos == QOS1) {
+        packet_id = get_next_packet_id(pClient);
+    }
+    LOG_DEBUG("publish qos%d seq=%d|topicName=%s", pHandle->qos, packet_id, pHandle->topic);
+
+    alias = _topic_alias_get(pClient, pHandle->topic, pHandle->topic_alias, &announced);
+    pHandle->topic_alias = alias;
+
+    ret = _publish_handle_header(pHandle, pClient->options.mqtt_version, packet_id, alias, announced, payload_len,
+                                 &header, &header_len);
+    if (SUCCESS_RET == ret) {
+        ret = _publish_send(pClient, pHandle->qos, pHandle->priority, packet_id, header, header_len,
+                            (unsigned char *)payload, payload_len, NULL, NULL, &timer);
+    }
+    if (SUCCESS_RET != ret) {
+        _publish_unlock(pClient, pHandle->priority);
+        uiot_mqtt_rate_refund(pClient, pHandle->topic, SUCCESS_RET == rate);
+        return ret;
+    }
+
+    if (alias > 0) {
+        pClient->topic_alias.announced[alias - 1] = 1;
+    }
+    _publish_latency_record(pClient, pHandle->priority, start_ms);
+
+    _publish_unlock(pClient, pHandle->priority);
+
+    return packet_id;
+}
+
+void uiot_mqtt_publish_release(UIoTPubHandle *pHandle) {
+    HAL_Free(pHandle);
+}
+
+/*
+ * MQTT 5.0下重发消息. 报文中的主题别名在当前连接中仍然有效时原样发送;
+ * 重连后别名还未携带主题全称, 或超出服务器允许的个数时, 把携带主题全称的报文头部重新序列化到write_buf中, 负载仍从重发缓存区发送.
+ */
+static int _publish_resend_v5(UIoT_Client *pClient, UIoTPubInfo *repubInfo, Timer *timer)
+{
+    UIoTTopicAlias *table = &pClient->topic_alias;
+    unsigned char *buf = repubInfo->buf;
+    unsigned char *ptr;
+    unsigned char *end;
+    char topic[MAX_SIZE_OF_CLOUD_TOPIC + 1];
+    char *topic_name = NULL;
+    uint16_t topic_len = 0;
+    uint16_t packet_id;
+    uint16_t alias;
+    uint32_t rem_len = 0;
+    uint32_t rem_len_bytes = 0;
+    uint32_t len = 0;
+    size_t payload_len;
+    QoS qos = (QoS)((buf[0] & MQTT_HEADER_QOS_MASK) >> MQTT_HEADER_QOS_SHIFT);
+    MQTTProperties props;
+    utils_iovec_t iov[2];
+    int ret;
+
+    ret = mqtt_read_packet_rem_len_form_buf(buf + 1, &rem_len, &rem_len_bytes);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+    ptr = buf + 1 + rem_len_bytes;
+    end = ptr + rem_len;
+
+    if (SUCCESS_RET != _read_string_with_len(&topic_name, &topic_len, &ptr, end) || end - ptr < 2) {
+        return FAILURE_RET;
+    }
+    packet_id = mqtt_read_uint16_t(&ptr);
+    if (SUCCESS_RET != mqtt_read_properties(&ptr, end, &props)) {
+        return FAILURE_RET;
+    }
+    alias = props.topic_alias;
+
+    if (0 == alias || (alias <= table->limit && (topic_len > 0 || table->announced[alias - 1]))) {
+        ret = send_mqtt_buf(pClient, buf, repubInfo->len, timer);
+        if (SUCCESS_RET == ret && alias > 0) {
+            table->announced[alias - 1] = 1;
         }
+        return ret;
+    }
 
-        HAL_MutexUnlock(pClient->lock_write_buf);
+    if (topic_len > 0) {
+        if (topic_len > MAX_SIZE_OF_CLOUD_TOPIC) {
+            return ERR_MAX_TOPIC_LENGTH;
+        }
+        memcpy(topic, topic_name, topic_len);
+        topic[topic_len] = '\0';
+    } else if (alias <= table->count) {
+        strncpy(topic, table->topics[alias - 1], MAX_SIZE_OF_CLOUD_TOPIC);
+        topic[MAX_SIZE_OF_CLOUD_TOPIC] = '\0';
+    } else {
+        LOG_ERROR("unknown topic alias %u of msg %u", alias, packet_id);
+        return FAILURE_RET;
+    }
+
+    if (alias > table->limit) {
+        alias = 0;
+    }
+
+    payload_len = (size_t)(end - ptr);
+    len = get_mqtt_packet_len(_get_publish_packet_len(MQTT_5_0, qos, topic, alias, payload_len));
+    ret = uiot_mqtt_write_buf_reserve(pClient, len - payload_len);
+    if (SUCCESS_RET == ret) {
+        ret = _serialize_publish_header(pClient->write_buf, pClient->write_buf_size, MQTT_5_0, 1, qos,
+                                        buf[0] & MQTT_HEADER_RETAIN_MASK, packet_id, topic, alias, payload_len, &len);
+    }
+    if (SUCCESS_RET != ret) {
         return ret;
     }
 
+    iov[0].base = pClient->write_buf;
+    iov[0].len = len;
+    iov[1].base = ptr;
+    iov[1].len = payload_len;
+    ret = send_mqtt_bufv(pClient, iov, 2, timer);
+    if (SUCCESS_RET == ret && alias > 0) {
+        table->announced[alias - 1] = 1;
+    }
+
+    return ret;
+}
+
+int uiot_mqtt_pub_resend(UIoT_Client *pClient, UIoTPubInfo *repubInfo, Timer *timer)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(repubInfo, ERR_PARAM_INVALID);
+
+    UIoTPubWindow *window = &pClient->pub_window;
+
+    repubInfo->buf[0] |= MQTT_HEADER_DUP_MASK;
+    repubInfo->sent_ms = HAL_UptimeMs();
+    _pub_window_schedule(window, repubInfo, _pub_window_rto(window, pClient->command_timeout_ms, repubInfo->retries));
+    window->retransmits++;
+    uiot_mqtt_rate_charge(pClient);
+
+    LOG_DEBUG("resend publish msg %u, retries: %u", repubInfo->msg_id, repubInfo->retries);
+
+    if (MQTT_5_0 == pClient->options.mqtt_version) {
+        return _publish_resend_v5(pClient, repubInfo, timer);
+    }
+
+    return send_mqtt_buf(pClient, repubInfo->buf, repubInfo->len, timer);
+}
+
+int uiot_mqtt_pub_resend_all(UIoT_Client *pClient, uint64_t sent_before_ms)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoTPubWindow *window = &pClient->pub_window;
+    UIoTPubInfo *repubInfo;
+    Timer timer;
+    uint16_t i;
+    int ret = SUCCESS_RET;
+
+    if (0 == UIOT_MQTT_RETRANS_MAX) {
+        return SUCCESS_RET;
+    }
+
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    HAL_MutexLock(pClient->lock_list_pub);
+    for (i = 0; i < window->count && SUCCESS_RET == ret; ++i) {
+        repubInfo = _pub_window_slot(window, window->order[(window->head + i) % window->size].msg_id);
+        if (NULL != repubInfo && repubInfo->sent_ms < sent_before_ms) {
+            ret = uiot_mqtt_pub_resend(pClient, repubInfo, &timer);
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_list_pub);
     HAL_MutexUnlock(pClient->lock_write_buf);
 
-    return pParams->id;
+    return ret;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,388 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+/* 令牌数的单位为百万分之一个令牌, 每毫秒补充的数量恰好等于每秒补充的千分之一令牌数 */
+#define RATE_TOKEN_UNIT             (1000000)
+
+/* 令牌桶容量上限, 单位:令牌 */
+#define RATE_BURST_MAX              (1000000)
+
+/* 补充速率上限, 单位:每秒千分之一个令牌 */
+#define RATE_RATE_MAX               (1000000000)
+
+static void _rate_refill(UIoTRateBucket *b, uint64_t now) {
+    uint64_t elapsed;
+    uint64_t gap;
+
+    if (now <= b->refill_ms) {
+        return;
+    }
+
+    elapsed = now - b->refill_ms;
+    b->refill_ms = now;
+    gap = (uint64_t)(b->burst - b->tokens);
+    /* 先比较时间再相乘, 长时间未取用时乘积不会溢出 */
+    if (elapsed > gap / b->rate) {
+        b->tokens = b->burst;
+    } else {
+        b->tokens += (int64_t)(elapsed * b->rate);
+    }
+}
+
+/* 取得一个令牌还需要等待的时间, 单位:ms */
+static uint32_t _rate_wait_ms(UIoTRateBucket *b) {
+    int64_t wait;
+
+    if (b->tokens >= RATE_TOKEN_UNIT) {
+        return 0;
+    }
+
+    wait = (RATE_TOKEN_UNIT - b->tokens + b->rate - 1) / b->rate;
+    return (uint32_t)Min(wait, (int64_t)UINT32_MAX);
+}
+
+/* 前缀与主题完全相同的令牌桶, 调用者需持有lock_rate */
+static UIoTRateBucket *_rate_find(UIoT_Client *pClient, const char *prefix) {
+    int i;
+
+    for (i = 0; i < UIOT_MQTT_RATE_LIMIT_TOPICS; ++i) {
+        if (pClient->rate_topics[i].rate > 0 && 0 == strcmp(pClient->rate_topics[i].prefix, prefix)) {
+            return &pClient->rate_topics[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* 与主题匹配的最长前缀的令牌桶, 调用者需持有lock_rate */
+static UIoTRateBucket *_rate_match(UIoT_Client *pClient, const char *topic) {
+    UIoTRateBucket *best = NULL;
+    size_t best_len = 0;
+    size_t len;
+    int i;
+
+    for (i = 0; i < UIOT_MQTT_RATE_LIMIT_TOPICS; ++i) {
+        if (0 == pClient->rate_topics[i].rate) {
+            continue;
+        }
+
+        len = strlen(pClient->rate_topics[i].prefix);
+        if ((NULL == best || len > best_len) && 0 == strncmp(topic, pClient->rate_topics[i].prefix, len)) {
+            best = &pClient->rate_topics[i];
+            best_len = len;
+        }
+    }
+
+    return best;
+}
+
+/*
+ * 从主题对应的令牌桶和客户端级令牌桶中各取一个令牌, 调用者需持有lock_rate.
+ * 成功返回0; 任一令牌桶不足时都不取, 返回还需要等待的时间, limited返回决定处理方式的令牌桶.
+ */
+static uint32_t _rate_take(UIoT_Client *pClient, const char *topic, UIoTRateBucket **limited, bool count) {
+    UIoTRateBucket *buckets[2];
+    uint64_t now = HAL_UptimeMs();
+    uint32_t wait = 0;
+    uint32_t w;
+    int n = 0;
+    int i;
+
+    if (NULL != (buckets[n] = _rate_match(pClient, topic))) {
+        n++;
+    }
+    if (pClient->rate_client.rate > 0) {
+        buckets[n++] = &pClient->rate_client;
+    }
+
+    *limited = NULL;
+    for (i = 0; i < n; ++i) {
+        _rate_refill(buckets[i], now);
+        w = _rate_wait_ms(buckets[i]);
+        if (w > 0 && NULL == *limited) {
+            *limited = buckets[i];
+        }
+        wait = Max(wait, w);
+    }
+    if (wait > 0) {
+        return wait;
+    }
+
+    for (i = 0; i < n; ++i) {
+        buckets[i]->tokens -= RATE_TOKEN_UNIT;
+        if (count) {
+            buckets[i]->passed++;
+        }
+    }
+
+    return 0;
+}
+
+static void _rate_give_back(UIoTRateBucket *b, bool passed) {
+    b->tokens = Min(b->tokens + RATE_TOKEN_UNIT, b->burst);
+    /* 撤销_rate_take计入的统计, 令牌桶可能在发送期间被重新设置, 不能减到0以下 */
+    if (passed && b->passed > 0) {
+        b->passed--;
+    }
+}
+
+int uiot_mqtt_rate_init(UIoT_Client *pClient) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    if ((pClient->lock_rate = HAL_MutexCreate()) == NULL) {
+        LOG_ERROR("create rate limit lock failed.");
+        return FAILURE_RET;
+    }
+
+    return SUCCESS_RET;
+}
+
+void uiot_mqtt_rate_deinit(UIoT_Client *pClient) {
+    int i;
+
+    if (NULL == pClient || NULL == pClient->lock_rate) {
+        return;
+    }
+
+    for (i = 0; i < UIOT_MQTT_RATE_LIMIT_TOPICS; ++i) {
+        HAL_Free(pClient->rate_topics[i].prefix);
+        pClient->rate_topics[i].prefix = NULL;
+        pClient->rate_topics[i].rate = 0;
+    }
+    pClient->rate_client.rate = 0;
+    pClient->rate_active = 0;
+
+    HAL_MutexDestroy(pClient->lock_rate);
+    pClient->lock_rate = NULL;
+}
+
+int uiot_mqtt_rate_set(UIoT_Client *pClient, const char *topic_prefix, MQTTRateLimitParams *pParams) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    bool enable = (NULL != pParams && pParams->rate > 0);
+    UIoTRateBucket *b = NULL;
+    char *prefix = NULL;
+    int i;
+
+    if (enable && (0 == pParams->burst || pParams->burst > RATE_BURST_MAX || pParams->rate > RATE_RATE_MAX
+                   || pParams->policy > MQTT_RATE_DROP)) {
+        return ERR_PARAM_INVALID;
+    }
+
+    if (NULL != topic_prefix) {
+        STRING_PTR_VALID_CHECK(topic_prefix, ERR_PARAM_INVALID);
+        if (strlen(topic_prefix) > MAX_SIZE_OF_CLOUD_TOPIC) {
+            return ERR_MAX_TOPIC_LENGTH;
+        }
+    }
+
+    HAL_MutexLock(pClient->lock_rate);
+    if (NULL == topic_prefix) {
+        b = &pClient->rate_client;
+    } else if (NULL == (b = _rate_find(pClient, topic_prefix)) && enable) {
+        for (i = 0; i < UIOT_MQTT_RATE_LIMIT_TOPICS && NULL == b; ++i) {
+            if (0 == pClient->rate_topics[i].rate) {
+                b = &pClient->rate_topics[i];
+            }
+        }
+        if (NULL == b) {
+            HAL_MutexUnlock(pClient->lock_rate);
+            LOG_ERROR("too many rate limit buckets, max: %d", UIOT_MQTT_RATE_LIMIT_TOPICS);
+            return FAILURE_RET;
+        }
+        if ((prefix = (char *)HAL_Malloc(strlen(topic_prefix) + 1)) == NULL) {
+            HAL_MutexUnlock(pClient->lock_rate);
+            LOG_ERROR("memory malloc failed!");
+            return FAILURE_RET;
+        }
+        strcpy(prefix, topic_prefix);
+        b->prefix = prefix;
+    }
+
+    if (!enable) {
+        if (NULL != b && b->rate > 0) {
+            HAL_Free(b->prefix);
+            memset(b, 0, sizeof(UIoTRateBucket));
+            pClient->rate_active--;
+        }
+        HAL_MutexUnlock(pClient->lock_rate);
+        return SUCCESS_RET;
+    }
+
+    /* 新建的令牌桶是满的; 修改参数时先按原速率补充, 再按新容量截断 */
+    if (0 == b->rate) {
+        b->tokens = (int64_t)pParams->burst * RATE_TOKEN_UNIT;
+        pClient->rate_active++;
+    } else {
+        _rate_refill(b, HAL_UptimeMs());
+        b->tokens = Min(b->tokens, (int64_t)pParams->burst * RATE_TOKEN_UNIT);
+    }
+    b->rate = pParams->rate;
+    b->burst = (int64_t)pParams->burst * RATE_TOKEN_UNIT;
+    b->policy = (uint8_t)pParams->policy;
+    b->refill_ms = HAL_UptimeMs();
+    HAL_MutexUnlock(pClient->lock_rate);
+
+    return SUCCESS_RET;
+}
+
+int uiot_mqtt_rate_get_stats(UIoT_Client *pClient, const char *topic_prefix, MQTTRateLimitStats *pStats) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pStats, ERR_PARAM_INVALID);
+
+    UIoTRateBucket *b;
+
+    HAL_MutexLock(pClient->lock_rate);
+    if (NULL == topic_prefix) {
+        b = (pClient->rate_client.rate > 0) ? &pClient->rate_client : NULL;
+    } else {
+        b = _rate_find(pClient, topic_prefix);
+    }
+    if (NULL == b) {
+        HAL_MutexUnlock(pClient->lock_rate);
+        return ERR_PARAM_INVALID;
+    }
+
+    _rate_refill(b, HAL_UptimeMs());
+    pStats->passed = b->passed;
+    pStats->deferred = b->deferred;
+    pStats->dropped = b->dropped;
+    pStats->tokens = (int32_t)(b->tokens / RATE_TOKEN_UNIT);
+    HAL_MutexUnlock(pClient->lock_rate);
+
+    return SUCCESS_RET;
+}
+
+int uiot_mqtt_rate_acquire(UIoT_Client *pClient, const char *topic) {
+    UIoTRateBucket *limited;
+    UIoTRateBucket *blocked;
+    Timer timer;
+    uint32_t wait;
+    int left;
+
+    if (0 == pClient->rate_active) {
+        return SUCCESS_RET;
+    }
+
+    HAL_MutexLock(pClient->lock_rate);
+    wait = _rate_take(pClient, topic, &limited, true);
+    if (0 == wait) {
+        HAL_MutexUnlock(pClient->lock_rate);
+        return SUCCESS_RET;
+    }
+
+    if (MQTT_RATE_QUEUE == limited->policy && NULL != pClient->store) {
+        limited->deferred++;
+        pClient->rate_deferred++;
+        HAL_MutexUnlock(pClient->lock_rate);
+        return MQTT_RATE_QUEUED;
+    }
+
+    if (MQTT_RATE_BLOCK != limited->policy) {
+        limited->dropped++;
+        pClient->rate_dropped++;
+        HAL_MutexUnlock(pClient->lock_rate);
+        LOG_WARN("publish rate limited, drop message to topic: %s", topic);
+        return ERR_MQTT_RATE_LIMITED;
+    }
+    HAL_MutexUnlock(pClient->lock_rate);
+
+    /* 等待期间不持锁, 令牌桶可能被修改或取消, 每次重新查找; 统计计入开始等待时耗尽的令牌桶 */
+    blocked = limited;
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+    do {
+        left = left_ms(&timer);
+        HAL_SleepMs(Min(wait, (uint32_t)Max(left, 1)));
+
+        HAL_MutexLock(pClient->lock_rate);
+        wait = _rate_take(pClient, topic, &limited, false);
+        if (0 == wait) {
+            blocked->deferred++;
+            pClient->rate_deferred++;
+            HAL_MutexUnlock(pClient->lock_rate);
+            return MQTT_RATE_WAITED;
+        }
+        HAL_MutexUnlock(pClient->lock_rate);
+    } while (!has_expired(&timer));
+
+    HAL_MutexLock(pClient->lock_rate);
+    blocked->dropped++;
+    pClient->rate_dropped++;
+    HAL_MutexUnlock(pClient->lock_rate);
+    LOG_WARN("publish rate limited, wait token timeout, topic: %s", topic);
+
+    return ERR_MQTT_RATE_LIMITED;
+}
+
+uint32_t uiot_mqtt_rate_poll(UIoT_Client *pClient, const char *topic) {
+    UIoTRateBucket *limited;
+    uint32_t wait;
+
+    if (0 == pClient->rate_active) {
+        return 0;
+    }
+
+    HAL_MutexLock(pClient->lock_rate);
+    wait = _rate_take(pClient, topic, &limited, false);
+    HAL_MutexUnlock(pClient->lock_rate);
+
+    return wait;
+}
+
+void uiot_mqtt_rate_refund(UIoT_Client *pClient, const char *topic, bool passed) {
+    UIoTRateBucket *b;
+
+    if (0 == pClient->rate_active) {
+        return;
+    }
+
+    HAL_MutexLock(pClient->lock_rate);
+    if (NULL != (b = _rate_match(pClient, topic))) {
+        _rate_give_back(b, passed);
+    }
+    if (pClient->rate_client.rate > 0) {
+        _rate_give_back(&pClient->rate_client, passed);
+    }
+    HAL_MutexUnlock(pClient->lock_rate);
+}
+
+void uiot_mqtt_rate_charge(UIoT_Client *pClient) {
+    UIoTRateBucket *b = &pClient->rate_client;
+
+    if (0 == pClient->rate_active) {
+        return;
+    }
+
+    /* 重发的消息必须发出, 只透支令牌, 使之后的新消息相应延后 */
+    HAL_MutexLock(pClient->lock_rate);
+    if (b->rate > 0) {
+        _rate_refill(b, HAL_UptimeMs());
+        b->tokens = Max(b->tokens - RATE_TOKEN_UNIT, -b->burst);
+    }
+    HAL_MutexUnlock(pClient->lock_rate);
+}
+
+#ifdef __cplusplus
+}
+#endif
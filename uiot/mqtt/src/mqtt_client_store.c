@@ -0,0 +1,827 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#if UIOT_MQTT_STORE_ENABLE
+
+#define STORE_SECTOR_MAGIC          (0x55515353UL)  /* 扇区头部魔数 */
+#define STORE_RECORD_MAGIC          (0x5152)        /* 记录头部魔数 */
+#define STORE_SECTOR_HDR_LEN        (8)             /* 扇区头部: 魔数(4), 扇区序号(4) */
+#define STORE_RECORD_HDR_LEN        (8)             /* 记录头部: 魔数(2), 数据长度(2), 数据的CRC32(4) */
+#define STORE_PUBLISH_HDR_LEN       (6)             /* 消息记录数据头部: 类型(1), QoS(1), retained(1), 优先级(1), 主题长度(2) */
+#define STORE_CHECKPOINT_LEN        (12)            /* 检查点记录数据: 类型(1), 保留(3), 扇区序号(4), 扇区内位置(4) */
+#define STORE_ALIGN                 (8)             /* 记录长度按flash最小编程单位对齐 */
+#define STORE_BODY_MAX              (STORE_PUBLISH_HDR_LEN + UIOT_MQTT_STORE_RECORD_MAX)
+#define STORE_RECORD_BUF_LEN        (STORE_RECORD_HDR_LEN + STORE_BODY_MAX + STORE_ALIGN)
+
+#define STORE_ALIGN_UP(len)         (((uint32_t)(len) + STORE_ALIGN - 1) & ~(uint32_t)(STORE_ALIGN - 1))
+
+typedef enum {
+    STORE_RECORD_PUBLISH = 1,                   /* 离线消息 */
+    STORE_RECORD_CHECKPOINT = 2,                /* 读取位置检查点 */
+} StoreRecordType;
+
+static void _store_put_u16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void _store_put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint16_t _store_get_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _store_get_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t _store_crc32(const unsigned char *buf, uint32_t len)
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    int i;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (i = 0; i < 8; ++i) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+static uint32_t _store_addr(UIoTStore *s, uint16_t sector, uint32_t offset)
+{
+    return (uint32_t)sector * s->sector_size + offset;
+}
+
+/* 读取扇区头部中的序号, 扇区未使用或头部无效时返回FAILURE */
+static int _store_sector_seq(UIoTStore *s, uint16_t sector, uint32_t *seq)
+{
+    unsigned char hdr[STORE_SECTOR_HDR_LEN];
+
+    if (SUCCESS_RET != HAL_Store_Read(s->handle, _store_addr(s, sector, 0), hdr, sizeof(hdr))) {
+        return ERR_MQTT_STORE_FAILED;
+    }
+    if (STORE_SECTOR_MAGIC != _store_get_u32(hdr)) {
+        return FAILURE_RET;
+    }
+
+    *seq = _store_get_u32(hdr + 4);
+    return SUCCESS_RET;
+}
+
+/**
+ * @brief 读取offset处记录的头部及数据的前4个字节, 不校验CRC
+ *
+ * @return 记录占用的长度, 该位置没有记录时返回0, 读flash失败返回错误码
+ */
+static int _store_peek_header(UIoTStore *s, uint16_t sector, uint32_t offset, uint8_t *type, uint32_t *body_len)
+{
+    unsigned char hdr[STORE_RECORD_HDR_LEN + 4];
+    uint32_t rec_len;
+
+    if (offset + sizeof(hdr) > s->sector_size) {
+        return 0;
+    }
+    if (SUCCESS_RET != HAL_Store_Read(s->handle, _store_addr(s, sector, offset), hdr, sizeof(hdr))) {
+        return ERR_MQTT_STORE_FAILED;
+    }
+    if (STORE_RECORD_MAGIC != _store_get_u16(hdr)) {
+        return 0;
+    }
+
+    *body_len = _store_get_u16(hdr + 2);
+    rec_len = STORE_ALIGN_UP(STORE_RECORD_HDR_LEN + *body_len);
+    if (*body_len < 4 || *body_len > STORE_BODY_MAX || offset + rec_len > s->sector_size) {
+        return 0;
+    }
+
+    *type = hdr[STORE_RECORD_HDR_LEN];
+    return (int)rec_len;
+}
+
+/**
+ * @brief 读取并校验offset处的记录, 记录数据存入buf
+ *
+ * @return 记录占用的长度, 该位置没有有效记录(未写入, 写入中掉电或数据损坏)时返回0, 读flash失败返回错误码
+ */
+static int _store_read_record(UIoTStore *s, uint16_t sector, uint32_t offset, unsigned char *buf, uint32_t *body_len)
+{
+    unsigned char hdr[STORE_RECORD_HDR_LEN];
+    uint32_t rec_len;
+
+    if (offset + STORE_RECORD_HDR_LEN > s->sector_size) {
+        return 0;
+    }
+    if (SUCCESS_RET != HAL_Store_Read(s->handle, _store_addr(s, sector, offset), hdr, sizeof(hdr))) {
+        return ERR_MQTT_STORE_FAILED;
+    }
+    if (STORE_RECORD_MAGIC != _store_get_u16(hdr)) {
+        return 0;
+    }
+
+    *body_len = _store_get_u16(hdr + 2);
+    rec_len = STORE_ALIGN_UP(STORE_RECORD_HDR_LEN + *body_len);
+    if (*body_len < 4 || *body_len > STORE_BODY_MAX || offset + rec_len > s->sector_size) {
+        return 0;
+    }
+
+    if (SUCCESS_RET != HAL_Store_Read(s->handle, _store_addr(s, sector, offset + STORE_RECORD_HDR_LEN),
+                                      buf, *body_len)) {
+        return ERR_MQTT_STORE_FAILED;
+    }
+    if (_store_crc32(buf, *body_len) != _store_get_u32(hdr + 4)) {
+        return 0;
+    }
+
+    return (int)rec_len;
+}
+
+/* 统计扇区中从offset开始的消息条数和占用的字节数, buf不为NULL时读出记录校验CRC */
+static void _store_count(UIoTStore *s, uint16_t sector, uint32_t offset, uint32_t end, unsigned char *buf,
+                         uint32_t *records, uint32_t *bytes)
+{
+    uint32_t body_len;
+    uint8_t type;
+    int rec_len;
+
+    while (offset < end) {
+        if (NULL != buf) {
+            rec_len = _store_read_record(s, sector, offset, buf, &body_len);
+            type = buf[0];
+        } else {
+            rec_len = _store_peek_header(s, sector, offset, &type, &body_len);
+        }
+        if (rec_len <= 0) {
+            break;
+        }
+
+        if (STORE_RECORD_PUBLISH == type) {
+            (*records)++;
+            *bytes += rec_len;
+        }
+        offset += rec_len;
+    }
+}
+
+/* 读取位置移到下一个扇区 */
+static void _store_advance_read(UIoTStore *s)
+{
+    uint32_t seq = s->read_seq + 1;
+
+    s->read_sector = (s->read_sector + 1) % s->sector_count;
+    s->read_offset = STORE_SECTOR_HDR_LEN;
+    (void)_store_sector_seq(s, s->read_sector, &seq);
+    s->read_seq = seq;
+}
+
+/* 所有扇区写满时丢弃最早的扇区 */
+static void _store_drop_oldest(UIoTStore *s)
+{
+    uint32_t records = 0;
+    uint32_t bytes = 0;
+
+    /* rbuf可能正被补发使用, 这里只读取记录头部 */
+    _store_count(s, s->read_sector, s->read_offset, s->sector_size, NULL, &records, &bytes);
+    LOG_WARN("mqtt store is full, drop %u oldest messages", records);
+
+    s->dropped += records;
+    s->records = (s->records > records) ? s->records - records : 0;
+    s->bytes = (s->bytes > bytes) ? s->bytes - bytes : 0;
+    _store_advance_read(s);
+}
+
+/* 擦除并打开一个新扇区用于写入, 扇区只在这里擦除, 每轮循环每个扇区擦除一次 */
+static int _store_open_sector(UIoTStore *s, uint16_t sector)
+{
+    unsigned char hdr[STORE_SECTOR_HDR_LEN];
+
+    if (SUCCESS_RET != HAL_Store_Erase(s->handle, _store_addr(s, sector, 0), s->sector_size)) {
+        LOG_ERROR("erase mqtt store sector %u failed", sector);
+        return ERR_MQTT_STORE_FAILED;
+    }
+
+    _store_put_u32(hdr, STORE_SECTOR_MAGIC);
+    _store_put_u32(hdr + 4, s->write_seq + 1);
+    if (SUCCESS_RET != HAL_Store_Write(s->handle, _store_addr(s, sector, 0), hdr, sizeof(hdr))) {
+        LOG_ERROR("write mqtt store sector %u failed", sector);
+        return ERR_MQTT_STORE_FAILED;
+    }
+
+    s->write_seq++;
+    s->write_sector = sector;
+    s->write_offset = STORE_SECTOR_HDR_LEN;
+
+    return SUCCESS_RET;
+}
+
+/* 确保当前写入扇区还有rec_len字节的空间, 不够时打开下一个扇区 */
+static int _store_reserve(UIoTStore *s, uint32_t rec_len)
+{
+    uint16_t next;
+    bool fresh = (0 == s->write_offset);
+    int ret;
+
+    if (!fresh && s->write_offset + rec_len <= s->sector_size) {
+        return SUCCESS_RET;
+    }
+
+    next = fresh ? s->write_sector : (uint16_t)((s->write_sector + 1) % s->sector_count);
+    if (!fresh && next == s->read_sector) {
+        _store_drop_oldest(s);
+    }
+
+    ret = _store_open_sector(s, next);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    if (fresh) {
+        s->read_sector = s->write_sector;
+        s->read_offset = s->write_offset;
+        s->read_seq = s->write_seq;
+    }
+
+    return SUCCESS_RET;
+}
+
+/**
+ * @brief 将wbuf中已填好的记录数据追加写入, 记录头部和对齐填充在这里补齐, 一次写入整条记录
+ *
+ * @return 记录占用的长度, 失败返回错误码
+ */
+static int _store_append(UIoTStore *s, uint32_t body_len)
+{
+    uint32_t rec_len = STORE_ALIGN_UP(STORE_RECORD_HDR_LEN + body_len);
+    int ret;
+
+    ret = _store_reserve(s, rec_len);
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    _store_put_u16(s->wbuf, STORE_RECORD_MAGIC);
+    _store_put_u16(s->wbuf + 2, (uint16_t)body_len);
+    _store_put_u32(s->wbuf + 4, _store_crc32(s->wbuf + STORE_RECORD_HDR_LEN, body_len));
+    memset(s->wbuf + STORE_RECORD_HDR_LEN + body_len, 0xFF, rec_len - STORE_RECORD_HDR_LEN - body_len);
+
+    if (SUCCESS_RET != HAL_Store_Write(s->handle, _store_addr(s, s->write_sector, s->write_offset), s->wbuf, rec_len)) {
+        /* 写入失败的区域状态未知, 不再在这个扇区中继续写入 */
+        LOG_ERROR("write mqtt store record failed");
+        s->write_offset = s->sector_size;
+        return ERR_MQTT_STORE_FAILED;
+    }
+    s->write_offset += rec_len;
+
+    return (int)rec_len;
+}
+
+/* 追加写入当前读取位置的检查点 */
+static int _store_checkpoint(UIoTStore *s)
+{
+    unsigned char *body = s->wbuf + STORE_RECORD_HDR_LEN;
+    int ret;
+
+    /* 先预留空间, 打开新扇区时可能丢弃最早的扇区从而改变读取位置 */
+    ret = _store_reserve(s, STORE_ALIGN_UP(STORE_RECORD_HDR_LEN + STORE_CHECKPOINT_LEN));
+    if (SUCCESS_RET != ret) {
+        return ret;
+    }
+
+    memset(body, 0, STORE_CHECKPOINT_LEN);
+    body[0] = STORE_RECORD_CHECKPOINT;
+    _store_put_u32(body + 4, s->read_seq);
+    _store_put_u32(body + 8, s->read_offset);
+    s->since_checkpoint = 0;
+
+    ret = _store_append(s, STORE_CHECKPOINT_LEN);
+    return (ret < 0) ? ret : SUCCESS_RET;
+}
+
+/**
+ * @brief 读取下一条待补发的消息到rbuf中, 跳过检查点记录, 当前扇区读完时移到下一个扇区
+ *
+ * @return 消息记录占用的长度, 没有待补发的消息时返回0
+ */
+static int _store_peek(UIoTStore *s, uint32_t *body_len)
+{
+    int rec_len;
+
+    while (0 != s->write_offset) {
+        if (s->read_sector == s->write_sector && s->read_offset >= s->write_offset) {
+            return 0;
+        }
+
+        rec_len = _store_read_record(s, s->read_sector, s->read_offset, s->rbuf, body_len);
+        if (rec_len < 0) {
+            return rec_len;
+        }
+
+        if (0 == rec_len) {
+            if (s->read_sector == s->write_sector) {
+                /* 写入扇区中间的记录损坏, 无法定位后续记录, 丢弃剩余部分 */
+                LOG_ERROR("mqtt store record corrupted, drop %u messages", s->records);
+                s->dropped += s->records;
+                s->records = 0;
+                s->bytes = 0;
+                s->read_offset = s->write_offset;
+                return 0;
+            }
+            _store_advance_read(s);
+            (void)_store_checkpoint(s);
+            continue;
+        }
+
+        if (STORE_RECORD_PUBLISH != s->rbuf[0]) {
+            s->read_offset += rec_len;
+            continue;
+        }
+
+        s->peek_sector = s->read_sector;
+        s->peek_offset = s->read_offset;
+        s->peek_len = rec_len;
+        return rec_len;
+    }
+
+    return 0;
+}
+
+/* 确认正在补发的消息已发出, 读取位置越过该消息 */
+static void _store_pop(UIoTStore *s)
+{
+    /* 补发期间存储写满丢弃了最早的扇区, 读取位置已经改变 */
+    if (s->peek_sector != s->read_sector || s->peek_offset != s->read_offset) {
+        return;
+    }
+
+    s->read_offset += s->peek_len;
+    if (s->records > 0) {
+        s->records--;
+        s->bytes = (s->bytes > s->peek_len) ? s->bytes - s->peek_len : 0;
+    }
+
+    if (++s->since_checkpoint >= UIOT_MQTT_STORE_CHECKPOINT_EVERY || 0 == s->records) {
+        (void)_store_checkpoint(s);
+    }
+}
+
+/**
+ * @brief 从flash中恢复读写位置
+ *
+ * 序号最大的扇区为写入扇区, 从头扫描到第一条无效记录即为写入位置; 该位置之后不是擦除状态说明写入时掉电,
+ * 这个扇区不再写入. 读取位置取所有扇区中最新的检查点, 检查点所在的扇区已被重新使用时从序号最小的扇区开始读取.
+ */
+static int _store_recover(UIoTStore *s)
+{
+    unsigned char tail[STORE_RECORD_HDR_LEN];
+    uint32_t seq, min_seq = 0, ck_seq = 0, ck_offset = 0;
+    uint32_t offset, body_len, i;
+    uint16_t sector, min_sector = 0;
+    bool used = false, has_checkpoint = false;
+    int rec_len, ret;
+
+    for (sector = 0; sector < s->sector_count; ++sector) {
+        ret = _store_sector_seq(s, sector, &seq);
+        if (ERR_MQTT_STORE_FAILED == ret) {
+            return ret;
+        }
+        if (SUCCESS_RET != ret) {
+            continue;
+        }
+
+        if (!used || seq < min_seq) {
+            min_seq = seq;
+            min_sector = sector;
+        }
+        if (!used || seq > s->write_seq) {
+            s->write_seq = seq;
+            s->write_sector = sector;
+        }
+        used = true;
+
+        /* 扫描扇区中的记录, 记录最新的检查点 */
+        offset = STORE_SECTOR_HDR_LEN;
+        while ((rec_len = _store_read_record(s, sector, offset, s->rbuf, &body_len)) > 0) {
+            if (STORE_RECORD_CHECKPOINT == s->rbuf[0] && body_len >= STORE_CHECKPOINT_LEN) {
+                seq = _store_get_u32(s->rbuf + 4);
+                if (!has_checkpoint || seq > ck_seq || (seq == ck_seq && _store_get_u32(s->rbuf + 8) > ck_offset)) {
+                    ck_seq = seq;
+                    ck_offset = _store_get_u32(s->rbuf + 8);
+                    has_checkpoint = true;
+                }
+            }
+            offset += rec_len;
+        }
+        if (rec_len < 0) {
+            return rec_len;
+        }
+
+        if (sector == s->write_sector) {
+            s->write_offset = offset;
+            if (offset + STORE_RECORD_HDR_LEN <= s->sector_size) {
+                if (SUCCESS_RET != HAL_Store_Read(s->handle, _store_addr(s, sector, offset), tail, sizeof(tail))) {
+                    return ERR_MQTT_STORE_FAILED;
+                }
+                for (i = 0; i < sizeof(tail); ++i) {
+                    if (0xFF != tail[i]) {
+                        s->write_offset = s->sector_size;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!used) {
+        s->write_offset = 0;
+        return SUCCESS_RET;
+    }
+
+    s->read_sector = min_sector;
+    s->read_offset = STORE_SECTOR_HDR_LEN;
+    s->read_seq = min_seq;
+    if (has_checkpoint && ck_seq >= min_seq && ck_seq <= s->write_seq) {
+        sector = (uint16_t)((min_sector + (ck_seq - min_seq)) % s->sector_count);
+        if (SUCCESS_RET == _store_sector_seq(s, sector, &seq) && seq == ck_seq) {
+            s->read_sector = sector;
+            s->read_offset = ck_offset;
+            s->read_seq = ck_seq;
+        }
+    }
+
+    /* 统计读取位置之后的消息 */
+    sector = s->read_sector;
+    offset = s->read_offset;
+    for (;;) {
+        _store_count(s, sector, offset, (sector == s->write_sector) ? s->write_offset : s->sector_size,
+                     s->rbuf, &s->records, &s->bytes);
+        if (sector == s->write_sector) {
+            break;
+        }
+        sector = (sector + 1) % s->sector_count;
+        offset = STORE_SECTOR_HDR_LEN;
+    }
+
+    return SUCCESS_RET;
+}
+
+static void _store_on_complete(void *pClient, uint16_t packet_id, int result, void *pUserData)
+{
+    UIoTStore *s = (UIoTStore *)pUserData;
+
+    /* 超时或失败的消息留在存储中, 下一次补发时重发; 被服务器拒绝的消息重发也不会成功, 直接丢弃 */
+    if (SUCCESS_RET == result || ERR_MQTT_PUB_NACK == result) {
+        HAL_MutexLock(s->lock);
+        _store_pop(s);
+        HAL_MutexUnlock(s->lock);
+    }
+    s->in_flight = 0;
+}
+
+/* 已打开的存储, 与IOT_MQTT_Construct一样, 客户端的创建和销毁不能在多个线程中同时进行 */
+static UIoTStore *sg_store_list = NULL;
+
+/* 存储中是否还有待补发的消息; records由异步发送线程和补发线程共同修改, 须在存储锁内读取 */
+static bool _store_pending(UIoTStore *s)
+{
+    bool pending;
+
+    HAL_MutexLock(s->lock);
+    pending = s->records > 0;
+    HAL_MutexUnlock(s->lock);
+
+    return pending;
+}
+
+static UIoTStore *_store_find_open(const char *partition)
+{
+    UIoTStore *s;
+
+    for (s = sg_store_list; NULL != s; s = s->next) {
+        if (0 == strcmp(s->partition, partition)) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+static void _store_unlink(UIoTStore *s)
+{
+    UIoTStore **pp;
+
+    for (pp = &sg_store_list; NULL != *pp; pp = &(*pp)->next) {
+        if (*pp == s) {
+            *pp = s->next;
+            return;
+        }
+    }
+}
+
+int uiot_mqtt_store_init(UIoT_Client *pClient, const char *partition)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+
+    UIoTStore *s;
+    uint32_t size = 0;
+    int ret;
+
+    if (NULL == partition) {
+        partition = UIOT_MQTT_STORE_PARTITION;
+    }
+    /* 两个客户端写同一个分区会互相覆盖记录和检查点 */
+    if (NULL != _store_find_open(partition)) {
+        LOG_ERROR("mqtt store partition %s is already used by another client", partition);
+        return FAILURE_RET;
+    }
+
+    s = (UIoTStore *)HAL_Malloc(sizeof(UIoTStore));
+    if (NULL == s) {
+        LOG_ERROR("memory malloc failed!");
+        return FAILURE_RET;
+    }
+    memset(s, 0, sizeof(UIoTStore));
+    init_timer(&s->drain_timer);
+
+    if ((s->partition = (char *)HAL_Malloc(strlen(partition) + 1)) == NULL) {
+        LOG_ERROR("memory malloc failed!");
+        goto error;
+    }
+    strcpy(s->partition, partition);
+
+    s->handle = HAL_Store_Open(s->partition, &size, &s->sector_size);
+    if (NULL == s->handle) {
+        goto error;
+    }
+    s->sector_count = (uint16_t)(size / s->sector_size);
+    if (s->sector_count < 2 || STORE_RECORD_BUF_LEN > s->sector_size - STORE_SECTOR_HDR_LEN) {
+        LOG_ERROR("mqtt store partition too small: %u sectors of %u bytes", s->sector_count, s->sector_size);
+        goto error;
+    }
+
+    s->wbuf = (unsigned char *)HAL_Malloc(STORE_RECORD_BUF_LEN);
+    s->rbuf = (unsigned char *)HAL_Malloc(STORE_RECORD_BUF_LEN);
+    if (NULL == s->wbuf || NULL == s->rbuf) {
+        LOG_ERROR("memory malloc failed!");
+        goto error;
+    }
+    if ((s->lock = HAL_MutexCreate()) == NULL) {
+        LOG_ERROR("create mqtt store lock failed.");
+        goto error;
+    }
+
+    ret = _store_recover(s);
+    if (SUCCESS_RET != ret) {
+        LOG_ERROR("recover mqtt store failed: %d", ret);
+        goto error;
+    }
+    LOG_INFO("mqtt store %s recovered, %u messages pending", s->partition, s->records);
+
+    s->next = sg_store_list;
+    sg_store_list = s;
+    pClient->store = s;
+    return SUCCESS_RET;
+
+error:
+    if (s->lock) {
+        HAL_MutexDestroy(s->lock);
+    }
+    HAL_Free(s->wbuf);
+    HAL_Free(s->rbuf);
+    HAL_Free(s->partition);
+    HAL_Free(s);
+    return FAILURE_RET;
+}
+
+void uiot_mqtt_store_deinit(UIoT_Client *pClient)
+{
+    UIoTStore *s;
+
+    if (NULL == pClient || NULL == pClient->store) {
+        return;
+    }
+
+    s = pClient->store;
+    pClient->store = NULL;
+    _store_unlink(s);
+
+    HAL_MutexDestroy(s->lock);
+    HAL_Free(s->wbuf);
+    HAL_Free(s->rbuf);
+    HAL_Free(s->partition);
+    HAL_Free(s);
+}
+
+bool uiot_mqtt_store_should_queue(UIoT_Client *pClient, uint8_t priority)
+{
+    if (NULL == pClient || NULL == pClient->store) {
+        return false;
+    }
+
+    if (!get_client_conn_state(pClient)) {
+        return true;
+    }
+
+    /* 存储中还有消息时新消息也写入存储, 保证补发的消息先于新消息发出; 关键消息不受此限制 */
+    return MQTT_PRIORITY_CRITICAL != priority && _store_pending(pClient->store);
+}
+
+int uiot_mqtt_store_push(UIoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pClient->store, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
+    STRING_PTR_VALID_CHECK(topicName, ERR_PARAM_INVALID);
+
+    UIoTStore *s = pClient->store;
+    unsigned char *body = s->wbuf + STORE_RECORD_HDR_LEN;
+    size_t topicLen = strlen(topicName);
+    int ret;
+
+    if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
+        return ERR_MAX_TOPIC_LENGTH;
+    }
+
+    if (pParams->qos == QOS2) {
+        LOG_ERROR("QoS2 is not supported currently");
+        return ERR_MQTT_QOS_NOT_SUPPORT;
+    }
+
+    if (topicLen + pParams->payload_len > UIOT_MQTT_STORE_RECORD_MAX) {
+        LOG_ERROR("message too long for mqtt store: %u", (uint32_t)(topicLen + pParams->payload_len));
+        return ERR_MQTT_BUFFER_TOO_SHORT;
+    }
+
+    HAL_MutexLock(s->lock);
+    body[0] = STORE_RECORD_PUBLISH;
+    body[1] = (unsigned char)pParams->qos;
+    body[2] = pParams->retained;
+    body[3] = (pParams->priority < MQTT_PRIORITY_MAX) ? pParams->priority : MQTT_PRIORITY_NORMAL;
+    _store_put_u16(body + 4, (uint16_t)topicLen);
+    memcpy(body + STORE_PUBLISH_HDR_LEN, topicName, topicLen);
+    if (pParams->payload_len > 0) {
+        memcpy(body + STORE_PUBLISH_HDR_LEN + topicLen, pParams->payload, pParams->payload_len);
+    }
+
+    ret = _store_append(s, (uint32_t)(STORE_PUBLISH_HDR_LEN + topicLen + pParams->payload_len));
+    if (ret > 0) {
+        s->records++;
+        s->bytes += ret;
+        ret = SUCCESS_RET;
+    }
+    HAL_MutexUnlock(s->lock);
+
+    return ret;
+}
+
+/* 补发存储中最早的一条消息, 返回1表示消息已从存储中移除, 可以接着补发下一条 */
+static int _store_drain_one(UIoT_Client *pClient)
+{
+    UIoTStore *s = pClient->store;
+    char topic[MAX_SIZE_OF_CLOUD_TOPIC + 1];
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    uint32_t body_len = 0;
+    uint32_t wait_ms;
+    uint16_t topicLen;
+    int ret;
+
+    HAL_MutexLock(s->lock);
+    ret = _store_peek(s, &body_len);
+    HAL_MutexUnlock(s->lock);
+    if (ret <= 0) {
+        return 0;
+    }
+
+    /* rbuf只由Yield所在线程访问, 发送期间不需要持锁 */
+    topicLen = _store_get_u16(s->rbuf + 4);
+    if (0 == topicLen || topicLen > MAX_SIZE_OF_CLOUD_TOPIC || STORE_PUBLISH_HDR_LEN + topicLen > body_len) {
+        LOG_ERROR("invalid message in mqtt store, skip it");
+        HAL_MutexLock(s->lock);
+        _store_pop(s);
+        HAL_MutexUnlock(s->lock);
+        return 1;
+    }
+    memcpy(topic, s->rbuf + STORE_PUBLISH_HDR_LEN, topicLen);
+    topic[topicLen] = '\0';
+
+    params.qos = (QoS)s->rbuf[1];
+    params.retained = s->rbuf[2];
+    params.priority = (s->rbuf[3] < MQTT_PRIORITY_MAX) ? s->rbuf[3] : MQTT_PRIORITY_NORMAL;
+    params.payload = s->rbuf + STORE_PUBLISH_HDR_LEN + topicLen;
+    params.payload_len = body_len - STORE_PUBLISH_HDR_LEN - topicLen;
+
+    /* QoS0消息发出即从存储中移除, 流水线连接可能被拒绝, 等收到CONNACK后再补发 */
+    if (QOS0 == params.qos && pClient->connack_pending) {
+        return 0;
+    }
+
+    /* 补发同样受速率限制, 令牌不足时推迟到令牌恢复 */
+    wait_ms = uiot_mqtt_rate_poll(pClient, topic);
+    if (wait_ms > 0) {
+        countdown_ms(&s->drain_timer, Max(wait_ms, UIOT_MQTT_STORE_DRAIN_INTERVAL_MS));
+        return 0;
+    }
+
+    if (QOS0 == params.qos) {
+        ret = uiot_mqtt_publish_with_callback(pClient, topic, &params, NULL, NULL, 0);
+        if (ret < 0) {
+            uiot_mqtt_rate_refund(pClient, topic, false);
+            return 0;
+        }
+        HAL_MutexLock(s->lock);
+        _store_pop(s);
+        HAL_MutexUnlock(s->lock);
+        return 1;
+    }
+
+    /* QoS1消息收到PUBACK后才从存储中移除, 同一时刻只补发一条 */
+    s->in_flight = 1;
+    ret = uiot_mqtt_publish_with_callback(pClient, topic, &params, _store_on_complete, s, 0);
+    if (ret < 0) {
+        s->in_flight = 0;
+        uiot_mqtt_rate_refund(pClient, topic, false);
+    }
+
+    return 0;
+}
+
+void uiot_mqtt_store_drain(UIoT_Client *pClient)
+{
+    UIoTStore *s = pClient->store;
+
+    if (NULL == s || s->in_flight || !_store_pending(s) || !has_expired(&s->drain_timer)) {
+        return;
+    }
+
+    /* 间歇连接模式的连接时间有限, 不按间隔补发: QoS0消息连续发出, QoS1消息收到PUBACK后立即补发下一条 */
+    if (pClient->duty.enabled) {
+        countdown_ms(&s->drain_timer, 0);
+        while (_store_drain_one(pClient) > 0 && _store_pending(s) && get_client_conn_state(pClient)) {
+        }
+        return;
+    }
+
+    countdown_ms(&s->drain_timer, UIOT_MQTT_STORE_DRAIN_INTERVAL_MS);
+    _store_drain_one(pClient);
+}
+
+#else
+
+int uiot_mqtt_store_init(UIoT_Client *pClient, const char *partition)
+{
+    return SUCCESS_RET;
+}
+
+void uiot_mqtt_store_deinit(UIoT_Client *pClient)
+{
+}
+
+bool uiot_mqtt_store_should_queue(UIoT_Client *pClient, uint8_t priority)
+{
+    return false;
+}
+
+int uiot_mqtt_store_push(UIoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    return ERR_MQTT_NO_CONN;
+}
+
+void uiot_mqtt_store_drain(UIoT_Client *pClient)
+{
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,16 +23,21 @@ extern "C" {
 
 /**
   * Determines the length of the MQTT subscribe packet that would be produced using the supplied parameters
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param count the number of topic filter strings in topicFilters
   * @param topicFilters the array of topic filter strings to be used in the publish
   * @return the length of buffer needed to contain the serialized version of the packet
   */
-static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilters) {
+static uint32_t _get_subscribe_packet_rem_len(uint8_t mqtt_version, uint32_t count, char **topicFilters) {
     size_t i;
     size_t len = 2; /* packetid */
 
+    if (MQTT_5_0 == mqtt_version) {
+        len += 1; /* properties length */
+    }
+
     for (i = 0; i < count; ++i) {
-        len += 2 + strlen(*topicFilters + i) + 1; /* length + topic + req_qos */
+        len += 2 + strlen(topicFilters[i]) + 1; /* length + topic + req_qos */
     }
 
     return (uint32_t) len;
@@ -42,6 +47,7 @@ static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilter
   * Serializes the supplied subscribe data into the supplied buffer, ready for sending
   * @param buf the buffer into which the packet will be serialized
   * @param buf_len the length in bytes of the supplied buffer
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param dup integer - the MQTT dup flag
   * @param packet_id integer - the MQTT packet identifier
   * @param count - number of members in the topicFilters and reqQos arrays
@@ -49,8 +55,9 @@ static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilter
   * @param requestedQoSs - array of requested QoS
   * @return the length of the serialized data.  <= 0 indicates error
   */
-static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8_t dup, uint16_t packet_id, uint32_t count,
-                                char **topicFilters, QoS *requestedQoSs, uint32_t *serialized_len) {
+static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8_t mqtt_version, uint8_t dup,
+                                       uint16_t packet_id, uint32_t count, char **topicFilters, QoS *requestedQoSs,
+                                       uint32_t *serialized_len) {
     POINTER_VALID_CHECK(buf, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(serialized_len, ERR_PARAM_INVALID);
 
@@ -61,7 +68,7 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     int ret;
 
     // SUBSCRIBE报文的剩余长度 = 报文标识符(2 byte) + count * (长度字段(2 byte) + topicLen + qos(1 byte))
-    rem_len = _get_subscribe_packet_rem_len(count, topicFilters);
+    rem_len = _get_subscribe_packet_rem_len(mqtt_version, count, topicFilters);
     if (get_mqtt_packet_len(rem_len) > buf_len) {
         return ERR_MQTT_BUFFER_TOO_SHORT;
     }
@@ -76,9 +83,13 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     ptr += mqtt_write_packet_rem_len(ptr, rem_len);
     // 写可变头部: 报文标识符
     mqtt_write_uint_16(&ptr, packet_id);
+    // MQTT 5.0 可变头部: 属性长度, 不携带属性; 订阅选项的低两位为QoS, 其余选项使用默认值
+    if (MQTT_5_0 == mqtt_version) {
+        mqtt_write_char(&ptr, 0);
+    }
     // 写报文的负载部分数据
     for (i = 0; i < count; ++i) {
-        mqtt_write_utf8_string(&ptr, *topicFilters + i);
+        mqtt_write_utf8_string(&ptr, topicFilters[i]);
         mqtt_write_char(&ptr, (unsigned char) requestedQoSs[i]);
     }
 
@@ -87,89 +98,134 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     return SUCCESS_RET;
 }
 
-int uiot_mqtt_subscribe(UIoT_Client *pClient, char *topicFilter, SubscribeParams *pParams) {
+/**
+ * @brief 从 sub ACK 等待列表中移除本次订阅添加的节点
+ */
+static void _remove_sub_info_nodes(UIoT_Client *pClient, ListNode **nodes, uint32_t count) {
+    uint32_t i;
+
+    HAL_MutexLock(pClient->lock_list_sub);
+    for (i = 0; i < count; ++i) {
+        list_remove(pClient->list_sub_wait_ack, nodes[i]);
+    }
+    HAL_MutexUnlock(pClient->lock_list_sub);
+}
+
+int uiot_mqtt_subscribe_many(UIoT_Client *pClient, char **topicFilters, SubscribeParams *pParams, uint32_t count) {
     int ret;
 
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(topicFilters, ERR_PARAM_INVALID);
     POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
-    STRING_PTR_VALID_CHECK(topicFilter, ERR_PARAM_INVALID);
+    if (0 == count || count > MAX_SUB_TOPICS) {
+        return ERR_PARAM_INVALID;
+    }
 
     Timer timer;
     uint32_t len = 0;
     uint16_t packet_id = 0;
+    uint32_t i;
+    char *topic_filter_stored[MAX_SUB_TOPICS] = {NULL};
+    QoS qos[MAX_SUB_TOPICS];
+    ListNode *node[MAX_SUB_TOPICS] = {NULL};
 
-    ListNode *node = NULL;
-    
-    size_t topicLen = strlen(topicFilter);
-    if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
-        return ERR_MAX_TOPIC_LENGTH;
-    }
+    for (i = 0; i < count; ++i) {
+        STRING_PTR_VALID_CHECK(topicFilters[i], ERR_PARAM_INVALID);
+
+        if (strlen(topicFilters[i]) > MAX_SIZE_OF_CLOUD_TOPIC) {
+            return ERR_MAX_TOPIC_LENGTH;
+        }
 
-    if (pParams->qos == QOS2) {
-        LOG_ERROR("QoS2 is not supported currently");
-        return ERR_MQTT_QOS_NOT_SUPPORT;
+        qos[i] = pParams[i].qos;
     }
     
     if (!get_client_conn_state(pClient)) {
+        /* 间歇连接模式休眠期间的订阅在下一次连接时发出 */
+        if (pClient->duty.enabled) {
+            return uiot_mqtt_duty_defer_subscribe(pClient, topicFilters, pParams, count);
+        }
         return ERR_MQTT_NO_CONN;
     }
 
     /* topic filter should be valid in the whole sub life */
-    char *topic_filter_stored = HAL_Malloc(topicLen + 1);
-    if (topic_filter_stored == NULL) {
-        LOG_ERROR("malloc failed");
-        return FAILURE_RET;
+    for (i = 0; i < count; ++i) {
+        size_t topicLen = strlen(topicFilters[i]);
+        topic_filter_stored[i] = HAL_Malloc(topicLen + 1);
+        if (topic_filter_stored[i] == NULL) {
+            LOG_ERROR("malloc failed");
+            ret = FAILURE_RET;
+            goto free_topics;
+        }
+        strcpy(topic_filter_stored[i], topicFilters[i]);
+        topic_filter_stored[i][topicLen] = 0;
     }
     
-    strcpy(topic_filter_stored, topicFilter);
-    topic_filter_stored[topicLen] = 0;
-    
     init_timer(&timer);
     countdown_ms(&timer, pClient->command_timeout_ms);
 
     HAL_MutexLock(pClient->lock_write_buf);
-    // 序列化SUBSCRIBE报文
-    packet_id = get_next_packet_id(pClient);
-    LOG_DEBUG("topicName=%s|packet_id=%d|Userdata=%s\n", topic_filter_stored, packet_id, (char *)pParams->user_data);
-
-    ret = _serialize_subscribe_packet(pClient->write_buf, pClient->write_buf_size, 0, packet_id, 1, &topic_filter_stored,
-                                     &pParams->qos, &len);
+    // 序列化SUBSCRIBE报文, 所有主题放在同一个报文中
+    ret = uiot_mqtt_write_buf_reserve(pClient,
+                                      get_mqtt_packet_len(_get_subscribe_packet_rem_len(pClient->options.mqtt_version,
+                                                                                        count, topic_filter_stored)));
     if (SUCCESS_RET != ret) {
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
     }
-
-    /* 等待 sub ack 列表中添加元素 */
-    SubTopicHandle sub_handle;
-    sub_handle.topic_filter = topic_filter_stored;
-    sub_handle.message_handler = pParams->on_message_handler;
-    sub_handle.qos = pParams->qos;
-    sub_handle.message_handler_data = pParams->user_data;
-
-    ret = push_sub_info_to(pClient, len, (unsigned int)packet_id, SUBSCRIBE, &sub_handle, &node);
+    packet_id = get_next_packet_id(pClient);
+    ret = _serialize_subscribe_packet(pClient->write_buf, pClient->write_buf_size, pClient->options.mqtt_version, 0,
+                                      packet_id, count, topic_filter_stored, qos, &len);
     if (SUCCESS_RET != ret) {
-        LOG_ERROR("push publish into to pubInfolist failed!");
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
+    }
+
+    /* 等待 sub ack 列表中按主题顺序添加元素, SUBACK中的返回码按相同顺序对应 */
+    for (i = 0; i < count; ++i) {
+        LOG_DEBUG("topicName=%s|packet_id=%d|Userdata=%s\n", topic_filter_stored[i], packet_id, (char *)pParams[i].user_data);
+
+        SubTopicHandle sub_handle;
+        sub_handle.topic_filter = topic_filter_stored[i];
+        sub_handle.message_handler = pParams[i].on_message_handler;
+        sub_handle.qos = pParams[i].qos;
+        sub_handle.message_handler_data = pParams[i].user_data;
+        sub_handle.chunk_handler = pParams[i].on_chunk_handler;
+        sub_handle.manual_ack = pParams[i].manual_ack;
+
+        /* 报文内容只需随第一个节点保存一份 */
+        ret = push_sub_info_to(pClient, (0 == i) ? len : 0, (unsigned int)packet_id, SUBSCRIBE, &sub_handle, &node[i]);
+        if (SUCCESS_RET != ret) {
+            LOG_ERROR("push publish into to pubInfolist failed!");
+            _remove_sub_info_nodes(pClient, node, i);
+            HAL_MutexUnlock(pClient->lock_write_buf);
+            goto free_topics;
+        }
     }
     
     // 发送SUBSCRIBE报文
     ret = send_mqtt_packet(pClient, len, &timer);
     if (SUCCESS_RET != ret) {
-        HAL_MutexLock(pClient->lock_list_sub);
-        list_remove(pClient->list_sub_wait_ack, node);
-        HAL_MutexUnlock(pClient->lock_list_sub);
-
+        _remove_sub_info_nodes(pClient, node, count);
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
     }
 
     HAL_MutexUnlock(pClient->lock_write_buf);
 
     return packet_id;
+
+free_topics:
+    for (i = 0; i < count; ++i) {
+        HAL_Free(topic_filter_stored[i]);
+    }
+    return ret;
+}
+
+int uiot_mqtt_subscribe(UIoT_Client *pClient, char *topicFilter, SubscribeParams *pParams) {
+    POINTER_VALID_CHECK(pParams, ERR_PARAM_INVALID);
+    STRING_PTR_VALID_CHECK(topicFilter, ERR_PARAM_INVALID);
+
+    return uiot_mqtt_subscribe_many(pClient, &topicFilter, pParams, 1);
 }
 
 int uiot_mqtt_resubscribe(UIoT_Client *pClient) {
@@ -178,29 +234,47 @@ int uiot_mqtt_resubscribe(UIoT_Client *pClient) {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
 
     uint32_t itr = 0;
-    char *topic = NULL;
-    SubscribeParams temp_param;
+    uint32_t count = 0;
+    char *topics[MAX_SUB_TOPICS];
+    SubscribeParams temp_params[MAX_SUB_TOPICS];
 
     if (!get_client_conn_state(pClient)) {
         return ERR_MQTT_NO_CONN;
     }
 
     for (itr = 0; itr < MAX_SUB_TOPICS; itr++) {
-        topic = (char *) pClient->sub_handles[itr].topic_filter;
-        if (topic == NULL) {
+        if (pClient->sub_handles[itr].topic_filter == NULL) {
             continue;
         }
-        temp_param.on_message_handler = pClient->sub_handles[itr].message_handler;
-        temp_param.qos = pClient->sub_handles[itr].qos;
-        temp_param.user_data = pClient->sub_handles[itr].message_handler_data;
-
-        ret = uiot_mqtt_subscribe(pClient, topic, &temp_param);
-        if (ret < 0) {
-            LOG_ERROR("resubscribe failed %d, topic: %s", ret, topic);
-            return ret;
+        topics[count] = (char *) pClient->sub_handles[itr].topic_filter;
+        temp_params[count].on_message_handler = pClient->sub_handles[itr].message_handler;
+        temp_params[count].qos = pClient->sub_handles[itr].qos;
+        temp_params[count].user_data = pClient->sub_handles[itr].message_handler_data;
+        temp_params[count].on_chunk_handler = pClient->sub_handles[itr].chunk_handler;
+        temp_params[count].manual_ack = pClient->sub_handles[itr].manual_ack;
+        count++;
+    }
+
+    if (0 == count) {
+        return SUCCESS_RET;
+    }
+
+    // 所有主题放在一个SUBSCRIBE报文中重新订阅, 发送缓冲区放不下时逐个订阅
+    ret = uiot_mqtt_subscribe_many(pClient, topics, temp_params, count);
+    if (ret == ERR_MQTT_BUFFER_TOO_SHORT) {
+        for (itr = 0; itr < count; itr++) {
+            ret = uiot_mqtt_subscribe(pClient, topics[itr], &temp_params[itr]);
+            if (ret < 0) {
+                break;
+            }
         }
     }
 
+    if (ret < 0) {
+        LOG_ERROR("resubscribe failed %d", ret);
+        return ret;
+    }
+
     return SUCCESS_RET;
 }
 
@@ -23,16 +23,21 @@ extern "C" {
 
 /**
   * Determines the length of the MQTT unsubscribe packet that would be produced using the supplied parameters
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param count the number of topic filter strings in topicFilters
   * @param topicFilters the array of topic filter strings to be used in the publish
   * @return the length of buffer needed to contain the serialized version of the packet
   */
-static uint32_t _get_unsubscribe_packet_rem_len(uint32_t count, char **topicFilters) {
+static uint32_t _get_unsubscribe_packet_rem_len(uint8_t mqtt_version, uint32_t count, char **topicFilters) {
     size_t i;
     size_t len = 2; /* packetid */
 
+    if (MQTT_5_0 == mqtt_version) {
+        len += 1; /* properties length */
+    }
+
     for (i = 0; i < count; ++i) {
-        len += 2 + strlen(*topicFilters + i); /* length + topic*/
+        len += 2 + strlen(topicFilters[i]); /* length + topic*/
     }
 
     return (uint32_t) len;
@@ -42,6 +47,7 @@ static uint32_t _get_unsubscribe_packet_rem_len(uint32_t count, char **topicFilt
   * Serializes the supplied unsubscribe data into the supplied buffer, ready for sending
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
   * @param buf_len the length in bytes of the data in the supplied buffer
+  * @param mqtt_version the MQTT protocol version of the connection
   * @param dup integer - the MQTT dup flag
   * @param packet_id integer - the MQTT packet identifier
   * @param count - number of members in the topicFilters array
@@ -49,7 +55,7 @@ static uint32_t _get_unsubscribe_packet_rem_len(uint32_t count, char **topicFilt
   * @param serialized_len - the length of the serialized data
   * @return int indicating function execution status
   */
-static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len,
+static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len, uint8_t mqtt_version,
                                          uint8_t dup, uint16_t packet_id,
                                          uint32_t count, char **topicFilters,
                                          uint32_t *serialized_len) {
@@ -62,7 +68,7 @@ static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len,
     uint32_t i = 0;
     int ret;
 
-    rem_len = _get_unsubscribe_packet_rem_len(count, topicFilters);
+    rem_len = _get_unsubscribe_packet_rem_len(mqtt_version, count, topicFilters);
     if (get_mqtt_packet_len(rem_len) > buf_len) {
         return ERR_MQTT_BUFFER_TOO_SHORT;
     }
@@ -77,8 +83,12 @@ static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len,
 
     mqtt_write_uint_16(&ptr, packet_id);
 
+    if (MQTT_5_0 == mqtt_version) {
+        mqtt_write_char(&ptr, 0); /* properties length */
+    }
+
     for (i = 0; i < count; ++i) {
-        mqtt_write_utf8_string(&ptr, *topicFilters + i);
+        mqtt_write_utf8_string(&ptr, topicFilters[i]);
     }
 
     *serialized_len = (uint32_t) (ptr - buf);
@@ -86,42 +96,58 @@ static int _serialize_unsubscribe_packet(unsigned char *buf, size_t buf_len,
     return SUCCESS_RET;
 }
 
-int uiot_mqtt_unsubscribe(UIoT_Client *pClient, char *topicFilter) {
+int uiot_mqtt_unsubscribe_many(UIoT_Client *pClient, char **topicFilters, uint32_t count) {
     int ret;
 
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
-    STRING_PTR_VALID_CHECK(topicFilter, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(topicFilters, ERR_PARAM_INVALID);
+    if (0 == count || count > MAX_SUB_TOPICS) {
+        return ERR_PARAM_INVALID;
+    }
 
     int i = 0;
+    uint32_t j = 0;
     Timer timer;
     uint32_t len = 0;
     uint16_t packet_id = 0;
     bool suber_exists = false;
+    char *topic_filter_stored[MAX_SUB_TOPICS] = {NULL};
+    ListNode *node[MAX_SUB_TOPICS] = {NULL};
 
-    ListNode *node = NULL;
+    for (j = 0; j < count; ++j) {
+        STRING_PTR_VALID_CHECK(topicFilters[j], ERR_PARAM_INVALID);
 
-    size_t topicLen = strlen(topicFilter);
-    if (topicLen > MAX_SIZE_OF_CLOUD_TOPIC) {
-        return ERR_MAX_TOPIC_LENGTH;
+        if (strlen(topicFilters[j]) > MAX_SIZE_OF_CLOUD_TOPIC) {
+            return ERR_MAX_TOPIC_LENGTH;
+        }
     }
     
     /* Remove from message handler array */
     HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_SUB_TOPICS; ++i) {        
-        if ((pClient->sub_handles[i].topic_filter != NULL && !strcmp(pClient->sub_handles[i].topic_filter, topicFilter))
-            || strstr(topicFilter,"/#") != NULL || strstr(topicFilter,"/+") != NULL) {
-            /* Free the topic filter malloced in uiot_mqtt_subscribe */
-            HAL_Free((void *)pClient->sub_handles[i].topic_filter);
-            pClient->sub_handles[i].topic_filter = NULL;
-            /* We don't want to break here, if the same topic is registered
-             * with 2 callbacks. Unlikely scenario */
+    for (j = 0; j < count; ++j) {
+        for (i = 0; i < MAX_SUB_TOPICS; ++i) {        
+            if ((pClient->sub_handles[i].topic_filter != NULL && !strcmp(pClient->sub_handles[i].topic_filter, topicFilters[j]))
+                || strstr(topicFilters[j],"/#") != NULL || strstr(topicFilters[j],"/+") != NULL) {
+                /* Free the topic filter malloced in uiot_mqtt_subscribe */
+                HAL_Free((void *)pClient->sub_handles[i].topic_filter);
+                pClient->sub_handles[i].topic_filter = NULL;
+                /* We don't want to break here, if the same topic is registered
+                 * with 2 callbacks. Unlikely scenario */
+                suber_exists = true;
+            }
+        }
+        /* 间歇连接模式休眠期间保存的订阅还未发出, 直接取消 */
+        if (uiot_mqtt_duty_cancel_subscribe(pClient, topicFilters[j])) {
             suber_exists = true;
         }
     }
+    if (suber_exists) {
+        uiot_mqtt_sub_trie_rebuild(pClient);
+    }
     HAL_MutexUnlock(pClient->lock_generic);
 
     if (suber_exists == false) {
-        LOG_ERROR("subscription does not exists: %s", topicFilter);
+        LOG_ERROR("subscription does not exists: %s", topicFilters[0]);
         return ERR_MQTT_UNSUB_FAILED;
     }
 
@@ -130,55 +156,84 @@ int uiot_mqtt_unsubscribe(UIoT_Client *pClient, char *topicFilter) {
     }
 
     /* topic filter should be valid in the whole sub life */
-    char *topic_filter_stored = HAL_Malloc(topicLen + 1);
-    if (topic_filter_stored == NULL) {
-        LOG_ERROR("malloc failed");
-        return FAILURE_RET;
+    for (j = 0; j < count; ++j) {
+        size_t topicLen = strlen(topicFilters[j]);
+        topic_filter_stored[j] = HAL_Malloc(topicLen + 1);
+        if (topic_filter_stored[j] == NULL) {
+            LOG_ERROR("malloc failed");
+            ret = FAILURE_RET;
+            goto free_topics;
+        }
+        strcpy(topic_filter_stored[j], topicFilters[j]);
+        topic_filter_stored[j][topicLen] = 0;
     }
-    strcpy(topic_filter_stored, topicFilter);
-    topic_filter_stored[topicLen] = 0;
 
     init_timer(&timer);
     countdown_ms(&timer, pClient->command_timeout_ms);
 
     HAL_MutexLock(pClient->lock_write_buf);
-    packet_id = get_next_packet_id(pClient);
-    ret = _serialize_unsubscribe_packet(pClient->write_buf, pClient->write_buf_size, 0, packet_id, 1, &topic_filter_stored,
-                                       &len);
+    ret = uiot_mqtt_write_buf_reserve(pClient,
+                                      get_mqtt_packet_len(_get_unsubscribe_packet_rem_len(pClient->options.mqtt_version,
+                                                                                          count, topic_filter_stored)));
     if (SUCCESS_RET != ret) {
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
     }
-
-    SubTopicHandle sub_handle;
-    sub_handle.topic_filter = topic_filter_stored;
-    sub_handle.message_handler = NULL;
-    sub_handle.message_handler_data = NULL;
-
-    ret = push_sub_info_to(pClient, len, (unsigned int)packet_id, UNSUBSCRIBE, &sub_handle, &node);
+    packet_id = get_next_packet_id(pClient);
+    ret = _serialize_unsubscribe_packet(pClient->write_buf, pClient->write_buf_size, pClient->options.mqtt_version, 0,
+                                        packet_id, count, topic_filter_stored, &len);
     if (SUCCESS_RET != ret) {
-        LOG_ERROR("push publish into to pubInfolist failed: %d", ret);
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
+    }
+
+    for (j = 0; j < count; ++j) {
+        SubTopicHandle sub_handle;
+        sub_handle.topic_filter = topic_filter_stored[j];
+        sub_handle.message_handler = NULL;
+        sub_handle.message_handler_data = NULL;
+        sub_handle.chunk_handler = NULL;
+        sub_handle.manual_ack = 0;
+
+        ret = push_sub_info_to(pClient, (0 == j) ? len : 0, (unsigned int)packet_id, UNSUBSCRIBE, &sub_handle, &node[j]);
+        if (SUCCESS_RET != ret) {
+            LOG_ERROR("push publish into to pubInfolist failed: %d", ret);
+            break;
+        }
     }
 
     /* send the unsubscribe packet */
-    ret = send_mqtt_packet(pClient, len, &timer);
+    if (SUCCESS_RET == ret) {
+        ret = send_mqtt_packet(pClient, len, &timer);
+    }
     if (SUCCESS_RET != ret) {
         HAL_MutexLock(pClient->lock_list_sub);
-        list_remove(pClient->list_sub_wait_ack, node);
+        for (i = 0; i < (int)count; ++i) {
+            if (NULL != node[i]) {
+                list_remove(pClient->list_sub_wait_ack, node[i]);
+            }
+        }
         HAL_MutexUnlock(pClient->lock_list_sub);
 
         HAL_MutexUnlock(pClient->lock_write_buf);
-        HAL_Free(topic_filter_stored);
-        return ret;
+        goto free_topics;
     }
 
     HAL_MutexUnlock(pClient->lock_write_buf);
 
     return packet_id;
+
+free_topics:
+    for (j = 0; j < count; ++j) {
+        HAL_Free(topic_filter_stored[j]);
+    }
+    return ret;
+}
+
+int uiot_mqtt_unsubscribe(UIoT_Client *pClient, char *topicFilter) {
+    STRING_PTR_VALID_CHECK(topicFilter, ERR_PARAM_INVALID);
+
+    return uiot_mqtt_unsubscribe_many(pClient, &topicFilter, 1);
 }
 
 #ifdef __cplusplus
@@ -21,6 +21,9 @@ extern "C" {
 
 #define MQTT_PING_RETRY_TIMES   2
 
+/* 暂停读取网络数据期间检查是否可以恢复读取的周期, 单位:ms */
+#define MQTT_RX_PAUSED_POLL_MS  20
+
 static void _iot_disconnect_callback(UIoT_Client *pClient)
 {
     if (NULL != pClient->event_handler.h_fp) {
@@ -72,6 +75,53 @@ static int _handle_disconnect(UIoT_Client *pClient) {
     return ERR_MQTT_NO_CONN;
 }
 
+/**
+ * @brief 生成重连抖动使用的随机数(xorshift32), 以客户端标识和启动时间作为种子, 同一时刻断线的设备得到不同的序列
+ *
+ * @param pClient
+ * @return
+ */
+static uint32_t _reconnect_rand(UIoT_Client *pClient)
+{
+    uint32_t x = pClient->reconnect_rand;
+    const char *id = pClient->options.client_id;
+
+    if (0 == x) {
+        x = 2166136261u;
+        while (NULL != id && '\0' != *id) {
+            x = (x ^ (uint8_t)*id++) * 16777619u;
+        }
+        x ^= (uint32_t)HAL_UptimeMs();
+        if (0 == x) {
+            x = 1;
+        }
+    }
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pClient->reconnect_rand = x;
+
+    return x;
+}
+
+/**
+ * @brief 按当前退避时间上限启动重连定时器, 开启抖动时在[0, 上限]之间随机取值
+ *
+ * @param pClient
+ */
+static void _reconnect_delay_start(UIoT_Client *pClient)
+{
+    uint32_t delay_ms = pClient->current_reconnect_wait_interval;
+
+#if UIOT_MQTT_RECONNECT_JITTER
+    delay_ms = _reconnect_rand(pClient) % (delay_ms + 1);
+#endif
+
+    LOG_DEBUG("reconnect after %u ms", delay_ms);
+    countdown_ms(&(pClient->reconnect_delay_timer), delay_ms);
+}
+
 /**
  * @brief 处理自动重连的相关逻辑
  *
@@ -106,14 +156,63 @@ static int _handle_reconnect(UIoT_Client *pClient) {
             return ERR_MQTT_RECONNECT_TIMEOUT;
         }
     }
-    countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
+    _reconnect_delay_start(pClient);
 
     return ret;
 }
 
+void uiot_mqtt_keepalive_reset(UIoT_Client *pClient)
+{
+    uint16_t keep_alive = pClient->options.keep_alive_interval;
+
+#if UIOT_MQTT_KEEPALIVE_ADAPTIVE
+    /* 学习到的上限只会因探测失败而缩短, 不超过本次连接协商的心跳周期 */
+    if (0 == pClient->ping_interval_max || pClient->ping_interval_max > keep_alive) {
+        pClient->ping_interval_max = keep_alive;
+    }
+    if (0 == pClient->ping_interval) {
+        pClient->ping_interval = Min(UIOT_MQTT_KEEPALIVE_ADAPTIVE_MIN, keep_alive);
+    }
+    pClient->ping_interval = Min(pClient->ping_interval, pClient->ping_interval_max);
+#else
+    pClient->ping_interval = keep_alive;
+#endif
+
+    pClient->is_ping_outstanding = 0;
+    pClient->ping_probe = 0;
+    countdown(&pClient->ping_timer, pClient->ping_interval);
+    countdown(&pClient->rx_idle_timer, 2 * pClient->ping_interval);
+}
+
+/**
+ * @brief 自适应心跳探测失败, 认为NAT在当前心跳周期内回收了连接, 缩短心跳周期上限
+ *
+ * @param pClient
+ */
+static void _mqtt_keep_alive_probe_failed(UIoT_Client *pClient)
+{
+#if UIOT_MQTT_KEEPALIVE_ADAPTIVE
+    uint16_t floor = Min(UIOT_MQTT_KEEPALIVE_ADAPTIVE_MIN, pClient->options.keep_alive_interval);
+
+    if (!pClient->ping_probe || pClient->ping_interval <= floor) {
+        return;
+    }
+
+    pClient->ping_interval_max = (pClient->ping_interval > floor + UIOT_MQTT_KEEPALIVE_ADAPTIVE_STEP) ?
+                                 pClient->ping_interval - UIOT_MQTT_KEEPALIVE_ADAPTIVE_STEP : floor;
+    pClient->ping_interval = pClient->ping_interval_max;
+    LOG_WARN("keepalive probe at current interval failed, limit interval to %u s", pClient->ping_interval_max);
+#else
+    (void)pClient;
+#endif
+}
+
 /**
  * @brief 处理与服务器维持心跳的相关逻辑
  *
+ * 心跳周期内客户端发出过其他报文时, 服务器已能确认客户端在线, 无需再发送心跳包.
+ * 只发送QoS0消息时服务器没有回应, 连续两个心跳周期没有收到任何报文时仍发送心跳包检测链路.
+ *
  * @param pClient
  * @return
  */
@@ -122,6 +221,7 @@ static int _mqtt_keep_alive(UIoT_Client *pClient)
     int ret;
     Timer timer;
     uint32_t serialized_len = 0;
+    bool tx_idle;
 
     if (0 == pClient->options.keep_alive_interval) {
         return SUCCESS_RET;
@@ -131,15 +231,26 @@ static int _mqtt_keep_alive(UIoT_Client *pClient)
         return SUCCESS_RET;
     }
 
-    if (pClient->is_ping_outstanding >= MQTT_PING_RETRY_TIMES) {
+    /* 暂停读取期间收不到PINGRESP, 恢复读取后再判断连接是否正常 */
+    if (pClient->is_ping_outstanding >= MQTT_PING_RETRY_TIMES && !uiot_mqtt_rx_paused(pClient)) {
         //Reaching here means we haven't received any MQTT packet for a long time (keep_alive_interval)
         LOG_ERROR("Fail to recv MQTT msg. Something wrong with the connection.");
+        _mqtt_keep_alive_probe_failed(pClient);
         ret = _handle_disconnect(pClient);
         return ret;
     }
 
-    /* there is no ping outstanding - send one */    
     HAL_MutexLock(pClient->lock_write_buf);
+    tx_idle = has_expired(&pClient->tx_idle_timer);
+    if (0 == pClient->is_ping_outstanding && !tx_idle && !has_expired(&pClient->rx_idle_timer)) {
+        /* 推迟到最后一次发送满一个心跳周期时再检查 */
+        countdown_ms(&pClient->ping_timer, left_ms(&pClient->tx_idle_timer));
+        pClient->ping_suppressed++;
+        HAL_MutexUnlock(pClient->lock_write_buf);
+        return SUCCESS_RET;
+    }
+
+    /* there is no ping outstanding - send one */    
     ret = serialize_packet_with_zero_payload(pClient->write_buf, pClient->write_buf_size, PINGREQ, &serialized_len);
     if (SUCCESS_RET != ret) {
         HAL_MutexUnlock(pClient->lock_write_buf);
@@ -151,7 +262,7 @@ static int _mqtt_keep_alive(UIoT_Client *pClient)
     init_timer(&timer);    
     do {
         countdown_ms(&timer, pClient->command_timeout_ms);
-        ret = send_mqtt_packet(pClient, serialized_len, &timer);
+        ret = send_mqtt_packet_corked(pClient, serialized_len, &timer);
     } while (SUCCESS_RET != ret && (i++ < 3));
     
     if (SUCCESS_RET != ret) {
@@ -161,22 +272,246 @@ static int _mqtt_keep_alive(UIoT_Client *pClient)
         ret = _handle_disconnect(pClient);
         return ret;
     }
+    pClient->ping_sent++;
     HAL_MutexUnlock(pClient->lock_write_buf);
     
     HAL_MutexLock(pClient->lock_generic);
-    pClient->is_ping_outstanding++;
-    /* start a timer to wait for PINGRESP from server */
-    countdown(&pClient->ping_timer, Min(5, pClient->options.keep_alive_interval/2));
+    /* 链路双向空闲满一个心跳周期后发出的心跳包, 其结果用于自适应心跳的学习 */
+    if (0 == pClient->is_ping_outstanding) {
+        pClient->ping_probe = tx_idle;
+    }
+    if (uiot_mqtt_rx_paused(pClient)) {
+        /* 暂停读取期间只按心跳周期发送心跳包, 使服务器不因心跳超时断开连接 */
+        pClient->is_ping_outstanding = Min(pClient->is_ping_outstanding + 1, MQTT_PING_RETRY_TIMES);
+        countdown(&pClient->ping_timer, pClient->ping_interval);
+    } else {
+        pClient->is_ping_outstanding++;
+        /* start a timer to wait for PINGRESP from server */
+        countdown(&pClient->ping_timer, Min(5, pClient->ping_interval/2));
+    }
     HAL_MutexUnlock(pClient->lock_generic);
     LOG_DEBUG("PING request %u has been sent...", pClient->is_ping_outstanding);
 
     return SUCCESS_RET;
 }
 
+static uint32_t _timer_remain_ms(Timer *timer)
+{
+    int remain_ms;
+
+    if (has_expired(timer)) {
+        return 0;
+    }
+
+    remain_ms = left_ms(timer);
+    return (remain_ms > 0) ? (uint32_t)remain_ms : 0;
+}
+
+/**
+ * @brief 计算距离下一个定时事件(Yield超时, 心跳, 等待ACK超时, 重连)的时间, 在此之前没有数据到达时无需唤醒
+ *
+ * @param pClient
+ * @param timer    Yield的超时定时器
+ * @return         需要等待的时间, 单位:ms
+ */
+uint32_t uiot_mqtt_next_deadline_ms(UIoT_Client *pClient, Timer *timer)
+{
+    uint32_t wait_ms = _timer_remain_ms(timer);
+    UIoTPubInfo *repubInfo;
+
+    if (pClient->duty.enabled) {
+        wait_ms = Min(wait_ms, uiot_mqtt_duty_deadline_ms(pClient));
+    }
+
+    if (!get_client_conn_state(pClient)) {
+        if (pClient->duty.enabled) {
+            return wait_ms;
+        }
+        return Min(wait_ms, _timer_remain_ms(&(pClient->reconnect_delay_timer)));
+    }
+
+    /* 暂停读取期间应用可能在其他线程中回复消息, 按固定周期检查, 其他定时事件在检查时一并处理 */
+    if (uiot_mqtt_rx_paused(pClient)) {
+        return Min(wait_ms, MQTT_RX_PAUSED_POLL_MS);
+    }
+
+    if (0 != pClient->options.keep_alive_interval) {
+        wait_ms = Min(wait_ms, _timer_remain_ms(&pClient->ping_timer));
+    }
+
+    HAL_MutexLock(pClient->lock_list_pub);
+    repubInfo = uiot_mqtt_pub_window_next_expiry(&pClient->pub_window);
+    if (NULL != repubInfo) {
+        wait_ms = Min(wait_ms, _timer_remain_ms(&repubInfo->pub_start_time));
+    }
+    HAL_MutexUnlock(pClient->lock_list_pub);
+
+    HAL_MutexLock(pClient->lock_list_sub);
+    if (NULL != pClient->list_sub_wait_ack->head && NULL != pClient->list_sub_wait_ack->head->val) {
+        UIoTSubInfo *sub_info = (UIoTSubInfo *) pClient->list_sub_wait_ack->head->val;
+        wait_ms = Min(wait_ms, _timer_remain_ms(&sub_info->sub_start_time));
+    }
+    HAL_MutexUnlock(pClient->lock_list_sub);
+
+    if (NULL != pClient->store && pClient->store->records > 0 && !pClient->store->in_flight) {
+        wait_ms = Min(wait_ms, _timer_remain_ms(&pClient->store->drain_timer));
+    }
+
+    /* 读取tx_batch_len不加锁, 最多使本次等待多等一个周期 */
+    if (pClient->tx_batch_len > 0) {
+        wait_ms = Min(wait_ms, _timer_remain_ms(&pClient->tx_batch_timer));
+    }
+
+    return wait_ms;
+}
+
+/**
+ * @brief 发送本轮处理中合并的小报文(PUBACK, PINGREQ等)
+ *
+ * @param pClient
+ * @return
+ */
+static int _mqtt_batch_flush(UIoT_Client *pClient)
+{
+    Timer timer;
+    int ret;
+
+    if (0 == pClient->tx_batch_len) {
+        return SUCCESS_RET;
+    }
+
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    ret = uiot_mqtt_batch_flush(pClient, &timer);
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    if (SUCCESS_RET != ret) {
+        LOG_ERROR("Fail to send batched packets. Something wrong with the connection.");
+        return _handle_disconnect(pClient);
+    }
+
+    return SUCCESS_RET;
+}
+
+/**
+ * @brief 读取并处理已到达的报文, 然后处理ACK超时, 心跳和合并发送等定时事件
+ *
+ * @param pClient
+ * @param timer         Yield的超时定时器
+ * @param readable      等待网络数据的结果, <0: 网络错误; =0: 没有数据到达; >0: 有数据可读
+ * @return
+ */
+static int _mqtt_process(UIoT_Client *pClient, Timer *timer, int readable)
+{
+    int ret = readable;
+    uint8_t packet_type;
+
+    if (readable > 0) {
+        // 预读缓冲区中还有完整到达的报文时一并处理, 避免每个报文都重新等待一次
+        do {
+            ret = cycle_for_read(pClient, timer, &packet_type, 0);
+        } while (ret == SUCCESS_RET && !uiot_mqtt_rx_paused(pClient)
+                 && utils_net_ring_pending(&(pClient->network_stack)) > 0);
+    } else if (readable == 0) {
+        ret = SUCCESS_RET;
+    }
+
+    if (ret == SUCCESS_RET) {
+        /* check list of wait publish ACK to remove node that is ACKED or timeout */
+        uiot_mqtt_pub_info_proc(pClient);
+
+        /* check list of wait subscribe(or unsubscribe) ACK to remove node that is ACKED or timeout */
+        uiot_mqtt_sub_info_proc(pClient);
+
+        /* 为大报文扩展的缓冲区空闲一段时间后收缩回初始长度 */
+        uiot_mqtt_buf_shrink_idle(pClient);
+
+        /* 补发离线存储中的消息 */
+        uiot_mqtt_store_drain(pClient);
+
+        ret = _mqtt_keep_alive(pClient);
+        if (ret == SUCCESS_RET) {
+            ret = _mqtt_batch_flush(pClient);
+        }
+    }
+    else if (ret == ERR_SSL_READ_TIMEOUT || ret == ERR_SSL_READ_FAILED ||
+             ret == ERR_TCP_PEER_SHUTDOWN || ret == ERR_TCP_READ_FAILED){
+        LOG_ERROR("network read failed, ret: %d. MQTT Disconnect.", ret);
+        ret = _handle_disconnect(pClient);
+    }
+    else if(ret == FAILURE_RET) //最后一次读肯定失败,因为没有数据了
+    {
+        ret = SUCCESS_RET;
+    }
+
+    if (ret == ERR_MQTT_NO_CONN) {
+        pClient->counter_network_disconnected++;
+
+        if (pClient->options.auto_connect_enable == 1) {
+            pClient->current_reconnect_wait_interval = MIN_RECONNECT_WAIT_INTERVAL;
+            _reconnect_delay_start(pClient);
+
+            // 如果超时时间到了,则会直接返回
+            ret = ERR_MQTT_ATTEMPTING_RECONNECT;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief 间歇连接模式的一轮处理: 休眠期间按唤醒条件连接, 连接期间处理报文, 消息补发完成后断开
+ *
+ * @param pClient
+ * @param timer         Yield的超时定时器
+ * @param readable      等待网络数据的结果
+ * @return
+ */
+static int _duty_yield_once(UIoT_Client *pClient, Timer *timer, int readable)
+{
+    if (get_client_conn_state(pClient)) {
+        return uiot_mqtt_duty_check(pClient, _mqtt_process(pClient, timer, readable));
+    }
+
+    if (pClient->was_manually_disconnected == 1) {
+        return MQTT_MANUALLY_DISCONNECTED;
+    }
+
+    return uiot_mqtt_duty_begin(pClient);
+}
+
+int uiot_mqtt_yield_once(UIoT_Client *pClient, Timer *timer, int readable) {
+    POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
+    POINTER_VALID_CHECK(timer, ERR_PARAM_INVALID);
+
+    if (pClient->duty.enabled) {
+        return _duty_yield_once(pClient, timer, readable);
+    }
+
+    if (get_client_conn_state(pClient)) {
+        return _mqtt_process(pClient, timer, readable);
+    }
+
+    if (pClient->was_manually_disconnected == 1) {
+        return MQTT_MANUALLY_DISCONNECTED;
+    }
+
+    if (pClient->options.auto_connect_enable == 0) {
+        return ERR_MQTT_NO_CONN;
+    }
+
+    if (pClient->current_reconnect_wait_interval > MAX_RECONNECT_WAIT_INTERVAL) {
+        return ERR_MQTT_RECONNECT_TIMEOUT;
+    }
+
+    return _handle_reconnect(pClient);
+}
+
 int uiot_mqtt_yield(UIoT_Client *pClient, uint32_t timeout_ms) {
     int ret = SUCCESS_RET;
     Timer timer;
-    uint8_t packet_type;
 
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
     NUMERIC_VALID_CHECK(timeout_ms, ERR_PARAM_INVALID);
@@ -186,8 +521,8 @@ int uiot_mqtt_yield(UIoT_Client *pClient, uint32_t timeout_ms) {
         return MQTT_MANUALLY_DISCONNECTED;
     }
 
-    // 2. 检查连接是否断开, 自动连接是否开启
-    if (!get_client_conn_state(pClient) && pClient->options.auto_connect_enable == 0) {
+    // 2. 检查连接是否断开, 自动连接是否开启; 间歇连接模式不依赖自动重连
+    if (!get_client_conn_state(pClient) && pClient->options.auto_connect_enable == 0 && !pClient->duty.enabled) {
         return ERR_MQTT_NO_CONN;
     }
 
@@ -197,62 +532,37 @@ int uiot_mqtt_yield(UIoT_Client *pClient, uint32_t timeout_ms) {
     // 3. 循环读取消息以及心跳包管理
     while (!has_expired(&timer)) {
         if (!get_client_conn_state(pClient)) {
-            if (pClient->current_reconnect_wait_interval > MAX_RECONNECT_WAIT_INTERVAL) {
-                ret = ERR_MQTT_RECONNECT_TIMEOUT;
+            ret = uiot_mqtt_yield_once(pClient, &timer, 0);
+            if (ret == ERR_MQTT_RECONNECT_TIMEOUT || ret == MQTT_MANUALLY_DISCONNECTED) {
                 break;
             }
-            ret = _handle_reconnect(pClient);
+            if (ret == ERR_MQTT_ATTEMPTING_RECONNECT || ret == MQTT_DUTY_CYCLE_SLEEPING) {
+                // 重连等待或间歇连接休眠期间休眠至下一次连接或Yield超时
+                HAL_SleepMs(uiot_mqtt_next_deadline_ms(pClient, &timer));
+            }
 
             continue;
         }        
 
-        //防止任务独占CPU时间过长
-        HAL_SleepMs(10);
-
-        ret = cycle_for_read(pClient, &timer, &packet_type, 0);
-
-        if (ret == SUCCESS_RET) {
-            /* check list of wait publish ACK to remove node that is ACKED or timeout */
-            uiot_mqtt_pub_info_proc(pClient);
-
-            /* check list of wait subscribe(or unsubscribe) ACK to remove node that is ACKED or timeout */
-            uiot_mqtt_sub_info_proc(pClient);
-
-            ret = _mqtt_keep_alive(pClient);
-        }          
-        else if (ret == ERR_SSL_READ_TIMEOUT || ret == ERR_SSL_READ_FAILED ||
-                 ret == ERR_TCP_PEER_SHUTDOWN || ret == ERR_TCP_READ_FAILED){
-            LOG_ERROR("network read failed, ret: %d. MQTT Disconnect.", ret);
-            ret = _handle_disconnect(pClient);
-        }
-        else if(ret == FAILURE_RET) //最后一次读肯定失败,因为没有数据了
-        {
-            ret = SUCCESS_RET;
+        if (uiot_mqtt_rx_paused(pClient)) {
+            // 等待应用回复的消息已达上限, 暂停读取, 由TCP流控使服务器减缓下发
+            HAL_SleepMs(uiot_mqtt_next_deadline_ms(pClient, &timer));
+            ret = 0;
+        } else {
+            ret = utils_net_wait_readable(&(pClient->network_stack), uiot_mqtt_next_deadline_ms(pClient, &timer));
         }
+        ret = uiot_mqtt_yield_once(pClient, &timer, ret);
 
-        if (ret == ERR_MQTT_NO_CONN) {
-            pClient->counter_network_disconnected++;
-
-            if (pClient->options.auto_connect_enable == 1) {
-                pClient->current_reconnect_wait_interval = MIN_RECONNECT_WAIT_INTERVAL;
-                countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
-
-                // 如果超时时间到了,则会直接返回
-                ret = ERR_MQTT_ATTEMPTING_RECONNECT;
-            } else {
-                break;
-            }
-        } else if (ret != SUCCESS_RET) {
+        if (ret != SUCCESS_RET && ret != ERR_MQTT_ATTEMPTING_RECONNECT && ret != MQTT_DUTY_CYCLE_SLEEPING) {
             break;
         }
-        
     }
 
     return ret;
 }
 
 /**
- * @brief puback等待超时检测
+ * @brief puback等待超时检测, 超时的消息重发, 重发UIOT_MQTT_RETRANS_MAX次后仍超时则通知发布超时
  *
  * @param pClient MQTTClient对象
  *
@@ -261,77 +571,65 @@ int uiot_mqtt_pub_info_proc(UIoT_Client *pClient)
 {
     POINTER_VALID_CHECK(pClient, ERR_PARAM_INVALID);
 
-    HAL_MutexLock(pClient->lock_list_pub);
-    do {
-        if (0 == pClient->list_pub_wait_ack->len) {
-            break;
-        }
+    UIoTPubInfo *repubInfo;
+    uint16_t msg_id;
+    OnPublishComplete on_complete;
+    void *complete_data;
+#if UIOT_MQTT_RETRANS_MAX > 0
+    Timer timer;
+    int ret;
 
-        ListIterator *iter;
-        ListNode *node = NULL;
-        ListNode *temp_node = NULL;
+    init_timer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+#endif
 
-        if (NULL == (iter = list_iterator_new(pClient->list_pub_wait_ack, LIST_TAIL))) {
-            LOG_ERROR("new list failed");
+    /* 重发需要使用发送缓冲区, 加锁顺序与发布时相同 */
+    HAL_MutexLock(pClient->lock_write_buf);
+    HAL_MutexLock(pClient->lock_list_pub);
+    while (pClient->is_connected) {
+        repubInfo = uiot_mqtt_pub_window_next_expiry(&pClient->pub_window);
+        if (NULL == repubInfo || left_ms(&repubInfo->pub_start_time) > 0) {
             break;
         }
 
-        for (;;) {
-            node = list_iterator_next(iter);
-
-            if (NULL != temp_node) {
-                list_remove(pClient->list_pub_wait_ack, temp_node);
-                temp_node = NULL;
-            }
-
-            if (NULL == node) {
-                break; /* end of list */
-            }
-
-            UIoTPubInfo *repubInfo = (UIoTPubInfo *) node->val;
-            if (NULL == repubInfo) {
-                LOG_ERROR("node's value is invalid!");
-                temp_node = node;
-                continue;
-            }
-
-            /* remove invalid node */
-            if (MQTT_NODE_STATE_INVALID == repubInfo->node_state) {
-                temp_node = node;
-                continue;
-            }
-
-            if (!pClient->is_connected) {
-                continue;
-            }
-
-            /* check the request if timeout or not */
-            if (left_ms(&repubInfo->pub_start_time) > 0) {
-                continue;
-            }
-
-            /* If wait ACK timeout, republish */
-            HAL_MutexUnlock(pClient->lock_list_pub);
-            /* 重发机制交给上层用户二次开发, 这里先把超时的节点从列表中移除 */
-            temp_node = node;
-
-            countdown_ms(&repubInfo->pub_start_time, pClient->command_timeout_ms);
-            HAL_MutexLock(pClient->lock_list_pub);
-
-                /* 通知外部网络已经断开 */
-            if (NULL != pClient->event_handler.h_fp) {
-                MQTTEventMsg msg;
-                msg.event_type = MQTT_EVENT_PUBLISH_TIMEOUT;
-                msg.msg = (void *)(uintptr_t)repubInfo->msg_id;
-                pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+#if UIOT_MQTT_RETRANS_MAX > 0
+        if (repubInfo->retries < UIOT_MQTT_RETRANS_MAX) {
+            repubInfo->retries++;
+            ret = uiot_mqtt_pub_resend(pClient, repubInfo, &timer);
+            if (SUCCESS_RET != ret) {
+                /* 连接异常, 由读取报文时处理断线, 未发出的消息重连后重发 */
+                LOG_ERROR("resend publish msg %u failed: %d", repubInfo->msg_id, ret);
+                break;
             }
+            continue;
         }
+#endif
 
-        list_iterator_destroy(iter);
+        msg_id = repubInfo->msg_id;
+        on_complete = repubInfo->on_complete;
+        complete_data = repubInfo->complete_data;
+        (void)uiot_mqtt_pub_window_release(&pClient->pub_window, msg_id);
+        HAL_MutexUnlock(pClient->lock_list_pub);
+        HAL_MutexUnlock(pClient->lock_write_buf);
 
-    } while (0);
+        if (NULL != on_complete) {
+            on_complete(pClient, msg_id, ERR_MQTT_REQUEST_TIMEOUT, complete_data);
+        }
+        uiot_mqtt_async_window_released(pClient);
+
+        /* 通知外部PUBLISH超时 */
+        if (NULL != pClient->event_handler.h_fp) {
+            MQTTEventMsg msg;
+            msg.event_type = MQTT_EVENT_PUBLISH_TIMEOUT;
+            msg.msg = (void *)(uintptr_t)msg_id;
+            pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
+        }
 
+        HAL_MutexLock(pClient->lock_write_buf);
+        HAL_MutexLock(pClient->lock_list_pub);
+    }
     HAL_MutexUnlock(pClient->lock_list_pub);
+    HAL_MutexUnlock(pClient->lock_write_buf);
 
     return SUCCESS_RET;
 }
@@ -360,6 +658,7 @@ int uiot_mqtt_sub_info_proc(UIoT_Client *pClient)
         ListNode *node = NULL;
         ListNode *temp_node = NULL;
         uint16_t packet_id = 0;
+        uint16_t last_timeout_id = 0;
         MessageTypes msg_type;
 
         if (NULL == (iter = list_iterator_new(pClient->list_sub_wait_ack, LIST_TAIL))) {
@@ -406,8 +705,8 @@ int uiot_mqtt_sub_info_proc(UIoT_Client *pClient)
             packet_id = sub_info->msg_id;
             msg_type = sub_info->type;
 
-            /* Wait MQTT SUBSCRIBE ACK timeout */
-            if (NULL != pClient->event_handler.h_fp) {
+            /* Wait MQTT SUBSCRIBE ACK timeout, 一个报文包含多个主题时只通知一次 */
+            if (NULL != pClient->event_handler.h_fp && packet_id != last_timeout_id) {
                 MQTTEventMsg msg;
 
                 if (SUBSCRIBE == msg_type) {
@@ -422,6 +721,7 @@ int uiot_mqtt_sub_info_proc(UIoT_Client *pClient)
 
                 pClient->event_handler.h_fp(pClient, pClient->event_handler.context, &msg);
             }
+            last_timeout_id = packet_id;
 
             if (NULL != sub_info->handler.topic_filter)
                 HAL_Free((void *)(sub_info->handler.topic_filter));
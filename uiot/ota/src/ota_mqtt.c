@@ -43,7 +43,8 @@ static int _ota_mqtt_gen_topic_name(char *buf, size_t buf_len, const char *ota_t
     FUNC_EXIT_RC(SUCCESS_RET);
 }
 
-static int _ota_mqtt_publish(OTA_MQTT_Struct_t *handle, const char *topic_type, int qos, const char *msg)
+static int _ota_mqtt_publish(OTA_MQTT_Struct_t *handle, const char *topic_type, int qos, MQTTPubPriority priority,
+                             const char *msg)
 {
     FUNC_ENTRY;
 
@@ -59,6 +60,7 @@ static int _ota_mqtt_publish(OTA_MQTT_Struct_t *handle, const char *topic_type,
     }
     pub_params.payload = (void *)msg;
     pub_params.payload_len = strlen(msg);
+    pub_params.priority = priority;
 
     ret = _ota_mqtt_gen_topic_name(topic_name, OTA_TOPIC_BUF_LEN, topic_type, handle->product_sn, handle->device_sn);
     if (ret < 0) {
@@ -159,14 +161,14 @@ int osc_deinit(void *handle)
     FUNC_EXIT_RC(SUCCESS_RET);
 }
 
-/* report progress of OTA */
+/* report progress of OTA, 进度上报频繁且可以丢失, 不占用其他消息的发送机会 */
 int osc_report_progress(void *handle, const char *msg)
 {
-    return _ota_mqtt_publish(handle, OTA_UPSTREAM_TOPIC_TYPE, QOS0, msg);
+    return _ota_mqtt_publish(handle, OTA_UPSTREAM_TOPIC_TYPE, QOS0, MQTT_PRIORITY_BULK, msg);
 }
 
 /* report version of firmware */
 int osc_upstream_publish(void *handle, const char *msg)
 {
-    return _ota_mqtt_publish(handle, OTA_UPSTREAM_TOPIC_TYPE, QOS1, msg);
+    return _ota_mqtt_publish(handle, OTA_UPSTREAM_TOPIC_TYPE, QOS1, MQTT_PRIORITY_NORMAL, msg);
 }
@@ -36,6 +36,7 @@ extern "C" {
 #endif
 
 typedef enum {
+    MQTT_DUTY_CYCLE_SLEEPING                          = 5,       // 表示间歇连接模式正在休眠, 与MQTT服务器断开
     MQTT_ALREADY_CONNECTED                            = 4,       // 表示与MQTT服务器已经建立连接
     MQTT_CONNECTION_ACCEPTED                          = 3,       // 表示服务器接受客户端MQTT连接
     MQTT_MANUALLY_DISCONNECTED                        = 2,       // 表示与MQTT服务器已经手动断开
@@ -76,6 +77,12 @@ typedef enum {
     ERR_MQTT_BUFFER_TOO_SHORT                         = -119,    // 表示消息接收缓冲区的长度小于消息的长度
     ERR_MQTT_QOS_NOT_SUPPORT                          = -120,    // 表示该QOS级别不支持
     ERR_MQTT_UNSUB_FAILED                             = -121,    // 表示取消订阅主题失败,比如该主题不存在
+    ERR_MQTT_ASYNC_QUEUE_FULL                         = -122,    // 表示异步发布队列已满
+    ERR_MQTT_GROUP_FULL                               = -123,    // 表示客户端组已满
+    ERR_MQTT_STORE_FAILED                             = -124,    // 表示离线消息读写flash失败
+    ERR_MQTT_PUB_NACK                                 = -125,    // 表示服务器拒绝了发布的消息(MQTT 5.0)
+    ERR_MQTT_ACK_INVALID                              = -126,    // 表示ack token无效或对应的消息已经回复
+    ERR_MQTT_RATE_LIMITED                             = -127,    // 表示发布速率超过限制, 消息被丢弃
 
     ERR_JSON_PARSE                                    = -132,    // 表示JSON解析错误
     ERR_JSON_BUFFER_TRUNCATED                         = -133,    // 表示JSON文档会被截断
@@ -23,6 +23,21 @@ extern "C" {
 /* MQTT心跳消息发送周期, 单位:s */
 #define UIOT_MQTT_KEEP_ALIVE_INTERNAL                               (240)
 
+/* 是否开启自适应心跳, 从较短的心跳周期开始逐步延长, 探测NAT回收空闲连接的时间, 最长不超过连接时协商的心跳周期 */
+#define UIOT_MQTT_KEEPALIVE_ADAPTIVE                                (0)
+
+/* 自适应心跳的初始周期, 单位:s */
+#define UIOT_MQTT_KEEPALIVE_ADAPTIVE_MIN                            (60)
+
+/* 自适应心跳周期每次延长或缩短的步长, 单位:s */
+#define UIOT_MQTT_KEEPALIVE_ADAPTIVE_STEP                           (30)
+
+/* MQTT协议版本, 4表示3.1.1, 5表示5.0. 5.0下发布消息自动使用主题别名, 并按服务器的Receive Maximum限制等待PUBACK的消息个数 */
+#define UIOT_MQTT_PROTOCOL_VERSION                                  (4)
+
+/* MQTT 5.0发布消息使用的主题别名个数上限, 取值范围1~65535, 实际个数不超过服务器在CONNACK中允许的个数 */
+#define UIOT_MQTT_TOPIC_ALIAS_MAX                                   (16)
+
 /* MQTT 阻塞调用(包括连接, 订阅, 发布等)的超时时间 */
 #define UIOT_MQTT_COMMAND_TIMEOUT                                   (5 * 1000)
 
@@ -35,9 +50,85 @@ extern "C" {
 /* MQTT消息接收buffer大小, 支持最大256*1024 */
 #define UIOT_MQTT_RX_BUF_LEN                                        (2048)
 
+/* MQTT接收预读缓冲区大小, 一次读取可取回多个连续到达的报文, 0表示不开启预读 */
+#define UIOT_MQTT_RX_RING_LEN                                       (512)
+
+/* 按需扩展的收发缓冲区空闲多久后收缩回初始大小, 单位ms */
+#define UIOT_MQTT_BUF_SHRINK_IDLE_MS                                (30 * 1000)
+
+/* 同时等待PUBACK的QoS1消息个数上限, 取值范围1~65535 */
+#define UIOT_MQTT_MAX_INFLIGHT                                      (20)
+
+/* 记录已收到的QoS1/QoS2消息packet id的窗口大小, 须为2的幂, 按packet id低位直接定位 */
+#define UIOT_MQTT_INBOUND_ID_WINDOW                                 (32)
+
+/* 已回复PUBACK的QoS1消息packet id的保留时间, 期间收到相同packet id且DUP置位的消息视为重复消息 */
+#define UIOT_MQTT_INBOUND_ID_AGE_MS                                 (60 * 1000)
+
+/* 手动回复的订阅中已分发但应用还未调用IOT_MQTT_Ack的QoS1/QoS2消息个数上限, 达到上限时暂停读取网络数据 */
+#define UIOT_MQTT_MANUAL_ACK_MAX                                    (8)
+
+/* QoS1消息重发缓存区大小, 客户端创建时一次性分配, 等待PUBACK的报文总长度不能超过该值 */
+#define UIOT_MQTT_RETRANS_ARENA_LEN                                 (4 * 1024)
+
+/* QoS1消息未收到PUBACK时的最大重发次数, 0表示不重发, 等待UIOT_MQTT_COMMAND_TIMEOUT后直接通知发布超时 */
+#define UIOT_MQTT_RETRANS_MAX                                       (3)
+
+/* 重发超时时间的上下限, 单位:ms. 重发超时时间根据PUBACK的往返时间动态计算, 每重发一次加倍 */
+#define UIOT_MQTT_RTO_MIN_MS                                        (1000)
+#define UIOT_MQTT_RTO_MAX_MS                                        (60 * 1000)
+
+/* 异步发布队列长度, 0表示不开启异步发布 */
+#define UIOT_MQTT_ASYNC_QUEUE_LEN                                   (0)
+
+/* 异步发布线程的栈大小和优先级 */
+#define UIOT_MQTT_ASYNC_TASK_STACK_SIZE                             (2048)
+#define UIOT_MQTT_ASYNC_TASK_PRIORITY                               (10)
+
+/* 异步发布队列中没有关键消息时, 普通消息与批量消息按此权重轮流发送 */
+#define UIOT_MQTT_PRIORITY_WEIGHT_NORMAL                            (4)
+#define UIOT_MQTT_PRIORITY_WEIGHT_BULK                              (1)
+
+/* 按主题前缀限速的令牌桶个数上限, 不包含客户端级的令牌桶 */
+#define UIOT_MQTT_RATE_LIMIT_TOPICS                                 (4)
+
+/* 一个客户端组中最多的客户端个数, 不能超过64 */
+#define UIOT_MQTT_GROUP_MAX_CLIENTS                                 (16)
+
+/* 小报文合并发送缓冲区大小, 0表示不开启合并发送 */
+#define UIOT_MQTT_TX_BATCH_LEN                                      (0)
+
+/* 合并发送的小报文最多延迟的时间, 单位ms */
+#define UIOT_MQTT_TX_BATCH_DELAY_MS                                 (20)
+
+/* 是否开启离线消息存储, 断线期间发布的消息写入flash分区, 重连后按顺序补发, 需要fal软件包 */
+#define UIOT_MQTT_STORE_ENABLE                                      (0)
+
+/* 离线消息存储默认使用的fal分区名, 可通过MQTTInitParams.store_partition为每个客户端指定, 分区至少包含两个擦除块 */
+#define UIOT_MQTT_STORE_PARTITION                                   "mqtt_store"
+
+/* 单条离线消息中主题与负载的最大总长度, 决定存储模块占用的内存, 不能超过擦除块大小 */
+#define UIOT_MQTT_STORE_RECORD_MAX                                  (512)
+
+/* 重连后补发离线消息的间隔, 单位ms */
+#define UIOT_MQTT_STORE_DRAIN_INTERVAL_MS                           (100)
+
+/* 每补发多少条离线消息记录一次读取位置, 掉电重启后最多重复补发这么多条 */
+#define UIOT_MQTT_STORE_CHECKPOINT_EVERY                            (8)
+
+/* 间歇连接模式休眠期间检查唤醒请求和离线消息条数的周期, 单位ms */
+#define UIOT_MQTT_DUTY_WAKE_POLL_MS                                 (1000)
+
 /* 重连最大等待时间 */
 #define MAX_RECONNECT_WAIT_INTERVAL                                 (60 * 1000)
 
+/* 重连等待时间是否加入随机抖动, 1表示在0到当前退避时间之间随机取值, 避免大量设备同时断线后同步重连 */
+#define UIOT_MQTT_RECONNECT_JITTER                                  (1)
+
+/* 流水线连接, 1表示发出CONNECT后不等待CONNACK, 紧接着发出重新订阅和离线存储中待补发的消息, 连接被拒绝时撤销;
+ * 只在clean_session为1时重新订阅, 否则仍需等待CONNACK确认服务器是否保留了会话 */
+#define UIOT_MQTT_CONNECT_PIPELINE                                  (0)
+
 /* 使能无限重连，0表示超过重连最大等待时间后放弃重连，
  * 1表示超过重连最大等待时间后以固定间隔尝试重连*/
 #define ENABLE_INFINITE_RECONNECT                                    1
@@ -31,9 +31,22 @@ extern "C" {
 typedef enum _QoS {
     QOS0 = 0,    // 至多分发一次
     QOS1 = 1,    // 至少分发一次, 消息的接收者需回复PUBACK报文
-    QOS2 = 2     // 仅分发一次, 目前暂不支持
+    QOS2 = 2     // 仅分发一次, 目前仅支持订阅, 暂不支持发布
 } QoS;
 
+/**
+ * @brief 发布消息的优先级
+ *
+ * 关键消息优先于其他消息获得发送机会, 不参与合并发送, 连接正常时也不排在离线存储的消息之后;
+ * 异步发布队列中普通消息与批量消息按UIOT_MQTT_PRIORITY_WEIGHT_NORMAL/UIOT_MQTT_PRIORITY_WEIGHT_BULK的权重轮流发送
+ */
+typedef enum {
+    MQTT_PRIORITY_NORMAL = 0,       // 普通消息, 默认值
+    MQTT_PRIORITY_CRITICAL = 1,     // 关键消息, 如告警事件
+    MQTT_PRIORITY_BULK = 2,         // 批量消息, 如周期上报的数据, OTA进度
+    MQTT_PRIORITY_MAX
+} MQTTPubPriority;
+
 /**
  * @brief 发布或接收已订阅消息的结构体定义
  */
@@ -48,17 +61,58 @@ typedef struct {
 
     void                    *payload;     // MQTT 消息负载
     size_t                  payload_len;  // MQTT 消息负载长度
+
+    uint32_t                ack_token;    // 接收消息时有效, 非0表示需由应用调用IOT_MQTT_Ack回复
+    uint8_t                 priority;     // 发布消息时有效, 见MQTTPubPriority
 } MQTTMessage;
 
 typedef MQTTMessage PublishParams;
 
-#define DEFAULT_PUB_PARAMS {QOS0, 0, 0, 0, NULL, 0, NULL, 0}
+#define DEFAULT_PUB_PARAMS {QOS0, 0, 0, 0, NULL, 0, NULL, 0, 0, MQTT_PRIORITY_NORMAL}
+
+/**
+ * @brief 异步发布完成的回调函数定义
+ *
+ * QoS1消息在收到PUBACK或等待超时后回调, QoS0消息在报文发送完成后回调
+ *
+ * @param pClient    MQTT句柄
+ * @param packet_id  消息的packet id, QoS0消息为0
+ * @param result     SUCCESS表示发布成功, 否则为错误码
+ * @param pUserData  调用IOT_MQTT_PublishAsync时传入的用户数据
+ */
+typedef void (*OnPublishComplete)(void *pClient, uint16_t packet_id, int result, void *pUserData);
 
 /**
  * @brief 接收已订阅消息的回调函数定义
  */
 typedef void (*OnMessageHandler)(void *pClient, MQTTMessage *message, void *pUserData);
 
+/**
+ * @brief 分片接收已订阅消息时, 每个分片的结构体定义
+ */
+typedef struct {
+    QoS                     qos;          // MQTT 服务质量等级
+    uint8_t                 retained;     // RETAIN 标识位
+    uint8_t                 dup;          // DUP 标识位
+    uint16_t                id;           // MQTT 消息标识符
+
+    const char              *topic;       // MQTT topic
+    size_t                  topic_len;    // topic 长度
+
+    size_t                  total_len;    // 消息负载总长度
+    size_t                  offset;       // 本分片在消息负载中的偏移
+    void                    *chunk;       // 本分片数据, 仅在回调函数内有效
+    size_t                  chunk_len;    // 本分片长度
+    uint8_t                 is_last;      // 是否为消息的最后一个分片
+} MQTTMessageChunk;
+
+/**
+ * @brief 分片接收已订阅消息的回调函数定义
+ *
+ * 消息负载按接收缓冲区大小依次回调, 首个分片offset为0, 最后一个分片is_last为1
+ */
+typedef void (*OnMessageChunkHandler)(void *pClient, MQTTMessageChunk *chunk, void *pUserData);
+
 /**
  * @brief 订阅主题的结构体定义
  */
@@ -66,9 +120,11 @@ typedef struct {
     QoS                     qos;                    // QOS服务质量标识
     OnMessageHandler        on_message_handler;     // 接收已订阅消息的回调函数
     void                    *user_data;             // 用户数据, 通过callback返回
+    OnMessageChunkHandler   on_chunk_handler;       // 可选, 分片接收消息的回调函数, 设置后超过接收缓冲区的消息不再被丢弃
+    uint8_t                 manual_ack;             // 可选, 为1时QoS1/QoS2消息回调返回后不自动回复, 由应用调用IOT_MQTT_Ack回复
 } SubscribeParams;
 
-#define DEFAULT_SUB_PARAMS {QOS0, NULL, NULL}
+#define DEFAULT_SUB_PARAMS {QOS0, NULL, NULL, NULL, 0}
 
 typedef enum {
 
@@ -102,7 +158,7 @@ typedef enum {
     /* 发布成功 */
     MQTT_EVENT_PUBLISH_SUCCESS = 9,
 
-    /* 发布超时 */
+    /* 发布超时, 重发UIOT_MQTT_RETRANS_MAX次后仍未收到PUBACK */
     MQTT_EVENT_PUBLISH_TIMEOUT = 10,
 
     /* 发布失败 */
@@ -111,6 +167,9 @@ typedef enum {
     /* SDK订阅的topic收到后台push消息 */
     MQTT_EVENT_PUBLISH_RECEIVED = 12,
 
+    /* 间歇连接模式的一个周期结束并已断开连接, msg指向本周期的MQTTDutyCycleStats */
+    MQTT_EVENT_DUTY_CYCLE_DONE = 13,
+
 } MQTTEventType;
 
 typedef struct {
@@ -154,9 +213,93 @@ typedef struct {
 
     MQTTEventHandler            event_handler;           // 事件回调
 
+    /**
+     * 收发缓冲区大小, 为0时使用UIOT_MQTT_TX_BUF_LEN/UIOT_MQTT_RX_BUF_LEN
+     */
+    uint32_t                    tx_buf_size;             // 发送缓冲区初始大小, 单位: 字节
+    uint32_t                    rx_buf_size;             // 接收缓冲区初始大小, 单位: 字节
+    uint32_t                    max_buf_size;            // 收发缓冲区按需扩展的上限, 不大于初始大小时不扩展; 扩展后空闲
+                                                         // UIOT_MQTT_BUF_SHRINK_IDLE_MS收缩回初始大小
+
+    char                        *store_partition;        // 离线消息存储使用的fal分区名, 为NULL时使用UIOT_MQTT_STORE_PARTITION,
+                                                         // 同时存在多个客户端时每个客户端须使用不同的分区
+
 } MQTTInitParams;
 
-#define DEFAULT_MQTT_INIT_PARAMS { NULL, NULL, NULL, NULL, 2000, 240, 1, 1, {0}}
+#define DEFAULT_MQTT_INIT_PARAMS { NULL, NULL, NULL, NULL, 2000, 240, 1, 1, {0}, 0, 0, 0, NULL}
+
+/* 一个优先级的消息从调用发布接口(异步发布时为放入队列)到报文发出的时延统计 */
+typedef struct {
+    uint32_t                    count;                     // 已发出的消息个数
+    uint32_t                    avg_ms;                    // 平均时延, 单位:ms
+    uint32_t                    max_ms;                    // 最大时延, 单位:ms
+} MQTTPubLatencyStats;
+
+/* 令牌桶中的令牌耗尽时对新发布消息的处理方式 */
+typedef enum {
+    MQTT_RATE_BLOCK = 0,                                   // 在调用线程中等待令牌, 最多等待command_timeout, 超时后丢弃
+    MQTT_RATE_QUEUE = 1,                                   // 写入离线存储, 令牌恢复后按顺序补发; 未开启离线存储时丢弃
+    MQTT_RATE_DROP = 2,                                    // 直接丢弃
+} MQTTRateLimitPolicy;
+
+/* 令牌桶参数, 每条消息消耗一个令牌 */
+typedef struct {
+    uint32_t                    rate;                      // 每秒补充的令牌数, 单位:千分之一个令牌, 即长期允许的每秒发布消息条数乘以1000,
+                                                           // 如1000表示每秒1条, 100表示每10秒1条, 为0表示取消限速
+    uint32_t                    burst;                     // 令牌桶容量, 即允许突发发布的消息条数, 不能小于1
+    MQTTRateLimitPolicy         policy;                    // 令牌耗尽时的处理方式
+} MQTTRateLimitParams;
+
+/* 一个令牌桶的统计 */
+typedef struct {
+    uint32_t                    passed;                    // 直接取得令牌的消息条数
+    uint32_t                    deferred;                  // 等待令牌或写入离线存储而延后发出的消息条数
+    uint32_t                    dropped;                   // 因令牌耗尽被丢弃的消息条数
+    int32_t                     tokens;                    // 当前令牌数, 重发消息使客户端级令牌桶透支时为负
+} MQTTRateLimitStats;
+
+/* 间歇连接模式参数 */
+typedef struct {
+    uint32_t                    interval_ms;               // 两次连接之间的休眠时间, 单位:ms, 为0时只在满足其他唤醒条件时连接
+    uint32_t                    queue_threshold;           // 离线存储中的消息达到此条数时提前连接, 为0表示不按条数唤醒
+    uint32_t                    listen_ms;                 // 连接后至少保持的时间, 用于接收服务器下发的消息, 单位:ms
+    uint32_t                    max_awake_ms;              // 一次连接最长保持的时间, 超过后即使还有未完成的消息也断开, 单位:ms
+} MQTTDutyCycleParams;
+
+/* 间歇连接模式一个周期的统计 */
+typedef struct {
+    uint32_t                    cycles;                    // 已完成的周期数
+    uint32_t                    radio_on_ms;               // 本周期从开始连接到断开的时间, 单位:ms
+    uint32_t                    connect_ms;                // 本周期建立连接(含TLS握手和CONNACK)所用的时间, 单位:ms
+    uint32_t                    tx_packets;                // 本周期发送的报文个数
+    uint32_t                    tx_bytes;                  // 本周期发送的字节数
+    uint8_t                     tls_resumed;               // 本周期的TLS连接是否恢复了上一次的会话
+    uint8_t                     complete;                  // 断开时是否已无待发送和等待应答的消息, 为0表示因max_awake_ms或断线提前结束
+    int32_t                     result;                    // 本周期的连接结果, SUCCESS或连接失败的错误码
+    uint64_t                    radio_on_total_ms;         // 所有周期的连接时间总和, 单位:ms
+} MQTTDutyCycleStats;
+
+/* MQTT客户端运行统计 */
+typedef struct {
+    uint32_t                    pub_in_flight;             // 等待PUBACK的QoS1消息个数
+    uint32_t                    retrans_arena_size;        // 重发缓存区大小
+    uint32_t                    retrans_arena_used;        // 重发缓存区当前占用的字节数
+    uint32_t                    retrans_arena_high_water;  // 重发缓存区占用的历史最大值
+    uint32_t                    pub_retransmits;           // 未收到PUBACK而重发的QoS1消息次数
+    uint32_t                    pub_rto;                   // 当前的重发超时时间, 单位:ms, 0表示还未测得PUBACK的往返时间
+    uint32_t                    tx_packets;                // 已发送的报文个数
+    uint32_t                    tx_writes;                 // 调用底层网络写接口的次数, 开启合并发送后小于tx_packets
+    uint32_t                    tx_bytes;                  // 已发送的字节数
+    uint32_t                    ping_sent;                 // 已发送的心跳包个数
+    uint32_t                    ping_suppressed;           // 心跳周期内有其他报文发出而省去的心跳包个数
+    uint32_t                    ping_interval;             // 当前心跳周期, 单位:s
+    uint32_t                    store_records;             // 离线存储中等待补发的消息条数
+    uint32_t                    store_bytes;               // 离线存储中等待补发的消息占用的flash字节数
+    uint32_t                    store_dropped;             // 离线存储已满时被丢弃的最早的消息条数
+    MQTTPubLatencyStats         pub_latency[MQTT_PRIORITY_MAX];  // 各优先级消息的发送时延, 按MQTTPubPriority索引
+    uint32_t                    rate_deferred;             // 所有令牌桶延后发出的消息条数, 按令牌桶的统计见IOT_MQTT_GetRateLimitStats
+    uint32_t                    rate_dropped;              // 所有令牌桶丢弃的消息条数
+} MQTTClientStats;
 
 /**
  * @brief 构造MQTTClient并完成MQTT连接
@@ -187,9 +330,57 @@ int IOT_MQTT_Destroy(void **pClient);
  */
 int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms);
 
+/**
+ * @brief 创建客户端组
+ *
+ * 网关等需要同时连接多个设备的场景下, 将多个MQTT客户端加入同一个客户端组, 由一个线程调用
+ * IOT_MQTT_GroupYield同时等待所有连接上的数据和定时事件, 不必为每个客户端创建线程.
+ * 组中的客户端不能再调用IOT_MQTT_Yield, 销毁客户端前需先将其移出客户端组.
+ *
+ * @return        创建成功返回客户端组句柄, 失败返回NULL
+ */
+void *IOT_MQTT_GroupCreate(void);
+
+/**
+ * @brief 销毁客户端组, 组中的客户端不会被销毁
+ *
+ * @param pGroup  客户端组句柄
+ * @return        返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_GroupDestroy(void **pGroup);
+
+/**
+ * @brief 将MQTT客户端加入客户端组, 最多UIOT_MQTT_GROUP_MAX_CLIENTS个
+ *
+ * @param pGroup  客户端组句柄
+ * @param pClient MQTT句柄
+ * @return        返回SUCCESS, 表示成功, 返回ERR_MQTT_GROUP_FULL, 表示客户端组已满
+ */
+int IOT_MQTT_GroupAdd(void *pGroup, void *pClient);
+
+/**
+ * @brief 将MQTT客户端移出客户端组, IOT_MQTT_GroupYield正在处理该客户端时等待处理结束后返回
+ *
+ * @param pGroup  客户端组句柄
+ * @param pClient MQTT句柄
+ * @return        返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_GroupRemove(void *pGroup, void *pClient);
+
+/**
+ * @brief 在当前线程为客户端组中的所有MQTT客户端让出一定CPU执行时间
+ *
+ * @param pGroup     客户端组句柄
+ * @param timeout_ms Yield操作超时时间
+ * @return           返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_GroupYield(void *pGroup, uint32_t timeout_ms);
+
 /**
  * @brief 发布MQTT消息
  *
+ * 开启离线消息存储(UIOT_MQTT_STORE_ENABLE)时, 断线期间以及离线消息补发完成之前发布的消息写入flash, 返回0
+ *
  * @param pClient   MQTT句柄
  * @param topicName 主题名
  * @param pParams   发布参数
@@ -198,6 +389,63 @@ int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms);
  */
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams);
 
+/**
+ * @brief 异步发布MQTT消息
+ *
+ * 消息被拷贝后放入发布队列即返回, 由客户端的发送线程完成序列化与发送, 结果通过on_complete回调通知.
+ * 需将UIOT_MQTT_ASYNC_QUEUE_LEN配置为大于0才能使用
+ *
+ * @param pClient     MQTT句柄
+ * @param topicName   主题名
+ * @param pParams     发布参数
+ * @param on_complete 可选, 发布完成的回调函数
+ * @param pUserData   用户数据, 通过回调函数返回
+ * @return            返回SUCCESS, 表示已放入发布队列; 队列已满返回ERR_MQTT_ASYNC_QUEUE_FULL
+ */
+int IOT_MQTT_PublishAsync(void *pClient, char *topicName, PublishParams *pParams,
+                          OnPublishComplete on_complete, void *pUserData);
+
+/**
+ * @brief 为频繁发布的主题创建发布句柄
+ *
+ * 主题只在创建句柄时编码一次, 之后每次通过IOT_MQTT_PublishWith发布时只需填写固定头部, 报文标识符和剩余长度.
+ * 同一个句柄只能用于创建它的MQTT客户端, 销毁客户端前需先释放句柄.
+ *
+ * @param pClient   MQTT句柄
+ * @param topicName 主题名
+ * @param qos       发布消息的QoS, 不支持QoS2
+ * @return          成功返回发布句柄, 失败返回NULL
+ */
+void *IOT_MQTT_PreparePublish(void *pClient, char *topicName, QoS qos);
+
+/**
+ * @brief 通过发布句柄发布MQTT消息, 除主题和QoS由句柄给出外, 行为与IOT_MQTT_Publish相同
+ *
+ * @param pHandle     发布句柄
+ * @param payload     消息负载
+ * @param payload_len 消息负载长度
+ * @return < 0  :   表示失败
+ *         >= 0 :   返回唯一的packet id
+ */
+int IOT_MQTT_PublishWith(void *pHandle, void *payload, size_t payload_len);
+
+/**
+ * @brief 设置通过发布句柄发布的消息的优先级, 默认为MQTT_PRIORITY_NORMAL
+ *
+ * @param pHandle   发布句柄
+ * @param priority  消息优先级
+ * @return          返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_SetPublishPriority(void *pHandle, MQTTPubPriority priority);
+
+/**
+ * @brief 释放发布句柄
+ *
+ * @param pHandle 发布句柄的地址, 释放后置为NULL
+ * @return        返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_ReleasePublish(void **pHandle);
+
 /**
  * @brief 订阅MQTT主题
  *
@@ -209,6 +457,18 @@ int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams);
  */
 int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParams);
 
+/**
+ * @brief 在一个SUBSCRIBE报文中订阅多个MQTT主题, 只需等待一次SUBACK
+ *
+ * @param pClient      MQTT句柄
+ * @param topicFilters 主题过滤器数组, 可参考MQTT协议说明 4.7
+ * @param pParams      订阅参数数组, 与topicFilters一一对应
+ * @param count        主题个数, 最大为10
+ * @return <  0 :      表示失败
+ *         >= 0 :      返回唯一的packet id
+ */
+int IOT_MQTT_SubscribeMany(void *pClient, char **topicFilters, SubscribeParams *pParams, uint32_t count);
+
 /**
  * @brief 取消订阅已订阅的MQTT主题
  *
@@ -219,6 +479,30 @@ int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParam
  */
 int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter);
 
+/**
+ * @brief 在一个UNSUBSCRIBE报文中取消订阅多个已订阅的MQTT主题
+ *
+ * @param pClient      MQTT客户端结构体
+ * @param topicFilters 主题过滤器数组, 可参考MQTT协议说明 4.7
+ * @param count        主题个数, 最大为10
+ * @return <  0 :      表示失败
+ *         >= 0 :      返回唯一的packet id
+ */
+int IOT_MQTT_UnsubscribeMany(void *pClient, char **topicFilters, uint32_t count);
+
+/**
+ * @brief 回复以手动回复方式订阅收到的QoS1/QoS2消息, 可在任意线程中调用
+ *
+ * 消息回调中的message->ack_token非0时, SDK不再自动回复PUBACK/PUBREC, 应用处理完消息后调用本接口回复.
+ * 未回复的消息达到UIOT_MQTT_MANUAL_ACK_MAX条时暂停读取网络数据. 断线期间的回复在重连且服务器保留了会话后发送,
+ * 服务器没有保留会话时之前的ack token失效. 分片接收的消息仍自动回复.
+ *
+ * @param pClient    MQTT句柄
+ * @param ack_token  消息回调中message->ack_token的值, 为0时直接返回成功
+ * @return           返回SUCCESS, 表示成功; 返回ERR_MQTT_ACK_INVALID, 表示ack token无效或已经回复过
+ */
+int IOT_MQTT_Ack(void *pClient, uint32_t ack_token);
+
 /**
  * @brief 客户端目前是否已连接
  *
@@ -227,6 +511,103 @@ int IOT_MQTT_Unsubscribe(void *pClient, char *topicFilter);
  */
 bool IOT_MQTT_IsConnected(void *pClient);
 
+/**
+ * @brief 最近一次连接时服务器是否保留了之前的会话, 即CONNACK中的Session Present标志
+ *
+ * clean_session为0且服务器保留了会话时, 重连后不再重新订阅, 订阅关系由服务器恢复
+ *
+ * @param pClient  MQTT Client结构体
+ * @return         返回true, 表示服务器保留了会话，返回false表示新建会话
+ */
+bool IOT_MQTT_IsSessionPresent(void *pClient);
+
+/**
+ * @brief 获取客户端运行统计
+ *
+ * @param pClient  MQTT Client结构体
+ * @param pStats   返回的统计数据
+ * @return         返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_GetStats(void *pClient, MQTTClientStats *pStats);
+
+/**
+ * @brief 设置发布速率限制, 避免超过云端的发布速率配额而被断开连接
+ *
+ * 令牌桶分为客户端级和按主题前缀两类, 一条消息需要同时从客户端级令牌桶和主题匹配的最长前缀的令牌桶中各取得一个令牌.
+ * 两者都没有配置时不限速. 令牌耗尽时按令牌桶的policy处理, 两者都耗尽时按主题前缀令牌桶的policy处理.
+ * 发送失败(如等待PUBACK的消息已达上限)的消息归还令牌; QoS1消息的重发不受限制, 但消耗客户端级令牌桶的令牌.
+ *
+ * @param pClient       MQTT Client结构体
+ * @param topic_prefix  主题前缀, 为NULL时设置客户端级令牌桶
+ * @param pParams       令牌桶参数, 为NULL或rate为0时取消该令牌桶
+ * @return              返回SUCCESS, 表示成功; 主题前缀的令牌桶已达UIOT_MQTT_RATE_LIMIT_TOPICS个时返回FAILURE
+ */
+int IOT_MQTT_SetRateLimit(void *pClient, const char *topic_prefix, MQTTRateLimitParams *pParams);
+
+/**
+ * @brief 获取一个令牌桶的统计
+ *
+ * @param pClient       MQTT Client结构体
+ * @param topic_prefix  主题前缀, 为NULL时获取客户端级令牌桶的统计
+ * @param pStats        返回的统计数据
+ * @return              返回SUCCESS, 表示成功; 令牌桶不存在时返回ERR_PARAM_INVALID
+ */
+int IOT_MQTT_GetRateLimitStats(void *pClient, const char *topic_prefix, MQTTRateLimitStats *pStats);
+
+/**
+ * @brief 开启或关闭间歇连接模式, 适用于电池供电的设备
+ *
+ * 开启后客户端平时保持断开, 发布的消息写入离线存储. 休眠interval_ms, 离线存储中的消息达到queue_threshold条
+ * 或调用IOT_MQTT_DutyCycleWake时连接服务器, 一次补发离线存储中的消息和休眠期间的订阅, 等待所有应答后
+ * 断开连接, 之后通过MQTT_EVENT_DUTY_CYCLE_DONE事件报告本周期的连接时间. 断开时保存TLS会话, 下一次连接时恢复.
+ * 连接和断开都在IOT_MQTT_Yield中进行, 休眠期间IOT_MQTT_Yield返回MQTT_DUTY_CYCLE_SLEEPING.
+ * 开启时已连接则当前连接作为第一个周期. 需要开启离线存储(UIOT_MQTT_STORE_ENABLE).
+ *
+ * @param pClient  MQTT Client结构体
+ * @param pParams  间歇连接参数, 为NULL时关闭间歇连接模式, 恢复自动重连
+ * @return         返回SUCCESS, 表示成功; 未开启离线存储时返回FAILURE
+ */
+int IOT_MQTT_SetDutyCycle(void *pClient, MQTTDutyCycleParams *pParams);
+
+/**
+ * @brief 间歇连接模式下请求尽快连接, 可以在其他线程中调用
+ *
+ * @param pClient  MQTT Client结构体
+ * @return         返回SUCCESS, 表示成功; 未开启间歇连接模式时返回FAILURE
+ */
+int IOT_MQTT_DutyCycleWake(void *pClient);
+
+/**
+ * @brief 获取间歇连接模式最近一个周期的统计
+ *
+ * @param pClient  MQTT Client结构体
+ * @param pStats   返回的统计数据
+ * @return         返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_GetDutyCycleStats(void *pClient, MQTTDutyCycleStats *pStats);
+
+/**
+ * @brief 开启或关闭小报文合并发送
+ *
+ * 开启后PUBACK, PINGREQ和QoS0 PUBLISH等小报文先写入合并发送缓冲区, 在缓冲区满, 超过
+ * UIOT_MQTT_TX_BATCH_DELAY_MS, 发送其他报文或IOT_MQTT_Yield循环结束时通过一次写操作发出,
+ * 减少TLS记录和TCP报文的个数. 关闭时立即发送缓冲区中的报文.
+ * UIOT_MQTT_TX_BATCH_LEN为0时开启无效.
+ *
+ * @param pClient  MQTT Client结构体
+ * @param enable   true开启, false关闭
+ * @return         返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_SetCork(void *pClient, bool enable);
+
+/**
+ * @brief 立即发送合并发送缓冲区中的报文
+ *
+ * @param pClient  MQTT Client结构体
+ * @return         返回SUCCESS, 表示成功
+ */
+int IOT_MQTT_Flush(void *pClient);
+
 /**
  * @brief 构造MQTTClient动态注册
  *
@@ -70,6 +70,49 @@ IoT_Error_t HAL_MutexTryLock(_IN_ void *mutex);
  */
 void HAL_MutexUnlock(_IN_ void *mutex);
 
+/**
+ * @brief 创建计数信号量
+ *
+ * @return 创建成功返回信号量指针，创建失败返回NULL
+ */
+void *HAL_SemaphoreCreate(void);
+
+/**
+ * @brief 销毁信号量
+ *
+ * @param sem   信号量指针
+ */
+void HAL_SemaphoreDestroy(_IN_ void *sem);
+
+/**
+ * @brief 释放信号量, 信号量计数加一
+ *
+ * @param sem   信号量指针
+ */
+void HAL_SemaphorePost(_IN_ void *sem);
+
+/**
+ * @brief 等待信号量, 计数为0时阻塞当前线程, 直到信号量被释放或超时
+ *
+ * @param sem           信号量指针
+ * @param timeout_ms    超时时间, 单位:ms
+ * @return              获取到信号量返回SUCCESS，超时返回FAILURE
+ */
+IoT_Error_t HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 创建并启动线程, 线程入口函数返回后线程自行退出并回收资源
+ *
+ * @param name          线程名
+ * @param entry         线程入口函数
+ * @param arg           传递给入口函数的参数
+ * @param stack_size    线程栈大小, 单位:字节
+ * @param priority      线程优先级
+ * @return              创建成功返回SUCCESS，否则返回FAILURE
+ */
+IoT_Error_t HAL_ThreadCreate(_IN_ const char *name, _IN_ void (*entry)(void *), _IN_ void *arg,
+                             _IN_ uint32_t stack_size, _IN_ uint8_t priority);
+
 /**
  * @brief 申请内存块
  *
@@ -250,6 +293,34 @@ void HAL_Timer_Init(_IN_ Timer *timer);
 uintptr_t HAL_TLS_Connect(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16_t authmode, _IN_ const char *ca_crt,
                           _IN_ size_t ca_crt_len);
 
+/**
+ * @brief 建立TLS连接, 提供了上一次连接保存的会话时尝试恢复会话(Session ID或Session Ticket), 省去完整握手.
+ *        服务器不接受时自动进行完整握手
+ *
+ * @session     HAL_TLS_SaveSession保存的会话, 为NULL时进行完整握手
+ * @resumed     返回是否恢复了会话, 可以为NULL
+ * @return      连接成功, 返回TLS连接句柄，连接失败，返回NULL; 其余参数同HAL_TLS_Connect
+ */
+uintptr_t HAL_TLS_ConnectResume(_IN_ const char *host, _IN_ uint16_t port, _IN_ uint16_t authmode,
+                                _IN_ const char *ca_crt, _IN_ size_t ca_crt_len, _IN_ void *session,
+                                _OU_ uint8_t *resumed);
+
+/**
+ * @brief 保存TLS连接的会话, 在HAL_TLS_Disconnect之前调用, 用于下一次连接时恢复会话
+ *
+ * @param handle    TLS连接句柄
+ * @param session   保存会话的对象, *session为NULL时创建, 否则覆盖; 保存失败时释放并置为NULL
+ * @return          保存成功返回SUCCESS，否则返回FAILURE
+ */
+int32_t HAL_TLS_SaveSession(_IN_ uintptr_t handle, _OU_ void **session);
+
+/**
+ * @brief 释放HAL_TLS_SaveSession保存的会话
+ *
+ * @param session   保存的会话, 可以为NULL
+ */
+void HAL_TLS_FreeSession(_IN_ void *session);
+
 /**
  * @brief 断开TLS连接, 并释放相关对象资源
  *
@@ -269,6 +340,17 @@ int32_t HAL_TLS_Disconnect(_IN_ uintptr_t handle);
  */
 int32_t HAL_TLS_Write(_IN_ uintptr_t handle, _IN_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
 
+/**
+ * @brief 向指定的TLS连接按顺序写入多个数据块。较小的相邻数据块应合并到同一个TLS记录中发送, 其余同HAL_TLS_Write
+ *
+ * @param handle        TLS连接句柄
+ * @param iov           数据块数组
+ * @param iovcnt        数据块个数
+ * @param timeout_ms    超时时间, 单位:ms
+ * @return              <0: TLS写入错误; =0: TLS写超时, 且没有写入任何数据; >0: TLS成功写入的字节数
+ */
+int32_t HAL_TLS_Writev(_IN_ uintptr_t handle, _IN_ utils_iovec_t *iov, _IN_ int iovcnt, _IN_ uint32_t timeout_ms);
+
 /**
  * @brief 通过TLS连接读数据
  *
@@ -280,6 +362,37 @@ int32_t HAL_TLS_Write(_IN_ uintptr_t handle, _IN_ unsigned char *buf, _IN_ size_
  */
 int32_t HAL_TLS_Read(_IN_ uintptr_t handle, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
 
+/**
+ * @brief 通过TLS连接读取当前已到达的数据。在超时时间内等待至少一个字节到达, 之后立即返回, 不等待凑满len字节
+ *
+ * @param handle        TLS连接句柄
+ * @param buf           指向数据接收缓冲区的指针
+ * @param len           数据接收缓冲区的字节大小
+ * @param timeout_ms    超时时间, 单位:ms
+ * @return              <0: TLS读取错误; =0: TLS读超时, 且没有读取任何数据; >0: TLS成功读取的字节数
+ */
+int32_t HAL_TLS_ReadAvail(_IN_ uintptr_t handle, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 等待TLS连接上有数据可读。TLS层已解密但未读取的数据同样视为可读
+ *
+ * @param handle        TLS连接句柄
+ * @param timeout_ms    超时时间, 单位:ms
+ * @return              <0: TLS连接错误; =0: 超时时间内没有数据到达; >0: 有数据可读
+ */
+int32_t HAL_TLS_WaitReadable(_IN_ uintptr_t handle, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 同时等待多个TLS连接中任意一个有数据可读, 多个客户端共用一个线程时使用
+ *
+ * @param handles       TLS连接句柄数组
+ * @param readable      返回每个连接是否可读, 1: 可读; 0: 不可读
+ * @param count         连接个数
+ * @param timeout_ms    超时时间, 单位:ms
+ * @return              <0: 等待出错; =0: 超时时间内没有数据到达; >0: 可读的连接个数
+ */
+int32_t HAL_TLS_WaitReadableMany(_IN_ uintptr_t *handles, _OU_ uint8_t *readable, _IN_ int count, _IN_ uint32_t timeout_ms);
+
 /**
  * @brief   建立TCP连接。根据指定的HOST地址, 服务器端口号建立TCP连接, 返回对应的连接句柄。
  *
@@ -309,16 +422,60 @@ int32_t HAL_TCP_Disconnect(_IN_ uintptr_t fd);
 int32_t HAL_TCP_Write(_IN_ uintptr_t fd, _IN_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
 
 /**
- * @brief 从指定的TCP连接读取数据。此接口为同步接口, 如果在超时时间内读取到参数len指定长度的数据则立即返回, 否则在超时时间到时返回。
+ * @brief 向指定的TCP连接按顺序写入多个数据块, 数据块直接从调用者的内存发送, 不经过额外拷贝。其余同HAL_TCP_Write
+ *
+ * 数据块个数不设上限, 超过底层单次发送支持的个数时须分批发送, 只有超时或出错时返回值才小于数据块的总长度
+ *
+ * @param fd                TCP连接句柄
+ * @param iov               数据块数组
+ * @param iovcnt            数据块个数
+ * @param timeout_ms        超时时间，单位: ms
+ * @return                  <0: TCP写入错误; =0: TCP写超时, 且没有写入任何数据; >0: TCP成功写入的字节数
+ */
+int32_t HAL_TCP_Writev(_IN_ uintptr_t fd, _IN_ utils_iovec_t *iov, _IN_ int iovcnt, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 从指定的TCP连接读取数据。此接口为同步接口, 等待期间阻塞当前线程, 如果在超时时间内读取到参数len指定长度的数据则立即返回, 否则在超时时间到时返回。
  *
  * @param fd                TCP连接句柄
  * @param buf               指向数据接收缓冲区的指针
  * @param len               数据接收缓冲区的字节大小
  * @param timeout_ms        超时时间，单位: ms
- * @return                  <0: TCP读取错误; =0: TCP读超时, 且没有读取任何数据; >0: TCP成功读取的字节数
+ * @return                  <0: TCP读取错误, 对端关闭连接时返回ERR_TCP_PEER_SHUTDOWN; =0: TCP读超时, 且没有读取任何数据; >0: TCP成功读取的字节数
  */
 int32_t HAL_TCP_Read(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
 
+/**
+ * @brief 从指定的TCP连接读取当前已到达的数据。在超时时间内等待至少一个字节到达, 之后立即返回, 不等待凑满len字节。
+ *
+ * @param fd                TCP连接句柄
+ * @param buf               指向数据接收缓冲区的指针
+ * @param len               数据接收缓冲区的字节大小
+ * @param timeout_ms        超时时间，单位: ms
+ * @return                  <0: TCP读取错误, 对端关闭连接时返回ERR_TCP_PEER_SHUTDOWN; =0: TCP读超时, 且没有读取任何数据; >0: TCP成功读取的字节数
+ */
+int32_t HAL_TCP_ReadAvail(_IN_ uintptr_t fd, _OU_ unsigned char *buf, _IN_ size_t len, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 等待指定的TCP连接上有数据可读(或连接被关闭)。此接口阻塞当前线程, 不占用CPU。
+ *
+ * @param fd                TCP连接句柄
+ * @param timeout_ms        超时时间，单位: ms
+ * @return                  <0: TCP连接错误; =0: 超时时间内没有数据到达; >0: 有数据可读
+ */
+int32_t HAL_TCP_WaitReadable(_IN_ uintptr_t fd, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief 同时等待多个TCP连接中任意一个有数据可读(或连接被关闭), 多个客户端共用一个线程时使用
+ *
+ * @param fds               TCP连接句柄数组
+ * @param readable          返回每个连接是否可读, 1: 可读; 0: 不可读
+ * @param count             连接个数
+ * @param timeout_ms        超时时间，单位: ms
+ * @return                  <0: 等待出错; =0: 超时时间内没有数据到达; >0: 可读的连接个数
+ */
+int32_t HAL_TCP_WaitReadableMany(_IN_ uintptr_t *fds, _OU_ uint8_t *readable, _IN_ int count, _IN_ uint32_t timeout_ms);
+
 /**
  * @brief 设置相应name
  *
@@ -153,6 +153,8 @@ typedef struct _Shadow {
     void *request_mutex;
     void *property_mutex;
     ShadowInnerData inner_data;
+    Method cloud_send_method;                           //最近一次发布的文档操作方式
+    char cloud_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];      //接收云端下发文档的缓冲区
 } UIoT_Shadow;
 
 /**
@@ -199,6 +201,17 @@ int uiot_shadow_make_request(UIoT_Shadow *pShadow,char *pJsonDoc, size_t sizeOfB
  */
 int uiot_shadow_subscribe_topic(UIoT_Shadow *pShadow, char *topicFilter, OnMessageHandler on_message_handler);
 
+/**
+ * @brief 在一个SUBSCRIBE报文中订阅多个设备影子topic
+ *
+ * @param pShadow                   shadow client
+ * @param topicFilters              topic的名称数组
+ * @param on_message_handlers       topic的消息回调函数数组, 与topicFilters一一对应
+ * @param count                     topic个数
+ * @return                 返回SUCCESS, 表示成功
+ */
+int uiot_shadow_subscribe_topics(UIoT_Shadow *pShadow, char **topicFilters, OnMessageHandler *on_message_handlers, uint32_t count);
+
 /**
  * @brief 初始化一个修改设备影子的请求
  * @param handle        ShadowClient对象
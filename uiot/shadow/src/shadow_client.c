@@ -48,6 +48,7 @@ void* IOT_Shadow_Construct(const char *product_sn, const char *device_sn, void *
     shadow_client->product_sn = product_sn;
     shadow_client->device_sn = device_sn;
     shadow_client->mqtt = mqtt_client;
+    shadow_client->cloud_send_method = GET;
     shadow_client->inner_data.version = 0;
     
     ret = uiot_shadow_init(shadow_client);    
@@ -55,18 +56,14 @@ void* IOT_Shadow_Construct(const char *product_sn, const char *device_sn, void *
         goto end;
     }
 
-    /* 订阅更新影子文档必要的topic */
-    ret = uiot_shadow_subscribe_topic(shadow_client, SHADOW_SUBSCRIBE_SYNC_TEMPLATE, topic_sync_handler);
-    if (ret < 0)
-    {
-        LOG_ERROR("Subcribe %s fail!\n",SHADOW_SUBSCRIBE_SYNC_TEMPLATE);
-        goto end;
-    }
-  
-    ret = uiot_shadow_subscribe_topic(shadow_client, SHADOW_SUBSCRIBE_REQUEST_TEMPLATE, topic_request_result_handler);
+    /* 订阅更新影子文档必要的topic, 两个topic放在同一个SUBSCRIBE报文中 */
+    char *topic_templates[] = {SHADOW_SUBSCRIBE_SYNC_TEMPLATE, SHADOW_SUBSCRIBE_REQUEST_TEMPLATE};
+    OnMessageHandler topic_handlers[] = {topic_sync_handler, topic_request_result_handler};
+
+    ret = uiot_shadow_subscribe_topics(shadow_client, topic_templates, topic_handlers, 2);
     if (ret < 0)
     {
-        LOG_ERROR("Subcribe %s fail!\n",SHADOW_SUBSCRIBE_SYNC_TEMPLATE);
+        LOG_ERROR("Subcribe %s and %s fail!\n", SHADOW_SUBSCRIBE_SYNC_TEMPLATE, SHADOW_SUBSCRIBE_REQUEST_TEMPLATE);
         goto end;
     }
 
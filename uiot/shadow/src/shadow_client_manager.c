@@ -44,10 +44,6 @@ typedef struct {
     OnRequestCallback      callback;               // 文档操作请求返回处理函数
 } Request;
 
-static char cloud_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
-
-static Method cloud_send_method;
-
 typedef void (*TraverseHandle)(UIoT_Shadow *pShadow, ListNode **node, List *list, const char *pType);
 
 static int shadow_json_init(char *pJsonDoc, size_t sizeOfBuffer, RequestParams *pParams);
@@ -268,33 +264,55 @@ end:
 }
 
 int uiot_shadow_subscribe_topic(UIoT_Shadow *pShadow, char *topicFilter, OnMessageHandler on_message_handler)
+{
+    return uiot_shadow_subscribe_topics(pShadow, &topicFilter, &on_message_handler, 1);
+}
+
+int uiot_shadow_subscribe_topics(UIoT_Shadow *pShadow, char **topicFilters, OnMessageHandler *on_message_handlers, uint32_t count)
 {
     FUNC_ENTRY;
     
     int ret;
+    uint32_t i;
     UIoT_Client *mqtt_client = (UIoT_Client *)pShadow->mqtt;
+    char *topic_names[MAX_SUB_TOPICS] = {NULL};
+    SubscribeParams subscribe_params[MAX_SUB_TOPICS];
 
-    char *topic_name = (char *)HAL_Malloc(MAX_SIZE_OF_CLOUD_TOPIC * sizeof(char));
-    if (topic_name == NULL) 
+    if (0 == count || count > MAX_SUB_TOPICS)
     {
-        LOG_ERROR("topic_name malloc fail\n");
-        FUNC_EXIT_RC(FAILURE_RET);
+        FUNC_EXIT_RC(ERR_PARAM_INVALID);
     }
-    memset(topic_name, 0x0, MAX_SIZE_OF_CLOUD_TOPIC);
-    HAL_Snprintf(topic_name, MAX_SIZE_OF_CLOUD_TOPIC, topicFilter, pShadow->product_sn, pShadow->device_sn);    
-    
-    SubscribeParams subscribe_params = DEFAULT_SUB_PARAMS;
-    subscribe_params.on_message_handler = on_message_handler;
-    subscribe_params.user_data = pShadow;    
-    subscribe_params.qos = QOS1;
 
-    ret = IOT_MQTT_Subscribe(mqtt_client, topic_name, &subscribe_params);
+    for (i = 0; i < count; i++)
+    {
+        topic_names[i] = (char *)HAL_Malloc(MAX_SIZE_OF_CLOUD_TOPIC * sizeof(char));
+        if (topic_names[i] == NULL) 
+        {
+            LOG_ERROR("topic_name malloc fail\n");
+            ret = FAILURE_RET;
+            goto end;
+        }
+        memset(topic_names[i], 0x0, MAX_SIZE_OF_CLOUD_TOPIC);
+        HAL_Snprintf(topic_names[i], MAX_SIZE_OF_CLOUD_TOPIC, topicFilters[i], pShadow->product_sn, pShadow->device_sn);    
+
+        SubscribeParams sub_params = DEFAULT_SUB_PARAMS;
+        sub_params.on_message_handler = on_message_handlers[i];
+        sub_params.user_data = pShadow;    
+        sub_params.qos = QOS1;
+        subscribe_params[i] = sub_params;
+    }
+
+    ret = IOT_MQTT_SubscribeMany(mqtt_client, topic_names, subscribe_params, count);
     if (ret < 0) 
     {
-        LOG_ERROR("subscribe topic: %s failed: %d.\n", topicFilter, ret);
+        LOG_ERROR("subscribe topic: %s failed: %d.\n", topicFilters[0], ret);
     }
 
-    HAL_Free(topic_name);
+end:
+    for (i = 0; i < count; i++)
+    {
+        HAL_Free(topic_names[i]);
+    }
     FUNC_EXIT_RC(ret);
 }
 
@@ -322,7 +340,7 @@ static int uiot_shadow_publish_operation_to_cloud(UIoT_Shadow *pShadow, Method m
         FUNC_EXIT_RC(FAILURE_RET);
     }
 
-    cloud_send_method = method;
+    pShadow->cloud_send_method = method;
     PublishParams pubParams = DEFAULT_PUB_PARAMS;
     pubParams.qos = QOS1;
     pubParams.payload_len = strlen(pJsonDoc);
@@ -433,16 +451,16 @@ static void _handle_delta(UIoT_Shadow *pShadow, char* delta_str)
     char JsonDoc[CLOUD_IOT_JSON_RX_BUF_LEN];
     size_t sizeOfBuffer = sizeof(JsonDoc) / sizeof(JsonDoc[0]);
 
-    if((UPDATE == cloud_send_method) 
-        || (GET == cloud_send_method) 
-        || (UPDATE_AND_RESET_VER == cloud_send_method) 
-        || (REPLY_CONTROL_UPDATE == cloud_send_method))
+    if((UPDATE == pShadow->cloud_send_method) 
+        || (GET == pShadow->cloud_send_method) 
+        || (UPDATE_AND_RESET_VER == pShadow->cloud_send_method) 
+        || (REPLY_CONTROL_UPDATE == pShadow->cloud_send_method))
     {
         pParams_property = (RequestParams *)uiot_shadow_request_init(REPLY_CONTROL_UPDATE, NULL, MAX_WAIT_TIME_SEC, NULL);
     }
-    else if((DELETE == cloud_send_method) 
-        || (DELETE_ALL == cloud_send_method) 
-        || (REPLY_CONTROL_DELETE == cloud_send_method))
+    else if((DELETE == pShadow->cloud_send_method) 
+        || (DELETE_ALL == pShadow->cloud_send_method) 
+        || (REPLY_CONTROL_DELETE == pShadow->cloud_send_method))
     {
         pParams_property = (RequestParams *)uiot_shadow_request_init(REPLY_CONTROL_DELETE, NULL, MAX_WAIT_TIME_SEC, NULL);
     }
@@ -564,7 +582,7 @@ static void _handle_request_callback(UIoT_Shadow *pShadow, ListNode **node, List
     }
     else if((!strcmp(pType, METHOD_REPLY)) || (!strcmp(pType, METHOD_CONTROL)))
     {
-        bool parse_success = parse_shadow_payload_retcode_type(cloud_rcv_buf, &result_code);
+        bool parse_success = parse_shadow_payload_retcode_type(pShadow->cloud_rcv_buf, &result_code);
         if (parse_success) 
         {
             if (result_code == 0) {
@@ -582,7 +600,7 @@ static void _handle_request_callback(UIoT_Shadow *pShadow, ListNode **node, List
     
     if (request->callback != NULL) 
     {
-        request->callback(pShadow, request->method, status, cloud_rcv_buf, request->user_context);
+        request->callback(pShadow, request->method, status, pShadow->cloud_rcv_buf, request->user_context);
     }
     
     list_remove(list, *node);
@@ -606,7 +624,7 @@ static void _handle_expired_request_callback(UIoT_Shadow *pShadow, ListNode **no
     {
         if (request->callback != NULL) 
         {
-            request->callback(pShadow, request->method, ACK_TIMEOUT, cloud_rcv_buf, request->user_context);
+            request->callback(pShadow, request->method, ACK_TIMEOUT, pShadow->cloud_rcv_buf, request->user_context);
         }
 
         list_remove(list, *node);
@@ -657,20 +675,20 @@ void topic_request_result_handler(void *pClient, MQTTMessage *message, void *pUs
     }
 
     int cloud_rcv_len = min(CLOUD_IOT_JSON_RX_BUF_LEN - 1, message->payload_len);
-    memcpy(cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
-    cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
+    memcpy(shadow_client->cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
+    shadow_client->cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
 
-    LOG_DEBUG("downstream get message:%s\n",cloud_rcv_buf);
+    LOG_DEBUG("downstream get message:%s\n",shadow_client->cloud_rcv_buf);
 
     //解析shadow result topic消息类型
-    if (!parse_shadow_method_type(cloud_rcv_buf, &method_str))
+    if (!parse_shadow_method_type(shadow_client->cloud_rcv_buf, &method_str))
     {
         LOG_ERROR("Fail to parse method type!\n");
         goto end;
     }
 
     uint32_t version_num = 0;
-    if (parse_version_num(cloud_rcv_buf, &version_num)) 
+    if (parse_version_num(shadow_client->cloud_rcv_buf, &version_num)) 
     {
         shadow_client->inner_data.version = version_num;
         LOG_DEBUG("update version:%d\n",version_num);
@@ -684,7 +702,7 @@ void topic_request_result_handler(void *pClient, MQTTMessage *message, void *pUs
     //属性更新或者删除成功，更新本地维护的版本号
     if (!strcmp(method_str, METHOD_REPLY)) 
     {
-        if (!parse_shadow_payload_retcode_type(cloud_rcv_buf, &ret_code))
+        if (!parse_shadow_payload_retcode_type(shadow_client->cloud_rcv_buf, &ret_code))
         {
             LOG_ERROR("Fail to parse RetCode!\n");
             goto end;
@@ -692,7 +710,7 @@ void topic_request_result_handler(void *pClient, MQTTMessage *message, void *pUs
 
         if(SUCCESS_RET != ret_code)
         {
-            LOG_DEBUG("update or delete fail! reply:%s\n",cloud_rcv_buf);
+            LOG_DEBUG("update or delete fail! reply:%s\n",shadow_client->cloud_rcv_buf);
             goto end;
         }
         
@@ -700,7 +718,7 @@ void topic_request_result_handler(void *pClient, MQTTMessage *message, void *pUs
     else if(!strcmp(method_str, METHOD_CONTROL))     //版本号与影子文档不符,重新同步属性
     {        
         char* desired_str = NULL;
-        if (parse_shadow_payload_state_desired_state(cloud_rcv_buf, &desired_str)) 
+        if (parse_shadow_payload_state_desired_state(shadow_client->cloud_rcv_buf, &desired_str)) 
         {
             LOG_DEBUG("desired:%s\n", desired_str);
             /* desired中的字段不为空 */
@@ -754,14 +772,14 @@ void topic_sync_handler(void *pClient, MQTTMessage *message, void *pUserdata)
     }
 
     int cloud_rcv_len = min(CLOUD_IOT_JSON_RX_BUF_LEN - 1, message->payload_len);
-    memcpy(cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
-    cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
+    memcpy(shadow_client->cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
+    shadow_client->cloud_rcv_buf[cloud_rcv_len] = '\0';    // jsmn_parse relies on a string
 
-    LOG_DEBUG("get_reply:%s\n",cloud_rcv_buf);
+    LOG_DEBUG("get_reply:%s\n",shadow_client->cloud_rcv_buf);
 
     //同步返回消息中的version
     uint32_t version_num = 0;
-    if (parse_version_num(cloud_rcv_buf, &version_num)) {
+    if (parse_version_num(shadow_client->cloud_rcv_buf, &version_num)) {
         shadow_client->inner_data.version = version_num;
     }
     else
@@ -773,7 +791,7 @@ void topic_sync_handler(void *pClient, MQTTMessage *message, void *pUserdata)
     LOG_DEBUG("version num:%d\n",shadow_client->inner_data.version);
 
     char* desired_str = NULL;
-    if (parse_shadow_state_desired_type(cloud_rcv_buf, &desired_str)) 
+    if (parse_shadow_state_desired_type(shadow_client->cloud_rcv_buf, &desired_str)) 
     {
         LOG_DEBUG("Desired part:%s\n", desired_str);
         /* desired中的字段不为空       */
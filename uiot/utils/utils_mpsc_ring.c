@@ -0,0 +1,126 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "utils_mpsc_ring.h"
+
+#include "uiot_import.h"
+
+/* 原子操作使用编译器内建函数, GCC/Clang/armclang均支持 */
+#define MPSC_LOAD_ACQUIRE(ptr)              __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define MPSC_LOAD_RELAXED(ptr)              __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define MPSC_STORE_RELEASE(ptr, val)        __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define MPSC_CAS(ptr, expected, desired)    __atomic_compare_exchange_n((ptr), (expected), (desired), 0, \
+                                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+MpscRing *mpsc_ring_new(uint32_t size)
+{
+    MpscRing *ring;
+    uint32_t capacity = 1;
+    uint32_t i;
+
+    if (0 == size || size > 0x80000000UL) {
+        return NULL;
+    }
+
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+
+    ring = (MpscRing *)HAL_Malloc(sizeof(MpscRing));
+    if (NULL == ring) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(MpscRing));
+
+    ring->cells = (MpscRingCell *)HAL_Malloc(capacity * sizeof(MpscRingCell));
+    if (NULL == ring->cells) {
+        HAL_Free(ring);
+        return NULL;
+    }
+
+    for (i = 0; i < capacity; ++i) {
+        ring->cells[i].seq = i;
+        ring->cells[i].data = NULL;
+    }
+    ring->mask = capacity - 1;
+
+    return ring;
+}
+
+void mpsc_ring_destroy(MpscRing *ring)
+{
+    if (NULL == ring) {
+        return;
+    }
+
+    HAL_Free(ring->cells);
+    HAL_Free(ring);
+}
+
+int mpsc_ring_push(MpscRing *ring, void *data)
+{
+    MpscRingCell *cell;
+    uint32_t pos;
+    int32_t diff;
+
+    pos = MPSC_LOAD_RELAXED(&ring->enqueue_pos);
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        diff = (int32_t)(MPSC_LOAD_ACQUIRE(&cell->seq) - pos);
+        if (0 == diff) {
+            /* 单元空闲, 抢占该入队位置; 失败时pos被更新为最新的入队位置 */
+            if (MPSC_CAS(&ring->enqueue_pos, &pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* 单元中的数据还未被消费者取走, 队列已满 */
+            return -1;
+        } else {
+            pos = MPSC_LOAD_RELAXED(&ring->enqueue_pos);
+        }
+    }
+
+    cell->data = data;
+    MPSC_STORE_RELEASE(&cell->seq, pos + 1);
+
+    return 0;
+}
+
+void *mpsc_ring_pop(MpscRing *ring)
+{
+    MpscRingCell *cell = &ring->cells[ring->dequeue_pos & ring->mask];
+    void *data;
+
+    /* 生产者尚未写完该单元时同样视为空 */
+    if ((int32_t)(MPSC_LOAD_ACQUIRE(&cell->seq) - (ring->dequeue_pos + 1)) < 0) {
+        return NULL;
+    }
+
+    data = cell->data;
+    MPSC_STORE_RELEASE(&cell->seq, ring->dequeue_pos + ring->mask + 1);
+    ring->dequeue_pos++;
+
+    return data;
+}
+
+#ifdef __cplusplus
+}
+#endif
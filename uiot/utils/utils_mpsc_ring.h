@@ -0,0 +1,58 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifndef C_SDK_UTILS_MPSC_RING_H_
+#define C_SDK_UTILS_MPSC_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* 环形队列单元, seq标记该单元当前可被哪一个入队/出队位置使用 */
+typedef struct {
+    volatile uint32_t       seq;
+    void                    *data;
+} MpscRingCell;
+
+/*
+ * 有界的多生产者单消费者无锁环形队列.
+ * 生产者通过原子比较交换抢占入队位置, 单个消费者按顺序出队, 入队和出队都不需要加锁.
+ */
+typedef struct {
+    MpscRingCell            *cells;         /* 队列单元数组 */
+    uint32_t                mask;           /* 队列容量减一, 容量为2的幂 */
+    volatile uint32_t       enqueue_pos;    /* 下一个入队位置, 由生产者原子递增 */
+    uint32_t                dequeue_pos;    /* 下一个出队位置, 只由消费者访问 */
+} MpscRing;
+
+/* 创建容量不小于size的队列, 容量向上取整为2的幂. 失败则返回NULL. */
+MpscRing *mpsc_ring_new(uint32_t size);
+
+/* 释放队列, 队列中剩余的数据由调用者先行取出. */
+void mpsc_ring_destroy(MpscRing *ring);
+
+/* 入队, 可由多个线程同时调用. 成功返回0, 队列已满返回-1. */
+int mpsc_ring_push(MpscRing *ring, void *data);
+
+/* 出队, 只能由单个消费者线程调用. 队列为空返回NULL. */
+void *mpsc_ring_pop(MpscRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //C_SDK_UTILS_MPSC_RING_H_
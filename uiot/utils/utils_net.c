@@ -37,6 +37,26 @@ static int read_ssl(utils_network_pt pNetwork, unsigned char *buffer, size_t len
     return HAL_TLS_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
 }
 
+static int read_avail_ssl(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TLS_ReadAvail((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+}
+
+static int wait_readable_ssl(utils_network_pt pNetwork, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TLS_WaitReadable((uintptr_t)pNetwork->handle, timeout_ms);
+}
+
 static int write_ssl(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
 {
     if (NULL == pNetwork) {
@@ -47,6 +67,16 @@ static int write_ssl(utils_network_pt pNetwork, unsigned char *buffer, size_t le
     return HAL_TLS_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
 }
 
+static int writev_ssl(utils_network_pt pNetwork, utils_iovec_t *iov, int iovcnt, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TLS_Writev((uintptr_t)pNetwork->handle, iov, iovcnt, timeout_ms);
+}
+
 static int disconnect_ssl(utils_network_pt pNetwork)
 {
     if (NULL == pNetwork) {
@@ -54,6 +84,12 @@ static int disconnect_ssl(utils_network_pt pNetwork)
         return FAILURE_RET;
     }
 
+    // 断开前保存会话, 下次连接时尝试恢复以省去完整握手
+    if (pNetwork->tls_session_cache && 0 != pNetwork->handle
+        && SUCCESS_RET != HAL_TLS_SaveSession((uintptr_t)pNetwork->handle, &pNetwork->tls_session)) {
+        LOG_DEBUG("save tls session failed");
+    }
+
     HAL_TLS_Disconnect((uintptr_t)pNetwork->handle);
     pNetwork->handle = 0;
 
@@ -67,12 +103,15 @@ static int connect_ssl(utils_network_pt pNetwork)
         return FAILURE_RET;
     }
 
-    if (0 != (pNetwork->handle = (intptr_t)HAL_TLS_Connect(
+    pNetwork->tls_resumed = 0;
+    if (0 != (pNetwork->handle = (intptr_t)HAL_TLS_ConnectResume(
             pNetwork->pHostAddress,
             pNetwork->port,
             pNetwork->authmode,
             pNetwork->ca_crt,
-            pNetwork->ca_crt_len))) {
+            pNetwork->ca_crt_len,
+            pNetwork->tls_session_cache ? pNetwork->tls_session : NULL,
+            &pNetwork->tls_resumed))) {
         return SUCCESS_RET;
     }
     else {
@@ -92,6 +131,26 @@ static int read_tcp(utils_network_pt pNetwork, unsigned char *buffer, size_t len
     return HAL_TCP_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
 }
 
+static int read_avail_tcp(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TCP_ReadAvail((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+}
+
+
+static int wait_readable_tcp(utils_network_pt pNetwork, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TCP_WaitReadable((uintptr_t)pNetwork->handle, timeout_ms);
+}
 
 static int write_tcp(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
 {
@@ -103,6 +162,16 @@ static int write_tcp(utils_network_pt pNetwork, unsigned char *buffer, size_t le
     return HAL_TCP_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
 }
 
+static int writev_tcp(utils_network_pt pNetwork, utils_iovec_t *iov, int iovcnt, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    return HAL_TCP_Writev((uintptr_t)pNetwork->handle, iov, iovcnt, timeout_ms);
+}
+
 static int disconnect_tcp(utils_network_pt pNetwork)
 {
     if (NULL == pNetwork) {
@@ -144,6 +213,66 @@ int utils_net_read(utils_network_pt pNetwork, unsigned char *buffer, size_t len,
     return ret;
 }
 
+int utils_net_read_avail(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
+{
+    int ret = 0;
+#ifdef PKG_USING_UCLOUD_TLS
+        ret = read_avail_ssl(pNetwork, buffer, len, timeout_ms);
+#else
+        ret = read_avail_tcp(pNetwork, buffer, len, timeout_ms);
+#endif
+
+    return ret;
+}
+
+int utils_net_wait_readable(utils_network_pt pNetwork, uint32_t timeout_ms)
+{
+    int ret = 0;
+
+    /* 预读缓冲区中还有数据时无需等待 */
+    if (utils_net_ring_pending(pNetwork) > 0) {
+        return 1;
+    }
+
+#ifdef PKG_USING_UCLOUD_TLS
+        ret = wait_readable_ssl(pNetwork, timeout_ms);
+#else
+        ret = wait_readable_tcp(pNetwork, timeout_ms);
+#endif
+
+    return ret;
+}
+
+int utils_net_wait_readable_many(utils_network_pt *networks, uint8_t *readable, int count, uint32_t timeout_ms)
+{
+    uintptr_t handles[UTILS_NET_WAIT_MANY_MAX];
+    int ret = 0;
+    int i;
+
+    if (NULL == networks || NULL == readable || count <= 0 || count > UTILS_NET_WAIT_MANY_MAX) {
+        LOG_ERROR("invalid network set");
+        return FAILURE_RET;
+    }
+
+    /* 任一连接的预读缓冲区中还有数据时无需等待 */
+    for (i = 0; i < count; ++i) {
+        readable[i] = (utils_net_ring_pending(networks[i]) > 0) ? 1 : 0;
+        ret += readable[i];
+        handles[i] = networks[i]->handle;
+    }
+    if (ret > 0) {
+        return ret;
+    }
+
+#ifdef PKG_USING_UCLOUD_TLS
+        ret = HAL_TLS_WaitReadableMany(handles, readable, count, timeout_ms);
+#else
+        ret = HAL_TCP_WaitReadableMany(handles, readable, count, timeout_ms);
+#endif
+
+    return ret;
+}
+
 int utils_net_write(utils_network_pt pNetwork,unsigned char *buffer, size_t len, uint32_t timeout_ms)
 {
     int ret = 0;
@@ -156,9 +285,23 @@ int utils_net_write(utils_network_pt pNetwork,unsigned char *buffer, size_t len,
     return ret;
 }
 
+int utils_net_writev(utils_network_pt pNetwork, utils_iovec_t *iov, int iovcnt, uint32_t timeout_ms)
+{
+    int ret = 0;
+#ifdef PKG_USING_UCLOUD_TLS
+        ret = writev_ssl(pNetwork, iov, iovcnt, timeout_ms);
+#else
+        ret = writev_tcp(pNetwork, iov, iovcnt, timeout_ms);
+#endif
+
+    return ret;
+}
+
 int utils_net_disconnect(utils_network_pt pNetwork)
 {
     int ret = 0;
+
+    utils_net_ring_reset(pNetwork);
 #ifdef PKG_USING_UCLOUD_TLS
         ret = disconnect_ssl(pNetwork);
 #else
@@ -171,6 +314,8 @@ int utils_net_disconnect(utils_network_pt pNetwork)
 int utils_net_connect(utils_network_pt pNetwork)
 {
     int ret = 0;
+
+    utils_net_ring_reset(pNetwork);
 #ifdef PKG_USING_UCLOUD_TLS
         ret = connect_ssl(pNetwork);
 #else
@@ -199,10 +344,151 @@ int utils_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, u
 
     pNetwork->handle = 0;
     pNetwork->read = utils_net_read;
+    pNetwork->read_avail = utils_net_read_avail;
+    pNetwork->wait_readable = utils_net_wait_readable;
     pNetwork->write = utils_net_write;
+    pNetwork->writev = utils_net_writev;
     pNetwork->disconnect = utils_net_disconnect;
     pNetwork->connect = utils_net_connect;
 
+    pNetwork->rx_ring = NULL;
+    pNetwork->rx_ring_size = 0;
+    pNetwork->rx_ring_head = 0;
+    pNetwork->rx_ring_len = 0;
+
+    pNetwork->tls_session_cache = 0;
+    pNetwork->tls_resumed = 0;
+    pNetwork->tls_session = NULL;
+
     return SUCCESS_RET;
 }
 
+void utils_net_session_free(utils_network_pt pNetwork)
+{
+    if (NULL == pNetwork) {
+        return;
+    }
+
+#ifdef PKG_USING_UCLOUD_TLS
+    if (NULL != pNetwork->tls_session) {
+        HAL_TLS_FreeSession(pNetwork->tls_session);
+    }
+#endif
+    pNetwork->tls_session = NULL;
+    pNetwork->tls_resumed = 0;
+}
+
+/****** read-ahead buffer ******/
+int utils_net_ring_init(utils_network_pt pNetwork, size_t size)
+{
+    if (NULL == pNetwork) {
+        LOG_ERROR("network is null");
+        return FAILURE_RET;
+    }
+
+    utils_net_ring_deinit(pNetwork);
+    if (0 == size) {
+        return SUCCESS_RET;
+    }
+
+    pNetwork->rx_ring = (unsigned char *)HAL_Malloc(size);
+    if (NULL == pNetwork->rx_ring) {
+        LOG_ERROR("malloc rx ring failed");
+        return FAILURE_RET;
+    }
+    pNetwork->rx_ring_size = size;
+
+    return SUCCESS_RET;
+}
+
+void utils_net_ring_deinit(utils_network_pt pNetwork)
+{
+    if (NULL == pNetwork) {
+        return;
+    }
+
+    if (NULL != pNetwork->rx_ring) {
+        HAL_Free(pNetwork->rx_ring);
+    }
+    pNetwork->rx_ring = NULL;
+    pNetwork->rx_ring_size = 0;
+    pNetwork->rx_ring_head = 0;
+    pNetwork->rx_ring_len = 0;
+}
+
+void utils_net_ring_reset(utils_network_pt pNetwork)
+{
+    if (NULL == pNetwork) {
+        return;
+    }
+
+    pNetwork->rx_ring_head = 0;
+    pNetwork->rx_ring_len = 0;
+}
+
+size_t utils_net_ring_pending(utils_network_pt pNetwork)
+{
+    if (NULL == pNetwork) {
+        return 0;
+    }
+
+    return pNetwork->rx_ring_len;
+}
+
+int utils_net_ring_read(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms)
+{
+    Timer timer;
+    size_t read_len = 0;
+    uint32_t left_ms = 0;
+    int ret = 0;
+
+    if (NULL == pNetwork || NULL == buffer) {
+        LOG_ERROR("parameter error! pNetwork=%p, buffer = %p", pNetwork, buffer);
+        return FAILURE_RET;
+    }
+
+    if (NULL == pNetwork->rx_ring) {
+        return pNetwork->read(pNetwork, buffer, len, timeout_ms);
+    }
+
+    HAL_Timer_Init(&timer);
+    HAL_Timer_Countdown_ms(&timer, timeout_ms);
+
+    while (read_len < len) {
+        /* 先取走缓冲区中已有的数据 */
+        if (pNetwork->rx_ring_len > 0) {
+            size_t copy_len = Min(pNetwork->rx_ring_len, len - read_len);
+            memcpy(buffer + read_len, pNetwork->rx_ring + pNetwork->rx_ring_head, copy_len);
+            pNetwork->rx_ring_head += copy_len;
+            pNetwork->rx_ring_len -= copy_len;
+            read_len += copy_len;
+            continue;
+        }
+
+        left_ms = HAL_Timer_Expired(&timer) ? 0 : HAL_Timer_Remain_ms(&timer);
+        if (read_len > 0 && 0 == left_ms) {
+            break;
+        }
+
+        /* 缓冲区已空, 剩余数据不少于缓冲区大小时直接读入目标地址, 否则整块预读 */
+        if (len - read_len >= pNetwork->rx_ring_size) {
+            ret = pNetwork->read_avail(pNetwork, buffer + read_len, len - read_len, left_ms);
+            if (ret > 0) {
+                read_len += ret;
+            }
+        } else {
+            pNetwork->rx_ring_head = 0;
+            ret = pNetwork->read_avail(pNetwork, pNetwork->rx_ring, pNetwork->rx_ring_size, left_ms);
+            if (ret > 0) {
+                pNetwork->rx_ring_len = ret;
+            }
+        }
+
+        if (ret < 0 || (0 == ret && HAL_Timer_Expired(&timer))) {
+            break;
+        }
+    }
+
+    return (0 != read_len) ? (int)read_len : ret;
+}
+
@@ -32,6 +32,17 @@
 struct utils_network;
 typedef struct utils_network utils_network_t, *utils_network_pt;
 
+/**
+ * @brief 分散写的数据块, 多个数据块按顺序连续发送
+ */
+typedef struct {
+    unsigned char *base;
+    size_t len;
+} utils_iovec_t;
+
+/* utils_net_wait_readable_many单次最多等待的连接个数 */
+#define UTILS_NET_WAIT_MANY_MAX     (64)
+
 typedef enum
 {
     SSL_CA_VERIFY_NONE = 0,         
@@ -55,22 +66,104 @@ struct utils_network {
     /**< Read data from server function pointer. */
     int (*read)(utils_network_pt,unsigned char *, size_t, uint32_t);
 
+    /**< Read whatever data has arrived (at least one byte) function pointer. */
+    int (*read_avail)(utils_network_pt,unsigned char *, size_t, uint32_t);
+
+    /**< Wait until data can be read or timeout function pointer. */
+    int (*wait_readable)(utils_network_pt, uint32_t);
+
     /**< Send data to server function pointer. */
     int (*write)(utils_network_pt,unsigned char *, size_t, uint32_t);
 
+    /**< Send several data blocks to server in order function pointer. */
+    int (*writev)(utils_network_pt,utils_iovec_t *, int, uint32_t);
+
     /**< Disconnect the network */
     int (*disconnect)(utils_network_pt);
 
     /**< Establish the network */
     int (*connect)(utils_network_pt);
+
+    /**< read-ahead buffer: NULL, read directly from the connection */
+    unsigned char *rx_ring;
+    size_t rx_ring_size;
+    /**< offset of the first unread byte in rx_ring */
+    size_t rx_ring_head;
+    /**< number of unread bytes in rx_ring */
+    size_t rx_ring_len;
+
+    /**< 0, do not keep TLS session; 1, keep TLS session on disconnect and try to resume it on next connect */
+    uint8_t tls_session_cache;
+    /**< 1, the last TLS connection resumed a saved session */
+    uint8_t tls_resumed;
+    /**< saved TLS session, owned by the TLS HAL */
+    void *tls_session;
 };
 
 int utils_net_read(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms);
+int utils_net_read_avail(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms);
+int utils_net_wait_readable(utils_network_pt pNetwork, uint32_t timeout_ms);
+int utils_net_wait_readable_many(utils_network_pt *networks, uint8_t *readable, int count, uint32_t timeout_ms);
 int utils_net_write(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms);
+int utils_net_writev(utils_network_pt pNetwork, utils_iovec_t *iov, int iovcnt, uint32_t timeout_ms);
 int utils_net_disconnect(utils_network_pt pNetwork);
 int utils_net_connect(utils_network_pt pNetwork);
 int utils_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, uint16_t authmode, const char *ca_crt);
 
+/**
+ * @brief 释放保存的TLS会话, 下次连接进行完整握手
+ *
+ * @param pNetwork 网络连接结构体
+ */
+void utils_net_session_free(utils_network_pt pNetwork);
+
+/**
+ * @brief 为网络连接开辟接收预读缓冲区
+ *
+ * 开启后每次访问底层连接都会尽可能多地读取已到达的数据, 后续读取优先从缓冲区中获取,
+ * 以减少对底层TCP/TLS/AT接口的调用次数
+ *
+ * @param pNetwork 网络连接结构体
+ * @param size     缓冲区大小, 为0时不开启预读
+ * @return         返回SUCCESS, 表示成功
+ */
+int utils_net_ring_init(utils_network_pt pNetwork, size_t size);
+
+/**
+ * @brief 释放接收预读缓冲区
+ *
+ * @param pNetwork 网络连接结构体
+ */
+void utils_net_ring_deinit(utils_network_pt pNetwork);
+
+/**
+ * @brief 丢弃预读缓冲区中尚未读取的数据, 连接建立或断开时调用
+ *
+ * @param pNetwork 网络连接结构体
+ */
+void utils_net_ring_reset(utils_network_pt pNetwork);
+
+/**
+ * @brief 经由预读缓冲区读取指定长度的数据
+ *
+ * 优先从缓冲区中读取, 缓冲区为空时再从底层连接中预读; 未开启预读时等同于pNetwork->read
+ *
+ * @param pNetwork   网络连接结构体
+ * @param buffer     数据接收缓冲区
+ * @param len        需要读取的字节数
+ * @param timeout_ms 超时时间, 单位:ms
+ * @return           <0: 读取错误; =0: 读超时, 且没有读取任何数据; >0: 成功读取的字节数
+ */
+int utils_net_ring_read(utils_network_pt pNetwork, unsigned char *buffer, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief 获取预读缓冲区中尚未读取的字节数
+ *
+ * @param pNetwork 网络连接结构体
+ * @return         未读取的字节数
+ */
+size_t utils_net_ring_pending(utils_network_pt pNetwork);
+
 #endif /* C_SDK_UTILS_NET_H_ */
 
 
@@ -0,0 +1,397 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "utils_topic_trie.h"
+
+#include "uiot_import.h"
+
+#define TOPIC_TRIE_CHILD_INIT_CAP   4
+
+static TopicTrieNode *_topic_trie_node_new(const char *level, size_t level_len)
+{
+    TopicTrieNode *node = (TopicTrieNode *)HAL_Malloc(sizeof(TopicTrieNode));
+    if (NULL == node) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(TopicTrieNode));
+    node->value = -1;
+
+    if (level_len > 0) {
+        node->level = (char *)HAL_Malloc(level_len);
+        if (NULL == node->level) {
+            HAL_Free(node);
+            return NULL;
+        }
+        memcpy(node->level, level, level_len);
+    }
+    node->level_len = level_len;
+
+    return node;
+}
+
+static void _topic_trie_node_free(TopicTrieNode *node)
+{
+    uint16_t i;
+
+    if (NULL == node) {
+        return;
+    }
+
+    for (i = 0; i < node->child_num; ++i) {
+        _topic_trie_node_free(node->children[i]);
+    }
+    _topic_trie_node_free(node->plus);
+    _topic_trie_node_free(node->hash);
+
+    HAL_Free(node->children);
+    HAL_Free(node->level);
+    HAL_Free(node);
+}
+
+static int _topic_trie_level_cmp(TopicTrieNode *node, const char *level, size_t level_len)
+{
+    size_t min_len = (node->level_len < level_len) ? node->level_len : level_len;
+    int ret = (min_len > 0) ? memcmp(node->level, level, min_len) : 0;
+
+    if (0 != ret) {
+        return ret;
+    }
+
+    return (node->level_len == level_len) ? 0 : ((node->level_len < level_len) ? -1 : 1);
+}
+
+/*
+ * 二分查找普通子节点, 找到返回其下标, 否则返回-1并通过pos返回插入位置.
+ */
+static int _topic_trie_child_search(TopicTrieNode *node, const char *level, size_t level_len, uint16_t *pos)
+{
+    int low = 0;
+    int high = (int)node->child_num - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int ret = _topic_trie_level_cmp(node->children[mid], level, level_len);
+        if (0 == ret) {
+            return mid;
+        } else if (ret < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (NULL != pos) {
+        *pos = (uint16_t)low;
+    }
+
+    return -1;
+}
+
+static TopicTrieNode *_topic_trie_child_get(TopicTrieNode *node, const char *level, size_t level_len, int create)
+{
+    uint16_t pos = 0;
+    int index;
+    TopicTrieNode *child;
+
+    if (1 == level_len && '+' == level[0]) {
+        if (NULL == node->plus && create) {
+            node->plus = _topic_trie_node_new(level, level_len);
+        }
+        return node->plus;
+    }
+
+    if (1 == level_len && '#' == level[0]) {
+        if (NULL == node->hash && create) {
+            node->hash = _topic_trie_node_new(level, level_len);
+        }
+        return node->hash;
+    }
+
+    index = _topic_trie_child_search(node, level, level_len, &pos);
+    if (index >= 0) {
+        return node->children[index];
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    if (node->child_num == node->child_cap) {
+        uint16_t new_cap = (0 == node->child_cap) ? TOPIC_TRIE_CHILD_INIT_CAP : (uint16_t)(node->child_cap * 2);
+        TopicTrieNode **children = (TopicTrieNode **)HAL_Malloc(new_cap * sizeof(TopicTrieNode *));
+        if (NULL == children) {
+            return NULL;
+        }
+        if (node->child_num > 0) {
+            memcpy(children, node->children, node->child_num * sizeof(TopicTrieNode *));
+        }
+        HAL_Free(node->children);
+        node->children = children;
+        node->child_cap = new_cap;
+    }
+
+    child = _topic_trie_node_new(level, level_len);
+    if (NULL == child) {
+        return NULL;
+    }
+
+    memmove(&node->children[pos + 1], &node->children[pos], (node->child_num - pos) * sizeof(TopicTrieNode *));
+    node->children[pos] = child;
+    node->child_num++;
+
+    return child;
+}
+
+static int _topic_trie_node_is_empty(TopicTrieNode *node)
+{
+    return (-1 == node->value && 0 == node->child_num && NULL == node->plus && NULL == node->hash);
+}
+
+/*
+ * 创建主题树. 失败则返回NULL.
+ */
+TopicTrieNode *topic_trie_new(void)
+{
+    return _topic_trie_node_new(NULL, 0);
+}
+
+/*
+ * 释放主题树的内存.
+ */
+void topic_trie_destroy(TopicTrieNode *root)
+{
+    _topic_trie_node_free(root);
+}
+
+/*
+ * 清空主题树, 保留根节点.
+ */
+void topic_trie_clear(TopicTrieNode *root)
+{
+    uint16_t i;
+
+    if (NULL == root) {
+        return;
+    }
+
+    for (i = 0; i < root->child_num; ++i) {
+        _topic_trie_node_free(root->children[i]);
+    }
+    _topic_trie_node_free(root->plus);
+    _topic_trie_node_free(root->hash);
+    HAL_Free(root->children);
+
+    root->children = NULL;
+    root->child_num = 0;
+    root->child_cap = 0;
+    root->plus = NULL;
+    root->hash = NULL;
+    root->value = -1;
+}
+
+/*
+ * 按'/'逐层插入主题过滤器, 叶子节点记录value.
+ */
+int topic_trie_insert(TopicTrieNode *root, const char *topic_filter, int value)
+{
+    const char *level = topic_filter;
+    const char *end;
+    TopicTrieNode *node = root;
+
+    if (NULL == root || NULL == topic_filter) {
+        return -1;
+    }
+
+    for (;;) {
+        end = strchr(level, '/');
+        if (NULL == end) {
+            end = level + strlen(level);
+        }
+
+        node = _topic_trie_child_get(node, level, (size_t)(end - level), 1);
+        if (NULL == node) {
+            return -1;
+        }
+
+        if ('\0' == *end) {
+            break;
+        }
+        level = end + 1;
+    }
+
+    node->value = value;
+    return 0;
+}
+
+/*
+ * 查找与主题过滤器完全相同的节点.
+ */
+int topic_trie_find(TopicTrieNode *root, const char *topic_filter)
+{
+    const char *level = topic_filter;
+    const char *end;
+    TopicTrieNode *node = root;
+
+    if (NULL == root || NULL == topic_filter) {
+        return -1;
+    }
+
+    for (;;) {
+        end = strchr(level, '/');
+        if (NULL == end) {
+            end = level + strlen(level);
+        }
+
+        node = _topic_trie_child_get(node, level, (size_t)(end - level), 0);
+        if (NULL == node) {
+            return -1;
+        }
+
+        if ('\0' == *end) {
+            break;
+        }
+        level = end + 1;
+    }
+
+    return node->value;
+}
+
+/*
+ * 递归删除主题过滤器, 返回1表示node已无用, 可以被父节点回收.
+ */
+static int _topic_trie_remove(TopicTrieNode *node, const char *level)
+{
+    const char *end = strchr(level, '/');
+    size_t level_len;
+    TopicTrieNode *child;
+    uint16_t i;
+
+    if (NULL == end) {
+        end = level + strlen(level);
+    }
+    level_len = (size_t)(end - level);
+
+    child = _topic_trie_child_get(node, level, level_len, 0);
+    if (NULL == child) {
+        return 0;
+    }
+
+    if ('\0' == *end) {
+        child->value = -1;
+    } else if (0 == _topic_trie_remove(child, end + 1)) {
+        return 0;
+    }
+
+    if (!_topic_trie_node_is_empty(child)) {
+        return 0;
+    }
+
+    if (child == node->plus) {
+        node->plus = NULL;
+    } else if (child == node->hash) {
+        node->hash = NULL;
+    } else {
+        for (i = 0; i < node->child_num; ++i) {
+            if (node->children[i] == child) {
+                memmove(&node->children[i], &node->children[i + 1], (node->child_num - i - 1) * sizeof(TopicTrieNode *));
+                node->child_num--;
+                break;
+            }
+        }
+    }
+    _topic_trie_node_free(child);
+
+    return _topic_trie_node_is_empty(node);
+}
+
+void topic_trie_remove(TopicTrieNode *root, const char *topic_filter)
+{
+    if (NULL == root || NULL == topic_filter) {
+        return;
+    }
+
+    (void)_topic_trie_remove(root, topic_filter);
+}
+
+static int _topic_trie_min_value(int a, int b)
+{
+    if (a < 0) {
+        return b;
+    }
+    if (b < 0) {
+        return a;
+    }
+    return (a < b) ? a : b;
+}
+
+/*
+ * 从pos开始匹配主题剩余的层, pos大于topic_len表示所有层已经匹配完.
+ */
+static int _topic_trie_match(TopicTrieNode *node, const char *topic, size_t topic_len, size_t pos)
+{
+    int value = -1;
+    size_t end;
+    TopicTrieNode *child;
+
+    if (pos > topic_len) {
+        /* 'a/#' 同样匹配 'a' */
+        value = node->value;
+        if (NULL != node->hash) {
+            value = _topic_trie_min_value(value, node->hash->value);
+        }
+        return value;
+    }
+
+    /* 以'$'开头的主题不与首层的通配符匹配 */
+    if (!(0 == pos && topic_len > 0 && '$' == topic[0])) {
+        if (NULL != node->hash) {
+            value = node->hash->value;
+        }
+        if (NULL != node->plus) {
+            for (end = pos; end < topic_len && '/' != topic[end]; ++end);
+            value = _topic_trie_min_value(value, _topic_trie_match(node->plus, topic, topic_len, end + 1));
+        }
+    }
+
+    for (end = pos; end < topic_len && '/' != topic[end]; ++end);
+    if (node->child_num > 0) {
+        int index = _topic_trie_child_search(node, topic + pos, end - pos, NULL);
+        if (index >= 0) {
+            child = node->children[index];
+            value = _topic_trie_min_value(value, _topic_trie_match(child, topic, topic_len, end + 1));
+        }
+    }
+
+    return value;
+}
+
+int topic_trie_match(TopicTrieNode *root, const char *topic, size_t topic_len)
+{
+    if (NULL == root || NULL == topic) {
+        return -1;
+    }
+
+    return _topic_trie_match(root, topic, topic_len, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
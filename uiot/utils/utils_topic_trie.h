@@ -0,0 +1,67 @@
+/*
+* Copyright (C) 2012-2019 UCloud. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+#ifndef C_SDK_UTILS_TOPIC_TRIE_H_
+#define C_SDK_UTILS_TOPIC_TRIE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * 主题树节点定义. 每个节点对应主题过滤器中的一层, '+'和'#'作为特殊子节点单独保存.
+ */
+typedef struct TopicTrieNode {
+    char                    *level;         /* 本层名称 */
+    size_t                  level_len;      /* 本层名称长度 */
+    struct TopicTrieNode    **children;     /* 普通子节点, 按名称排序 */
+    uint16_t                child_num;      /* 普通子节点个数 */
+    uint16_t                child_cap;      /* 普通子节点数组容量 */
+    struct TopicTrieNode    *plus;          /* '+' 子节点 */
+    struct TopicTrieNode    *hash;          /* '#' 子节点 */
+    int                     value;          /* 以本节点结尾的主题过滤器对应的值, -1表示无 */
+} TopicTrieNode;
+
+/* 创建主题树. 失败则返回NULL. */
+TopicTrieNode *topic_trie_new(void);
+
+/* 释放主题树. */
+void topic_trie_destroy(TopicTrieNode *root);
+
+/* 清空主题树中的所有主题过滤器. */
+void topic_trie_clear(TopicTrieNode *root);
+
+/* 插入主题过滤器, 已存在时更新其值. 成功返回0, 失败返回-1. */
+int topic_trie_insert(TopicTrieNode *root, const char *topic_filter, int value);
+
+/* 查找与主题过滤器完全相同的节点的值, 不存在返回-1. */
+int topic_trie_find(TopicTrieNode *root, const char *topic_filter);
+
+/* 删除主题过滤器, 并回收不再使用的节点. */
+void topic_trie_remove(TopicTrieNode *root, const char *topic_filter);
+
+/*
+ * 匹配不含通配符的主题名, 返回所有匹配的主题过滤器中最小的值, 没有匹配返回-1.
+ * 匹配开销只与主题层数有关, 与主题过滤器的个数无关.
+ */
+int topic_trie_match(TopicTrieNode *root, const char *topic, size_t topic_len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //C_SDK_UTILS_TOPIC_TRIE_H_